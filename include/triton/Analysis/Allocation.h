@@ -162,6 +162,12 @@ public:
   /// Returns the size of total shared memory allocated
   size_t getSharedMemorySize() const { return sharedMemorySize; }
 
+  /// Returns the size of total shared memory that first-fit graph coloring
+  /// allocates, which the packed allocation never exceeds
+  size_t getFirstFitSharedMemorySize() const {
+    return firstFitSharedMemorySize;
+  }
+
   /// Returns mapping from operation to list of live LDS buffers
   std::map<Operation *, SmallVector<BufferId>> getLiveBuffers();
 
@@ -231,6 +237,7 @@ private:
   AliasBufferMapT aliasBuffer;
   BufferSetT bufferSet;
   size_t sharedMemorySize = 0;
+  size_t firstFitSharedMemorySize = 0;
 
   friend class triton::AllocationAnalysis;
 };
@@ -2,62 +2,240 @@
 #define TRITON_ANALYSIS_MEMBAR_H
 
 #include "Allocation.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SmallPtrSet.h"
 
-#include <set>
+#include <algorithm>
+#include <iterator>
+#include <map>
 
 namespace mlir {
 
+class DominanceInfo;
 class OpBuilder;
 
+/// A set of addresses stored as disjoint intervals, where intervals that
+/// overlap or touch are coalesced. Testing an interval for intersection takes
+/// logarithmic time in the number of intervals.
+class IntervalSet {
+public:
+  IntervalSet() = default;
+
+  bool empty() const { return intervals.empty(); }
+
+  size_t size() const { return intervals.size(); }
+
+  void clear() { intervals.clear(); }
+
+  /// Adds the addresses of the interval.
+  void insert(Interval<size_t> interval) {
+    auto start = interval.start();
+    auto end = interval.end();
+    if (start == end)
+      return;
+    // The first interval that may overlap or touch the new one
+    auto it = intervals.upper_bound(start);
+    if (it != intervals.begin() && std::prev(it)->second >= start)
+      --it;
+    while (it != intervals.end() && it->first <= end) {
+      start = std::min(start, it->first);
+      end = std::max(end, it->second);
+      it = intervals.erase(it);
+    }
+    intervals.emplace_hint(it, start, end);
+  }
+
+  /// Adds the addresses of the other set.
+  void insert(const IntervalSet &other) {
+    if (empty()) {
+      intervals = other.intervals;
+      return;
+    }
+    for (auto [start, end] : other.intervals)
+      insert(Interval<size_t>(start, end));
+  }
+
+  /// Returns true if the set contains any address of the interval.
+  bool intersects(Interval<size_t> interval) const {
+    if (interval.start() == interval.end())
+      return false;
+    auto it = intervals.upper_bound(interval.start());
+    if (it != intervals.begin() && std::prev(it)->second > interval.start())
+      return true;
+    return it != intervals.end() && it->first < interval.end();
+  }
+
+  /// Returns true if the sets have any address in common.
+  bool intersects(const IntervalSet &other) const {
+    // Look up the intervals of the smaller set in the larger one
+    if (size() > other.size())
+      return other.intersects(*this);
+    for (auto [start, end] : intervals) {
+      if (other.intersects(Interval<size_t>(start, end)))
+        return true;
+    }
+    return false;
+  }
+
+  bool operator==(const IntervalSet &other) const {
+    return intervals == other.intervals;
+  }
+
+  bool operator!=(const IntervalSet &other) const { return !(*this == other); }
+
+private:
+  /// Start -> End
+  std::map<size_t, size_t> intervals;
+};
+
+/// Marks a gpu.barrier that only synchronizes the threads of each warp.
+constexpr static char AttrWarpSyncName[] = "warp_sync";
+
 struct BlockInfo {
-  using IntervalSetT = std::set<Interval<size_t>>;
+  using IntervalSetT = IntervalSet;
+
+  /// An access to a buffer in which every element is accessed by a single
+  /// warp, so that it only has to be ordered by a barrier with the accesses of
+  /// other warps.
+  struct WarpAccess {
+    Interval<size_t> interval;
+    /// Since the last barrier
+    bool read = false;
+    bool write = false;
+    /// Since the last warp barrier
+    bool unsyncedRead = false;
+    bool unsyncedWrite = false;
+
+    bool operator==(const WarpAccess &other) const {
+      return interval == other.interval && read == other.read &&
+             write == other.write && unsyncedRead == other.unsyncedRead &&
+             unsyncedWrite == other.unsyncedWrite;
+    }
+  };
+
+  /// The buffer and the register type of a warp access.
+  using WarpAccessKeyT = std::pair<Value, Type>;
+  /// Returns true if two warp accesses access every element from the same
+  /// warp.
+  using SameWarpFnT =
+      llvm::function_ref<bool(const WarpAccessKeyT &, const WarpAccessKeyT &)>;
 
   IntervalSetT syncReadIntervals;
   IntervalSetT syncWriteIntervals;
+  /// Asynchronous writes that are not waited for yet, which are not synced by
+  /// barriers.
+  IntervalSetT asyncWriteIntervals;
+  llvm::MapVector<WarpAccessKeyT, WarpAccess> warpAccesses;
 
   BlockInfo() = default;
 
   /// Unions two BlockInfo objects.
   BlockInfo &join(const BlockInfo &other) {
-    syncReadIntervals.insert(other.syncReadIntervals.begin(),
-                             other.syncReadIntervals.end());
-    syncWriteIntervals.insert(other.syncWriteIntervals.begin(),
-                              other.syncWriteIntervals.end());
+    syncReadIntervals.insert(other.syncReadIntervals);
+    syncWriteIntervals.insert(other.syncWriteIntervals);
+    asyncWriteIntervals.insert(other.asyncWriteIntervals);
+    for (auto &[key, access] : other.warpAccesses) {
+      auto [it, inserted] = warpAccesses.insert({key, access});
+      if (inserted)
+        continue;
+      it->second.read |= access.read;
+      it->second.write |= access.write;
+      it->second.unsyncedRead |= access.unsyncedRead;
+      it->second.unsyncedWrite |= access.unsyncedWrite;
+    }
     return *this;
   }
 
-  /// Returns true if intervals in two BlockInfo objects are intersected.
-  bool isIntersected(const BlockInfo &other) const {
-    return /*RAW*/ isIntersected(syncWriteIntervals, other.syncReadIntervals) ||
-           /*WAR*/
-           isIntersected(syncReadIntervals, other.syncWriteIntervals) ||
-           /*WAW*/
-           isIntersected(syncWriteIntervals, other.syncWriteIntervals);
+  /// Returns true if intervals in two BlockInfo objects are intersected, i.e.
+  /// a barrier is needed between them. Warp accesses for which sameWarp holds
+  /// are not considered.
+  bool isIntersected(const BlockInfo &other,
+                     SameWarpFnT sameWarp = nullptr) const {
+    if (/*RAW*/ syncWriteIntervals.intersects(other.syncReadIntervals) ||
+        /*WAR*/
+        syncReadIntervals.intersects(other.syncWriteIntervals) ||
+        /*WAW*/
+        syncWriteIntervals.intersects(other.syncWriteIntervals))
+      return true;
+    for (auto &[key, access] : warpAccesses) {
+      if (isIntersected(access.interval, access.read, access.write,
+                        other.syncReadIntervals, other.syncWriteIntervals))
+        return true;
+    }
+    for (auto &[key, access] : other.warpAccesses) {
+      if (isIntersected(access.interval, access.read, access.write,
+                        syncReadIntervals, syncWriteIntervals))
+        return true;
+      for (auto &[thisKey, thisAccess] : warpAccesses) {
+        if ((!sameWarp || !sameWarp(thisKey, key)) &&
+            isIntersected(thisAccess.interval, thisAccess.read,
+                          thisAccess.write, access))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  /// Returns true if the warp accesses of two BlockInfo objects for which
+  /// sameWarp holds are intersected, i.e. a warp barrier is needed between
+  /// them.
+  bool isWarpIntersected(const BlockInfo &other, SameWarpFnT sameWarp) const {
+    for (auto &[key, access] : other.warpAccesses) {
+      for (auto &[thisKey, thisAccess] : warpAccesses) {
+        if (sameWarp(thisKey, key) &&
+            isIntersected(thisAccess.interval, thisAccess.unsyncedRead,
+                          thisAccess.unsyncedWrite, access))
+          return true;
+      }
+    }
+    return false;
   }
 
   /// Clears the intervals because a barrier is inserted.
   void sync() {
     syncReadIntervals.clear();
     syncWriteIntervals.clear();
+    warpAccesses.clear();
+  }
+
+  /// Clears the warp accesses that a warp barrier orders.
+  void syncWarps() {
+    for (auto &[key, access] : warpAccesses) {
+      access.unsyncedRead = false;
+      access.unsyncedWrite = false;
+    }
   }
 
   /// Compares two BlockInfo objects.
   bool operator==(const BlockInfo &other) const {
-    return syncReadIntervals == other.syncReadIntervals &&
-           syncWriteIntervals == other.syncWriteIntervals;
+    if (syncReadIntervals != other.syncReadIntervals ||
+        syncWriteIntervals != other.syncWriteIntervals ||
+        asyncWriteIntervals != other.asyncWriteIntervals ||
+        warpAccesses.size() != other.warpAccesses.size())
+      return false;
+    for (auto &[key, access] : warpAccesses) {
+      auto it = other.warpAccesses.find(key);
+      if (it == other.warpAccesses.end() || !(it->second == access))
+        return false;
+    }
+    return true;
   }
 
   bool operator!=(const BlockInfo &other) const { return !(*this == other); }
 
 private:
-  bool isIntersected(const IntervalSetT &lhsIntervalSet,
-                     const IntervalSetT &rhsIntervalSet) const {
-    for (auto &lhs : lhsIntervalSet)
-      for (auto &rhs : rhsIntervalSet)
-        if (lhs.intersects(rhs))
-          return true;
-    return false;
+  static bool isIntersected(Interval<size_t> interval, bool read, bool write,
+                            const IntervalSetT &readIntervals,
+                            const IntervalSetT &writeIntervals) {
+    return (write && (readIntervals.intersects(interval) ||
+                      writeIntervals.intersects(interval))) ||
+           (read && writeIntervals.intersects(interval));
+  }
+
+  static bool isIntersected(Interval<size_t> interval, bool read, bool write,
+                            const WarpAccess &other) {
+    return interval.intersects(other.interval) &&
+           ((write && (other.read || other.write)) || (read && other.write));
   }
 };
 
@@ -80,8 +258,19 @@ public:
   /// a shared memory read. If the temporary storage is written but not read,
   /// it is considered as the problem of the operation itself but not the membar
   /// analysis.
+  ///
+  /// With minimizeBarriers, the barriers are placed to be executed as rarely
+  /// as possible instead:
+  /// - A barrier for accesses that come from the block entering a loop is
+  /// placed at the end of that block rather than in the loop header.
+  /// - No barrier follows an async wait; the writes of the async copies only
+  /// need one before the first access that races with them.
+  /// - Accesses to a buffer with register layouts that put every element in
+  /// the same single warp only need a warp barrier between them.
   MembarAnalysis() = default;
-  explicit MembarAnalysis(Allocation *allocation) : allocation(allocation) {}
+  explicit MembarAnalysis(Allocation *allocation,
+                          bool minimizeBarriers = false)
+      : allocation(allocation), minimizeBarriers(minimizeBarriers) {}
 
   /// Runs the membar analysis to the given operation, inserts a barrier if
   /// necessary.
@@ -105,17 +294,69 @@ private:
   void resolve(FunctionOpInterface funcOp, FuncBlockInfoMapT *funcBlockInfoMap,
                OpBuilder *builder);
 
+  /// Places the barriers when minimizing them. Each round computes the
+  /// accesses that reach every block, assuming barriers right before the
+  /// hazards that are left, and places the barriers of the first block in
+  /// reverse post-order that has a hazard. Barriers only shrink the accesses,
+  /// so the blocks before it stay free of hazards.
+  void resolveMinimal(FunctionOpInterface funcOp,
+                      FuncBlockInfoMapT *funcBlockInfoMap, OpBuilder *builder);
+
   /// Updates the BlockInfo operation based on the operation.
   void update(Operation *operation, BlockInfo *blockInfo,
               FuncBlockInfoMapT *funcBlockInfoMap, OpBuilder *builder);
 
+  /// Updates the BlockInfo with the operations of the block when minimizing
+  /// barriers and returns true if any barrier is needed. Barriers are inserted
+  /// if a builder is given, and assumed otherwise.
+  bool visitBlock(Block *block, BlockInfo &blockInfo,
+                  FuncBlockInfoMapT *funcBlockInfoMap, OpBuilder *builder,
+                  const DenseMap<Block *, BlockInfo> &outputBlockInfoMap,
+                  DominanceInfo &domInfo);
+
+  /// Returns the block entering the loop that the block is in, at the end of
+  /// which a barrier can be placed for the accesses at the start of the
+  /// block, if they only race with accesses that come from it.
+  Block *getHoistBlock(Block *block, const BlockInfo &curBlockInfo,
+                       FuncBlockInfoMapT *funcBlockInfoMap,
+                       const DenseMap<Block *, BlockInfo> &outputBlockInfoMap,
+                       DominanceInfo &domInfo);
+
+  /// Returns the shared memory accesses of the operation, and the id of its
+  /// scratch buffer, if any.
+  BlockInfo getAccesses(Operation *operation,
+                        FuncBlockInfoMapT *funcBlockInfoMap,
+                        Allocation::BufferId &scratchBufferId);
+
+  /// Returns the key of the operation's access if it is a warp access, i.e.
+  /// it moves a tensor whose elements are each held by a single warp between
+  /// registers and a buffer allocated by local_alloc.
+  std::optional<BlockInfo::WarpAccessKeyT> getWarpAccessKey(Operation *op);
+
+  /// Returns true if two warp accesses access every element from the same
+  /// warp.
+  bool isSameWarp(const BlockInfo::WarpAccessKeyT &lhs,
+                  const BlockInfo::WarpAccessKeyT &rhs);
+
+  /// The linear map from the elements of a tensor to the warps and blocks
+  /// holding them, as (element, warp and block) rows in echelon form.
+  using WarpMapT = SmallVector<std::pair<uint64_t, uint64_t>>;
+
+  /// Returns the warp map of the tensor type, or std::nullopt if an element
+  /// is held by several warps or the layout is not supported.
+  const std::optional<WarpMapT> &getWarpMap(RankedTensorType type);
+
   /// Collects the successors of the terminator
   void visitTerminator(Operation *operation, SmallVector<Block *> &successors);
 
   void insertBarrier(Operation *operation, OpBuilder *builder);
 
+  void insertWarpBarrier(Operation *operation, OpBuilder *builder);
+
 private:
   Allocation *allocation = nullptr;
+  bool minimizeBarriers = false;
+  DenseMap<Type, std::optional<WarpMapT>> warpMaps;
 };
 
 /// Postorder traversal on the callgraph to insert membar instructions
@@ -125,9 +366,11 @@ private:
 /// before and after function calls, but might be a bit conservative.
 class ModuleMembarAnalysis : public CallGraph<BlockInfo> {
 public:
-  ModuleMembarAnalysis(ModuleAllocation *moduleAllocation)
+  ModuleMembarAnalysis(ModuleAllocation *moduleAllocation,
+                       bool minimizeBarriers = false)
       : CallGraph<BlockInfo>(moduleAllocation->getModuleOp()),
-        moduleAllocation(moduleAllocation) {}
+        moduleAllocation(moduleAllocation),
+        minimizeBarriers(minimizeBarriers) {}
 
   void run() {
     walk<WalkOrder::PreOrder, WalkOrder::PostOrder>(
@@ -138,7 +381,7 @@ public:
           auto *allocation = moduleAllocation->getFuncData(funcOp);
           auto [it, inserted] = funcMap.try_emplace(funcOp, BlockInfo());
           if (inserted) {
-            MembarAnalysis analysis(allocation);
+            MembarAnalysis analysis(allocation, minimizeBarriers);
             analysis.run(funcMap);
           }
         });
@@ -146,6 +389,7 @@ public:
 
 private:
   ModuleAllocation *moduleAllocation;
+  bool minimizeBarriers;
 };
 
 } // namespace mlir
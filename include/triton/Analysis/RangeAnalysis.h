@@ -0,0 +1,60 @@
+#ifndef TRITON_ANALYSIS_RANGEANALYSIS_H
+#define TRITON_ANALYSIS_RANGEANALYSIS_H
+
+#include "mlir/Analysis/DataFlow/IntegerRangeAnalysis.h"
+#include "mlir/Interfaces/InferIntRangeInterface.h"
+
+#include <optional>
+
+namespace mlir::triton {
+
+//===----------------------------------------------------------------------===//
+// TritonIntegerRangeAnalysis
+//===----------------------------------------------------------------------===//
+
+/// Computes the ranges of the integer values, such as the indices and the
+/// pointer offsets of a kernel. Extends the upstream analysis, which covers the
+/// ops implementing InferIntRangeInterface and the induction variables of
+/// loops, with:
+///
+///   - tt.make_range, tt.get_program_id and tt.get_num_programs, whose ranges
+///     follow from their attributes and the size of the launch grid.
+///   - The ops that move integers without changing them, such as tt.splat and
+///     tt.broadcast, whose ranges are the ones of their operands.
+///   - The assumptions of llvm.intr.assume ops, the way tl.assume lowers, on
+///     conditions that compare a value to a constant. They bound the value if
+///     the assume is in the block that defines it, as both then execute.
+///
+/// Integer arguments of kernels are bounded by their types only: the frontend
+/// specializes the arguments that fit in 32 bits to i32.
+class TritonIntegerRangeAnalysis : public dataflow::IntegerRangeAnalysis {
+public:
+  /// Collects the assumptions of the assumes nested in `top`.
+  TritonIntegerRangeAnalysis(DataFlowSolver &solver, Operation *top);
+
+  void setToEntryState(dataflow::IntegerValueRangeLattice *lattice) override;
+
+  void visitOperation(
+      Operation *op,
+      ArrayRef<const dataflow::IntegerValueRangeLattice *> operands,
+      ArrayRef<dataflow::IntegerValueRangeLattice *> results) override;
+
+private:
+  /// Intersects the range with the assumptions on the value, if any.
+  ConstantIntRanges getAssumedRange(Value value,
+                                    const ConstantIntRanges &range) const;
+
+  void joinResultRange(dataflow::IntegerValueRangeLattice *lattice,
+                       const ConstantIntRanges &range);
+
+  DenseMap<Value, ConstantIntRanges> assumptions;
+};
+
+/// Returns the range of the integer value as computed by the solver, or
+/// std::nullopt if the value is not an integer or is not reachable.
+std::optional<ConstantIntRanges> getIntegerRange(DataFlowSolver &solver,
+                                                 Value value);
+
+} // namespace mlir::triton
+
+#endif
@@ -28,6 +28,8 @@ inline const std::set<std::string> CACHE_INVALIDATING_ENV_VARS = {
     "TRITON_DISABLE_RESHAPE_ENCODING_INFERENCE",
     "TRITON_ENABLE_LLVM_DEBUG",
     "TRITON_LLVM_DEBUG_ONLY",
+    "TRITON_MINIMIZE_BARRIERS",
+    "TRITON_NARROW_INT_ARITHMETIC",
     "USE_TTGIR_LOC",
     "NVPTX_ENABLE_DUMP",
     // clang-format on
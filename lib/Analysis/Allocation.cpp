@@ -37,6 +37,9 @@ namespace triton {
 // Bitwidth of pointers
 constexpr int kPtrBitWidth = 64;
 
+// Functions with at most this many buffers are packed by an exhaustive search
+constexpr size_t kMaxExactPackingBuffers = 7;
+
 static std::pair<SmallVector<unsigned>, SmallVector<unsigned>>
 getCvtOrder(Attribute srcLayout, Attribute dstLayout) {
   auto srcMmaLayout = mlir::dyn_cast<NvidiaMmaEncodingAttr>(srcLayout);
@@ -152,6 +155,80 @@ ScratchConfig getScratchConfigForCvt(RankedTensorType srcTy,
   return scratchConfig;
 }
 
+/// Counts the intervals of a set that cover each point, so that whether any
+/// of them intersects a given interval is found in logarithmic time. All the
+/// ends of the intervals must be among the points given on construction.
+class IntervalCoverage {
+public:
+  explicit IntervalCoverage(SmallVector<size_t> points)
+      : points(std::move(points)) {
+    llvm::sort(this->points);
+    this->points.erase(std::unique(this->points.begin(), this->points.end()),
+                       this->points.end());
+    numSegments = std::max<size_t>(this->points.size(), 2) - 1;
+    maxCount.resize(4 * numSegments, 0);
+    nodeCount.resize(4 * numSegments, 0);
+  }
+
+  void insert(Interval<size_t> interval) { update(interval, 1); }
+
+  void erase(Interval<size_t> interval) { update(interval, -1); }
+
+  bool intersects(Interval<size_t> interval) const {
+    auto [from, to] = getSegments(interval);
+    return from < to && query(1, 0, numSegments, from, to) > 0;
+  }
+
+private:
+  /// Returns the range of segments between consecutive points that the
+  /// interval spans.
+  std::pair<size_t, size_t> getSegments(Interval<size_t> interval) const {
+    size_t from = llvm::lower_bound(points, interval.start()) - points.begin();
+    size_t to = llvm::lower_bound(points, interval.end()) - points.begin();
+    return {from, to};
+  }
+
+  void update(Interval<size_t> interval, int delta) {
+    auto [from, to] = getSegments(interval);
+    if (from < to)
+      update(1, 0, numSegments, from, to, delta);
+  }
+
+  // Segment tree over the segments: nodeCount is the number of intervals that
+  // cover the whole range of a node but not that of its parent, and maxCount
+  // the largest count of a segment within the node from those intervals.
+  void update(size_t node, size_t lo, size_t hi, size_t from, size_t to,
+              int delta) {
+    if (to <= lo || hi <= from)
+      return;
+    if (from <= lo && hi <= to) {
+      nodeCount[node] += delta;
+      maxCount[node] += delta;
+      return;
+    }
+    size_t mid = (lo + hi) / 2;
+    update(2 * node, lo, mid, from, to, delta);
+    update(2 * node + 1, mid, hi, from, to, delta);
+    maxCount[node] =
+        nodeCount[node] + std::max(maxCount[2 * node], maxCount[2 * node + 1]);
+  }
+
+  int query(size_t node, size_t lo, size_t hi, size_t from, size_t to) const {
+    if (to <= lo || hi <= from)
+      return 0;
+    if (from <= lo && hi <= to)
+      return maxCount[node];
+    size_t mid = (lo + hi) / 2;
+    return nodeCount[node] + std::max(query(2 * node, lo, mid, from, to),
+                                      query(2 * node + 1, mid, hi, from, to));
+  }
+
+  SmallVector<size_t> points;
+  size_t numSegments;
+  SmallVector<int> maxCount;
+  SmallVector<int> nodeCount;
+};
+
 class AllocationAnalysis {
 public:
   AllocationAnalysis(Operation *operation,
@@ -425,28 +502,57 @@ private:
   }
 
   /// Computes the shared memory offsets for all related values.
-  /// Paper: Algorithms for Compile-Time Memory Optimization
-  /// (https://dl.acm.org/doi/pdf/10.5555/314500.315082)
+  /// The buffers are first colored as in the paper below and then packed
+  /// again, and the allocation that uses less shared memory is kept.
   void computeOffsets() {
     SmallVector<BufferT *> buffers;
     for (auto bufferIter : bufferRange) {
       buffers.emplace_back(bufferIter.first);
     }
 
+    buildLivenessGraph(buffers);
+    colorBuffers(buffers);
+    allocation->firstFitSharedMemorySize = allocation->sharedMemorySize;
+
+    SmallVector<size_t> coloredOffsets;
+    for (auto *buffer : buffers)
+      coloredOffsets.push_back(buffer->offset);
+    size_t packedSize = packBuffers(buffers);
+    if (packedSize < allocation->sharedMemorySize) {
+      allocation->sharedMemorySize = packedSize;
+    } else {
+      for (auto [buffer, offset] : llvm::zip(buffers, coloredOffsets))
+        buffer->offset = offset;
+    }
+  }
+
+  /// Computes the shared memory offsets by first-fit graph coloring.
+  /// Paper: Algorithms for Compile-Time Memory Optimization
+  /// (https://dl.acm.org/doi/pdf/10.5555/314500.315082)
+  void colorBuffers(const SmallVector<BufferT *> &buffers) {
     calculateStarts(buffers);
 
     // NOTE: The original paper doesn't consider interference between
     // the bumped ranges. Buffers that previously do not interfere with
     // could interfere after offset bumping if their liveness ranges overlap.
-    // Therefore, we rerun the interference graph algorithm after bumping so
-    // that we regroup the buffers and color them again. Since we always
-    // increase the buffer offset and keep reducing conflicts, we will
-    // eventually reach a fixed point.
+    // Therefore, we update the interference graph after bumping so that we
+    // regroup the buffers and color them again. Since we always increase the
+    // buffer offset and keep reducing conflicts, we will eventually reach a
+    // fixed point.
     GraphT interference;
     buildInterferenceGraph(buffers, interference);
+    SmallVector<size_t> offsets(buffers.size());
     do {
+      for (auto [i, buffer] : llvm::enumerate(buffers))
+        offsets[i] = buffer->offset;
       allocate(buffers, interference);
-      buildInterferenceGraph(buffers, interference);
+      // Only the edges of the bumped buffers can change
+      SmallVector<BufferT *> bumped;
+      for (auto [i, buffer] : llvm::enumerate(buffers)) {
+        if (buffer->offset != offsets[i])
+          bumped.push_back(buffer);
+      }
+      updateInterferenceGraph(bumped, interference);
     } while (!interference.empty());
   }
 
@@ -471,21 +577,31 @@ private:
     // Start -> Liveness Range
     using TripleMapT = std::multimap<size_t, Interval<size_t>>;
     TripleMapT tripleMap;
-    tripleMap.insert(std::make_pair(0, Interval<size_t>()));
+    // The ranges of the triples, which are bounded by those of the buffers
+    SmallVector<size_t> points = {0, std::numeric_limits<size_t>::max()};
+    for (auto *buffer : buffers) {
+      points.push_back(bufferRange.lookup(buffer).start());
+      points.push_back(bufferRange.lookup(buffer).end());
+    }
+    IntervalCoverage tripleRanges(std::move(points));
+    auto insertTriple = [&](size_t offset, Interval<size_t> range) {
+      tripleMap.insert({offset, range});
+      tripleRanges.insert(range);
+    };
+    insertTriple(0, Interval<size_t>());
     SmallVector<BufferT *> xBuffers = buffers;
     while (!xBuffers.empty()) {
       auto tripleIt = tripleMap.begin();
       auto offset = tripleIt->first;
       auto range = tripleIt->second;
       tripleMap.erase(tripleIt);
+      tripleRanges.erase(range);
       auto bufferIt =
           std::find_if(xBuffers.begin(), xBuffers.end(), [&](auto *buffer) {
-            auto xRange = bufferRange[buffer];
-            bool res = xRange.intersects(range);
-            for (auto val : tripleMap)
-              res = res &&
-                    !val.second.intersects(xRange); // only one buffer intersect
-            return res;
+            auto xRange = bufferRange.lookup(buffer);
+            // only one buffer intersect
+            return xRange.intersects(range) &&
+                   !tripleRanges.intersects(xRange);
           });
       if (bufferIt != xBuffers.end()) {
         auto buffer = *bufferIt;
@@ -494,46 +610,92 @@ private:
         // TODO(Keren): A buffer's size shouldn't be determined here, have to
         // clean it up
         size_t alignOffset = buffer->setOffsetAligned(offset);
-        tripleMap.insert({alignOffset + xSize,
-                          Interval{std::max(range.start(), xRange.start()),
-                                   std::min(range.end(), xRange.end())}});
+        insertTriple(alignOffset + xSize,
+                     Interval{std::max(range.start(), xRange.start()),
+                              std::min(range.end(), xRange.end())});
         // We could either insert (range.start, xRange.start) or (range.start,
         // xRange.end), both are correct and determine the potential buffer
         // offset, and the graph coloring algorithm will solve the interference,
         // if any
         if (range.start() < xRange.start())
-          tripleMap.insert({offset, Interval{range.start(), xRange.end()}});
+          insertTriple(offset, Interval{range.start(), xRange.end()});
         if (xRange.end() < range.end())
-          tripleMap.insert({offset, Interval{xRange.start(), range.end()}});
+          insertTriple(offset, Interval{xRange.start(), range.end()});
         xBuffers.erase(bufferIt);
       }
     }
   }
 
+  /// Builds a graph of the buffers whose liveness ranges overlap. The ranges
+  /// are swept in the order of their starts, keeping those that contain the
+  /// current start, so that the time taken is proportional to the number of
+  /// edges rather than to the number of pairs of buffers.
+  void buildLivenessGraph(const SmallVector<BufferT *> &buffers) {
+    liveNeighbors.clear();
+    SmallVector<BufferT *> sortedBuffers = buffers;
+    llvm::stable_sort(sortedBuffers, [&](BufferT *x, BufferT *y) {
+      return bufferRange.lookup(x).start() < bufferRange.lookup(y).start();
+    });
+    // End -> Buffers that are live at the current start
+    std::multimap<size_t, BufferT *> liveBuffers;
+    for (auto *x : sortedBuffers) {
+      auto xRange = bufferRange.lookup(x);
+      if (xRange.size() == 0)
+        continue;
+      liveBuffers.erase(liveBuffers.begin(),
+                        liveBuffers.upper_bound(xRange.start()));
+      for (auto [end, y] : liveBuffers) {
+        liveNeighbors[x].insert(y);
+        liveNeighbors[y].insert(x);
+      }
+      liveBuffers.insert({xRange.end(), x});
+    }
+  }
+
+  /// Adds edges between `x` and the buffers that overlap it in both liveness
+  /// and shared memory.
+  void addInterference(BufferT *x, GraphT &interference) {
+    auto it = liveNeighbors.find(x);
+    if (it == liveNeighbors.end())
+      return;
+    Interval xSizeRange = {x->offset, x->offset + x->size};
+    for (auto *y : it->second) {
+      Interval ySizeRange = {y->offset, y->offset + y->size};
+      if (xSizeRange.intersects(ySizeRange)) {
+        interference[x].insert(y);
+        interference[y].insert(x);
+      }
+    }
+  }
+
   /// Builds a graph of all shared memory values. Edges are created between
   /// shared memory values that are overlapping.
   void buildInterferenceGraph(const SmallVector<BufferT *> &buffers,
                               GraphT &interference) {
     // Reset interference graph
     interference.clear();
-    for (auto x : buffers) {
-      for (auto y : buffers) {
-        if (x == y)
-          continue;
-        auto xStart = x->offset;
-        auto yStart = y->offset;
-        auto xSize = x->size;
-        auto ySize = y->size;
-        Interval xSizeRange = {xStart, xStart + xSize};
-        Interval ySizeRange = {yStart, yStart + ySize};
-        auto xOpRange = bufferRange.lookup(x);
-        auto yOpRange = bufferRange.lookup(y);
-        if (xOpRange.intersects(yOpRange) &&
-            xSizeRange.intersects(ySizeRange)) {
-          interference[x].insert(y);
-        }
+    for (auto *x : buffers)
+      addInterference(x, interference);
+  }
+
+  /// Updates the interference graph after the given buffers have moved.
+  void updateInterferenceGraph(const SmallVector<BufferT *> &moved,
+                               GraphT &interference) {
+    for (auto *x : moved) {
+      auto it = interference.find(x);
+      if (it == interference.end())
+        continue;
+      auto neighbors = std::move(it->second);
+      interference.erase(it);
+      for (auto *y : neighbors) {
+        auto yIt = interference.find(y);
+        yIt->second.erase(x);
+        if (yIt->second.empty())
+          interference.erase(yIt);
       }
     }
+    for (auto *x : moved)
+      addInterference(x, interference);
   }
 
   /// Finalizes shared memory offsets considering interference.
@@ -550,13 +712,19 @@ private:
     for (auto value : buffers) {
       colors[value] = (value == buffers[0]) ? 0 : -1;
     }
-    SmallVector<bool> available(buffers.size());
+    SmallVector<bool> available;
     for (auto x : buffers) {
-      std::fill(available.begin(), available.end(), true);
-      for (auto y : interference.lookup(x)) {
-        int color = colors[y];
-        if (color >= 0) {
-          available[color] = false;
+      // A node with n neighbors always has one of the first n + 1 colors free
+      auto neighborsIt = interference.find(x);
+      size_t numNeighbors =
+          neighborsIt == interference.end() ? 0 : neighborsIt->second.size();
+      available.assign(numNeighbors + 1, true);
+      if (neighborsIt != interference.end()) {
+        for (auto y : neighborsIt->second) {
+          int color = colors[y];
+          if (color >= 0 && static_cast<size_t>(color) < available.size()) {
+            available[color] = false;
+          }
         }
       }
       auto it = std::find(available.begin(), available.end(), true);
@@ -580,11 +748,163 @@ private:
     }
   }
 
+  /// Packs the buffers into as little shared memory as possible and returns
+  /// the size used. Packing is a rectangle packing problem: each buffer is a
+  /// rectangle spanning its liveness range in time and its size in space, and
+  /// rectangles may only be moved in space. Buffers are placed from the
+  /// largest to the smallest in the tightest gap that fits them, and the
+  /// result is refined by an exhaustive search when there are few buffers.
+  size_t packBuffers(const SmallVector<BufferT *> &buffers) {
+    SmallVector<BufferT *> order = buffers;
+    llvm::sort(order, [&](BufferT *x, BufferT *y) {
+      if (x->size != y->size)
+        return x->size > y->size;
+      auto xRange = bufferRange.lookup(x);
+      auto yRange = bufferRange.lookup(y);
+      if (xRange.size() != yRange.size())
+        return xRange.size() > yRange.size();
+      return x->id < y->id;
+    });
+    size_t size = 0;
+    DenseSet<BufferT *> placed;
+    for (auto *buffer : order) {
+      placeBestFit(buffer, placed);
+      placed.insert(buffer);
+      size = std::max(size, buffer->offset + buffer->size);
+    }
+    if (order.size() <= kMaxExactPackingBuffers)
+      size = searchOffsets(order, size);
+    return size;
+  }
+
+  /// Returns the allocated ranges of the placed buffers that are live at the
+  /// same time as `x`, sorted by offset.
+  SmallVector<Interval<size_t>>
+  getConflicts(BufferT *x, const DenseSet<BufferT *> &placed) {
+    SmallVector<Interval<size_t>> conflicts;
+    auto it = liveNeighbors.find(x);
+    if (it == liveNeighbors.end())
+      return conflicts;
+    for (auto *y : it->second) {
+      if (placed.contains(y))
+        conflicts.push_back(Interval(y->offset, y->offset + y->size));
+    }
+    llvm::sort(conflicts);
+    return conflicts;
+  }
+
+  /// Places `x` in the smallest gap between the conflicting placed buffers
+  /// that it fits in, or above all of them if there is none.
+  void placeBestFit(BufferT *x, const DenseSet<BufferT *> &placed) {
+    auto bestOffset = std::numeric_limits<size_t>::max();
+    auto bestGap = std::numeric_limits<size_t>::max();
+    size_t top = 0;
+    for (auto conflict : getConflicts(x, placed)) {
+      if (top < conflict.start()) {
+        size_t offset = llvm::alignTo(top, x->alignment);
+        size_t gap = conflict.start() - top;
+        if (offset + x->size <= conflict.start() && gap < bestGap) {
+          bestOffset = offset;
+          bestGap = gap;
+        }
+      }
+      top = std::max(top, conflict.end());
+    }
+    if (bestOffset == std::numeric_limits<size_t>::max())
+      bestOffset = llvm::alignTo(top, x->alignment);
+    x->offset = bestOffset;
+  }
+
+  /// Places `x` at the lowest offset where it does not overlap the
+  /// conflicting placed buffers.
+  void placeLowest(BufferT *x, const DenseSet<BufferT *> &placed) {
+    size_t offset = 0;
+    for (auto conflict : getConflicts(x, placed)) {
+      if (offset + x->size <= conflict.start())
+        break;
+      offset = std::max(offset, llvm::alignTo(conflict.end(), x->alignment));
+    }
+    x->offset = offset;
+  }
+
+  /// Returns the largest total size of the buffers that are live at the same
+  /// time, which no allocation can go below.
+  size_t getLiveSizeBound(const SmallVector<BufferT *> &buffers) {
+    // Time -> Change of the live size, where ends come before starts
+    SmallVector<std::pair<size_t, int64_t>> events;
+    for (auto *x : buffers) {
+      auto xRange = bufferRange.lookup(x);
+      events.push_back({xRange.start(), x->size});
+      events.push_back({xRange.end(), -static_cast<int64_t>(x->size)});
+    }
+    llvm::sort(events);
+    int64_t size = 0;
+    int64_t bound = 0;
+    for (auto [time, delta] : events) {
+      size += delta;
+      bound = std::max(bound, size);
+    }
+    return bound;
+  }
+
+  /// Searches for the order in which placing every buffer at its lowest
+  /// offset uses the least shared memory, starting from the current offsets
+  /// of size `bestSize`. Returns the size of the best allocation found, whose
+  /// offsets are left in the buffers.
+  /// The search is exact: placing the buffers of any allocation in the order
+  /// of their offsets, each at its lowest offset, moves none of them up.
+  size_t searchOffsets(const SmallVector<BufferT *> &buffers,
+                       size_t bestSize) {
+    SmallVector<size_t> bestOffsets;
+    for (auto *buffer : buffers)
+      bestOffsets.push_back(buffer->offset);
+    size_t bound = getLiveSizeBound(buffers);
+    DenseSet<BufferT *> placed;
+    searchOffsets(buffers, bound, /*size=*/0, /*last=*/nullptr, placed,
+                  bestSize, bestOffsets);
+    for (auto [buffer, offset] : llvm::zip(buffers, bestOffsets))
+      buffer->offset = offset;
+    return bestSize;
+  }
+
+  void searchOffsets(const SmallVector<BufferT *> &buffers, size_t bound,
+                     size_t size, BufferT *last, DenseSet<BufferT *> &placed,
+                     size_t &bestSize, SmallVector<size_t> &bestOffsets) {
+    if (bestSize <= bound)
+      return;
+    if (placed.size() == buffers.size()) {
+      bestSize = size;
+      for (auto [i, buffer] : llvm::enumerate(buffers))
+        bestOffsets[i] = buffer->offset;
+      return;
+    }
+    for (auto *buffer : buffers) {
+      if (placed.contains(buffer))
+        continue;
+      // Swapping buffers that are not live at the same time places them at
+      // the same offsets, so only one of their orders is searched
+      if (last && buffer->id < last->id &&
+          !bufferRange.lookup(buffer).intersects(bufferRange.lookup(last)))
+        continue;
+      placeLowest(buffer, placed);
+      size_t newSize = std::max(size, buffer->offset + buffer->size);
+      // Only strictly smaller allocations are of interest
+      if (newSize >= bestSize)
+        continue;
+      placed.insert(buffer);
+      searchOffsets(buffers, bound, newSize, buffer, placed, bestSize,
+                    bestOffsets);
+      placed.erase(buffer);
+    }
+  }
+
 private:
   Operation *operation;
   Allocation::FuncAllocMapT *funcAllocMap;
   Allocation *allocation;
   BufferRangeMapT bufferRange;
+  /// Buffer -> Buffers whose liveness ranges overlap it
+  GraphT liveNeighbors;
 };
 
 } // namespace triton
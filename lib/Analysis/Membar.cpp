@@ -1,20 +1,59 @@
 #include "triton/Analysis/Membar.h"
 #include "triton/Analysis/Alias.h"
 #include "triton/Dialect/TritonGPU/IR/Dialect.h"
+#include "triton/Dialect/TritonGPU/IR/LinearLayoutConversions.h"
 
 #include "mlir/Dialect/Func/IR/FuncOps.h"
 #include "mlir/Dialect/GPU/IR/GPUDialect.h"
 #include "mlir/Dialect/Tensor/IR/Tensor.h"
+#include "mlir/IR/Dominance.h"
+#include "mlir/IR/RegionGraphTraits.h"
 #include "mlir/Interfaces/ControlFlowInterfaces.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Support/MathExtras.h"
 #include <deque>
 
 namespace mlir {
 
+namespace {
+
+void checkNoSCF(Block *block) {
+  for (auto &op : block->getOperations()) {
+    // Check if the operation belongs to scf dialect, if so, we need to
+    // throw an error
+    if (op.getDialect()->getNamespace() == "scf") {
+      llvm::report_fatal_error(
+          "scf dialect is not supported in membar. Please lower it "
+          "to cf dialect first.");
+      return;
+    }
+  }
+}
+
+/// Clears the pivots of the rows of a warp map from the element, where the
+/// pivot of a row is the highest bit of its element, and accumulates the
+/// warps and blocks of the rows into owner.
+void reduceByWarpMap(ArrayRef<std::pair<uint64_t, uint64_t>> rows,
+                     uint64_t &element, uint64_t &owner) {
+  // The rows are sorted by decreasing pivots
+  for (auto [rowElement, rowOwner] : rows) {
+    if (element & (uint64_t(1) << llvm::Log2_64(rowElement))) {
+      element ^= rowElement;
+      owner ^= rowOwner;
+    }
+  }
+}
+
+} // namespace
+
 void MembarAnalysis::run(FuncBlockInfoMapT &funcBlockInfoMap) {
   FunctionOpInterface funcOp =
       dyn_cast<FunctionOpInterface>(allocation->getOperation());
   OpBuilder builder(funcOp.getContext());
-  resolve(funcOp, &funcBlockInfoMap, &builder);
+  if (minimizeBarriers)
+    resolveMinimal(funcOp, &funcBlockInfoMap, &builder);
+  else
+    resolve(funcOp, &funcBlockInfoMap, &builder);
 }
 
 void MembarAnalysis::resolve(FunctionOpInterface funcOp,
@@ -25,16 +64,7 @@ void MembarAnalysis::resolve(FunctionOpInterface funcOp,
   DenseMap<Block *, BlockInfo> outputBlockInfoMap;
   std::deque<Block *> blockList;
   funcOp.walk<WalkOrder::PreOrder>([&](Block *block) {
-    for (auto &op : block->getOperations()) {
-      // Check if the operation belongs to scf dialect, if so, we need to
-      // throw an error
-      if (op.getDialect()->getNamespace() == "scf") {
-        llvm::report_fatal_error(
-            "scf dialect is not supported in membar. Please lower it "
-            "to cf dialect first.");
-        return;
-      }
-    }
+    checkNoSCF(block);
     if (block->isEntryBlock())
       blockList.emplace_back(block);
   });
@@ -78,6 +108,78 @@ void MembarAnalysis::resolve(FunctionOpInterface funcOp,
   });
 }
 
+void MembarAnalysis::resolveMinimal(FunctionOpInterface funcOp,
+                                    FuncBlockInfoMapT *funcBlockInfoMap,
+                                    OpBuilder *builder) {
+  // The blocks of each region in reverse post-order
+  SmallVector<SmallVector<Block *>> regionBlocks;
+  funcOp.walk<WalkOrder::PreOrder>([&](Block *block) {
+    checkNoSCF(block);
+    if (block->isEntryBlock()) {
+      llvm::ReversePostOrderTraversal<Block *> rpot(block);
+      regionBlocks.emplace_back(rpot.begin(), rpot.end());
+    }
+  });
+  DominanceInfo domInfo(funcOp);
+
+  DenseMap<Block *, BlockInfo> outputBlockInfoMap;
+  auto getInputBlockInfo = [&](Block *block) {
+    BlockInfo inputBlockInfo;
+    for (auto *pred : block->getPredecessors()) {
+      auto it = outputBlockInfoMap.find(pred);
+      if (it != outputBlockInfoMap.end())
+        inputBlockInfo.join(it->second);
+    }
+    return inputBlockInfo;
+  };
+
+  while (true) {
+    // A fixed point algorithm, in which the outputs only grow
+    outputBlockInfoMap.clear();
+    for (auto &blocks : regionBlocks) {
+      std::deque<Block *> blockList(blocks.begin(), blocks.end());
+      while (!blockList.empty()) {
+        auto *block = blockList.front();
+        blockList.pop_front();
+        auto blockInfo = getInputBlockInfo(block);
+        visitBlock(block, blockInfo, funcBlockInfoMap, /*builder=*/nullptr,
+                   outputBlockInfoMap, domInfo);
+        auto &outputBlockInfo = outputBlockInfoMap[block];
+        auto prevOutputBlockInfo = outputBlockInfo;
+        if (outputBlockInfo.join(blockInfo) == prevOutputBlockInfo)
+          continue;
+        blockList.insert(blockList.end(), block->getSuccessors().begin(),
+                         block->getSuccessors().end());
+      }
+    }
+
+    Block *hazardBlock = nullptr;
+    for (auto &blocks : regionBlocks) {
+      for (auto *block : blocks) {
+        auto blockInfo = getInputBlockInfo(block);
+        if (visitBlock(block, blockInfo, funcBlockInfoMap, /*builder=*/nullptr,
+                       outputBlockInfoMap, domInfo)) {
+          hazardBlock = block;
+          break;
+        }
+      }
+      if (hazardBlock)
+        break;
+    }
+    if (!hazardBlock)
+      break;
+    auto blockInfo = getInputBlockInfo(hazardBlock);
+    visitBlock(hazardBlock, blockInfo, funcBlockInfoMap, builder,
+               outputBlockInfoMap, domInfo);
+  }
+
+  // Update the final dangling buffers that haven't been synced
+  auto &funcBlockInfo = (*funcBlockInfoMap)[funcOp];
+  funcOp.walk([&](triton::ReturnOp returnOp) {
+    funcBlockInfo.join(outputBlockInfoMap[returnOp->getBlock()]);
+  });
+}
+
 void MembarAnalysis::visitTerminator(Operation *op,
                                      SmallVector<Block *> &successors) {
   if (auto branchInterface = dyn_cast<BranchOpInterface>(op)) {
@@ -97,10 +199,16 @@ void MembarAnalysis::insertBarrier(Operation *op, OpBuilder *builder) {
   auto barrierOp = builder->create<gpu::BarrierOp>(op->getLoc());
 }
 
+void MembarAnalysis::insertWarpBarrier(Operation *op, OpBuilder *builder) {
+  OpBuilder::InsertionGuard g(*builder);
+  auto barrierOp = builder->create<gpu::BarrierOp>(op->getLoc());
+  barrierOp->setAttr(AttrWarpSyncName, builder->getUnitAttr());
+}
+
 void MembarAnalysis::update(Operation *op, BlockInfo *blockInfo,
                             FuncBlockInfoMapT *funcBlockInfoMap,
                             OpBuilder *builder) {
-  if (isa<gpu::BarrierOp>(op)) {
+  if (isa<gpu::BarrierOp>(op) && !op->hasAttr(AttrWarpSyncName)) {
     // If the current op is a barrier, we sync previous reads and writes
     blockInfo->sync();
     return;
@@ -116,38 +224,8 @@ void MembarAnalysis::update(Operation *op, BlockInfo *blockInfo,
     return;
   }
 
-  BlockInfo curBlockInfo;
-  auto scratchBufferId = Allocation::InvalidBufferId;
-  if (isa<triton::CallOp>(op)) {
-    // Inter-function dependencies
-    auto callOpInterface = dyn_cast<CallOpInterface>(op);
-    if (auto callee =
-            dyn_cast<FunctionOpInterface>(callOpInterface.resolveCallable()))
-      curBlockInfo = funcBlockInfoMap->lookup(callee);
-  } else {
-    // Intra-function dependencies
-    if (auto memoryEffectOpInterface = dyn_cast<MemoryEffectOpInterface>(op)) {
-      // Explicit buffer
-      SmallVector<SideEffects::EffectInstance<MemoryEffects::Effect>>
-          effectInstances;
-      memoryEffectOpInterface.getEffects(effectInstances);
-      for (auto effectInstance : effectInstances) {
-        if (auto value = effectInstance.getValue()) {
-          for (auto bufferId : allocation->getBufferIds(value)) {
-            if (bufferId != Allocation::InvalidBufferId) {
-              if (isa<MemoryEffects::Write>(effectInstance.getEffect()))
-                curBlockInfo.syncWriteIntervals.insert(
-                    allocation->getAllocatedInterval(bufferId));
-              else if (isa<MemoryEffects::Read>(effectInstance.getEffect()))
-                curBlockInfo.syncReadIntervals.insert(
-                    allocation->getAllocatedInterval(bufferId));
-            }
-          }
-        }
-      }
-    }
-    scratchBufferId = allocation->getBufferId(op);
-  }
+  Allocation::BufferId scratchBufferId;
+  auto curBlockInfo = getAccesses(op, funcBlockInfoMap, scratchBufferId);
 
   // Scratch buffer operations consist of a series of shared memory operations
   // starting from a shared memory write, followed by a series of shared memory
@@ -178,4 +256,302 @@ void MembarAnalysis::update(Operation *op, BlockInfo *blockInfo,
   // the current op's read/write buffers.
   blockInfo->join(curBlockInfo);
 }
+
+bool MembarAnalysis::visitBlock(
+    Block *block, BlockInfo &blockInfo, FuncBlockInfoMapT *funcBlockInfoMap,
+    OpBuilder *builder, const DenseMap<Block *, BlockInfo> &outputBlockInfoMap,
+    DominanceInfo &domInfo) {
+  auto sameWarp = [&](const BlockInfo::WarpAccessKeyT &lhs,
+                      const BlockInfo::WarpAccessKeyT &rhs) {
+    return isSameWarp(lhs, rhs);
+  };
+  bool needsBarrier = false;
+  // The accesses of the block so far, and whether a barrier syncs them
+  BlockInfo localBlockInfo;
+  bool synced = false;
+  for (auto &op : block->getOperations()) {
+    if (op.hasTrait<OpTrait::IsTerminator>())
+      continue;
+    if (isa<gpu::BarrierOp>(&op)) {
+      if (op.hasAttr(AttrWarpSyncName)) {
+        blockInfo.syncWarps();
+        localBlockInfo.syncWarps();
+      } else {
+        blockInfo.sync();
+        localBlockInfo.sync();
+        synced = true;
+      }
+      continue;
+    }
+    if (auto waitOp = dyn_cast<triton::gpu::AsyncWaitOp>(&op)) {
+      // The writes of the async copies are visible to the other threads after
+      // the next barrier
+      blockInfo.syncWriteIntervals.insert(blockInfo.asyncWriteIntervals);
+      localBlockInfo.syncWriteIntervals.insert(blockInfo.asyncWriteIntervals);
+      if (waitOp.getNum() == 0)
+        blockInfo.asyncWriteIntervals.clear();
+      continue;
+    }
+
+    Allocation::BufferId scratchBufferId;
+    auto curBlockInfo = getAccesses(&op, funcBlockInfoMap, scratchBufferId);
+    Interval<size_t> scratchInterval;
+    if (scratchBufferId != Allocation::InvalidBufferId) {
+      if (!curBlockInfo.syncReadIntervals.empty() ||
+          !curBlockInfo.syncWriteIntervals.empty() ||
+          !curBlockInfo.warpAccesses.empty()) {
+        llvm::report_fatal_error(
+            "scratch buffer operations should not have any shared memory "
+            "dependencies");
+      }
+      scratchInterval = allocation->getAllocatedInterval(scratchBufferId);
+      curBlockInfo.syncWriteIntervals.insert(scratchInterval);
+    }
+    if (blockInfo.isIntersected(curBlockInfo, sameWarp)) {
+      needsBarrier = true;
+      if (builder) {
+        // Before any barrier of the block, the accesses that race with the
+        // op's either come from the predecessors or from the block
+        auto *hoistBlock =
+            !synced && !localBlockInfo.isIntersected(curBlockInfo, sameWarp)
+                ? getHoistBlock(block, curBlockInfo, funcBlockInfoMap,
+                                outputBlockInfoMap, domInfo)
+                : nullptr;
+        if (hoistBlock) {
+          builder->setInsertionPoint(hoistBlock->getTerminator());
+          insertBarrier(hoistBlock->getTerminator(), builder);
+          // The accesses that reach the block have changed
+          return true;
+        }
+        builder->setInsertionPoint(&op);
+        insertBarrier(&op, builder);
+      }
+      blockInfo.sync();
+      localBlockInfo.sync();
+      synced = true;
+    } else if (blockInfo.isWarpIntersected(curBlockInfo, sameWarp)) {
+      needsBarrier = true;
+      if (builder) {
+        builder->setInsertionPoint(&op);
+        insertWarpBarrier(&op, builder);
+      }
+      blockInfo.syncWarps();
+      localBlockInfo.syncWarps();
+    }
+    if (scratchBufferId != Allocation::InvalidBufferId) {
+      // Ops with a scratch buffer internally syncs read/write on shared memory
+      blockInfo.sync();
+      localBlockInfo.sync();
+      synced = true;
+      curBlockInfo.syncReadIntervals.insert(scratchInterval);
+    }
+    blockInfo.join(curBlockInfo);
+    localBlockInfo.join(curBlockInfo);
+  }
+  return needsBarrier;
+}
+
+Block *MembarAnalysis::getHoistBlock(
+    Block *block, const BlockInfo &curBlockInfo,
+    FuncBlockInfoMapT *funcBlockInfoMap,
+    const DenseMap<Block *, BlockInfo> &outputBlockInfoMap,
+    DominanceInfo &domInfo) {
+  auto sameWarp = [&](const BlockInfo::WarpAccessKeyT &lhs,
+                      const BlockInfo::WarpAccessKeyT &rhs) {
+    return isSameWarp(lhs, rhs);
+  };
+  // Go up to the loop header, e.g. from the body of a lowered scf.for
+  SmallPtrSet<Block *, 4> visited;
+  for (auto *curBlock = block; visited.insert(curBlock).second;
+       curBlock = curBlock->getSinglePredecessor()) {
+    if (curBlock != block) {
+      // The accesses of the blocks on the way must not race with the op's
+      BlockInfo blockInfo;
+      visitBlock(curBlock, blockInfo, funcBlockInfoMap, /*builder=*/nullptr,
+                 outputBlockInfoMap, domInfo);
+      if (blockInfo.isIntersected(curBlockInfo, sameWarp))
+        return nullptr;
+    }
+    Block *hoistBlock = nullptr;
+    bool isLoopHeader = false;
+    for (auto *pred : curBlock->getPredecessors()) {
+      // The header dominates the sources of the back edges of its loop
+      bool isBackEdge = domInfo.dominates(curBlock, pred);
+      isLoopHeader |= isBackEdge;
+      auto it = outputBlockInfoMap.find(pred);
+      if (it == outputBlockInfoMap.end() ||
+          !it->second.isIntersected(curBlockInfo, sameWarp))
+        continue;
+      // A barrier at the end of the predecessor must only run on the way
+      // to the loop, and must not run in it
+      if (hoistBlock || isBackEdge || pred->getNumSuccessors() != 1)
+        return nullptr;
+      hoistBlock = pred;
+    }
+    if (isLoopHeader)
+      return hoistBlock;
+    if (!curBlock->getSinglePredecessor())
+      return nullptr;
+  }
+  return nullptr;
+}
+
+BlockInfo MembarAnalysis::getAccesses(Operation *op,
+                                      FuncBlockInfoMapT *funcBlockInfoMap,
+                                      Allocation::BufferId &scratchBufferId) {
+  BlockInfo curBlockInfo;
+  scratchBufferId = Allocation::InvalidBufferId;
+  if (isa<triton::CallOp>(op)) {
+    // Inter-function dependencies
+    auto callOpInterface = dyn_cast<CallOpInterface>(op);
+    if (auto callee =
+            dyn_cast<FunctionOpInterface>(callOpInterface.resolveCallable()))
+      curBlockInfo = funcBlockInfoMap->lookup(callee);
+    // The buffers of the callee are not known to the caller
+    for (auto &[key, access] : curBlockInfo.warpAccesses) {
+      if (access.read)
+        curBlockInfo.syncReadIntervals.insert(access.interval);
+      if (access.write)
+        curBlockInfo.syncWriteIntervals.insert(access.interval);
+    }
+    curBlockInfo.warpAccesses.clear();
+    return curBlockInfo;
+  }
+  // Intra-function dependencies
+  if (auto memoryEffectOpInterface = dyn_cast<MemoryEffectOpInterface>(op)) {
+    std::optional<BlockInfo::WarpAccessKeyT> warpAccessKey;
+    if (minimizeBarriers)
+      warpAccessKey = getWarpAccessKey(op);
+    // Explicit buffer
+    SmallVector<SideEffects::EffectInstance<MemoryEffects::Effect>>
+        effectInstances;
+    memoryEffectOpInterface.getEffects(effectInstances);
+    for (auto effectInstance : effectInstances) {
+      auto value = effectInstance.getValue();
+      if (!value)
+        continue;
+      bool isWrite = isa<MemoryEffects::Write>(effectInstance.getEffect());
+      bool isRead = isa<MemoryEffects::Read>(effectInstance.getEffect());
+      for (auto bufferId : allocation->getBufferIds(value)) {
+        if (bufferId == Allocation::InvalidBufferId)
+          continue;
+        auto interval = allocation->getAllocatedInterval(bufferId);
+        if (warpAccessKey && (isWrite || isRead)) {
+          auto &access = curBlockInfo.warpAccesses[*warpAccessKey];
+          access.interval = interval;
+          access.read |= isRead;
+          access.unsyncedRead |= isRead;
+          access.write |= isWrite;
+          access.unsyncedWrite |= isWrite;
+        } else if (isWrite) {
+          curBlockInfo.syncWriteIntervals.insert(interval);
+          // Async copies write to the buffer until they are waited for
+          if (minimizeBarriers &&
+              isa<triton::gpu::AsyncCopyGlobalToLocalOp>(op))
+            curBlockInfo.asyncWriteIntervals.insert(interval);
+        } else if (isRead) {
+          curBlockInfo.syncReadIntervals.insert(interval);
+        }
+      }
+    }
+  }
+  scratchBufferId = allocation->getBufferId(op);
+  return curBlockInfo;
+}
+
+std::optional<BlockInfo::WarpAccessKeyT>
+MembarAnalysis::getWarpAccessKey(Operation *op) {
+  Value buffer;
+  RankedTensorType type;
+  if (auto loadOp = dyn_cast<triton::gpu::LocalLoadOp>(op)) {
+    buffer = loadOp.getSrc();
+    type = loadOp.getType();
+  } else if (auto storeOp = dyn_cast<triton::gpu::LocalStoreOp>(op)) {
+    buffer = storeOp.getDst();
+    type = storeOp.getSrc().getType();
+  } else if (auto allocOp = dyn_cast<triton::gpu::LocalAllocOp>(op)) {
+    if (!allocOp.getSrc())
+      return std::nullopt;
+    buffer = allocOp.getResult();
+    type = allocOp.getSrc().getType();
+  } else {
+    return std::nullopt;
+  }
+  // A subview or a block argument may put the elements at different
+  // addresses each time it is reached, unlike an allocation
+  if (!buffer.getDefiningOp<triton::gpu::LocalAllocOp>() || !getWarpMap(type))
+    return std::nullopt;
+  return BlockInfo::WarpAccessKeyT(buffer, type);
+}
+
+bool MembarAnalysis::isSameWarp(const BlockInfo::WarpAccessKeyT &lhs,
+                                const BlockInfo::WarpAccessKeyT &rhs) {
+  if (lhs.first != rhs.first)
+    return false;
+  if (lhs.second == rhs.second)
+    return true;
+  auto lhsType = cast<RankedTensorType>(lhs.second);
+  auto rhsType = cast<RankedTensorType>(rhs.second);
+  // Computing a map may invalidate the references to the others
+  if (!getWarpMap(lhsType) || !getWarpMap(rhsType))
+    return false;
+  const auto &lhsMap = *getWarpMap(lhsType);
+  const auto &rhsMap = *getWarpMap(rhsType);
+  // Both maps cover all the elements, so they are equal if the rows of one
+  // are mapped the same by the other
+  if (lhsMap.size() != rhsMap.size())
+    return false;
+  for (auto [element, owner] : rhsMap) {
+    uint64_t lhsOwner = 0;
+    reduceByWarpMap(lhsMap, element, lhsOwner);
+    if (element != 0 || lhsOwner != owner)
+      return false;
+  }
+  return true;
+}
+
+const std::optional<MembarAnalysis::WarpMapT> &
+MembarAnalysis::getWarpMap(RankedTensorType type) {
+  auto [it, inserted] = warpMaps.try_emplace(type, std::nullopt);
+  if (!inserted)
+    return it->second;
+  auto layout =
+      triton::gpu::toLinearLayout(type.getShape(), type.getEncoding());
+  if (!layout)
+    return it->second;
+  auto *ctx = type.getContext();
+  auto kWarp = StringAttr::get(ctx, "warp");
+  auto kBlock = StringAttr::get(ctx, "block");
+  WarpMapT rows;
+  for (auto inDim : layout->getInDimNames()) {
+    for (int i = 0; i < layout->getInDimSizeLog2(inDim); ++i) {
+      // Flatten the element, and put the block above the warp in the owner
+      uint64_t element = 0;
+      int shift = 0;
+      for (auto outDim : layout->getOutDimNames()) {
+        element |= uint64_t(layout->getBasis(inDim, i, outDim)) << shift;
+        shift += layout->getOutDimSizeLog2(outDim);
+      }
+      uint64_t owner = 0;
+      if (inDim == kWarp)
+        owner = uint64_t(1) << i;
+      else if (inDim == kBlock)
+        owner = uint64_t(1) << (32 + i);
+      reduceByWarpMap(rows, element, owner);
+      if (element != 0) {
+        auto pos = llvm::upper_bound(
+            rows, element, [](uint64_t element, const auto &row) {
+              return element > row.first;
+            });
+        rows.insert(pos, {element, owner});
+      } else if (owner != 0) {
+        // Another warp or block holds the same elements
+        return it->second;
+      }
+    }
+  }
+  it->second = std::move(rows);
+  return it->second;
+}
+
 } // namespace mlir
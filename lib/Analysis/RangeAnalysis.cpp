@@ -0,0 +1,234 @@
+#include "triton/Analysis/RangeAnalysis.h"
+#include "mlir/Analysis/DataFlowFramework.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/LLVMIR/LLVMDialect.h"
+#include "mlir/IR/Matchers.h"
+#include "llvm/Support/Debug.h"
+
+#include "triton/Dialect/Triton/IR/Dialect.h"
+#include "triton/Dialect/TritonGPU/IR/Dialect.h"
+
+#define DEBUG_TYPE "range-analysis"
+#define DBGS() (llvm::dbgs() << "[" DEBUG_TYPE "]: ")
+#define LDBG(X) LLVM_DEBUG(DBGS() << X << "\n")
+
+namespace mlir::triton {
+namespace {
+
+using dataflow::IntegerValueRangeLattice;
+
+/// The predicate of the comparison with the operands swapped.
+arith::CmpIPredicate swapPredicate(arith::CmpIPredicate predicate) {
+  switch (predicate) {
+  case arith::CmpIPredicate::slt:
+    return arith::CmpIPredicate::sgt;
+  case arith::CmpIPredicate::sle:
+    return arith::CmpIPredicate::sge;
+  case arith::CmpIPredicate::sgt:
+    return arith::CmpIPredicate::slt;
+  case arith::CmpIPredicate::sge:
+    return arith::CmpIPredicate::sle;
+  case arith::CmpIPredicate::ult:
+    return arith::CmpIPredicate::ugt;
+  case arith::CmpIPredicate::ule:
+    return arith::CmpIPredicate::uge;
+  case arith::CmpIPredicate::ugt:
+    return arith::CmpIPredicate::ult;
+  case arith::CmpIPredicate::uge:
+    return arith::CmpIPredicate::ule;
+  default:
+    return predicate;
+  }
+}
+
+/// The range of the values `x` for which `x predicate bound` holds, or
+/// std::nullopt if it is not an interval.
+std::optional<ConstantIntRanges>
+getPredicateRange(arith::CmpIPredicate predicate, const APInt &bound) {
+  auto width = bound.getBitWidth();
+  auto smin = APInt::getSignedMinValue(width);
+  auto smax = APInt::getSignedMaxValue(width);
+  auto umin = APInt::getMinValue(width);
+  auto umax = APInt::getMaxValue(width);
+  switch (predicate) {
+  case arith::CmpIPredicate::eq:
+    return ConstantIntRanges::constant(bound);
+  case arith::CmpIPredicate::slt:
+    if (bound == smin)
+      return std::nullopt;
+    return ConstantIntRanges::fromSigned(smin, bound - 1);
+  case arith::CmpIPredicate::sle:
+    return ConstantIntRanges::fromSigned(smin, bound);
+  case arith::CmpIPredicate::sgt:
+    if (bound == smax)
+      return std::nullopt;
+    return ConstantIntRanges::fromSigned(bound + 1, smax);
+  case arith::CmpIPredicate::sge:
+    return ConstantIntRanges::fromSigned(bound, smax);
+  case arith::CmpIPredicate::ult:
+    if (bound == umin)
+      return std::nullopt;
+    return ConstantIntRanges::fromUnsigned(umin, bound - 1);
+  case arith::CmpIPredicate::ule:
+    return ConstantIntRanges::fromUnsigned(umin, bound);
+  case arith::CmpIPredicate::ugt:
+    if (bound == umax)
+      return std::nullopt;
+    return ConstantIntRanges::fromUnsigned(bound + 1, umax);
+  case arith::CmpIPredicate::uge:
+    return ConstantIntRanges::fromUnsigned(bound, umax);
+  default:
+    return std::nullopt;
+  }
+}
+
+/// The intersection of the ranges, or `lhs` if they are disjoint, which only
+/// happens in code that cannot execute without breaking an assumption.
+ConstantIntRanges intersect(const ConstantIntRanges &lhs,
+                            const ConstantIntRanges &rhs) {
+  auto range = lhs.intersection(rhs);
+  if (range.smin().sgt(range.smax()) || range.umin().ugt(range.umax()))
+    return lhs;
+  return range;
+}
+
+bool isInteger(Value value) {
+  return ConstantIntRanges::getStorageBitwidth(value.getType()) != 0;
+}
+
+} // namespace
+
+TritonIntegerRangeAnalysis::TritonIntegerRangeAnalysis(DataFlowSolver &solver,
+                                                       Operation *top)
+    : dataflow::IntegerRangeAnalysis(solver) {
+  top->walk([&](LLVM::AssumeOp assumeOp) {
+    auto cmpOp = assumeOp.getCond().getDefiningOp<arith::CmpIOp>();
+    if (!cmpOp)
+      return;
+    Value value = cmpOp.getLhs();
+    auto predicate = cmpOp.getPredicate();
+    APInt bound;
+    if (!matchPattern(cmpOp.getRhs(), m_ConstantInt(&bound))) {
+      if (!matchPattern(cmpOp.getLhs(), m_ConstantInt(&bound)))
+        return;
+      value = cmpOp.getRhs();
+      predicate = swapPredicate(predicate);
+    }
+    // The uses of the value that execute without the assume are not bounded
+    if (value.getParentBlock() != assumeOp->getBlock())
+      return;
+    auto range = getPredicateRange(predicate, bound);
+    if (!range)
+      return;
+    auto [it, inserted] = assumptions.try_emplace(value, *range);
+    if (!inserted)
+      it->second = intersect(it->second, *range);
+    LDBG("assume " << value << " in " << it->second);
+  });
+}
+
+ConstantIntRanges TritonIntegerRangeAnalysis::getAssumedRange(
+    Value value, const ConstantIntRanges &range) const {
+  auto it = assumptions.find(value);
+  if (it == assumptions.end())
+    return range;
+  return intersect(range, it->second);
+}
+
+void TritonIntegerRangeAnalysis::setToEntryState(
+    IntegerValueRangeLattice *lattice) {
+  Value value = lattice->getPoint();
+  if (!isInteger(value) || !assumptions.count(value))
+    return dataflow::IntegerRangeAnalysis::setToEntryState(lattice);
+  auto width = ConstantIntRanges::getStorageBitwidth(value.getType());
+  propagateIfChanged(
+      lattice, lattice->join(IntegerValueRange(getAssumedRange(
+                   value, ConstantIntRanges::maxRange(width)))));
+}
+
+void TritonIntegerRangeAnalysis::joinResultRange(
+    IntegerValueRangeLattice *lattice, const ConstantIntRanges &range) {
+  Value value = lattice->getPoint();
+  IntegerValueRange oldRange = lattice->getValue();
+  ChangeResult changed =
+      lattice->join(IntegerValueRange(getAssumedRange(value, range)));
+  // Like the upstream analysis, widen the values that loops carry once they
+  // change, as the number of iterations is not bounded
+  bool isYielded = llvm::any_of(value.getUses(), [](OpOperand &use) {
+    return use.getOwner()->hasTrait<OpTrait::IsTerminator>();
+  });
+  if (isYielded && !oldRange.isUninitialized() &&
+      !(lattice->getValue() == oldRange)) {
+    auto width = ConstantIntRanges::getStorageBitwidth(value.getType());
+    changed |= lattice->join(IntegerValueRange(
+        getAssumedRange(value, ConstantIntRanges::maxRange(width))));
+  }
+  propagateIfChanged(lattice, changed);
+}
+
+void TritonIntegerRangeAnalysis::visitOperation(
+    Operation *op, ArrayRef<const IntegerValueRangeLattice *> operands,
+    ArrayRef<IntegerValueRangeLattice *> results) {
+  if (auto makeRangeOp = dyn_cast<triton::MakeRangeOp>(op)) {
+    auto start = makeRangeOp.getStartAttr().getInt();
+    auto end = makeRangeOp.getEndAttr().getInt();
+    joinResultRange(results[0],
+                    ConstantIntRanges::fromSigned(APInt(32, start, true),
+                                                  APInt(32, end - 1, true)));
+    return;
+  }
+  if (isa<triton::GetProgramIdOp, triton::GetNumProgramsOp>(op)) {
+    // The size of the grid along each axis is a positive i32
+    auto min = isa<triton::GetProgramIdOp>(op) ? 0 : 1;
+    joinResultRange(results[0],
+                    ConstantIntRanges::fromSigned(
+                        APInt(32, min), APInt::getSignedMaxValue(32)));
+    return;
+  }
+  if (isa<triton::SplatOp, triton::BroadcastOp, triton::ExpandDimsOp,
+          triton::ReshapeOp, triton::TransOp, triton::CatOp, triton::JoinOp,
+          triton::SplitOp, triton::gpu::ConvertLayoutOp>(op)) {
+    if (!isInteger(op->getResult(0)))
+      return setAllToEntryStates(results);
+    std::optional<ConstantIntRanges> range;
+    for (auto *operand : operands) {
+      if (operand->getValue().isUninitialized())
+        return;
+      const auto &operandRange = operand->getValue().getValue();
+      range = range ? range->rangeUnion(operandRange) : operandRange;
+    }
+    for (auto *result : results)
+      joinResultRange(result, *range);
+    return;
+  }
+
+  // The upstream analysis ignores the assumptions on the results
+  auto inferrable = dyn_cast<InferIntRangeInterface>(op);
+  if (!inferrable || llvm::none_of(op->getResults(), [&](Value result) {
+        return assumptions.count(result);
+      }))
+    return dataflow::IntegerRangeAnalysis::visitOperation(op, operands,
+                                                          results);
+  SmallVector<ConstantIntRanges> argRanges;
+  for (auto *operand : operands) {
+    if (operand->getValue().isUninitialized())
+      return;
+    argRanges.push_back(operand->getValue().getValue());
+  }
+  inferrable.inferResultRanges(
+      argRanges, [&](Value value, const ConstantIntRanges &range) {
+        auto result = dyn_cast<OpResult>(value);
+        if (result && result.getOwner() == op)
+          joinResultRange(results[result.getResultNumber()], range);
+      });
+}
+
+std::optional<ConstantIntRanges> getIntegerRange(DataFlowSolver &solver,
+                                                 Value value) {
+  auto *lattice = solver.lookupState<IntegerValueRangeLattice>(value);
+  if (!lattice || lattice->getValue().isUninitialized())
+    return std::nullopt;
+  return lattice->getValue().getValue();
+}
+
+} // namespace mlir::triton
@@ -0,0 +1,160 @@
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/IR/IRMapping.h"
+#include "mlir/IR/PatternMatch.h"
+#include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "triton/Analysis/RangeAnalysis.h"
+#include "triton/Analysis/Utility.h"
+#include "triton/Dialect/Triton/IR/Dialect.h"
+#include "triton/Dialect/TritonGPU/IR/Dialect.h"
+#include "triton/Dialect/TritonGPU/Transforms/Passes.h"
+
+#include <memory>
+
+namespace mlir {
+namespace triton {
+namespace gpu {
+
+#define GEN_PASS_DEF_TRITONGPUNARROWINTARITHMETIC
+#include "triton/Dialect/TritonGPU/Transforms/Passes.h.inc"
+
+namespace {
+
+bool isI64(Type type) { return getElementTypeOrSelf(type).isInteger(64); }
+
+Type getI32Type(Type type) {
+  auto i32Ty = IntegerType::get(type.getContext(), 32);
+  if (auto tensorTy = dyn_cast<RankedTensorType>(type))
+    return tensorTy.clone(i32Ty);
+  return i32Ty;
+}
+
+// Returns true if computing the op in 32 bits gives the same results once they
+// are sign extended, that is if its 64-bit operands and results fit in i32.
+// Add, sub and mul wrap around to the same low 32 bits, and the comparisons
+// keep their order since sign extension preserves both signed and unsigned
+// order.
+bool canNarrow(Operation *op, DataFlowSolver &solver) {
+  if (!isa<arith::AddIOp, arith::SubIOp, arith::MulIOp, arith::DivSIOp,
+           arith::RemSIOp, arith::MinSIOp, arith::MaxSIOp, arith::CmpIOp,
+           arith::SelectOp, triton::SplatOp, triton::BroadcastOp,
+           triton::ExpandDimsOp, triton::gpu::ConvertLayoutOp>(op))
+    return false;
+  SmallVector<Value> values(op->getOperands());
+  values.append(op->result_begin(), op->result_end());
+  bool hasI64 = false;
+  for (Value value : values) {
+    if (!isI64(value.getType()))
+      continue;
+    auto range = getIntegerRange(solver, value);
+    if (!range || !range->smin().isSignedIntN(32) ||
+        !range->smax().isSignedIntN(32))
+      return false;
+    hasI64 = true;
+  }
+  return hasI64;
+}
+
+// Replaces the op by a copy that computes on the truncated operands, whose
+// results are sign extended back to 64 bits. Adds the casts and the ops that
+// they may leave unused to the worklist.
+void narrow(Operation *op, const DenseSet<Operation *> &narrowOps,
+            SmallVectorImpl<Operation *> &worklist) {
+  OpBuilder builder(op);
+  auto loc = op->getLoc();
+  IRMapping mapping;
+  for (Value operand : op->getOperands()) {
+    if (!isI64(operand.getType()) || mapping.contains(operand))
+      continue;
+    auto truncOp = builder.create<arith::TruncIOp>(
+        loc, getI32Type(operand.getType()), operand);
+    mapping.map(operand, truncOp.getResult());
+    worklist.push_back(truncOp);
+    Operation *defOp = operand.getDefiningOp();
+    if (defOp && !narrowOps.contains(defOp))
+      worklist.push_back(defOp);
+  }
+  Operation *newOp = builder.clone(*op, mapping);
+  for (auto [result, newResult] :
+       llvm::zip(op->getResults(), newOp->getResults())) {
+    if (!isI64(result.getType())) {
+      result.replaceAllUsesWith(newResult);
+      continue;
+    }
+    newResult.setType(getI32Type(result.getType()));
+    auto extOp =
+        builder.create<arith::ExtSIOp>(loc, result.getType(), newResult);
+    result.replaceAllUsesWith(extOp.getResult());
+    worklist.push_back(extOp);
+  }
+  op->erase();
+}
+
+// addptr(ptr, extsi(offset)) => addptr(ptr, offset)
+// The lowering of tt.addptr sign extends the offsets.
+struct AddPtrOfExtSIPattern : public OpRewritePattern<triton::AddPtrOp> {
+  using OpRewritePattern::OpRewritePattern;
+
+  LogicalResult matchAndRewrite(triton::AddPtrOp op,
+                                PatternRewriter &rewriter) const override {
+    auto extOp = op.getOffset().getDefiningOp<arith::ExtSIOp>();
+    if (!extOp || !getElementTypeOrSelf(extOp.getIn().getType()).isInteger(32))
+      return failure();
+    rewriter.modifyOpInPlace(
+        op, [&]() { op.getOffsetMutable().assign(extOp.getIn()); });
+    return success();
+  }
+};
+
+} // namespace
+
+class NarrowIntArithmeticPass
+    : public impl::TritonGPUNarrowIntArithmeticBase<NarrowIntArithmeticPass> {
+public:
+  void runOnOperation() override {
+    MLIRContext *context = &getContext();
+    ModuleOp m = getOperation();
+
+    // Decide on the ranges of the original values before rewriting any op
+    SmallVector<Operation *> narrowOps;
+    m.walk([&](FuncOp funcOp) {
+      std::unique_ptr<DataFlowSolver> solver = createDataFlowSolver();
+      solver->load<TritonIntegerRangeAnalysis>(funcOp);
+      if (failed(solver->initializeAndRun(funcOp)))
+        return signalPassFailure();
+      funcOp.walk([&](Operation *op) {
+        if (canNarrow(op, *solver))
+          narrowOps.push_back(op);
+      });
+    });
+
+    DenseSet<Operation *> narrowOpSet(narrowOps.begin(), narrowOps.end());
+    SmallVector<Operation *> worklist;
+    for (Operation *op : narrowOps) {
+      narrowOpSet.erase(op);
+      narrow(op, narrowOpSet, worklist);
+    }
+    m.walk([&](triton::AddPtrOp op) {
+      if (auto extOp = op.getOffset().getDefiningOp<arith::ExtSIOp>()) {
+        worklist.push_back(op);
+        worklist.push_back(extOp);
+      }
+    });
+    if (worklist.empty())
+      return;
+
+    // Fold trunci(extsi(x)) back to x, so that chains of narrowed ops compute
+    // in 32 bits from end to end, and drop the extensions left unused
+    RewritePatternSet patterns(context);
+    patterns.add<AddPtrOfExtSIPattern>(context);
+    arith::TruncIOp::getCanonicalizationPatterns(patterns, context);
+    arith::ExtSIOp::getCanonicalizationPatterns(patterns, context);
+    GreedyRewriteConfig config;
+    config.strictMode = GreedyRewriteStrictness::ExistingAndNewOps;
+    if (failed(applyOpPatternsAndFold(worklist, std::move(patterns), config)))
+      signalPassFailure();
+  }
+};
+
+} // namespace gpu
+} // namespace triton
+} // namespace mlir
@@ -1,9 +1,17 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <stdexcept>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace py = pybind11;
 
@@ -20,6 +28,114 @@ std::map<MemSemantic, int> mem_semantic_map = {
     {MemSemantic::RELAXED, __ATOMIC_RELAXED},
 };
 
+// Invokes `fn` with a value of the unsigned integer type that has the given
+// byte size, so element copies compile to a single fixed-width move.
+template <typename Fn> void dispatchItemSize(size_t itemsize, Fn &&fn) {
+  switch (itemsize) {
+  case 1:
+    return fn(uint8_t{});
+  case 2:
+    return fn(uint16_t{});
+  case 4:
+    return fn(uint32_t{});
+  case 8:
+    return fn(uint64_t{});
+  default:
+    throw std::invalid_argument("Invalid byte size");
+  }
+}
+
+// 16-bit floating point element types. numpy holds fp16 as float16 and bf16 as
+// raw uint16 bits; both are updated through their 16-bit storage and widened
+// to fp32 for arithmetic.
+struct Float16 {
+  using Storage = uint16_t;
+
+  static bool matches(const py::dtype &dtype) {
+    return dtype.kind() == 'f' && dtype.itemsize() == 2;
+  }
+
+  static float toFloat(uint16_t bits) {
+    uint32_t sign = static_cast<uint32_t>(bits & 0x8000) << 16;
+    uint32_t exp = (bits >> 10) & 0x1f;
+    uint32_t man = bits & 0x3ff;
+    if (exp == 0) {
+      float value = std::ldexp(static_cast<float>(man), -24);
+      return sign ? -value : value;
+    }
+    uint32_t f = exp == 0x1f ? sign | 0x7f800000 | (man << 13)
+                             : sign | ((exp + 112) << 23) | (man << 13);
+    float value;
+    std::memcpy(&value, &f, sizeof(f));
+    return value;
+  }
+
+  // Round to nearest even
+  static uint16_t fromFloat(float value) {
+    const uint32_t f32Infinity = 255u << 23;
+    const uint32_t f16Overflow = (127u + 16) << 23;
+    const uint32_t denormMagicBits = ((127u - 15) + (23 - 10) + 1) << 23;
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+    uint32_t bits;
+    if (f >= f16Overflow) {
+      bits = f > f32Infinity ? 0x7e00 : 0x7c00;
+    } else if (f < (113u << 23)) {
+      // Subnormal or zero: let an fp32 addition do the rounding
+      float denormMagic, shifted;
+      std::memcpy(&denormMagic, &denormMagicBits, sizeof(float));
+      std::memcpy(&shifted, &f, sizeof(float));
+      shifted += denormMagic;
+      std::memcpy(&bits, &shifted, sizeof(float));
+      bits -= denormMagicBits;
+    } else {
+      uint32_t mantissaOdd = (f >> 13) & 1;
+      f += (static_cast<uint32_t>(15 - 127) << 23) + 0xfff + mantissaOdd;
+      bits = f >> 13;
+    }
+    return static_cast<uint16_t>(bits | (sign >> 16));
+  }
+};
+
+struct BFloat16 {
+  using Storage = uint16_t;
+
+  // bf16 is the only 16-bit type that reaches FADD as uint16
+  static bool matches(const py::dtype &dtype) {
+    return dtype.is(py::dtype::of<uint16_t>());
+  }
+
+  static float toFloat(uint16_t bits) {
+    uint32_t f = static_cast<uint32_t>(bits) << 16;
+    float value;
+    std::memcpy(&value, &f, sizeof(f));
+    return value;
+  }
+
+  // Round to nearest even
+  static uint16_t fromFloat(float value) {
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    if ((f & 0x7fffffffu) > 0x7f800000u)
+      return static_cast<uint16_t>((f >> 16) | 0x40);
+    f += 0x7fff + ((f >> 16) & 1);
+    return static_cast<uint16_t>(f >> 16);
+  }
+};
+
+template <typename DType> struct ElementTraits {
+  using Storage = DType;
+
+  static bool matches(const py::dtype &dtype) {
+    return dtype.is(py::dtype::of<DType>());
+  }
+};
+
+template <> struct ElementTraits<Float16> : Float16 {};
+template <> struct ElementTraits<BFloat16> : BFloat16 {};
+
 // Use compiler builtin atomics instead of std::atomic which requires
 // each variable to be declared as atomic.
 // Currently work for clang and gcc.
@@ -65,241 +181,951 @@ template <typename T> T atomic_fadd(T *ptr, T val, int order) {
   return old_val;
 }
 
-class AtomicOp {
-public:
-  AtomicOp(const uint64_t *ptr, size_t numel, int order)
-      : ptr(ptr), numel(numel), order(order) {}
-
-  void apply() {
-    for (size_t i = 0; i < numel; ++i) {
-      applyAt(reinterpret_cast<void *>(ptr[i]), i);
+// There are no 16-bit floating point atomics on the host, so the sum is
+// computed in fp32, rounded back to 16 bits and published with a CAS loop.
+// fp32 carries more than twice the precision of either format, so rounding
+// twice gives the same result as a single correctly rounded 16-bit add.
+template <typename Half>
+uint16_t atomic_fadd16(uint16_t *ptr, uint16_t val, int order) {
+  float addend = Half::toFloat(val);
+  uint16_t old_val = __atomic_load_n(ptr, order);
+  while (true) {
+    uint16_t new_val = Half::fromFloat(Half::toFloat(old_val) + addend);
+    if (__atomic_compare_exchange_n(ptr, &old_val, new_val, false, order,
+                                    order)) {
+      break;
     }
   }
+  return old_val;
+}
 
-  virtual ~AtomicOp() = default;
-
-protected:
-  virtual void applyAt(void *, size_t i) = 0;
+// Scalar read-modify-write operations; `apply` returns the previous value.
+template <typename DType, RMWOp Op, typename = void> struct AtomicRMWFn;
 
-  const uint64_t *ptr;
-  size_t numel;
-  int order;
-};
-
-template <typename DType> class AtomicRMWOpBase : public AtomicOp {
-public:
-  AtomicRMWOpBase(const uint64_t *ptr, const void *val, void *ret,
-                  const bool *mask, size_t numel, int order)
-      : AtomicOp(ptr, numel, order), val(val), ret(ret), mask(mask) {}
-
-protected:
-  void applyAt(void *loc, size_t i) override final {
-    if (mask[i]) {
-      *(static_cast<DType *>(ret) + i) =
-          applyAtMasked(static_cast<DType *>(loc),
-                        *(static_cast<const DType *>(val) + i), order);
-    }
+template <typename DType, RMWOp Op>
+struct AtomicRMWFn<DType, Op, std::enable_if_t<Op == RMWOp::ADD>> {
+  static DType apply(DType *loc, DType value, int order) {
+    return __atomic_fetch_add(loc, value, order);
   }
-
-  virtual DType applyAtMasked(DType *loc, const DType value, int order) = 0;
-
-  const void *val;
-  void *ret;
-  const bool *mask;
-};
-
-template <typename DType, RMWOp Op, typename = void>
-class AtomicRMWOp : public AtomicRMWOpBase<DType> {
-public:
-  using AtomicRMWOpBase<DType>::AtomicRMWOpBase;
 };
 
 template <typename DType, RMWOp Op>
-class AtomicRMWOp<DType, Op, std::enable_if_t<Op == RMWOp::ADD>>
-    : public AtomicRMWOpBase<DType> {
-public:
-  using AtomicRMWOpBase<DType>::AtomicRMWOpBase;
-
-protected:
-  DType applyAtMasked(DType *loc, const DType value, int order) override {
-    return __atomic_fetch_add(loc, value, order);
+struct AtomicRMWFn<DType, Op, std::enable_if_t<Op == RMWOp::FADD>> {
+  static DType apply(DType *loc, DType value, int order) {
+    return atomic_fadd(loc, value, order);
   }
 };
 
-template <typename DType, RMWOp Op>
-class AtomicRMWOp<DType, Op, std::enable_if_t<Op == RMWOp::FADD>>
-    : public AtomicRMWOpBase<DType> {
-public:
-  using AtomicRMWOpBase<DType>::AtomicRMWOpBase;
+template <RMWOp Op>
+struct AtomicRMWFn<Float16, Op, std::enable_if_t<Op == RMWOp::FADD>> {
+  static uint16_t apply(uint16_t *loc, uint16_t value, int order) {
+    return atomic_fadd16<Float16>(loc, value, order);
+  }
+};
 
-protected:
-  DType applyAtMasked(DType *loc, const DType value, int order) override {
-    return atomic_fadd(loc, value, order);
+template <RMWOp Op>
+struct AtomicRMWFn<BFloat16, Op, std::enable_if_t<Op == RMWOp::FADD>> {
+  static uint16_t apply(uint16_t *loc, uint16_t value, int order) {
+    return atomic_fadd16<BFloat16>(loc, value, order);
   }
 };
 
 template <typename DType, RMWOp Op>
-class AtomicRMWOp<DType, Op, std::enable_if_t<Op == RMWOp::AND>>
-    : public AtomicRMWOpBase<DType> {
-public:
-  using AtomicRMWOpBase<DType>::AtomicRMWOpBase;
-
-protected:
-  DType applyAtMasked(DType *loc, const DType value, int order) override {
+struct AtomicRMWFn<DType, Op, std::enable_if_t<Op == RMWOp::AND>> {
+  static DType apply(DType *loc, DType value, int order) {
     return __atomic_fetch_and(loc, value, order);
   }
 };
 
 template <typename DType, RMWOp Op>
-class AtomicRMWOp<DType, Op, std::enable_if_t<Op == RMWOp::OR>>
-    : public AtomicRMWOpBase<DType> {
-public:
-  using AtomicRMWOpBase<DType>::AtomicRMWOpBase;
-
-protected:
-  DType applyAtMasked(DType *loc, const DType value, int order) override {
+struct AtomicRMWFn<DType, Op, std::enable_if_t<Op == RMWOp::OR>> {
+  static DType apply(DType *loc, DType value, int order) {
     return __atomic_fetch_or(loc, value, order);
   }
 };
 
 template <typename DType, RMWOp Op>
-class AtomicRMWOp<DType, Op, std::enable_if_t<Op == RMWOp::XOR>>
-    : public AtomicRMWOpBase<DType> {
-public:
-  using AtomicRMWOpBase<DType>::AtomicRMWOpBase;
-
-protected:
-  DType applyAtMasked(DType *loc, const DType value, int order) override {
+struct AtomicRMWFn<DType, Op, std::enable_if_t<Op == RMWOp::XOR>> {
+  static DType apply(DType *loc, DType value, int order) {
     return __atomic_fetch_xor(loc, value, order);
   }
 };
 
 template <typename DType, RMWOp Op>
-class AtomicRMWOp<DType, Op,
-                  std::enable_if_t<Op == RMWOp::MAX || Op == RMWOp::UMAX>>
-    : public AtomicRMWOpBase<DType> {
-public:
-  using AtomicRMWOpBase<DType>::AtomicRMWOpBase;
-
-protected:
-  DType applyAtMasked(DType *loc, const DType value, int order) override {
+struct AtomicRMWFn<DType, Op,
+                   std::enable_if_t<Op == RMWOp::MAX || Op == RMWOp::UMAX>> {
+  static DType apply(DType *loc, DType value, int order) {
     return atomic_cmp</*is_min=*/false>(loc, value, order);
   }
 };
 
 template <typename DType, RMWOp Op>
-class AtomicRMWOp<DType, Op,
-                  std::enable_if_t<Op == RMWOp::MIN || Op == RMWOp::UMIN>>
-    : public AtomicRMWOpBase<DType> {
-public:
-  using AtomicRMWOpBase<DType>::AtomicRMWOpBase;
-
-protected:
-  DType applyAtMasked(DType *loc, const DType value, int order) override {
+struct AtomicRMWFn<DType, Op,
+                   std::enable_if_t<Op == RMWOp::MIN || Op == RMWOp::UMIN>> {
+  static DType apply(DType *loc, DType value, int order) {
     return atomic_cmp</*is_min=*/true>(loc, value, order);
   }
 };
 
 template <typename DType, RMWOp Op>
-class AtomicRMWOp<DType, Op, std::enable_if_t<Op == RMWOp::XCHG>>
-    : public AtomicRMWOpBase<DType> {
-public:
-  using AtomicRMWOpBase<DType>::AtomicRMWOpBase;
-
-protected:
-  DType applyAtMasked(DType *loc, const DType value, int order) override {
+struct AtomicRMWFn<DType, Op, std::enable_if_t<Op == RMWOp::XCHG>> {
+  static DType apply(DType *loc, DType value, int order) {
     return __atomic_exchange_n(loc, value, order);
   }
 };
 
-class AtomicCASOp : public AtomicOp {
-public:
-  AtomicCASOp(const uint64_t *ptr, void *expected, const void *desired,
-              size_t itemsize, size_t numel, int order)
-      : AtomicOp(ptr, numel, order), expected(expected), desired(desired),
-        itemsize(itemsize) {}
-
-protected:
-  void applyAt(void *loc, size_t i) override {
-    // Atomic operations perform bitwise comparison, so it's safe to
-    // use number of bytes (itemsize) to determine the type of pointers
-    if (itemsize == 1) {
-      uint8_t desired_val = *(static_cast<const uint8_t *>(desired) + i);
-      __atomic_compare_exchange_n(static_cast<uint8_t *>(loc),
-                                  static_cast<uint8_t *>(expected) + i,
-                                  desired_val, false, order, order);
-    } else if (itemsize == 2) {
-      uint16_t desired_val = *(static_cast<const uint16_t *>(desired) + i);
-      __atomic_compare_exchange_n(static_cast<uint16_t *>(loc),
-                                  static_cast<uint16_t *>(expected) + i,
-                                  desired_val, false, order, order);
-    } else if (itemsize == 4) {
-      uint32_t desired_val = *(static_cast<const uint32_t *>(desired) + i);
-      __atomic_compare_exchange_n(static_cast<uint32_t *>(loc),
-                                  static_cast<uint32_t *>(expected) + i,
-                                  desired_val, false, order, order);
-    } else if (itemsize == 8) {
-      uint64_t desired_val = *(static_cast<const uint64_t *>(desired) + i);
-      __atomic_compare_exchange_n(static_cast<uint64_t *>(loc),
-                                  static_cast<uint64_t *>(expected) + i,
-                                  desired_val, false, order, order);
-    } else {
-      // The ‘__atomic’ builtins can be used with any integral scalar or pointer
-      // type that is 1, 2, 4, or 8 bytes in length. 16-byte integral types are
-      // also allowed if ‘__int128’ (see 128-bit Integers) is supported by the
-      // architecture.
-      // https://gcc.gnu.org/onlinedocs/gcc/_005f_005fatomic-Builtins.html
-      throw std::invalid_argument("Invalid byte size");
-    }
+// Applies `Op` to the elements listed in `active`. The operation is resolved
+// at compile time, so the loop body is a single inlined atomic instruction
+// (or CAS loop) rather than a virtual call per element.
+template <typename DType, RMWOp Op>
+void atomicRMWBatch(const uint64_t *ptr, const void *val, void *ret,
+                    const size_t *active, size_t num_active, int order) {
+  using Storage = typename ElementTraits<DType>::Storage;
+  auto *values = static_cast<const Storage *>(val);
+  auto *results = static_cast<Storage *>(ret);
+  for (size_t j = 0; j < num_active; ++j) {
+    size_t i = active[j];
+    results[i] = AtomicRMWFn<DType, Op>::apply(
+        reinterpret_cast<Storage *>(ptr[i]), values[i], order);
+  }
+}
+
+using AtomicRMWBatchFn = void (*)(const uint64_t *, const void *, void *,
+                                  const size_t *, size_t, int);
+
+// Picks the batch routine of the first supported type matching `dtype`
+template <RMWOp Op, typename... SupportedDTypes>
+AtomicRMWBatchFn getAtomicRMWBatch(const py::dtype &dtype) {
+  AtomicRMWBatchFn fn = nullptr;
+  ((fn = fn ? fn
+            : ElementTraits<SupportedDTypes>::matches(dtype)
+                ? &atomicRMWBatch<SupportedDTypes, Op>
+                : nullptr),
+   ...);
+  if (!fn) {
+    throw std::invalid_argument("Unsupported data type");
   }
+  return fn;
+}
 
-private:
-  void *expected;
-  const void *desired;
-  size_t itemsize;
+// Atomic operations perform bitwise comparison, so it's safe to use number of
+// bytes (itemsize) to determine the type of pointers
+template <typename T>
+void atomicCASBatch(const uint64_t *ptr, void *expected, const void *desired,
+                    size_t numel, int order) {
+  auto *expected_data = static_cast<T *>(expected);
+  auto *desired_data = static_cast<const T *>(desired);
+  for (size_t i = 0; i < numel; ++i) {
+    __atomic_compare_exchange_n(reinterpret_cast<T *>(ptr[i]),
+                                expected_data + i, desired_data[i], false,
+                                order, order);
+  }
+}
+
+// Indices of the elements whose mask is set
+std::vector<size_t> activeIndices(const bool *mask, size_t numel) {
+  std::vector<size_t> active;
+  active.reserve(numel);
+  for (size_t i = 0; i < numel; ++i) {
+    if (mask[i])
+      active.push_back(i);
+  }
+  return active;
+}
+
+// A numpy array viewed as raw bytes plus per-dimension byte strides. Operands
+// are walked with their own strides, so transposed, sliced or broadcast
+// (zero-stride) arrays are consumed in place instead of being reshaped into a
+// contiguous copy first.
+struct StridedOperand {
+  py::array array;
+  const char *data;
+  std::vector<ptrdiff_t> strides;
 };
 
-// This is a workaround because explicit template parameter list for lambdas is
-// a C++20 extension:
-// auto try_make_op = [&]<typename T>() {
-//   if (dtype.is(pybind11::dtype::of<T>())) {
-//     atomic_op = std::make_unique<AtomicRMWOp<T, Op>>(ptr, val, ret, mask,
-//                                                      numel, order);
-//   }
-// };
-template <RMWOp Op> struct OpCreator {
-  pybind11::dtype dtype;
-  const uint64_t *ptr;
-  const void *val;
-  void *ret;
-  const bool *mask;
-  size_t numel;
-  int order;
-  std::unique_ptr<AtomicOp> &atomic_op;
-
-  template <typename T> void create() {
-    if (!atomic_op && dtype.is(pybind11::dtype::of<T>())) {
-      atomic_op = std::make_unique<AtomicRMWOp<T, Op>>(ptr, val, ret, mask,
-                                                       numel, order);
+StridedOperand makeStridedOperand(py::array array,
+                                  const std::vector<ptrdiff_t> &shape) {
+  if (array.ndim() != static_cast<ptrdiff_t>(shape.size()) ||
+      !std::equal(shape.begin(), shape.end(), array.shape())) {
+    // Same number of elements but a different shape; let numpy reconcile it
+    array = array.reshape(shape);
+  }
+  auto *data = static_cast<const char *>(array.data());
+  std::vector<ptrdiff_t> strides(array.strides(),
+                                 array.strides() + array.ndim());
+  return {std::move(array), data, std::move(strides)};
+}
+
+// Merges adjacent dimensions that are laid out back to back in every operand,
+// so that fully contiguous operands are walked as a single long row.
+void coalesceDims(std::vector<ptrdiff_t> &shape,
+                  std::vector<StridedOperand *> operands) {
+  if (shape.empty()) {
+    shape.push_back(1);
+    for (auto *operand : operands)
+      operand->strides.push_back(0);
+    return;
+  }
+  for (size_t d = shape.size() - 1; d > 0; --d) {
+    bool mergeable = true;
+    for (auto *operand : operands)
+      mergeable &= operand->strides[d - 1] == operand->strides[d] * shape[d];
+    if (!mergeable)
+      continue;
+    shape[d - 1] *= shape[d];
+    shape.erase(shape.begin() + d);
+    for (auto *operand : operands) {
+      operand->strides[d - 1] = operand->strides[d];
+      operand->strides.erase(operand->strides.begin() + d);
     }
   }
+}
+
+// Calls `fn(offsets)` once per innermost row of `shape`, where `offsets[k]` is
+// the byte offset of the row within `operands[k]`.
+template <typename Fn>
+void forEachRow(const std::vector<ptrdiff_t> &shape,
+                const std::vector<StridedOperand *> &operands, Fn &&fn) {
+  size_t numRows = 1;
+  for (size_t d = 0; d + 1 < shape.size(); ++d)
+    numRows *= shape[d];
+  std::vector<ptrdiff_t> index(shape.size(), 0);
+  std::vector<ptrdiff_t> offsets(operands.size(), 0);
+  for (size_t row = 0; row < numRows; ++row) {
+    fn(offsets);
+    for (ptrdiff_t d = static_cast<ptrdiff_t>(shape.size()) - 2; d >= 0; --d) {
+      for (size_t k = 0; k < operands.size(); ++k)
+        offsets[k] += operands[k]->strides[d];
+      if (++index[d] < shape[d])
+        break;
+      for (size_t k = 0; k < operands.size(); ++k)
+        offsets[k] -= operands[k]->strides[d] * shape[d];
+      index[d] = 0;
+    }
+  }
+}
+
+// Copies `n` elements between two strided locations. With a constant address
+// stride this is a plain strided loop that compilers turn into vector
+// gathers/scatters where the target supports them.
+template <typename T>
+void copyStrided(char *dst, ptrdiff_t dstStride, const char *src,
+                 ptrdiff_t srcStride, size_t n) {
+  for (size_t k = 0; k < n; ++k)
+    std::memcpy(dst + k * dstStride, src + k * srcStride, sizeof(T));
+}
+
+template <typename T>
+void gatherElements(char *dst, const char *ptrs, ptrdiff_t ptrStride,
+                    size_t n) {
+  for (size_t k = 0; k < n; ++k) {
+    auto addr = *reinterpret_cast<const uint64_t *>(ptrs + k * ptrStride);
+    std::memcpy(dst + k * sizeof(T), reinterpret_cast<const void *>(addr),
+                sizeof(T));
+  }
+}
+
+template <typename T>
+void scatterElements(const char *ptrs, ptrdiff_t ptrStride, const char *src,
+                     ptrdiff_t srcStride, size_t n) {
+  for (size_t k = 0; k < n; ++k) {
+    auto addr = *reinterpret_cast<const uint64_t *>(ptrs + k * ptrStride);
+    std::memcpy(reinterpret_cast<void *>(addr), src + k * srcStride,
+                sizeof(T));
+  }
+}
+
+// Shortest arithmetic run of non-contiguous addresses worth handling as a
+// strided copy; shorter runs go through the generic per-element path.
+constexpr size_t kMinStridedRun = 4;
+
+// Splits the address stream `ptrs[0, n)` into maximal arithmetic runs and
+// invokes `onRun(begin, length, base, stride)` for runs that are contiguous
+// or long enough, and `onIrregular(begin, length)` for everything in between.
+template <typename RunFn, typename IrregularFn>
+void forEachAddressRun(const char *ptrs, ptrdiff_t ptrStride, size_t n,
+                       size_t itemsize, RunFn &&onRun,
+                       IrregularFn &&onIrregular) {
+  auto addrAt = [&](size_t k) {
+    return *reinterpret_cast<const uint64_t *>(ptrs + k * ptrStride);
+  };
+  size_t irregularBegin = 0;
+  size_t k = 0;
+  while (k < n) {
+    size_t length = 1;
+    uint64_t delta = itemsize;
+    if (k + 1 < n) {
+      delta = addrAt(k + 1) - addrAt(k);
+      length = 2;
+      while (k + length < n &&
+             addrAt(k + length) - addrAt(k + length - 1) == delta)
+        ++length;
+    }
+    bool contiguous = delta == itemsize;
+    if (!contiguous && length < kMinStridedRun) {
+      ++k;
+      continue;
+    }
+    if (irregularBegin < k)
+      onIrregular(irregularBegin, k - irregularBegin);
+    onRun(k, length, addrAt(k), static_cast<ptrdiff_t>(delta));
+    k += length;
+    irregularBegin = k;
+  }
+  if (irregularBegin < n)
+    onIrregular(irregularBegin, n - irregularBegin);
+}
+
+// Calls `fn(begin, length, value)` for each maximal segment of equal mask
+// values in `mask[0, n)`.
+template <typename Fn>
+void forEachMaskSegment(const char *mask, ptrdiff_t maskStride, size_t n,
+                        Fn &&fn) {
+  if (maskStride == 0) {
+    fn(0, n, *mask != 0);
+    return;
+  }
+  size_t i = 0;
+  while (i < n) {
+    bool value = mask[i * maskStride] != 0;
+    size_t j = i + 1;
+    while (j < n && (mask[j * maskStride] != 0) == value)
+      ++j;
+    fn(i, j - i, value);
+    i = j;
+  }
+}
+
+template <typename T>
+void loadRow(char *ret, const char *ptrs, ptrdiff_t ptrStride,
+             const char *mask, ptrdiff_t maskStride, const char *other,
+             ptrdiff_t otherStride, size_t n) {
+  constexpr ptrdiff_t itemsize = sizeof(T);
+  forEachMaskSegment(mask, maskStride, n, [&](size_t i, size_t len, bool on) {
+    char *dst = ret + i * itemsize;
+    if (!on) {
+      if (otherStride == itemsize)
+        std::memcpy(dst, other + i * otherStride, len * itemsize);
+      else
+        copyStrided<T>(dst, itemsize, other + i * otherStride, otherStride,
+                       len);
+      return;
+    }
+    const char *segPtrs = ptrs + i * ptrStride;
+    forEachAddressRun(
+        segPtrs, ptrStride, len, itemsize,
+        [&](size_t begin, size_t length, uint64_t base, ptrdiff_t stride) {
+          auto *src = reinterpret_cast<const char *>(base);
+          if (stride == itemsize)
+            std::memcpy(dst + begin * itemsize, src, length * itemsize);
+          else
+            copyStrided<T>(dst + begin * itemsize, itemsize, src, stride,
+                           length);
+        },
+        [&](size_t begin, size_t length) {
+          gatherElements<T>(dst + begin * itemsize,
+                            segPtrs + begin * ptrStride, ptrStride, length);
+        });
+  });
+}
+
+template <typename T>
+void storeRow(const char *ptrs, ptrdiff_t ptrStride, const char *value,
+              ptrdiff_t valueStride, const char *mask, ptrdiff_t maskStride,
+              size_t n) {
+  constexpr ptrdiff_t itemsize = sizeof(T);
+  forEachMaskSegment(mask, maskStride, n, [&](size_t i, size_t len, bool on) {
+    if (!on)
+      return;
+    const char *segPtrs = ptrs + i * ptrStride;
+    const char *src = value + i * valueStride;
+    forEachAddressRun(
+        segPtrs, ptrStride, len, itemsize,
+        [&](size_t begin, size_t length, uint64_t base, ptrdiff_t stride) {
+          auto *dst = reinterpret_cast<char *>(base);
+          if (stride == itemsize && valueStride == itemsize)
+            std::memcpy(dst, src + begin * valueStride, length * itemsize);
+          else
+            copyStrided<T>(dst, stride, src + begin * valueStride,
+                           valueStride, length);
+        },
+        [&](size_t begin, size_t length) {
+          scatterElements<T>(segPtrs + begin * ptrStride, ptrStride,
+                             src + begin * valueStride, valueStride, length);
+        });
+  });
+}
+
+// Gathers `ret[i] = mask[i] ? *ptr[i] : other[i]` for all elements. `ret` must
+// be a freshly allocated C-contiguous array with the shape of `ptr`.
+void gather(py::array ptr, py::array mask, py::array other, py::array ret) {
+  auto shape = std::vector<ptrdiff_t>(ptr.shape(), ptr.shape() + ptr.ndim());
+  if (ptr.size() == 0)
+    return;
+  StridedOperand ptrOp = makeStridedOperand(ptr, shape);
+  StridedOperand maskOp = makeStridedOperand(mask, shape);
+  StridedOperand otherOp = makeStridedOperand(other, shape);
+  StridedOperand retOp = makeStridedOperand(ret, shape);
+  std::vector<StridedOperand *> operands = {&ptrOp, &maskOp, &otherOp, &retOp};
+  coalesceDims(shape, operands);
+  auto *retData = static_cast<char *>(ret.mutable_data());
+  size_t n = shape.back();
+  auto itemsize = ret.itemsize();
+  py::gil_scoped_release release;
+  dispatchItemSize(itemsize, [&](auto tag) {
+    using T = decltype(tag);
+    forEachRow(shape, operands, [&](const std::vector<ptrdiff_t> &offsets) {
+      loadRow<T>(retData + offsets[3], ptrOp.data + offsets[0],
+                 ptrOp.strides.back(), maskOp.data + offsets[1],
+                 maskOp.strides.back(), otherOp.data + offsets[2],
+                 otherOp.strides.back(), n);
+    });
+  });
+}
+
+// Scatters `*ptr[i] = value[i]` for all elements where `mask[i]` is set.
+// Elements are written in C order, so the last write to an address wins.
+void scatter(py::array ptr, py::array value, py::array mask) {
+  auto shape = std::vector<ptrdiff_t>(ptr.shape(), ptr.shape() + ptr.ndim());
+  if (ptr.size() == 0)
+    return;
+  StridedOperand ptrOp = makeStridedOperand(ptr, shape);
+  StridedOperand valueOp = makeStridedOperand(value, shape);
+  StridedOperand maskOp = makeStridedOperand(mask, shape);
+  std::vector<StridedOperand *> operands = {&ptrOp, &valueOp, &maskOp};
+  coalesceDims(shape, operands);
+  size_t n = shape.back();
+  auto itemsize = value.itemsize();
+  py::gil_scoped_release release;
+  dispatchItemSize(itemsize, [&](auto tag) {
+    using T = decltype(tag);
+    forEachRow(shape, operands, [&](const std::vector<ptrdiff_t> &offsets) {
+      storeRow<T>(ptrOp.data + offsets[0], ptrOp.strides.back(),
+                  valueOp.data + offsets[1], valueOp.strides.back(),
+                  maskOp.data + offsets[2], maskOp.strides.back(), n);
+    });
+  });
+}
+
+// A block pointer access: the `tensorShape` tile at `offsets` of a tensor with
+// `shape` elements laid out with `strides` (in elements) from `base`. Indices
+// along the `boundaryCheck` dimensions are only accessed if they lie within
+// [0, shape).
+struct BlockAccess {
+  uint64_t base;
+  std::vector<int64_t> shape;
+  std::vector<int64_t> strides;
+  std::vector<int64_t> offsets;
+  std::vector<ptrdiff_t> tensorShape;
+  std::vector<int> boundaryCheck;
+};
+
+// Computes the box `[lo, hi)` of tile indices that are accessed. Returns false
+// if the box is empty.
+bool getBlockBox(const BlockAccess &block, std::vector<ptrdiff_t> &lo,
+                 std::vector<ptrdiff_t> &hi) {
+  size_t rank = block.tensorShape.size();
+  lo.assign(rank, 0);
+  hi = block.tensorShape;
+  for (int dim : block.boundaryCheck) {
+    if (dim < 0 || static_cast<size_t>(dim) >= rank)
+      throw std::out_of_range("boundary check dimension out of range");
+    lo[dim] = std::clamp<int64_t>(-block.offsets[dim], 0, hi[dim]);
+    hi[dim] = std::clamp<int64_t>(block.shape[dim] - block.offsets[dim],
+                                  lo[dim], hi[dim]);
+  }
+  for (size_t d = 0; d < rank; ++d) {
+    if (lo[d] == hi[d])
+      return false;
+  }
+  return true;
+}
+
+// The memory side of a block access restricted to the box starting at `lo`,
+// in bytes.
+StridedOperand makeBlockOperand(const BlockAccess &block,
+                                const std::vector<ptrdiff_t> &lo,
+                                size_t itemsize) {
+  uint64_t addr = block.base;
+  std::vector<ptrdiff_t> strides;
+  for (size_t d = 0; d < lo.size(); ++d) {
+    addr += itemsize * (block.offsets[d] + lo[d]) * block.strides[d];
+    strides.push_back(itemsize * block.strides[d]);
+  }
+  return {py::array(), reinterpret_cast<const char *>(addr),
+          std::move(strides)};
+}
+
+// Offsets an operand that spans the whole tile to the box starting at `lo`
+void moveToBox(StridedOperand &operand, const std::vector<ptrdiff_t> &lo) {
+  for (size_t d = 0; d < lo.size(); ++d)
+    operand.data += lo[d] * operand.strides[d];
+}
+
+// Loads a block pointer tile into `ret`, which must be a freshly allocated
+// C-contiguous array of the tile shape. Elements outside of the accessed box
+// are set to the single element of `padding`. Rows are copied straight from
+// the source tensor without materializing per-element addresses.
+void loadBlock(const BlockAccess &block, py::array padding, py::array ret) {
+  if (ret.size() == 0)
+    return;
+  std::vector<ptrdiff_t> lo, hi;
+  bool nonEmpty = getBlockBox(block, lo, hi);
+  bool padded = !nonEmpty || lo != std::vector<ptrdiff_t>(lo.size(), 0) ||
+                hi != block.tensorShape;
+  auto itemsize = ret.itemsize();
+  auto *retData = static_cast<char *>(ret.mutable_data());
+  auto *padData = static_cast<const char *>(padding.data());
+  size_t numel = ret.size();
+  std::vector<ptrdiff_t> shape(hi.size());
+  for (size_t d = 0; d < hi.size(); ++d)
+    shape[d] = hi[d] - lo[d];
+  StridedOperand srcOp = makeBlockOperand(block, lo, itemsize);
+  StridedOperand retOp = makeStridedOperand(ret, block.tensorShape);
+  moveToBox(retOp, lo);
+  std::vector<StridedOperand *> operands = {&srcOp, &retOp};
+  coalesceDims(shape, operands);
+  size_t n = shape.back();
+  py::gil_scoped_release release;
+  dispatchItemSize(itemsize, [&](auto tag) {
+    using T = decltype(tag);
+    if (padded)
+      copyStrided<T>(retData, itemsize, padData, 0, numel);
+    if (!nonEmpty)
+      return;
+    forEachRow(shape, operands, [&](const std::vector<ptrdiff_t> &offsets) {
+      char *dst = const_cast<char *>(retOp.data) + offsets[1];
+      const char *src = srcOp.data + offsets[0];
+      if (srcOp.strides.back() == itemsize)
+        std::memcpy(dst, src, n * itemsize);
+      else
+        copyStrided<T>(dst, itemsize, src, srcOp.strides.back(), n);
+    });
+  });
+}
+
+// Stores `value` (of the tile shape) through a block pointer. Elements are
+// written in C order, like `scatter`. Returns the half-open range of bytes
+// that may have been written, which is empty if nothing was.
+std::pair<uint64_t, uint64_t> storeBlock(const BlockAccess &block,
+                                         py::array value) {
+  std::vector<ptrdiff_t> lo, hi;
+  if (value.size() == 0 || !getBlockBox(block, lo, hi))
+    return {0, 0};
+  auto itemsize = value.itemsize();
+  std::vector<ptrdiff_t> shape(hi.size());
+  for (size_t d = 0; d < hi.size(); ++d)
+    shape[d] = hi[d] - lo[d];
+  StridedOperand dstOp = makeBlockOperand(block, lo, itemsize);
+  StridedOperand valueOp = makeStridedOperand(value, block.tensorShape);
+  moveToBox(valueOp, lo);
+  auto begin = reinterpret_cast<uint64_t>(dstOp.data);
+  auto end = begin + itemsize;
+  for (size_t d = 0; d < shape.size(); ++d) {
+    ptrdiff_t extent = (shape[d] - 1) * dstOp.strides[d];
+    (extent < 0 ? begin : end) += extent;
+  }
+  std::vector<StridedOperand *> operands = {&dstOp, &valueOp};
+  coalesceDims(shape, operands);
+  size_t n = shape.back();
+  py::gil_scoped_release release;
+  dispatchItemSize(itemsize, [&](auto tag) {
+    using T = decltype(tag);
+    forEachRow(shape, operands, [&](const std::vector<ptrdiff_t> &offsets) {
+      char *dst = const_cast<char *>(dstOp.data) + offsets[0];
+      const char *src = valueOp.data + offsets[1];
+      ptrdiff_t dstStride = dstOp.strides.back();
+      ptrdiff_t srcStride = valueOp.strides.back();
+      if (dstStride == itemsize && srcStride == itemsize)
+        std::memcpy(dst, src, n * itemsize);
+      else
+        copyStrided<T>(dst, dstStride, src, srcStride, n);
+    });
+  });
+  return {begin, end};
+}
+
+// Floating point storage formats understood by the native conversion and dot
+// routines. Low precision values are stored as raw bits (uint16/uint8).
+enum class FloatFormat {
+  FP64,
+  FP32,
+  FP16,
+  BF16,
+  FP8E5,
+  FP8E5B16,
+  FP8E4NV,
+  FP8E4B8,
+  FP8E4B15
 };
 
-template <RMWOp Op, typename... SupportedDTypes>
-std::unique_ptr<AtomicOp>
-makeAtomicRMWOp(pybind11::dtype dtype, const uint64_t *ptr, const void *val,
-                void *ret, const bool *mask, size_t numel, int order) {
-  // Iterate over all supported data types, make one that matches, and return
-  std::unique_ptr<AtomicOp> atomic_op;
-  OpCreator<Op> try_make_op{dtype, ptr,   val,   ret,
-                            mask,  numel, order, atomic_op};
-
-  (try_make_op.template create<SupportedDTypes>(), ...);
-  if (!atomic_op) {
-    throw std::invalid_argument("Unsupported data type");
+struct FloatFormatInfo {
+  int bits;
+  int mantissa;
+  int bias;
+  // The all-ones exponent encodes inf/nan, as in IEEE formats
+  bool ieeeSpecials;
+  // "fnuz" formats: no inf, no negative zero, and 0x80 encodes nan
+  bool fnuz;
+  // e4m3fn: no inf, and only the all-ones magnitude encodes nan
+  bool allOnesIsNaN;
+};
+
+FloatFormatInfo getFloatFormatInfo(FloatFormat format) {
+  switch (format) {
+  case FloatFormat::FP64:
+    return {64, 52, 1023, true, false, false};
+  case FloatFormat::FP32:
+    return {32, 23, 127, true, false, false};
+  case FloatFormat::FP16:
+    return {16, 10, 15, true, false, false};
+  case FloatFormat::BF16:
+    return {16, 7, 127, true, false, false};
+  case FloatFormat::FP8E5:
+    return {8, 2, 15, true, false, false};
+  case FloatFormat::FP8E5B16:
+    return {8, 2, 16, false, true, false};
+  case FloatFormat::FP8E4NV:
+    return {8, 3, 7, false, false, true};
+  case FloatFormat::FP8E4B8:
+    return {8, 3, 8, false, true, false};
+  case FloatFormat::FP8E4B15:
+    return {8, 3, 15, false, false, false};
+  }
+  throw std::invalid_argument("Unsupported float format");
+}
+
+float decodeFloatBits(uint32_t bits, const FloatFormatInfo &info) {
+  int expBits = info.bits - 1 - info.mantissa;
+  uint32_t sign = (bits >> (info.bits - 1)) & 1;
+  uint32_t exp = (bits >> info.mantissa) & ((1u << expBits) - 1);
+  uint32_t man = bits & ((1u << info.mantissa) - 1);
+  uint32_t magnitude = bits & ((1u << (info.bits - 1)) - 1);
+  if (info.fnuz && sign && magnitude == 0)
+    return std::numeric_limits<float>::quiet_NaN();
+  if (info.allOnesIsNaN && magnitude == (1u << (info.bits - 1)) - 1)
+    return std::numeric_limits<float>::quiet_NaN();
+  if (info.ieeeSpecials && exp == (1u << expBits) - 1) {
+    if (man)
+      return std::numeric_limits<float>::quiet_NaN();
+    return sign ? -std::numeric_limits<float>::infinity()
+                : std::numeric_limits<float>::infinity();
+  }
+  float value =
+      exp == 0
+          ? std::ldexp(static_cast<float>(man), 1 - info.bias - info.mantissa)
+          : std::ldexp(static_cast<float>(man | (1u << info.mantissa)),
+                       static_cast<int>(exp) - info.bias - info.mantissa);
+  return sign ? -value : value;
+}
+
+// Lookup tables mapping every 8/16-bit encoding to its fp32 value
+const float *getDecodeTable(FloatFormat format) {
+  auto build = [](FloatFormat format) {
+    auto info = getFloatFormatInfo(format);
+    std::vector<float> table(size_t(1) << info.bits);
+    for (size_t bits = 0; bits < table.size(); ++bits)
+      table[bits] = decodeFloatBits(bits, info);
+    return table;
+  };
+  switch (format) {
+  case FloatFormat::FP16: {
+    static const std::vector<float> table = build(FloatFormat::FP16);
+    return table.data();
+  }
+  case FloatFormat::FP8E5: {
+    static const std::vector<float> table = build(FloatFormat::FP8E5);
+    return table.data();
+  }
+  case FloatFormat::FP8E5B16: {
+    static const std::vector<float> table = build(FloatFormat::FP8E5B16);
+    return table.data();
+  }
+  case FloatFormat::FP8E4NV: {
+    static const std::vector<float> table = build(FloatFormat::FP8E4NV);
+    return table.data();
+  }
+  case FloatFormat::FP8E4B8: {
+    static const std::vector<float> table = build(FloatFormat::FP8E4B8);
+    return table.data();
+  }
+  case FloatFormat::FP8E4B15: {
+    static const std::vector<float> table = build(FloatFormat::FP8E4B15);
+    return table.data();
+  }
+  default:
+    throw std::invalid_argument("No decode table for float format");
+  }
+}
+
+// Widens `n` consecutive values stored in `format` to fp32
+void decodeRow(FloatFormat format, const char *src, float *dst, size_t n) {
+  switch (format) {
+  case FloatFormat::FP64:
+    for (size_t i = 0; i < n; ++i) {
+      double value;
+      std::memcpy(&value, src + i * sizeof(value), sizeof(value));
+      dst[i] = static_cast<float>(value);
+    }
+    return;
+  case FloatFormat::FP32:
+    std::memcpy(dst, src, n * sizeof(float));
+    return;
+  case FloatFormat::BF16:
+    for (size_t i = 0; i < n; ++i) {
+      uint16_t bits;
+      std::memcpy(&bits, src + i * sizeof(bits), sizeof(bits));
+      uint32_t widened = static_cast<uint32_t>(bits) << 16;
+      std::memcpy(dst + i, &widened, sizeof(widened));
+    }
+    return;
+  case FloatFormat::FP16: {
+    const float *table = getDecodeTable(format);
+    for (size_t i = 0; i < n; ++i) {
+      uint16_t bits;
+      std::memcpy(&bits, src + i * sizeof(bits), sizeof(bits));
+      dst[i] = table[bits];
+    }
+    return;
+  }
+  default: {
+    const float *table = getDecodeTable(format);
+    auto *bytes = reinterpret_cast<const uint8_t *>(src);
+    for (size_t i = 0; i < n; ++i)
+      dst[i] = table[bytes[i]];
+    return;
+  }
+  }
+}
+
+size_t getFloatFormatSize(FloatFormat format) {
+  return getFloatFormatInfo(format).bits / 8;
+}
+
+enum class RoundingMode { RTZ, RTNE };
+
+// Number of elements converted per step, through a buffer on the stack
+constexpr size_t kConvertChunk = 256;
+
+// Encodes `value` in a format of at most 32 bits, rounding once. Overflow
+// produces inf in formats that have one, unless rounding toward zero; formats
+// without inf saturate to their largest finite value instead.
+uint32_t encodeFloatBits(double value, const FloatFormatInfo &info,
+                         RoundingMode mode) {
+  int expBits = info.bits - 1 - info.mantissa;
+  uint32_t signBit = 1u << (info.bits - 1);
+  uint32_t sign = std::signbit(value) ? signBit : 0;
+  uint32_t expMask = (1u << expBits) - 1;
+  uint32_t infBits = expMask << info.mantissa;
+  uint32_t maxFinite = info.ieeeSpecials ? infBits - 1 : signBit - 1;
+  if (info.allOnesIsNaN)
+    maxFinite -= 1;
+  if (std::isnan(value)) {
+    if (info.ieeeSpecials)
+      return sign | infBits | (1u << (info.mantissa - 1));
+    if (info.fnuz)
+      return signBit;
+    // Formats without a nan encoding use their largest magnitude
+    return sign | (signBit - 1);
+  }
+  if (std::isinf(value))
+    return sign | (info.ieeeSpecials ? infBits : maxFinite);
+  double magnitude = std::fabs(value);
+  if (magnitude == 0)
+    return info.fnuz ? 0 : sign;
+  // Scale the magnitude so that one unit in the last place of the target
+  // becomes 1. Scaling by a power of two is exact.
+  int exp;
+  std::frexp(magnitude, &exp);
+  int unbiased = std::max(exp - 1, 1 - info.bias);
+  double scaled = std::ldexp(magnitude, info.mantissa - unbiased);
+  double rounded = std::floor(scaled);
+  if (mode == RoundingMode::RTNE) {
+    double remainder = scaled - rounded;
+    if (remainder > 0.5 ||
+        (remainder == 0.5 && std::fmod(rounded, 2.0) != 0.0))
+      rounded += 1;
+  }
+  uint64_t significand = static_cast<uint64_t>(rounded);
+  uint64_t bits;
+  if (significand < (uint64_t(1) << info.mantissa)) {
+    // Subnormal, with a biased exponent of zero
+    bits = significand;
+  } else {
+    int64_t biased = unbiased + info.bias;
+    // Rounding up carried into the next binade
+    if (significand >> (info.mantissa + 1)) {
+      significand >>= 1;
+      biased += 1;
+    }
+    bits = (uint64_t(biased) << info.mantissa) |
+           (significand & ((uint64_t(1) << info.mantissa) - 1));
+  }
+  if (bits > maxFinite) {
+    if (info.ieeeSpecials && mode == RoundingMode::RTNE)
+      return sign | infBits;
+    return sign | maxFinite;
+  }
+  if (bits == 0 && info.fnuz)
+    return 0;
+  return sign | static_cast<uint32_t>(bits);
+}
+
+// Widens `n` consecutive values stored in `format` to fp64, exactly
+void decodeRowDouble(FloatFormat format, const char *src, double *dst,
+                     size_t n) {
+  switch (format) {
+  case FloatFormat::FP64:
+    std::memcpy(dst, src, n * sizeof(double));
+    return;
+  case FloatFormat::FP32:
+    for (size_t i = 0; i < n; ++i) {
+      float value;
+      std::memcpy(&value, src + i * sizeof(value), sizeof(value));
+      dst[i] = value;
+    }
+    return;
+  default: {
+    float row[kConvertChunk];
+    for (size_t i = 0; i < n; i += kConvertChunk) {
+      size_t len = std::min(kConvertChunk, n - i);
+      decodeRow(format, src + i * getFloatFormatSize(format), row, len);
+      std::copy(row, row + len, dst + i);
+    }
+    return;
+  }
+  }
+}
+
+// Converts `n` consecutive values from `srcFormat` to `dstFormat`. Every
+// source value is exactly representable as a double, so each result is
+// rounded only once.
+void convertFloats(FloatFormat srcFormat, const char *src,
+                   FloatFormat dstFormat, char *dst, size_t n,
+                   RoundingMode mode) {
+  size_t srcItemsize = getFloatFormatSize(srcFormat);
+  size_t dstItemsize = getFloatFormatSize(dstFormat);
+  auto info = getFloatFormatInfo(dstFormat);
+  double row[kConvertChunk];
+  for (size_t begin = 0; begin < n; begin += kConvertChunk) {
+    size_t len = std::min(kConvertChunk, n - begin);
+    decodeRowDouble(srcFormat, src + begin * srcItemsize, row, len);
+    char *out = dst + begin * dstItemsize;
+    if (dstFormat == FloatFormat::FP64) {
+      std::memcpy(out, row, len * sizeof(double));
+    } else if (dstFormat == FloatFormat::FP32 &&
+               mode == RoundingMode::RTNE) {
+      // The native conversion rounds to nearest even
+      for (size_t i = 0; i < len; ++i) {
+        float value = static_cast<float>(row[i]);
+        std::memcpy(out + i * sizeof(value), &value, sizeof(value));
+      }
+    } else {
+      dispatchItemSize(dstItemsize, [&](auto tag) {
+        using T = decltype(tag);
+        for (size_t i = 0; i < len; ++i) {
+          T bits = static_cast<T>(encodeFloatBits(row[i], info, mode));
+          std::memcpy(out + i * sizeof(T), &bits, sizeof(T));
+        }
+      });
+    }
+  }
+}
+
+// Cache blocking of the dot kernel; a KC x NC panel of B plus an MC x KC
+// panel of A stay resident in L2.
+constexpr size_t kDotBlockM = 64;
+constexpr size_t kDotBlockN = 256;
+constexpr size_t kDotBlockK = 256;
+
+// Explicit mantissa bits kept by the accumulator of fp8 MMAs, which only
+// carries about 14 significant bits between its flushes into fp32
+constexpr int kImpreciseAccMantissa = 13;
+
+// Keeps only the sign, exponent and top mantissa bits selected by `mask` of
+// each of the `n` floats in `values`
+void truncateFloats(float *values, size_t n, uint32_t mask) {
+  for (size_t j = 0; j < n; ++j) {
+    uint32_t bits;
+    std::memcpy(&bits, &values[j], sizeof(bits));
+    bits &= mask;
+    std::memcpy(&values[j], &bits, sizeof(bits));
+  }
+}
+
+// Accumulates `a[:, kBegin:kEnd] @ b[kBegin:kEnd, :]` into the row-major fp32
+// matrix `acc`. Operands are decoded to fp32 one panel at a time, and the
+// innermost loop is a unit-stride axpy over N that compilers vectorize. When
+// `accMask` is not all ones, the accumulator is truncated with it after every
+// step of K.
+void dotBlock(const char *a, FloatFormat aFormat, const char *b,
+              FloatFormat bFormat, float *acc, size_t M, size_t N, size_t K,
+              size_t kBegin, size_t kEnd, uint32_t accMask) {
+  size_t aItemsize = getFloatFormatSize(aFormat);
+  size_t bItemsize = getFloatFormatSize(bFormat);
+  std::vector<float> aPanel(kDotBlockM * kDotBlockK);
+  std::vector<float> bPanel(kDotBlockK * kDotBlockN);
+  for (size_t kk = kBegin; kk < kEnd; kk += kDotBlockK) {
+    size_t kc = std::min(kDotBlockK, kEnd - kk);
+    for (size_t jj = 0; jj < N; jj += kDotBlockN) {
+      size_t nc = std::min(kDotBlockN, N - jj);
+      for (size_t k = 0; k < kc; ++k)
+        decodeRow(bFormat, b + ((kk + k) * N + jj) * bItemsize,
+                  &bPanel[k * nc], nc);
+      for (size_t ii = 0; ii < M; ii += kDotBlockM) {
+        size_t mc = std::min(kDotBlockM, M - ii);
+        for (size_t i = 0; i < mc; ++i)
+          decodeRow(aFormat, a + ((ii + i) * K + kk) * aItemsize,
+                    &aPanel[i * kc], kc);
+        for (size_t i = 0; i < mc; ++i) {
+          float *__restrict accRow = acc + (ii + i) * N + jj;
+          const float *aRow = &aPanel[i * kc];
+          for (size_t k = 0; k < kc; ++k) {
+            float aValue = aRow[k];
+            const float *__restrict bRow = &bPanel[k * nc];
+            for (size_t j = 0; j < nc; ++j)
+              accRow[j] += aValue * bRow[j];
+            if (accMask != ~0u)
+              truncateFloats(accRow, nc, accMask);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Computes `d[i] += a[i] @ b[i]` over a batch of matrices, where `a` and `b`
+// may hold a single matrix that is broadcast over the batch. A positive
+// `maxNumImpreciseAcc` below K mimics fp8 MMA: products are summed into a
+// separate partial accumulator, truncated to kImpreciseAccMantissa bits of
+// mantissa after every addition, that is flushed into `d` every
+// `maxNumImpreciseAcc` elements of K.
+void dot(const char *a, FloatFormat aFormat, size_t aBatch, const char *b,
+         FloatFormat bFormat, size_t bBatch, float *d, size_t batch, size_t M,
+         size_t N, size_t K, size_t maxNumImpreciseAcc) {
+  size_t aStride = M * K * getFloatFormatSize(aFormat);
+  size_t bStride = K * N * getFloatFormatSize(bFormat);
+  size_t chunk = maxNumImpreciseAcc > 0 && maxNumImpreciseAcc < K
+                     ? maxNumImpreciseAcc
+                     : K;
+  std::vector<float> partial(chunk < K ? M * N : 0);
+  const uint32_t impreciseMask = ~((1u << (23 - kImpreciseAccMantissa)) - 1);
+  for (size_t i = 0; i < batch; ++i) {
+    const char *aMat = a + (aBatch == 1 ? 0 : i) * aStride;
+    const char *bMat = b + (bBatch == 1 ? 0 : i) * bStride;
+    float *dMat = d + i * M * N;
+    if (chunk == K) {
+      dotBlock(aMat, aFormat, bMat, bFormat, dMat, M, N, K, 0, K, ~0u);
+      continue;
+    }
+    for (size_t k = 0; k < K; k += chunk) {
+      std::fill(partial.begin(), partial.end(), 0.0f);
+      dotBlock(aMat, aFormat, bMat, bFormat, partial.data(), M, N, K, k,
+               std::min(K, k + chunk), impreciseMask);
+      for (size_t j = 0; j < M * N; ++j)
+        dMat[j] += partial[j];
+    }
   }
-  // Make it a unique_ptr
-  return atomic_op;
 }
 
 } // namespace
@@ -327,40 +1153,119 @@ void init_triton_interpreter(py::module &&m) {
       .value("UMAX", RMWOp::UMAX)
       .export_values();
 
+  py::enum_<FloatFormat>(m, "FLOAT_FORMAT", py::module_local())
+      .value("FP64", FloatFormat::FP64)
+      .value("FP32", FloatFormat::FP32)
+      .value("FP16", FloatFormat::FP16)
+      .value("BF16", FloatFormat::BF16)
+      .value("FP8E5", FloatFormat::FP8E5)
+      .value("FP8E5B16", FloatFormat::FP8E5B16)
+      .value("FP8E4NV", FloatFormat::FP8E4NV)
+      .value("FP8E4B8", FloatFormat::FP8E4B8)
+      .value("FP8E4B15", FloatFormat::FP8E4B15)
+      .export_values();
+
+  py::enum_<RoundingMode>(m, "ROUNDING_MODE", py::module_local())
+      .value("RTZ", RoundingMode::RTZ)
+      .value("RTNE", RoundingMode::RTNE)
+      .export_values();
+
   m.def("load",
         [](py::array_t<uint64_t> ptr, py::array_t<bool> mask, py::array other,
            py::dtype ret_dtype) -> py::array {
-          int numel = ptr.size();
           auto shape =
               std::vector<ptrdiff_t>(ptr.shape(), ptr.shape() + ptr.ndim());
-          py::array ret(ret_dtype, py::array::ShapeContainer{numel});
-          py::array_t<uint64_t> reshaped_ptr = ptr.reshape({numel});
-          py::array_t<bool> reshaped_mask = mask.reshape({numel});
-          py::array reshaped_others = other.reshape({numel});
-          for (size_t i = 0; i < ptr.size(); ++i) {
-            if (reshaped_mask.at(i))
-              memcpy(ret.mutable_data(i),
-                     reinterpret_cast<void *>(reshaped_ptr.at(i)),
-                     ret_dtype.itemsize());
-            else
-              memcpy(ret.mutable_data(i), reshaped_others.data(i),
-                     ret_dtype.itemsize());
-          }
-          return ret.reshape(shape);
+          py::array ret(ret_dtype, py::array::ShapeContainer{shape});
+          gather(ptr, mask, other, ret);
+          return ret;
         });
 
   m.def("store",
         [](py::array_t<uint64_t> ptr, py::array value, py::array_t<bool> mask) {
-          int numel = ptr.size();
-          py::array_t<uint64_t> reshaped_ptr = ptr.reshape({numel});
-          py::array_t<int8_t> reshaped_mask = mask.reshape({numel});
-          py::array reshaped_value = value.reshape({numel});
-          for (size_t i = 0; i < ptr.size(); ++i) {
-            if (reshaped_mask.at(i)) {
-              memcpy(reinterpret_cast<void *>(reshaped_ptr.mutable_at(i)),
-                     reshaped_value.data(i), value.dtype().itemsize());
-            }
+          scatter(ptr, value, mask);
+        });
+
+  m.def("load_block",
+        [](uint64_t base, std::vector<int64_t> shape,
+           std::vector<int64_t> strides, std::vector<int64_t> offsets,
+           std::vector<ptrdiff_t> tensor_shape, std::vector<int> boundary_check,
+           py::array padding, py::dtype ret_dtype) -> py::array {
+          BlockAccess block{base,    shape,        strides,
+                            offsets, tensor_shape, boundary_check};
+          py::array ret(ret_dtype,
+                        py::array::ShapeContainer{block.tensorShape});
+          loadBlock(block, padding, ret);
+          return ret;
+        });
+
+  m.def("store_block",
+        [](uint64_t base, std::vector<int64_t> shape,
+           std::vector<int64_t> strides, std::vector<int64_t> offsets,
+           std::vector<ptrdiff_t> tensor_shape, std::vector<int> boundary_check,
+           py::array value) {
+          BlockAccess block{base,    shape,        strides,
+                            offsets, tensor_shape, boundary_check};
+          return storeBlock(block, value);
+        });
+
+  m.def("convert_float",
+        [](py::array src, FloatFormat src_format, FloatFormat dst_format,
+           RoundingMode rounding_mode) -> py::array {
+          // Values are passed and returned as raw bits; the result has the
+          // unsigned integer dtype of the destination width.
+          if (src.itemsize() != getFloatFormatSize(src_format))
+            throw std::invalid_argument("convert_float source dtype mismatch");
+          py::array contiguous = py::array::ensure(src, py::array::c_style);
+          auto shape = std::vector<ptrdiff_t>(
+              contiguous.shape(), contiguous.shape() + contiguous.ndim());
+          py::dtype ret_dtype;
+          dispatchItemSize(getFloatFormatSize(dst_format), [&](auto tag) {
+            ret_dtype = py::dtype::of<decltype(tag)>();
+          });
+          py::array ret(ret_dtype, py::array::ShapeContainer{shape});
+          auto *src_data = static_cast<const char *>(contiguous.data());
+          auto *dst_data = static_cast<char *>(ret.mutable_data());
+          size_t numel = contiguous.size();
+          {
+            py::gil_scoped_release release;
+            convertFloats(src_format, src_data, dst_format, dst_data, numel,
+                          rounding_mode);
           }
+          return ret;
+        });
+
+  m.def("dot",
+        [](py::array a, FloatFormat a_format, py::array b,
+           FloatFormat b_format, py::array_t<float> d,
+           int max_num_imprecise_acc) {
+          // a: [batch_a, M, K], b: [batch_b, K, N] and d: [batch, M, N], all
+          // C-contiguous; batch_a and batch_b are either 1 or batch. The
+          // product is accumulated into d in place. A positive
+          // max_num_imprecise_acc below K emulates the low precision
+          // accumulator of fp8 MMAs.
+          if (a.ndim() != 3 || b.ndim() != 3 || d.ndim() != 3)
+            throw std::invalid_argument("dot operands must be 3-dimensional");
+          if (!(a.flags() & py::array::c_style) ||
+              !(b.flags() & py::array::c_style) ||
+              !(d.flags() & py::array::c_style))
+            throw std::invalid_argument("dot operands must be C-contiguous");
+          size_t batch = d.shape(0), M = d.shape(1), N = d.shape(2);
+          size_t K = a.shape(2);
+          if (a.shape(1) != M || b.shape(1) != K || b.shape(2) != N)
+            throw std::invalid_argument("dot operand shapes mismatch");
+          if ((a.shape(0) != 1 && a.shape(0) != batch) ||
+              (b.shape(0) != 1 && b.shape(0) != batch))
+            throw std::invalid_argument("dot batch dimensions mismatch");
+          if (a.itemsize() != getFloatFormatSize(a_format) ||
+              b.itemsize() != getFloatFormatSize(b_format))
+            throw std::invalid_argument("dot operand dtype mismatch");
+          auto *a_data = static_cast<const char *>(a.data());
+          auto *b_data = static_cast<const char *>(b.data());
+          auto *d_data = d.mutable_data();
+          size_t a_batch = a.shape(0), b_batch = b.shape(0);
+          py::gil_scoped_release release;
+          dot(a_data, a_format, a_batch, b_data, b_format, b_batch, d_data,
+              batch, M, N, K, std::max(max_num_imprecise_acc, 0));
         });
 
   m.def("atomic_rmw",
@@ -380,33 +1285,42 @@ void init_triton_interpreter(py::module &&m) {
           auto *val_data = static_cast<const void *>(reshaped_val.data());
           auto *ret_data = static_cast<void *>(ret.mutable_data());
 
-          std::unique_ptr<AtomicOp> atomic_op;
+          auto active = activeIndices(mask_data, numel);
+
+          AtomicRMWBatchFn atomic_batch;
 
-#define MAKE_ATOMIC_RMW_OP(OP_NAME, ...)                                       \
+#define GET_ATOMIC_RMW_BATCH(OP_NAME, ...)                                     \
   case OP_NAME:                                                                \
-    atomic_op = makeAtomicRMWOp<OP_NAME, __VA_ARGS__>(                         \
-        ret_dtype, ptr_data, val_data, ret_data, mask_data, numel, order);     \
+    atomic_batch = getAtomicRMWBatch<OP_NAME, __VA_ARGS__>(ret_dtype);         \
     break;
 
           switch (rmw_op) {
-            MAKE_ATOMIC_RMW_OP(RMWOp::ADD, int32_t, uint32_t, int64_t, uint64_t)
-            MAKE_ATOMIC_RMW_OP(RMWOp::FADD, float, double)
-            MAKE_ATOMIC_RMW_OP(RMWOp::AND, int32_t, uint32_t, int64_t, uint64_t)
-            MAKE_ATOMIC_RMW_OP(RMWOp::OR, int32_t, uint32_t, int64_t, uint64_t)
-            MAKE_ATOMIC_RMW_OP(RMWOp::XOR, int32_t, uint32_t, int64_t, uint64_t)
-            MAKE_ATOMIC_RMW_OP(RMWOp::MAX, int32_t, int64_t)
-            MAKE_ATOMIC_RMW_OP(RMWOp::UMAX, uint32_t, uint64_t)
-            MAKE_ATOMIC_RMW_OP(RMWOp::MIN, int32_t, int64_t)
-            MAKE_ATOMIC_RMW_OP(RMWOp::UMIN, uint32_t, uint64_t)
-            MAKE_ATOMIC_RMW_OP(RMWOp::XCHG, int32_t, uint32_t, int64_t,
-                               uint64_t)
+            GET_ATOMIC_RMW_BATCH(RMWOp::ADD, int32_t, uint32_t, int64_t,
+                                 uint64_t)
+            GET_ATOMIC_RMW_BATCH(RMWOp::FADD, float, double, Float16, BFloat16)
+            GET_ATOMIC_RMW_BATCH(RMWOp::AND, int32_t, uint32_t, int64_t,
+                                 uint64_t)
+            GET_ATOMIC_RMW_BATCH(RMWOp::OR, int32_t, uint32_t, int64_t,
+                                 uint64_t)
+            GET_ATOMIC_RMW_BATCH(RMWOp::XOR, int32_t, uint32_t, int64_t,
+                                 uint64_t)
+            GET_ATOMIC_RMW_BATCH(RMWOp::MAX, int32_t, int64_t)
+            GET_ATOMIC_RMW_BATCH(RMWOp::UMAX, uint32_t, uint64_t)
+            GET_ATOMIC_RMW_BATCH(RMWOp::MIN, int32_t, int64_t)
+            GET_ATOMIC_RMW_BATCH(RMWOp::UMIN, uint32_t, uint64_t)
+            GET_ATOMIC_RMW_BATCH(RMWOp::XCHG, int32_t, uint32_t, int64_t,
+                                 uint64_t)
           default:
             throw std::invalid_argument("Unsupported RMW operation");
           }
 
-#undef MAKE_ATOMIC_RMW_OP
+#undef GET_ATOMIC_RMW_BATCH
 
-          atomic_op->apply();
+          {
+            py::gil_scoped_release release;
+            atomic_batch(ptr_data, val_data, ret_data, active.data(),
+                         active.size(), order);
+          }
           return ret.reshape(shape);
         });
 
@@ -426,10 +1340,16 @@ void init_triton_interpreter(py::module &&m) {
           memcpy(static_cast<void *>(ret.mutable_data()),
                  static_cast<const void *>(reshaped_cmp.data()),
                  itemsize * numel);
-          AtomicCASOp(reshaped_ptr.data(), ret.mutable_data(),
-                      static_cast<const void *>(reshaped_val.data()), itemsize,
-                      numel, order)
-              .apply();
+          auto *ptr_data = reshaped_ptr.data();
+          auto *expected_data = ret.mutable_data();
+          auto *desired_data = static_cast<const void *>(reshaped_val.data());
+          {
+            py::gil_scoped_release release;
+            dispatchItemSize(itemsize, [&](auto tag) {
+              atomicCASBatch<decltype(tag)>(ptr_data, expected_data,
+                                            desired_data, numel, order);
+            });
+          }
           return ret.reshape(shape);
         });
 }
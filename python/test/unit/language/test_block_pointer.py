@@ -54,6 +54,41 @@ def test_block_copy(dtypes_str, n, padding_option, device):
         assert torch.all(torch.isnan(b[n // 2:n]))
 
 
+@triton.jit
+def block_copy_2d_kernel(a_ptr, b_ptr, M, N, stride_am, stride_an, stride_bm, stride_bn, OFFSET_M: tl.constexpr,
+                         OFFSET_N: tl.constexpr, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr):
+    pid_m = tl.program_id(0)
+    pid_n = tl.program_id(1)
+    # Tiles are shifted by OFFSET_M/OFFSET_N so that they straddle the lower as well as the upper bounds
+    a_block_ptr = tl.make_block_ptr(base=a_ptr, shape=(M, N), strides=(stride_am, stride_an),
+                                    offsets=(pid_m * BLOCK_M + OFFSET_M, pid_n * BLOCK_N + OFFSET_N),
+                                    block_shape=(BLOCK_M, BLOCK_N), order=(1, 0))
+    b_block_ptr = tl.make_block_ptr(base=b_ptr, shape=(M, N), strides=(stride_bm, stride_bn),
+                                    offsets=(pid_m * BLOCK_M + OFFSET_M, pid_n * BLOCK_N + OFFSET_N),
+                                    block_shape=(BLOCK_M, BLOCK_N), order=(1, 0))
+    a = tl.load(a_block_ptr, boundary_check=(0, 1), padding_option="zero")
+    tl.store(b_block_ptr, a + 1, boundary_check=(0, 1))
+
+
+@pytest.mark.interpreter
+@pytest.mark.parametrize("transpose_a", [False, True])
+@pytest.mark.parametrize("offset", [(0, 0), (-3, 5), (7, -2)])
+def test_block_copy_2d(transpose_a, offset, device):
+    M, N, BLOCK_M, BLOCK_N = 37, 45, 16, 8
+    a = torch.randn((N, M) if transpose_a else (M, N), device=device, dtype=torch.float32)
+    if transpose_a:
+        a = a.t()
+    b = torch.zeros((M, N), device=device, dtype=torch.float32)
+    grid = (triton.cdiv(M, BLOCK_M) + 1, triton.cdiv(N, BLOCK_N) + 1)
+    block_copy_2d_kernel[grid](a, b, M, N, a.stride(0), a.stride(1), b.stride(0), b.stride(1), OFFSET_M=offset[0],
+                               OFFSET_N=offset[1], BLOCK_M=BLOCK_M, BLOCK_N=BLOCK_N)
+    # Every element is covered by some tile except for those before the first one
+    expected = a + 1
+    expected[:max(offset[0], 0)] = 0
+    expected[:, :max(offset[1], 0)] = 0
+    torch.testing.assert_close(b, expected)
+
+
 @triton.jit
 def matmul_no_scf_with_advance_kernel(  #
         a_ptr, b_ptr, c_ptr,  #
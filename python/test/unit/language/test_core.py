@@ -1384,10 +1384,6 @@ def test_noinline(mode, device):
                                    for mode in ['all_neg', 'all_pos', 'min_neg', 'max_pos']
                                    for sem in [None, 'acquire', 'release', 'acq_rel', 'relaxed']]))
 def test_atomic_rmw(op, dtype_x_str, mode, sem, device):
-    if is_interpreter():
-        if dtype_x_str == 'float16':
-            pytest.skip("Only test atomic float16 ops on GPU")
-
     n_programs = 5
 
     # triton kernel
@@ -1549,6 +1545,319 @@ def test_atomic_cas(sem, num_ctas, device):
     assert f"atom.global.{sem_str}" in h.asm["ptx"]
 
 
+@pytest.mark.interpreter
+@pytest.mark.parametrize("num_threads", [2, 0])
+def test_interpreter_parallel_grid(num_threads, device, monkeypatch):
+    if not is_interpreter():
+        pytest.skip("TRITON_INTERPRET_NUM_THREADS only applies to the interpreter")
+    monkeypatch.setenv("TRITON_INTERPRET_NUM_THREADS", str(num_threads))
+
+    @triton.jit
+    def kernel(data, Lock, Count, Pids):
+        pid = tl.program_id(0) * tl.num_programs(1) + tl.program_id(1)
+        tl.store(Pids + pid, pid)
+        tl.atomic_add(Count, 1)
+        ptrs = data + tl.arange(0, 128)
+        while tl.atomic_cas(Lock, 0, 1) == 1:
+            pass
+        tl.store(ptrs, tl.load(ptrs) + 1.0)
+        tl.atomic_xchg(Lock, 0)
+
+    grid = (50, 4)
+    Lock = torch.zeros((1, ), device=device, dtype=torch.int32)
+    Count = torch.zeros((1, ), device=device, dtype=torch.int32)
+    Pids = torch.full((grid[0] * grid[1], ), -1, device=device, dtype=torch.int32)
+    data = torch.zeros((128, ), device=device, dtype=torch.float32)
+    kernel[grid](data, Lock, Count, Pids)
+    assert Count.item() == grid[0] * grid[1]
+    assert torch.equal(Pids.cpu(), torch.arange(grid[0] * grid[1], dtype=torch.int32))
+    np.testing.assert_allclose(to_numpy(data), np.full((128, ), grid[0] * grid[1], dtype=np.float32))
+
+
+@pytest.mark.interpreter
+def test_interpreter_parallel_grid_failure(device, monkeypatch):
+    if not is_interpreter():
+        pytest.skip("TRITON_INTERPRET_NUM_THREADS only applies to the interpreter")
+    monkeypatch.setenv("TRITON_INTERPRET_NUM_THREADS", "2")
+
+    @triton.jit
+    def kernel(Flag):
+        pid = tl.program_id(0)
+        if pid == 0:
+            tl.static_assert(pid != 0, "program 0 fails before releasing the others")
+            tl.atomic_xchg(Flag, 1)
+        else:
+            # Never released: the program only stops because program 0 failed
+            while tl.atomic_add(Flag, 0) == 0:
+                pass
+
+    Flag = torch.zeros((1, ), device=device, dtype=torch.int32)
+    with pytest.raises(triton.runtime.InterpreterError, match="program 0 fails"):
+        kernel[(2, )](Flag)
+
+
+@pytest.mark.interpreter
+@pytest.mark.parametrize("divergent", [False, True])
+def test_interpreter_vectorized_grid(divergent, device, monkeypatch):
+    if not is_interpreter():
+        pytest.skip("TRITON_INTERPRET_VECTORIZE_GRID only applies to the interpreter")
+    monkeypatch.setenv("TRITON_INTERPRET_VECTORIZE_GRID", "1")
+
+    @triton.jit
+    def kernel(X, Y, Z, N, DIVERGENT: tl.constexpr, BLOCK: tl.constexpr):
+        pid = tl.program_id(0)
+        offs = pid * BLOCK + tl.arange(0, BLOCK)
+        mask = offs < N
+        x = tl.load(X + offs, mask=mask, other=0.)
+        tl.store(Y + offs, x * 2 + pid, mask=mask)
+        if DIVERGENT:
+            # Programs run a different number of iterations, which can't be vectorized over the grid
+            for _ in range(pid):
+                tl.atomic_add(Z + pid, 1.)
+        else:
+            tl.atomic_add(Z + pid, tl.sum(x, axis=0))
+
+    N, BLOCK = 1000, 64
+    num_programs = triton.cdiv(N, BLOCK)
+    x = torch.randn((N, ), device=device, dtype=torch.float32)
+    y = torch.empty_like(x)
+    z = torch.zeros((num_programs, ), device=device, dtype=torch.float32)
+    kernel[(num_programs, )](x, y, z, N, DIVERGENT=divergent, BLOCK=BLOCK)
+    pids = torch.arange(N, device=device) // BLOCK
+    torch.testing.assert_close(y, x * 2 + pids)
+    if divergent:
+        z_ref = torch.arange(num_programs, device=device, dtype=torch.float32)
+    else:
+        z_ref = torch.zeros_like(z).index_add_(0, pids, x)
+    torch.testing.assert_close(z, z_ref)
+    # Divergence is remembered per constexpr specialization rather than for the whole kernel
+    from triton.runtime.interpreter import GridExecutor
+    fn = kernel.rewrite()
+    assert [key for key in GridExecutor.unvectorizable_specializations if key[0] is fn] == \
+        ([(fn, (True, BLOCK))] if divergent else [])
+
+
+@pytest.mark.interpreter
+@pytest.mark.parametrize("divergent", [False, True])
+def test_interpreter_vectorized_grid_print(divergent, device, monkeypatch, capfd):
+    if not is_interpreter():
+        pytest.skip("TRITON_INTERPRET_VECTORIZE_GRID only applies to the interpreter")
+    monkeypatch.setenv("TRITON_INTERPRET_VECTORIZE_GRID", "1")
+
+    @triton.jit
+    def kernel(Z, DIVERGENT: tl.constexpr):
+        pid = tl.program_id(0)
+        tl.device_print("pid", pid)
+        if DIVERGENT:
+            for _ in range(pid):
+                tl.atomic_add(Z + pid, 1.)
+
+    num_programs = 4
+    z = torch.zeros((num_programs, ), device=device, dtype=torch.float32)
+    kernel[(num_programs, )](z, DIVERGENT=divergent)
+    # A diverged vectorized run is rerun one program at a time; its prints must not show up twice
+    lines = [line for line in capfd.readouterr().out.splitlines() if "pid:" in line]
+    assert sorted(line.split(")")[0] + ")" for line in lines) == [f"({pid}, 0, 0)" for pid in range(num_programs)]
+
+
+@triton.jit
+def _branching_max_combine(a, b):
+    if a > b:
+        c = a
+    else:
+        c = b
+    return c
+
+
+@triton.jit
+def _pair_combine(a, b):
+    return a + b, a * b
+
+
+@pytest.mark.interpreter
+def test_interpreter_combine_fallback(device):
+    if not is_interpreter():
+        pytest.skip("vectorized combines only apply to the interpreter")
+
+    @triton.jit
+    def kernel(X, Y, Z, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        x = tl.load(X + offs)
+        tl.store(Y, tl.reduce(x, 0, _branching_max_combine))
+        tl.store(Z + offs, tl.associative_scan(x, 0, _branching_max_combine))
+
+    @triton.jit
+    def bad_kernel(X, Y, BLOCK: tl.constexpr):
+        x = tl.load(X + tl.arange(0, BLOCK))
+        tl.store(Y, tl.reduce(x, 0, _pair_combine))
+
+    BLOCK = 32
+    x = torch.randn((BLOCK, ), device=device, dtype=torch.float32)
+    y = torch.empty((1, ), device=device, dtype=torch.float32)
+    z = torch.empty_like(x)
+    # Branching on the operands can't be vectorized over lanes and falls back to one element at a time
+    kernel[(1, )](x, y, z, BLOCK=BLOCK)
+    torch.testing.assert_close(y[0], x.max())
+    torch.testing.assert_close(z, torch.cummax(x, 0).values)
+    # Other errors raised by the combine are reported rather than retried
+    with pytest.raises(triton.runtime.InterpreterError, match="combine_fn returned 2 values"):
+        bad_kernel[(1, )](x, y, BLOCK=BLOCK)
+
+
+@pytest.mark.interpreter
+@pytest.mark.parametrize("dst_dtype", ["float8e5", "float8e4nv", "float8e4b15", "float8e4b8", "float8e5b16", "bfloat16"])
+@pytest.mark.parametrize("rounding", ["rtne", "rtz", None])
+def test_interpreter_convert_float(dst_dtype, rounding):
+    if not is_interpreter():
+        pytest.skip("the native float conversion is part of the interpreter")
+    from triton.runtime.interpreter import _convert_float
+    from triton._C.libtriton import ir
+    dst = getattr(tl, dst_dtype)
+    m, bias = dst.fp_mantissa_width, dst.exponent_bias
+    sign = 1 << (dst.primitive_bitwidth - 1)
+    # Encodings of the largest finite value, inf and nan, if the format has them
+    max_bits, inf_bits, nan_bits = {
+        "float8e5": (0x7B, 0x7C, 0x7E),
+        "float8e4nv": (0x7E, None, 0x7F),
+        "float8e4b15": (0x7F, None, None),
+        "float8e4b8": (0x7F, None, 0x80),
+        "float8e5b16": (0x7F, None, 0x80),
+        "bfloat16": (0x7F7F, 0x7F80, 0x7FC0),
+    }[dst_dtype]
+    fnuz = nan_bits == sign
+    rtz = rounding == "rtz"
+    one = bias << m
+    ulp = 2.0**-m
+    max_value = (1 + (max_bits & ((1 << m) - 1)) * ulp) * 2.0**((max_bits >> m) - bias)
+    overflow = min(max_value * 2, float(np.finfo(np.float32).max))
+    # Overflow saturates, except to inf in IEEE formats when rounding to nearest
+    overflow_bits = inf_bits if inf_bits is not None and not rtz else max_bits
+    inf = inf_bits if inf_bits is not None else max_bits
+    subnormal = 2.0**(1 - bias - m)
+    cases = [
+        (1.0, one),
+        # Ties round to the even neighbour
+        (1 + ulp / 2, one),
+        (1 + ulp * 1.5, one + (1 if rtz else 2)),
+        (-(1 + ulp * 1.5), sign | (one + (1 if rtz else 2))),
+        (1 + ulp / 2 + ulp / 8, one + (0 if rtz else 1)),
+        (subnormal, 1),
+        (subnormal / 2, 0),
+        (subnormal * 1.5, 1 if rtz else 2),
+        # fnuz formats have no negative zero
+        (-0.0, 0 if fnuz else sign),
+        (overflow, overflow_bits),
+        (-overflow, sign | overflow_bits),
+        (float("inf"), inf),
+        (float("-inf"), sign | inf),
+        # Formats without nan use their largest magnitude
+        (float("nan"), nan_bits if nan_bits is not None else max_bits),
+    ]
+    rounding_mode = {"rtne": ir.ROUNDING_MODE.RTNE, "rtz": ir.ROUNDING_MODE.RTZ, None: None}[rounding]
+    src = np.array([value for value, _ in cases], dtype=np.float32)
+    ret = _convert_float(src, tl.float32, dst, rounding_mode)
+    np.testing.assert_array_equal(ret.astype(np.uint32), np.array([bits for _, bits in cases], dtype=np.uint32))
+
+
+@pytest.mark.interpreter
+@pytest.mark.parametrize("dtype_str", ["float16", "bfloat16", "float8_e5m2", "float8_e4m3fn"])
+@pytest.mark.parametrize("a_batch, b_batch", [(3, 3), (1, 3), (3, 1)])
+@pytest.mark.parametrize("max_num_imprecise_acc", [0, 32])
+def test_interpreter_native_dot(dtype_str, a_batch, b_batch, max_num_imprecise_acc):
+    if not is_interpreter():
+        pytest.skip("the native dot kernel is part of the interpreter")
+    from triton._C.libtriton import interpreter as _interpreter
+    float_format = {
+        "float16": _interpreter.FLOAT_FORMAT.FP16,
+        "bfloat16": _interpreter.FLOAT_FORMAT.BF16,
+        "float8_e5m2": _interpreter.FLOAT_FORMAT.FP8E5,
+        "float8_e4m3fn": _interpreter.FLOAT_FORMAT.FP8E4NV,
+    }[dtype_str]
+    dtype = getattr(torch, dtype_str)
+    bits_dtype = torch.int16 if dtype.itemsize == 2 else torch.uint8
+    # K spans several cache blocks of the kernel
+    batch, M, N, K = 3, 17, 33, 600
+    torch.manual_seed(0)
+    a = torch.randn((a_batch, M, K)).to(dtype)
+    b = torch.randn((b_batch, K, N)).to(dtype)
+    d = torch.randn((batch, M, N)).numpy()
+    ret = d.copy()
+    _interpreter.dot(a.view(bits_dtype).numpy(), float_format, b.view(bits_dtype).numpy(), float_format, ret,
+                     max_num_imprecise_acc)
+    a, b = a.float().numpy(), b.float().numpy()
+    if max_num_imprecise_acc == 0:
+        # The product is accumulated into d in place
+        np.testing.assert_allclose(ret, np.matmul(a, b) + d, rtol=1e-5, atol=1e-4)
+        return
+    # Every chunk of K is summed in an fp32 accumulator truncated to 13 bits of mantissa, then added to d
+    mask = np.uint32(~((1 << 10) - 1) & 0xFFFFFFFF)
+    ref = d.copy()
+    for k in range(0, K, max_num_imprecise_acc):
+        partial = np.zeros((batch, M, N), dtype=np.float32)
+        for kk in range(k, min(K, k + max_num_imprecise_acc)):
+            partial += a[:, :, kk:kk + 1] * b[:, kk:kk + 1, :]
+            partial = (partial.view(np.uint32) & mask).view(np.float32)
+        ref += partial
+    np.testing.assert_allclose(ret, ref, rtol=1e-3, atol=1e-3)
+    assert not np.allclose(ret, np.matmul(a, b) + d, rtol=1e-4, atol=1e-4)
+
+
+@pytest.mark.interpreter
+@pytest.mark.parametrize("view", ["transposed", "strided", "offset"])
+def test_store_to_view(view, device):
+    # The interpreter runs device arguments on host copies; writes through views must reach the caller's tensor
+
+    @triton.jit
+    def kernel(X, Y, stride0, stride1, BLOCK: tl.constexpr):
+        offs = tl.arange(0, BLOCK)
+        # Only the second half of the rows is written, far from the start of strided views
+        rows = BLOCK // 2 + tl.arange(0, BLOCK // 2)
+        tl.store(X + rows[:, None] * stride0 + offs[None, :] * stride1, tl.load(Y + rows[:, None] * BLOCK + offs))
+
+    def make_view(t):
+        return {"transposed": t[:, :BLOCK].t(), "strided": t[:, ::2], "offset": t[:, BLOCK:]}[view]
+
+    BLOCK = 16
+    base = torch.zeros((BLOCK, 2 * BLOCK), device=device, dtype=torch.float32)
+    x = make_view(base)
+    y = torch.randn((BLOCK, BLOCK), device=device, dtype=torch.float32)
+    kernel[(1, )](x, y, x.stride(0), x.stride(1), BLOCK)
+    ref = torch.zeros_like(base)
+    make_view(ref)[BLOCK // 2:] = y[BLOCK // 2:]
+    torch.testing.assert_close(base, ref)
+
+
+@pytest.mark.interpreter
+def test_interpreter_mem_trace(device, monkeypatch, tmp_path):
+    if not is_interpreter():
+        pytest.skip("TRITON_INTERPRET_TRACE only applies to the interpreter")
+    from triton.tools import mem_trace
+    trace_path = tmp_path / "trace.bin"
+    monkeypatch.setenv("TRITON_INTERPRET_TRACE", str(trace_path))
+
+    @triton.jit
+    def kernel(X, Y, STRIDE: tl.constexpr, BLOCK: tl.constexpr):
+        offs = tl.program_id(0) * BLOCK + tl.arange(0, BLOCK)
+        x = tl.load(X + offs * STRIDE)
+        tl.store(Y + offs, x)
+
+    BLOCK, num_programs = 64, 4
+    x = torch.randn((num_programs * BLOCK * 8, ), device=device, dtype=torch.float32)
+    y = torch.empty((num_programs * BLOCK, ), device=device, dtype=torch.float32)
+    kernel[(num_programs, )](x, y, 1, BLOCK)
+    kernel[(num_programs, )](x, y, 8, BLOCK)
+    launches = mem_trace.read_trace(trace_path)
+    assert [launch.name for launch in launches] == ["kernel", "kernel"]
+    # A 32B stride between fp32 elements uses 4 of every 32 bytes fetched
+    for launch, load_utilization in zip(launches, [1.0, 0.125]):
+        stats = mem_trace.analyze(launch)
+        load, = [s for s in stats.values() if s.kinds == {"load"}]
+        store, = [s for s in stats.values() if s.kinds == {"store"}]
+        assert load.instructions == num_programs and store.instructions == num_programs
+        assert load.sector_utilization == load_utilization
+        assert store.sector_utilization == 1.0
+
+
 @pytest.mark.interpreter
 @pytest.mark.parametrize("sem", [None, 'acquire', 'release', 'acq_rel', 'relaxed'])
 @pytest.mark.parametrize("num_ctas", num_ctas_list)
@@ -1743,6 +2052,31 @@ def test_store_constant_default_dtype(num_ctas, device):
     assert torch.all(output == ref)
 
 
+@pytest.mark.interpreter
+@pytest.mark.parametrize("dtype_str", ['int8', 'float16', 'float32', 'int64'])
+@pytest.mark.parametrize("transpose", [False, True])
+def test_load_store_strided_masked(dtype_str, transpose, device):
+    """Tests loads and stores mixing contiguous runs, strided runs and partial masks"""
+
+    @triton.jit
+    def kernel(X, Y, M, N, TRANSPOSE: tl.constexpr, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr):
+        offs_m = tl.arange(0, BLOCK_M)
+        offs_n = tl.arange(0, BLOCK_N)
+        mask = (offs_m[:, None] < M) & (offs_n[None, :] < N)
+        if TRANSPOSE:
+            x = tl.load(X + offs_n[None, :] * M + offs_m[:, None], mask=mask, other=0)
+        else:
+            x = tl.load(X + offs_m[:, None] * N + offs_n[None, :], mask=mask, other=0)
+        tl.store(Y + offs_m[:, None] * N + offs_n[None, :], x, mask=mask)
+
+    M, N = 13, 29
+    x = numpy_random((M, N), dtype_str=dtype_str)
+    x_tri = to_triton(np.ascontiguousarray(x.T) if transpose else x, device=device)
+    y_tri = to_triton(np.zeros((M, N), dtype=x.dtype), device=device)
+    kernel[(1, )](x_tri, y_tri, M, N, TRANSPOSE=transpose, BLOCK_M=16, BLOCK_N=32)
+    np.testing.assert_equal(to_numpy(y_tri), x)
+
+
 def test_load_store_same_ptr(device):
 
     @triton.jit()
@@ -2420,6 +2754,52 @@ def test_scan2d(op, dtype_str, shape, axis, reverse, num_warps, device):
         np.testing.assert_equal(z_ref, z_tri)
 
 
+@triton.jit
+def select_max(a, b):
+    return tl.where(a > b, a, b)
+
+
+@triton.jit
+def branching_max(a, b):
+    # Branches on the combined values, so the interpreter can't evaluate it for many elements at once
+    if a > b:
+        c = a
+    else:
+        c = b
+    return c
+
+
+@pytest.mark.interpreter
+@pytest.mark.parametrize("branching", [False, True])
+@pytest.mark.parametrize("axis", [0, 1])
+def test_reduce_scan_custom_combine(branching, axis, device):
+
+    @triton.jit
+    def kernel(X, R, S, BRANCHING: tl.constexpr, AXIS: tl.constexpr, BLOCK_M: tl.constexpr, BLOCK_N: tl.constexpr):
+        offs = tl.arange(0, BLOCK_M)[:, None] * BLOCK_N + tl.arange(0, BLOCK_N)[None, :]
+        x = tl.load(X + offs)
+        if BRANCHING:
+            r = tl.reduce(x, AXIS, branching_max)
+            s = tl.associative_scan(x, AXIS, branching_max)
+        else:
+            r = tl.reduce(x, AXIS, select_max)
+            s = tl.associative_scan(x, AXIS, select_max)
+        if AXIS == 0:
+            tl.store(R + tl.arange(0, BLOCK_N), r)
+        else:
+            tl.store(R + tl.arange(0, BLOCK_M), r)
+        tl.store(S + offs, s)
+
+    BLOCK_M, BLOCK_N = 8, 16
+    x = numpy_random((BLOCK_M, BLOCK_N), 'float32')
+    x_tri = to_triton(x, device=device)
+    r_tri = to_triton(np.empty(x.shape[1 - axis], dtype=np.float32), device=device)
+    s_tri = to_triton(np.empty_like(x), device=device)
+    kernel[(1, )](x_tri, r_tri, s_tri, branching, axis, BLOCK_M, BLOCK_N)
+    np.testing.assert_equal(to_numpy(r_tri), np.max(x, axis=axis))
+    np.testing.assert_equal(to_numpy(s_tri), np.maximum.accumulate(x, axis=axis))
+
+
 scan_layouts = [
     BlockedLayout([1, 4], [4, THREADS_PER_WARP // 4], [4, 1], [0, 1], [1, 1], [1, 1], [0, 1]),
     BlockedLayout([1, 4], [8, THREADS_PER_WARP // 8], [4, 1], [0, 1], [1, 1], [1, 1], [0, 1]),
@@ -1,6 +1,11 @@
 import ast
+import itertools
+import os
 import textwrap
+import threading
 import inspect
+from concurrent.futures import ThreadPoolExecutor
+from contextlib import contextmanager
 from typing import Tuple
 
 import math
@@ -11,6 +16,7 @@ import triton.language as tl
 from dataclasses import dataclass
 from .errors import InterpreterError
 from functools import partial
+from ..tools import mem_trace
 from .._C.libtriton import interpreter as _interpreter
 from .._C.libtriton import ir as _ir
 
@@ -57,19 +63,30 @@ class BlockPointerHandle:
     def materialize_pointers(self, boundary_check):
         dtype_tt = self.base.get_element_ty()
         n_bytes = dtype_tt.primitive_bitwidth // 8
-        tensor_shape = self.tensor_shape
-        ptrs = np.broadcast_to(self.base.data, self.tensor_shape)
-        masks = np.ones(self.tensor_shape, dtype=bool)
+        tensor_shape = tuple(self.tensor_shape)
+        # Scalars carry the leading grid axis (if any); expand them so they broadcast against the tile
+        lead = interpreter_builder.grid_lead
+        expand = lambda handle: handle.data.reshape(handle.data.shape[:lead] + (1, ) * len(tensor_shape))
+        ptrs = expand(self.base)
+        masks = np.ones((1, ) * (lead + len(tensor_shape)), dtype=bool)
         for dim in range(len(tensor_shape)):
             bcast_dims = [1] * len(tensor_shape)
             bcast_dims[dim] = tensor_shape[dim]
-            off = (self.offsets[dim].data + np.arange(tensor_shape[dim])).reshape(bcast_dims)
-            ptrs = ptrs + (n_bytes * off * self.strides[dim].data).astype(np.uint64)
+            off = expand(self.offsets[dim]) + np.arange(tensor_shape[dim]).reshape((1, ) * lead + tuple(bcast_dims))
+            ptrs = ptrs + (n_bytes * off * expand(self.strides[dim])).astype(np.uint64)
             if dim in boundary_check:
-                masks = np.logical_and(masks, off < self.shape[dim].data)
+                masks = np.logical_and(masks, (off >= 0) & (off < expand(self.shape[dim])))
+        ptrs = np.broadcast_to(ptrs, ptrs.shape[:lead] + tensor_shape)
+        masks = np.broadcast_to(masks, ptrs.shape)
         ptrs = TensorHandle(ptrs, self.base.dtype.scalar)
         return ptrs, masks
 
+    def native_args(self, boundary_check):
+        # The block geometry as plain integers, in the argument order of the native load_block/store_block
+        scalar = lambda handle: handle.data.item()
+        return (scalar(self.base), [scalar(s) for s in self.shape], [scalar(s) for s in self.strides],
+                [scalar(o) for o in self.offsets], [int(s) for s in self.tensor_shape], list(boundary_check))
+
 
 @dataclass(frozen=True)
 class InterpreterOptions:
@@ -128,68 +145,31 @@ def _get_np_dtype(tt_dtype):
     return np_types[tt_dtype]
 
 
+def _get_float_format(tt_dtype):
+    # Storage format of a floating point type for the native routines, None if unsupported
+    float_formats = {
+        tl.float64: _interpreter.FLOAT_FORMAT.FP64,
+        tl.float32: _interpreter.FLOAT_FORMAT.FP32,
+        tl.float16: _interpreter.FLOAT_FORMAT.FP16,
+        tl.bfloat16: _interpreter.FLOAT_FORMAT.BF16,
+        tl.float8e5: _interpreter.FLOAT_FORMAT.FP8E5,
+        tl.float8e5b16: _interpreter.FLOAT_FORMAT.FP8E5B16,
+        tl.float8e4nv: _interpreter.FLOAT_FORMAT.FP8E4NV,
+        tl.float8e4b8: _interpreter.FLOAT_FORMAT.FP8E4B8,
+        tl.float8e4b15: _interpreter.FLOAT_FORMAT.FP8E4B15,
+    }
+    return float_formats.get(tt_dtype)
+
+
 def _convert_float(input, input_dtype, output_dtype, rounding_mode):
-    input_uint_dtype = getattr(np, f"uint{input_dtype.primitive_bitwidth}")
-    output_unint_dtype = getattr(np, f"uint{output_dtype.primitive_bitwidth}")
-    input_bin = np.frombuffer(input.tobytes(), dtype=input_uint_dtype)
-    sign = (input_bin >> (input_dtype.primitive_bitwidth - 1)) & 0x01
-    input_exponent_width = input_dtype.primitive_bitwidth - input_dtype.fp_mantissa_width - 1
-    output_exponent_width = output_dtype.primitive_bitwidth - output_dtype.fp_mantissa_width - 1
-    significand = input_bin & ((1 << input_dtype.fp_mantissa_width) - 1)
-    bias_input = input_dtype.exponent_bias
-    bias_output = output_dtype.exponent_bias
-    exponent = ((input_bin >> input_dtype.fp_mantissa_width) & ((1 << input_exponent_width) - 1)).astype(np.int32)
-    subnormal_index = exponent == 0
-    if np.any(subnormal_index):
-        # Credit to Phil: phil@openai.com
-        # subnormal repr: ((-1.0)**sign) * (2.0**(1 - exp_bias)) * (2^(m0) + 2^(m1) + ... + 2^(mn))
-        # where m0, m1, ..., mn are the 1-bit of the mantissa
-        # convert it to normal repr: ((-1.0)**sign) * (2.0**(1 + m0 - exp_bias)) * (1 + 2^(m1 - m0) + ... + 2^(mn - m0))
-        bit_pos = np.zeros_like(input_bin, dtype=np.int32)
-        # Find the most significant bit of the mantissa in the significand
-        for i in range(input_dtype.fp_mantissa_width):
-            bit_index = ((significand >> i) & 0x01)
-            # pos should be >= 1
-            bit_pos[bit_index == 1] = input_dtype.fp_mantissa_width - i
-        zero_significand_index = significand == 0
-        exponent[subnormal_index] = 1 - bit_pos[subnormal_index]
-        # 0 significand and subnormal should be treated as 0
-        exponent[zero_significand_index & subnormal_index] = bias_input - bias_output
-        significand[subnormal_index] = (significand[subnormal_index] << bit_pos[subnormal_index]) & (
-            (1 << input_dtype.fp_mantissa_width) - 1)
-    # Prevent overflow and underflow
-    exponent_output = np.maximum(0, np.minimum((exponent - bias_input + bias_output), (1 << output_exponent_width) - 1))
-    exponent_output = exponent_output.astype(output_unint_dtype)
-    sign_output = sign.astype(output_unint_dtype)
-    if input_dtype.primitive_bitwidth > output_dtype.primitive_bitwidth:  # Downcast
-        significand_output = (significand >> (input_dtype.fp_mantissa_width - output_dtype.fp_mantissa_width)) & (
-            (1 << output_dtype.fp_mantissa_width) - 1)
-        if rounding_mode == _ir.ROUNDING_MODE.RTNE:  # Round to nearst even
-            # find the cut-off bit
-            cut_off = significand & (1 << (input_dtype.fp_mantissa_width - output_dtype.fp_mantissa_width - 1))
-            significand_output = significand_output + (cut_off > 0)
-        significand_output = significand_output.astype(output_unint_dtype)
-    else:  # Upcast
-        significand_output = (significand.astype(output_unint_dtype) <<
-                              (output_dtype.fp_mantissa_width - input_dtype.fp_mantissa_width)) & (
-                                  (1 << output_dtype.fp_mantissa_width) - 1)
-    subnormal_index = exponent_output == 0
-    if np.any(subnormal_index):  # underflow
-        # normal repr: ((-1.0)**sign) * (2.0**(exp - exp_bias_input)) * (1 + 2^(m0) + 2^(m1) + ... + 2^(mn))
-        # where m0, m1, ..., mn are the 1-bit of the mantissa
-        # shift = (1 - exp_bias_output) - (exp - exp_bias_input)
-        # convert it to subnormal repr: ((-1.0)**sign) * (2.0**(1 - exp_bias_output)) * (2^(-shift) + 2^(m0 - shift) + 2^(m1 - shift) + ... + 2^(mn - shift))
-        exponent = ((input_bin >> input_dtype.fp_mantissa_width) & ((1 << input_exponent_width) - 1)).astype(np.int32)
-        non_zero_exponent_index = exponent != 0
-        # If the original exponent is not zero, we still need to shift the significand and consider the 1.0 part in mantissa
-        subnormal_index = subnormal_index & non_zero_exponent_index
-        shift = np.zeros_like(input_bin, dtype=np.int32)
-        shift[subnormal_index] = (1 - bias_output) - (exponent[subnormal_index] - bias_input)
-        significand_output[subnormal_index] = (significand_output[subnormal_index] >> shift[subnormal_index]) | (
-            1 << (output_dtype.fp_mantissa_width - shift[subnormal_index]))
-    output = (sign_output << (output_dtype.primitive_bitwidth - 1)) | (
-        exponent_output << output_dtype.fp_mantissa_width) | significand_output
-    return output.reshape(input.shape)
+    # Returns the raw bits of `input` converted to `output_dtype`. Downcasts round to nearest even unless
+    # round-toward-zero is requested.
+    if rounding_mode == _ir.ROUNDING_MODE.RTZ:
+        rounding_mode = _interpreter.ROUNDING_MODE.RTZ
+    else:
+        rounding_mode = _interpreter.ROUNDING_MODE.RTNE
+    return _interpreter.convert_float(input, _get_float_format(input_dtype), _get_float_format(output_dtype),
+                                      rounding_mode)
 
 
 def _erf(x):
@@ -203,6 +183,22 @@ def _umulhi_64(a, b):
     return (int(a) * int(b)) >> 64
 
 
+class GridDivergenceError(Exception):
+    '''
+        Raised while interpreting a whole grid at once when program instances would need to take different
+        control flow paths (or when an operation has no grid-vectorized implementation).
+    '''
+    pass
+
+
+class LaunchAbortedError(Exception):
+    '''
+        Raised in a program instance running on the thread pool once another program of the same launch has failed,
+        so that programs waiting on the failed one stop instead of spinning forever.
+    '''
+    pass
+
+
 np_erf_fp32 = np.vectorize(_erf, otypes=[np.float32])
 np_erf_fp64 = np.vectorize(_erf, otypes=[np.float64])
 np_umulhi_u64 = np.vectorize(_umulhi_64, otypes=[np.uint64])
@@ -215,6 +211,58 @@ class ExtraFunctions:
         return tl.tensor(_builder.create_fp_to_fp(input.handle, dst_ty, fp_downcast_rounding), dst_ty)
 
 
+# Frames in these directories belong to the language and the interpreter rather than to the kernel being run
+_INTERNAL_DIRS = (os.path.join(os.path.dirname(tl.__file__), ""), os.path.join(os.path.dirname(__file__), ""))
+
+
+def _get_user_location():
+    frame = inspect.currentframe()
+    while frame is not None and frame.f_code.co_filename.startswith(_INTERNAL_DIRS):
+        frame = frame.f_back
+    if frame is None:
+        return "<unknown>"
+    return f"{frame.f_code.co_filename}:{frame.f_lineno}"
+
+
+def _get_storage_span(tensor):
+    # Byte range of its storage that a (possibly strided) view covers, up to its last element rather than numel
+    # elements on
+    begin = tensor.storage_offset() * tensor.element_size()
+    if tensor.numel() == 0:
+        return begin, begin
+    last = sum((size - 1) * stride for size, stride in zip(tensor.shape, tensor.stride()))
+    return begin, begin + (last + 1) * tensor.element_size()
+
+
+class WriteTracker:
+    '''
+        Records which of a set of host buffers are written by stores and atomics, so that only those need to be
+        copied back to the device after a launch
+    '''
+
+    def __init__(self, tensors):
+        self.spans = []
+        for tensor in tensors:
+            tensor = getattr(tensor, "base", tensor)
+            begin, end = _get_storage_span(tensor)
+            self.spans.append((tensor.data_ptr(), tensor.data_ptr() + end - begin))
+        self.written = [False] * len(self.spans)
+
+    def record(self, ptrs, mask, itemsize):
+        if all(self.written):
+            return
+        ptrs = ptrs[mask] if mask is not None else ptrs
+        if ptrs.size == 0:
+            return
+        self.record_span(int(ptrs.min()), int(ptrs.max()) + itemsize)
+
+    def record_span(self, lo, hi):
+        # Marks the buffers overlapping the byte range [lo, hi)
+        for i, (begin, end) in enumerate(self.spans):
+            if begin < hi and lo < end:
+                self.written[i] = True
+
+
 class InterpreterBuilder:
     ir_sem_to_interpreter_sem = {
         _ir.MEM_SEMANTIC.ACQUIRE: _interpreter.MEM_SEMANTIC.ACQUIRE,
@@ -242,6 +290,112 @@ class InterpreterBuilder:
         self.codegen_fns = {}
         self.codegen_fns["convert_custom_types"] = ExtraFunctions._convert_custom_types
         self.codegen_fns["min_dot_size"] = lambda lhsType, rhsType: (16, 16, 16)
+        # The grid index is per-thread so that program instances can run concurrently
+        self._local = threading.local()
+        # Shared by all threads running programs of the current launch
+        self.write_tracker = None
+        # Set once a program of the current launch has failed on the thread pool
+        self.launch_failed = None
+        self.access_trace = None
+
+    @property
+    def grid_idx(self):
+        return getattr(self._local, "grid_idx", None)
+
+    @property
+    def grid_lead(self):
+        # Number of leading grid axes carried by every tensor: 1 while interpreting the whole grid at once,
+        # in which case the leading axis has either one entry per program or a single uniform entry
+        return getattr(self._local, "grid_lead", 0)
+
+    def set_grid_vectorized(self, enabled, side_effect_hook=None, print_buffer=None):
+        if enabled:
+            nx, ny, nz = self.grid_dim
+            ids = np.arange(nx * ny * nz, dtype=np.int32)
+            # Same program order as the serial x/y/z loop
+            self._local.grid_ids = (ids // (ny * nz), (ids // nz) % ny, ids % nz)
+            self._local.grid_idx = None
+            self._local.grid_lead = 1
+        else:
+            self._local.grid_ids = None
+            self._local.grid_lead = 0
+        self._local.side_effect_hook = side_effect_hook
+        # Lines printed by the kernel are collected here rather than printed, if given
+        self._local.print_buffer = print_buffer
+
+    @contextmanager
+    def vectorized_lanes(self):
+        '''
+            Evaluates per-element code for many independent elements at once: inside the context every value
+            carries one leading lane axis, the same way whole-grid interpretation carries one entry per program.
+            Code that cannot run per lane (side effects, program ids, branching on lane-dependent values) raises.
+        '''
+        saved = (self.grid_lead, getattr(self._local, "grid_ids", None), getattr(self._local, "side_effect_hook",
+                                                                                 None))
+
+        def reject_side_effect():
+            raise GridDivergenceError("side effects are not supported on vectorized lanes")
+
+        self._local.grid_lead = 1
+        self._local.grid_ids = None
+        self._local.side_effect_hook = reject_side_effect
+        try:
+            yield
+        finally:
+            self._local.grid_lead, self._local.grid_ids, self._local.side_effect_hook = saved
+
+    def check_launch_failed(self):
+        failed = self.launch_failed
+        if failed is not None and failed.is_set():
+            raise LaunchAbortedError("another program instance of the launch failed")
+
+    def _get_grid_ids(self):
+        grid_ids = getattr(self._local, "grid_ids", None)
+        if grid_ids is None:
+            raise GridDivergenceError("program ids are not available on vectorized lanes")
+        return grid_ids
+
+    def _run_side_effect_hook(self):
+        hook = getattr(self._local, "side_effect_hook", None)
+        if hook is not None:
+            self._local.side_effect_hook = None
+            hook()
+
+    def _before_side_effect(self, ptrs, mask, itemsize):
+        self._run_side_effect_hook()
+        if self.write_tracker is not None:
+            self.write_tracker.record(ptrs, mask, itemsize)
+
+    def _trace_access(self, kind, ptrs, mask, itemsize):
+        trace = self.access_trace
+        if trace is None:
+            return
+        location = _get_user_location()
+        if not self.grid_lead:
+            addresses = ptrs[mask] if mask is not None else ptrs.reshape(-1)
+            trace.write(kind, itemsize, location, self.grid_idx, addresses)
+            return
+        for pid, grid_idx in enumerate(zip(*self._get_grid_ids())):
+            row = pid if ptrs.shape[0] > 1 else 0
+            addresses = ptrs[row][mask[row]] if mask is not None else ptrs[row].reshape(-1)
+            trace.write(kind, itemsize, location, grid_idx, addresses)
+
+    def ungrid(self, data):
+        '''
+            Returns the per-program value of `data` when all program instances agree on it. Raises
+            GridDivergenceError otherwise, since the caller is about to branch on it.
+        '''
+        if self.grid_lead == 0:
+            return data
+        if data.shape[0] == 1 or np.all(data == data[:1]):
+            return data[0]
+        raise GridDivergenceError("program instances diverge")
+
+    def _broadcast_grid(self, *data):
+        if self.grid_lead == 0:
+            return data
+        size = max(d.shape[0] for d in data)
+        return tuple(np.broadcast_to(d, (size, ) + d.shape[1:]) for d in data)
 
     def set_grid_idx(self, x, y, z):
         if not x < self.grid_dim[0]:
@@ -250,7 +404,7 @@ class InterpreterBuilder:
             raise ValueError("y >= grid_dim[1]")
         if not z < self.grid_dim[2]:
             raise ValueError("z >= grid_dim[2]")
-        self.grid_idx = (x, y, z)
+        self._local.grid_idx = (x, y, z)
 
     def set_grid_dim(self, nx, ny, nz):
         self.grid_dim = (nx, ny, nz)
@@ -355,6 +509,8 @@ class InterpreterBuilder:
 
     # programming model
     def create_get_program_id(self, axis):
+        if self.grid_lead:
+            return TensorHandle(self._get_grid_ids()[axis], tl.int32)
         if self.grid_idx is None:
             raise ValueError("grid_idx is None")
         return TensorHandle(np.array([self.grid_idx[axis]], dtype=np.int32), tl.int32)
@@ -375,20 +531,29 @@ class InterpreterBuilder:
     def create_masked_load(self, ptrs, mask, other, cache_modifier, eviction_policy, is_volatile):
         dtype_tt = ptrs.get_element_ty()
         dtype_np = _get_np_dtype(dtype_tt)
+        # Operands may differ in their grid axis; broadcasting only creates zero-stride views
+        ptrs_data, mask_data = np.broadcast_arrays(ptrs.data, mask.data)
         if other is None:
-            other = TensorHandle(np.zeros_like(ptrs.data, dtype=dtype_np), dtype_tt)
-        ret = _interpreter.load(ptrs.data, mask.data, other.data, dtype_np)
+            other_data = np.zeros((1, ) * ptrs_data.ndim, dtype=dtype_np)
+        else:
+            other_data = other.data
+        other_data = np.broadcast_to(other_data, ptrs_data.shape)
+        self._trace_access(mem_trace.ACCESS_LOAD, ptrs_data, mask_data, dtype_np.itemsize)
+        ret = _interpreter.load(ptrs_data, mask_data, other_data, dtype_np)
         return TensorHandle(ret, dtype_tt)
 
     def create_masked_store(self, ptrs, value, mask, cache_modifier, eviction_policy):
-        return _interpreter.store(ptrs.data, value.data, mask.data)
+        ptrs_data, value_data, mask_data = np.broadcast_arrays(ptrs.data, value.data, mask.data)
+        self._before_side_effect(ptrs_data, mask_data, value_data.itemsize)
+        self._trace_access(mem_trace.ACCESS_STORE, ptrs_data, mask_data, value_data.itemsize)
+        return _interpreter.store(ptrs_data, value_data, mask_data)
 
     # casting ops
     def cast_impl(self, src, dst_type):
         src_element_type = src.dtype.scalar
         dst_element_type = dst_type.scalar
-        if (src_element_type == tl.bfloat16 and dst_element_type == tl.float32) or \
-           (src_element_type == tl.float32 and dst_element_type == tl.bfloat16):
+        if (src_element_type == tl.bfloat16 and dst_element_type.is_floating()) or \
+           (src_element_type.is_floating() and dst_element_type == tl.bfloat16):
             data = _convert_float(src.data, src_element_type, dst_element_type, None).view(_get_np_dtype(dst_type))
             return TensorHandle(data, dst_type.scalar)
         else:
@@ -475,11 +640,10 @@ class InterpreterBuilder:
 
     def create_ashr(self, lhs, rhs):
         # Triton's rshift operator depends on the signedness of the left operand
-        lhs_dtype = _get_signed_np_dtype(lhs.data.dtype)
-        rhs_dtype = _get_signed_np_dtype(rhs.data.dtype)
-        lhs.data = lhs.data.astype(lhs_dtype)
-        rhs.data = rhs.data.astype(rhs_dtype)
-        return self.binary_op(lhs, rhs, np.right_shift)
+        # Operands may be shared across program instances, so don't modify them in place
+        lhs_data = lhs.data.astype(_get_signed_np_dtype(lhs.data.dtype))
+        rhs_data = rhs.data.astype(_get_signed_np_dtype(rhs.data.dtype))
+        return TensorHandle(np.right_shift(lhs_data, rhs_data), lhs.dtype.scalar)
 
     def create_umulhi(self, lhs, rhs):
         dtype = lhs.data.dtype
@@ -536,12 +700,25 @@ class InterpreterBuilder:
         return TensorHandle(1 / np.sqrt(arg.data), arg.dtype.scalar)
 
     # tensor operators
-    create_reshape = lambda self, arg, shape, allow_reorder: TensorHandle(arg.data.reshape(shape), arg.dtype.scalar)
+    def create_reshape(self, arg, shape, allow_reorder):
+        lead = self.grid_lead
+        return TensorHandle(arg.data.reshape(arg.data.shape[:lead] + tuple(shape)), arg.dtype.scalar)
 
     def create_trans(self, arg, perm):
+        lead = self.grid_lead
+        perm = tuple(range(lead)) + tuple(p + lead for p in perm)
         return TensorHandle(np.transpose(arg.data, perm), arg.dtype.scalar)
 
     def create_dot(self, a, b, d, input_precision, max_num_imprecise_acc):
+        a_format = _get_float_format(a.get_element_ty())
+        b_format = _get_float_format(b.get_element_ty())
+        # The native kernel multiplies in fp32, so fp64 operands stay on the numpy path
+        numpy_formats = (None, _interpreter.FLOAT_FORMAT.FP64)
+        if a_format not in numpy_formats and b_format not in numpy_formats and d.data.dtype == np.float32:
+            if not (a.get_element_ty().is_fp8() and b.get_element_ty().is_fp8()):
+                max_num_imprecise_acc = 0
+            return TensorHandle(self._native_dot(a.data, a_format, b.data, b_format, d.data, max_num_imprecise_acc),
+                                d.dtype.scalar)
         a_data = a.data
         b_data = b.data
         if (a.dtype.primitive_bitwidth == 8 and a.dtype.is_floating()) or \
@@ -550,11 +727,36 @@ class InterpreterBuilder:
             b_data = _convert_float(b_data, b.dtype, tl.float16, None).view(np.float16)
         return TensorHandle(np.matmul(a_data, b_data, dtype=d.data.dtype) + d.data, d.dtype.scalar)
 
+    def _native_dot(self, a_data, a_format, b_data, b_format, d_data, max_num_imprecise_acc):
+        M, K = a_data.shape[-2:]
+        N = b_data.shape[-1]
+        batch_shape = np.broadcast_shapes(a_data.shape[:-2], b_data.shape[:-2], d_data.shape[:-2])
+
+        def as_batches(data):
+            # [batch, rows, cols] with a batch of 1 when the operand is shared by all batches
+            if data.shape[:-2] != batch_shape and math.prod(data.shape[:-2]) != 1:
+                data = np.broadcast_to(data, batch_shape + data.shape[-2:])
+            data = np.ascontiguousarray(data)
+            return data.reshape((-1, ) + data.shape[-2:])
+
+        # Accumulate into a fresh copy of the accumulator; `d` itself is an SSA value that may still be used
+        ret = np.array(np.broadcast_to(d_data, batch_shape + (M, N)), dtype=np.float32, order="C")
+        _interpreter.dot(as_batches(a_data), a_format, as_batches(b_data), b_format, ret.reshape(-1, M, N),
+                         max_num_imprecise_acc)
+        return ret
+
     def create_make_range(self, start, stop):
-        return TensorHandle(np.arange(start, stop, dtype=np.int32), tl.int32)
+        return TensorHandle(np.arange(start, stop, dtype=np.int32).reshape((1, ) * self.grid_lead + (-1, )), tl.int32)
 
     def create_histogram(self, data, bins):
-        return TensorHandle(np.histogram(data.data, bins=bins, range=(0, bins))[0], tl.int32)
+        if self.grid_lead == 0:
+            return TensorHandle(np.histogram(data.data, bins=bins, range=(0, bins))[0], tl.int32)
+        # One histogram per program: offset each program's bins so a single bincount covers the grid
+        values = data.data.reshape(data.data.shape[0], -1).astype(np.int64)
+        valid = (values >= 0) & (values < bins)
+        rows = np.broadcast_to(np.arange(values.shape[0])[:, None], values.shape)
+        counts = np.bincount((rows * bins + values)[valid], minlength=values.shape[0] * bins)
+        return TensorHandle(counts.reshape(values.shape[0], bins).astype(np.int32), tl.int32)
 
     # pointer arithmetic
 
@@ -565,43 +767,64 @@ class InterpreterBuilder:
         element_bytewidth = max(1, element_bitwidth // 8)
         return TensorHandle(ptr.data + element_bytewidth * offset.data.astype(np.uint64), ptr.dtype)
 
+    def _native_block_access(self):
+        # Block pointers are loaded and stored natively unless the per-element addresses are needed, i.e. when the
+        # scalars carry a grid axis or accesses are being traced
+        return self.grid_lead == 0 and self.access_trace is None
+
     def create_tensor_pointer_load(self, ptr, boundary_check, padding_option, cache_modifier, eviction_policy,
                                    is_volatile):
-        ptrs, masks = ptr.materialize_pointers(boundary_check)
-        dtype_tt = ptrs.get_element_ty()
+        dtype_tt = ptr.base.get_element_ty()
         dtype_np = _get_np_dtype(dtype_tt)
-        if padding_option is None:
-            other = None
-        elif padding_option == _ir.PADDING_OPTION.PAD_ZERO:
-            other = TensorHandle(np.zeros_like(ptrs.data, dtype=dtype_np), dtype_tt)
+        if padding_option is None or padding_option == _ir.PADDING_OPTION.PAD_ZERO:
+            padding = np.zeros(1, dtype=dtype_np)
         elif padding_option == _ir.PADDING_OPTION.PAD_NAN:
-            other = TensorHandle(np.full_like(ptrs.data, float('nan'), dtype=dtype_np), dtype_tt)
+            padding = np.full(1, float('nan'), dtype=dtype_np)
         else:
             raise ValueError(f"unsupported padding option {padding_option}")
+        if self._native_block_access():
+            ret = _interpreter.load_block(*ptr.native_args(boundary_check), padding, dtype_np)
+            return TensorHandle(ret, dtype_tt)
+        ptrs, masks = ptr.materialize_pointers(boundary_check)
+        other = TensorHandle(np.broadcast_to(padding, ptrs.data.shape), dtype_tt)
         return self.create_masked_load(ptrs, masks, other, cache_modifier, eviction_policy, is_volatile)
 
     def create_tensor_pointer_store(self, ptr, value, boundary_check, cache_modifier, eviction_policy):
+        if self._native_block_access():
+            self._run_side_effect_hook()
+            value_data = np.broadcast_to(value.data, tuple(ptr.tensor_shape))
+            lo, hi = _interpreter.store_block(*ptr.native_args(boundary_check), value_data)
+            if self.write_tracker is not None and lo < hi:
+                self.write_tracker.record_span(lo, hi)
+            return
         ptrs, masks = ptr.materialize_pointers(boundary_check)
         return self.create_masked_store(ptrs, value, masks, cache_modifier, eviction_policy)
 
     def create_expand_dims(self, arg, axis):
-        return TensorHandle(np.expand_dims(arg.data, axis), arg.dtype.scalar)
+        return TensorHandle(np.expand_dims(arg.data, axis + self.grid_lead), arg.dtype.scalar)
 
     def create_broadcast(self, arg, shape):
-        return TensorHandle(np.broadcast_to(arg.data, shape), arg.dtype.scalar)
+        lead = self.grid_lead
+        return TensorHandle(np.broadcast_to(arg.data, arg.data.shape[:lead] + tuple(shape)), arg.dtype.scalar)
 
     def create_cat(self, lhs, rhs):
-        return TensorHandle(np.concatenate([lhs.data, rhs.data]), lhs.dtype.scalar)
+        return TensorHandle(np.concatenate(self._broadcast_grid(lhs.data, rhs.data), axis=self.grid_lead),
+                            lhs.dtype.scalar)
 
     def create_join(self, lhs, rhs):
         # Triton only supports joining two original tensors into a new one along the last axis
-        return TensorHandle(np.stack([lhs.data, rhs.data], axis=-1), lhs.dtype.scalar)
+        return TensorHandle(np.stack(np.broadcast_arrays(lhs.data, rhs.data), axis=-1), lhs.dtype.scalar)
 
     def create_split(self, val):
         # Triton only supports splitting the original tensor into two along the last axis
         return (TensorHandle(val.data[..., 0], val.dtype.scalar), TensorHandle(val.data[..., 1], val.dtype.scalar))
 
     def create_splat(self, arg, shape):
+        if self.grid_lead:
+            # Scalars are stored as one value per program (or a single uniform value)
+            data = arg.data.reshape(arg.data.shape[0], -1)[:, :1].reshape((-1, ) + (1, ) * len(shape))
+            data = np.broadcast_to(data, data.shape[:1] + tuple(shape)).astype(_get_np_dtype(arg.dtype))
+            return TensorHandle(data, arg.dtype.scalar)
         if isinstance(arg.dtype, tl.block_type):
             return TensorHandle(np.full(shape, arg.data[0], dtype=_get_np_dtype(arg.dtype)), arg.dtype.scalar)
         else:  # scalar
@@ -611,7 +834,10 @@ class InterpreterBuilder:
         if sem not in self.ir_sem_to_interpreter_sem:
             raise ValueError(f"unsupported semantic {sem}")
         sem = self.ir_sem_to_interpreter_sem[sem]
-        return TensorHandle(_interpreter.atomic_cas(ptr.data, cmp.data, val.data, sem), cmp.dtype.scalar)
+        ptr_data, cmp_data, val_data = np.broadcast_arrays(ptr.data, cmp.data, val.data)
+        self._before_side_effect(ptr_data, None, cmp_data.itemsize)
+        self._trace_access(mem_trace.ACCESS_ATOMIC, ptr_data, None, cmp_data.itemsize)
+        return TensorHandle(_interpreter.atomic_cas(ptr_data, cmp_data, val_data, sem), cmp.dtype.scalar)
 
     def create_atomic_rmw(self, rmwOp, ptr, val, mask, sem, scope):
         if rmwOp not in self.ir_rmw_op_to_interpreter_rmw_op:
@@ -620,7 +846,10 @@ class InterpreterBuilder:
             raise ValueError(f"unsupported semantic {sem}")
         rmwOp = self.ir_rmw_op_to_interpreter_rmw_op[rmwOp]
         sem = self.ir_sem_to_interpreter_sem[sem]
-        return TensorHandle(_interpreter.atomic_rmw(rmwOp, ptr.data, val.data, mask.data, sem), val.dtype.scalar)
+        ptr_data, val_data, mask_data = np.broadcast_arrays(ptr.data, val.data, mask.data)
+        self._before_side_effect(ptr_data, mask_data, val_data.itemsize)
+        self._trace_access(mem_trace.ACCESS_ATOMIC, ptr_data, mask_data, val_data.itemsize)
+        return TensorHandle(_interpreter.atomic_rmw(rmwOp, ptr_data, val_data, mask_data, sem), val.dtype.scalar)
 
     def create_extern_elementwise(self, libName, libPath, symbol, argList, retType, isPure):
         raise NotImplementedError("extern_elementwise not supported in interpreter mode")
@@ -633,16 +862,29 @@ class InterpreterBuilder:
         # by `values` themselves in python interpreter, thus not really needed here;
         # it is only used for triton PrintOpToLLVM to correctly construct the format specifier.
         # Interpreter's device_print function has a different format than Triton's device_print
-        msg = f"({self.grid_idx[0]}, {self.grid_idx[1]}, {self.grid_idx[2]})"
-        if prefix:
-            msg += f" {prefix}"
+        if self.grid_lead:
+            grid_ids = list(zip(*self._get_grid_ids()))
+        else:
+            grid_ids = [self.grid_idx]
         if hex:
             np.set_printoptions(formatter={'all': lambda x: f"0x{x:02x}"})
-        for value in values:
-            print(msg + f" {value.data}")
+        for pid, grid_idx in enumerate(grid_ids):
+            msg = f"({grid_idx[0]}, {grid_idx[1]}, {grid_idx[2]})"
+            if prefix:
+                msg += f" {prefix}"
+            for value in values:
+                data = value.data[pid if value.data.shape[0] > 1 else 0] if self.grid_lead else value.data
+                self._print(msg + f" {data}")
         if hex:
             np.set_printoptions(formatter=None)
 
+    def _print(self, line):
+        print_buffer = getattr(self._local, "print_buffer", None)
+        if print_buffer is None:
+            print(line)
+        else:
+            print_buffer.append(line)
+
     def create_assert(self, condition, message, fileName, funcName, lineNo):
         # Interpreter's device_assert function has a different format than Triton's device_assert
         assert condition, f"{message} in {fileName}:{funcName}:{lineNo}"
@@ -666,7 +908,7 @@ class InterpreterBuilder:
         new_offsets = [offset.clone() for offset in ptr.offsets]
         ret = BlockPointerHandle(ptr.base, ptr.shape, ptr.strides, new_offsets, ptr.tensor_shape, ptr.order)
         for i in range(len(offsets)):
-            ret.offsets[i].data += offsets[i].data
+            ret.offsets[i].data = ret.offsets[i].data + offsets[i].data
         return ret
 
     def get_all_ones_value(self, type):
@@ -694,15 +936,20 @@ def _patch_builtin(pkg, builder):
 def _patch_lang_tensor(tensor):
 
     def _get_bool(self):
+        # Programs wait on each other by branching on loaded values, e.g. in spin loops
+        interpreter_builder.check_launch_failed()
         data = self.handle.data
+        if interpreter_builder.grid_lead and data[:1].size == 1:
+            data = interpreter_builder.ungrid(data)
         # in triton, only scalars can be converted to booleans
         # here we need this hack because all scalars are tensors
         return bool(data) if data.size == 1 else True
 
     def _get_transpose(self):
-        return tl.core.tensor(TensorHandle(np.transpose(self.handle.data), self.handle.dtype), self.dtype.scalar)
+        perm = list(reversed(range(len(self.shape))))
+        return tl.core.tensor(interpreter_builder.create_trans(self.handle, perm), self.dtype.scalar)
 
-    tensor.__index__ = lambda self: int(self.handle.data)
+    tensor.__index__ = lambda self: int(interpreter_builder.ungrid(self.handle.data))
     tensor.__bool__ = lambda self: _get_bool(self)
     tensor.__repr__ = lambda self: repr(self.handle.data)
     tensor.__str__ = lambda self: str(self.handle.data)
@@ -726,13 +973,41 @@ class ReduceScanOpIneterface:
             self.check_axis(arg.shape, self.axis)
 
     def to_tensor(self, ret, dtype):
-        if hasattr(ret, "shape") and ret.shape:
-            ret_type = tl.block_type(dtype, ret.shape)
+        lead = interpreter_builder.grid_lead
+        if hasattr(ret, "shape") and len(ret.shape) > lead:
+            ret_type = tl.block_type(dtype, list(ret.shape[lead:]))
         else:
-            ret = np.array([ret], dtype=_get_np_dtype(dtype))
+            ret = np.array(ret, dtype=_get_np_dtype(dtype)).reshape(-1)
             ret_type = dtype
         return tl.core.tensor(TensorHandle(ret, dtype.scalar), ret_type)
 
+    def data_axis(self, axis):
+        # Position of a tensor axis in the underlying data, which may carry a leading grid axis
+        return axis + interpreter_builder.grid_lead if axis is not None and axis >= 0 else axis
+
+    def check_grid_vectorizable(self):
+        if interpreter_builder.grid_lead:
+            raise GridDivergenceError(f"{self.combine_fn} is not supported when interpreting the whole grid at once")
+
+    def combine_lanes(self, lhs, rhs, dtypes):
+        '''
+            Applies combine_fn to every pair of elements of the equally shaped arrays in `lhs` and `rhs` with a
+            single call, treating each element position as an independent lane
+        '''
+        shape = lhs[0].shape
+        with interpreter_builder.vectorized_lanes():
+            lhs_tuple = tuple(self.to_tensor(d.reshape(-1), dtype) for d, dtype in zip(lhs, dtypes))
+            rhs_tuple = tuple(self.to_tensor(d.reshape(-1), dtype) for d, dtype in zip(rhs, dtypes))
+            combine_fn_ret = self.combine_fn.fn(*lhs_tuple, *rhs_tuple)
+        acc_tuple = (combine_fn_ret, ) if not isinstance(combine_fn_ret, tuple) else combine_fn_ret
+        if len(acc_tuple) != len(lhs):
+            raise ValueError(f"combine_fn returned {len(acc_tuple)} values, expected {len(lhs)}")
+        ret = []
+        for acc, d in zip(acc_tuple, lhs):
+            data = acc.handle.data if isinstance(acc, tl.core.tensor) else acc
+            ret.append(np.broadcast_to(data, (d.size, )).astype(d.dtype).reshape(shape))
+        return ret
+
     def apply(self, input):
         if not isinstance(input, tuple):
             input = (input, )
@@ -760,6 +1035,7 @@ class ReduceOps(ReduceScanOpIneterface):
         return tuple(ret), axis
 
     def generic_reduce(self, input):
+        self.check_grid_vectorizable()
         original_axis = self.axis
         input, axis = self.unravel(input, self.axis)
         input_data = []
@@ -802,15 +1078,59 @@ class ReduceOps(ReduceScanOpIneterface):
             ret.append(self.to_tensor(data, input[i].dtype))
         return ret[0] if len(ret) == 1 else tuple(ret)
 
+    def tree_reduce(self, input):
+        '''
+            Reduces as a log-depth tree of pairwise combines. Each level is one combine_fn call vectorized over all
+            pairs of all reduced rows; the operand order of every combine is preserved.
+        '''
+        lead = interpreter_builder.grid_lead
+        dtypes = [arg.dtype for arg in input]
+        data = interpreter_builder._broadcast_grid(*[arg.handle.data for arg in input])
+        if self.axis is None:
+            # Reduce all tensor axes of each program
+            ndim = data[0].ndim
+            data = [d.reshape(d.shape[:lead] + (-1, )) for d in data]
+            axis = lead
+        else:
+            axis = self.data_axis(self.axis)
+        data = [np.moveaxis(d, axis, -1) for d in data]
+        output_shape = data[0].shape[:-1]
+        rows = [d.reshape(-1, d.shape[-1]) for d in data]
+        while rows[0].shape[1] > 1:
+            paired = rows[0].shape[1] // 2 * 2
+            acc = self.combine_lanes([r[:, 0:paired:2] for r in rows], [r[:, 1:paired:2] for r in rows], dtypes)
+            # An odd trailing element moves up to the next level unchanged
+            rows = [np.concatenate((a, r[:, paired:]), axis=1) for a, r in zip(acc, rows)]
+        ret = []
+        for i, row in enumerate(rows):
+            data = row.reshape(output_shape)
+            if self.keep_dims:
+                if self.axis is not None:
+                    data = np.expand_dims(data, axis)
+                else:
+                    data = data.reshape(output_shape + (1, ) * (ndim - lead))
+            ret.append(self.to_tensor(data, input[i].dtype))
+        return ret[0] if len(ret) == 1 else tuple(ret)
+
+    def np_reduce(self, op, data):
+        lead = interpreter_builder.grid_lead
+        if self.axis is not None or lead == 0:
+            return op(data, axis=self.data_axis(self.axis), keepdims=self.keep_dims)
+        # Reduce all tensor axes of each program
+        ret = op(data.reshape(data.shape[:lead] + (-1, )), axis=lead)
+        if self.keep_dims:
+            ret = ret.reshape(ret.shape + (1, ) * (data.ndim - lead))
+        return ret
+
     def min_max(self, input, val_reduce_op, idx_reduce_op=None):
         # If input is a tuple, it must be (val, index), and we only take val
         input = input[0] if isinstance(input, tuple) else input
         val = None
         idx = None
         if val_reduce_op:
-            val = self.to_tensor(val_reduce_op(input.handle.data, axis=self.axis, keepdims=self.keep_dims), input.dtype)
+            val = self.to_tensor(self.np_reduce(val_reduce_op, input.handle.data), input.dtype)
         if idx_reduce_op:
-            idx = self.to_tensor(idx_reduce_op(input.handle.data, axis=self.axis, keepdims=self.keep_dims), tl.int32)
+            idx = self.to_tensor(self.np_reduce(idx_reduce_op, input.handle.data), tl.int32)
         if val is not None and idx is not None:
             return val, idx
         elif val is not None:
@@ -821,7 +1141,7 @@ class ReduceOps(ReduceScanOpIneterface):
             raise ValueError("val_reduce_op and idx_reduce_op are both None")
 
     def sum(self, input):
-        return self.to_tensor(np.sum(input.handle.data, axis=self.axis, keepdims=self.keep_dims), input.dtype)
+        return self.to_tensor(self.np_reduce(np.sum, input.handle.data), input.dtype)
 
     def apply_impl(self, input):
         if self.combine_fn == tl.standard._argmin_combine_tie_break_left:
@@ -835,8 +1155,12 @@ class ReduceOps(ReduceScanOpIneterface):
         elif self.combine_fn == tl.standard._sum_combine:
             return self.sum(input[0])
         else:
-            # Fall back to the slow mode
-            return self.generic_reduce(input)
+            try:
+                return self.tree_reduce(input)
+            except GridDivergenceError:
+                # Fall back to the slow mode for combine bodies that cannot run on vectorized lanes, such as those
+                # branching on their operands. Other errors are genuine failures of combine_fn and propagate.
+                return self.generic_reduce(input)
 
 
 class ScanOps(ReduceScanOpIneterface):
@@ -846,12 +1170,32 @@ class ScanOps(ReduceScanOpIneterface):
         self.reverse = reverse
 
     def cumsum(self, input):
-        return [self.to_tensor(np.cumsum(input.handle.data, axis=self.axis), dtype=input.dtype)]
+        return [self.to_tensor(np.cumsum(input.handle.data, axis=self.data_axis(self.axis)), dtype=input.dtype)]
 
     def cumprod(self, input):
-        return [self.to_tensor(np.cumprod(input.handle.data, axis=self.axis), dtype=input.dtype)]
+        return [self.to_tensor(np.cumprod(input.handle.data, axis=self.data_axis(self.axis)), dtype=input.dtype)]
+
+    def tree_scan(self, input):
+        '''
+            Inclusive scan in log-depth rounds: round k combines every element with the partial result 2**k
+            positions before it, as one combine_fn call vectorized over the whole tensor
+        '''
+        axis = self.data_axis(self.axis)
+        dtypes = [arg.dtype for arg in input]
+        data = interpreter_builder._broadcast_grid(*[arg.handle.data for arg in input])
+        data = [np.moveaxis(d, axis, -1) for d in data]
+        shape = data[0].shape
+        rows = [d.reshape(-1, shape[-1]) for d in data]
+        n = shape[-1]
+        offset = 1
+        while offset < n:
+            acc = self.combine_lanes([r[:, :n - offset] for r in rows], [r[:, offset:] for r in rows], dtypes)
+            rows = [np.concatenate((r[:, :offset], a), axis=1) for a, r in zip(acc, rows)]
+            offset *= 2
+        return [self.to_tensor(np.moveaxis(r.reshape(shape), -1, axis), input[i].dtype) for i, r in enumerate(rows)]
 
     def generic_scan(self, input):
+        self.check_grid_vectorizable()
         input_data = []
         output_data = []
         shape = input[0].handle.data.shape
@@ -885,7 +1229,7 @@ class ScanOps(ReduceScanOpIneterface):
         new_input = []
         if self.reverse:
             for arg in input:
-                new_input.append(self.to_tensor(np.flip(arg.handle.data, axis=self.axis), arg.dtype))
+                new_input.append(self.to_tensor(np.flip(arg.handle.data, axis=self.data_axis(self.axis)), arg.dtype))
         else:
             new_input = input
         if self.combine_fn == tl.standard._sum_combine:
@@ -893,11 +1237,15 @@ class ScanOps(ReduceScanOpIneterface):
         elif self.combine_fn == tl.standard._prod_combine:
             ret = self.cumprod(new_input[0])
         else:
-            # Fall back to the slow mode
-            ret = self.generic_scan(new_input)
+            try:
+                ret = self.tree_scan(new_input)
+            except GridDivergenceError:
+                # Fall back to the slow mode for combine bodies that cannot run on vectorized lanes, such as those
+                # branching on their operands. Other errors are genuine failures of combine_fn and propagate.
+                ret = self.generic_scan(new_input)
         if self.reverse:
             for arg in ret:
-                arg.handle.data = np.flip(arg.handle.data, axis=self.axis)
+                arg.handle.data = np.flip(arg.handle.data, axis=self.data_axis(self.axis))
         return len(ret) == 1 and ret[0] or tuple(ret)
 
 
@@ -1037,7 +1385,26 @@ interpreter_builder = InterpreterBuilder()
 RESERVED_KWS = ["num_warps", "num_stages", "num_ctas", "enable_fp_fusion", "grid", "maxnreg"]
 
 
+def _get_num_threads():
+    # Number of threads used to run program instances concurrently; 1 keeps the serial execution order
+    num_threads = int(os.getenv("TRITON_INTERPRET_NUM_THREADS", "1"))
+    if num_threads <= 0:
+        num_threads = os.cpu_count() or 1
+    return num_threads
+
+
+def _vectorize_grid():
+    return os.getenv("TRITON_INTERPRET_VECTORIZE_GRID", "0") == "1"
+
+
+def _get_trace_path():
+    return os.getenv("TRITON_INTERPRET_TRACE", "")
+
+
 class GridExecutor:
+    # (kernel, constexpr specialization) pairs whose programs diverged when run with the whole grid vectorized;
+    # they go straight to per-program execution
+    unvectorizable_specializations = set()
 
     def __init__(self, fn, arg_names, grid):
         from .jit import _normalize_ty  # TODO: modularize
@@ -1049,32 +1416,142 @@ class GridExecutor:
         self.constexprs = [name for name in arg_names if __annotations__.get(name) == "constexpr"]
 
     def _init_args_hst(self, args_dev, kwargs):
-        args_hst = []
-        for arg in args_dev:
-            if hasattr(arg, "data_ptr"):
-                args_hst.append(arg.cpu())
-            else:
-                args_hst.append(arg)
+        def is_device_tensor(arg):
+            return hasattr(arg, "data_ptr") and arg.device.type != "cpu"
+
+        # Device tensors viewing the same storage share one host copy of the bytes they cover, so aliasing arguments
+        # stay aliased and the host views keep the strides the kernel computes its addresses with
+        spans = {}
+        for arg in itertools.chain(args_dev, kwargs.values()):
+            arg = getattr(arg, "base", arg)
+            if not is_device_tensor(arg):
+                continue
+            begin, end = _get_storage_span(arg)
+            # Aligned so that the host views of every dtype start on an element
+            begin -= begin % 16
+            key = arg.untyped_storage().data_ptr()
+            if key in spans:
+                begin, end = min(begin, spans[key][0]), max(end, spans[key][1])
+            spans[key] = (begin, end)
+        storages = {}
+
+        def to_host(arg):
+            # Host-resident tensors are passed through, so the kernel reads and writes their buffers in place
+            if not is_device_tensor(arg):
+                return arg
+            if isinstance(arg, triton.runtime.jit.TensorWrapper):
+                return triton.runtime.jit.TensorWrapper(to_host(arg.base), arg.dtype)
+            key = arg.untyped_storage().data_ptr()
+            begin, end = spans[key]
+            if key not in storages:
+                import torch
+                storage_bytes = torch.empty(0, dtype=torch.uint8, device=arg.device).set_(arg.untyped_storage())
+                storages[key] = storage_bytes[begin:end].cpu().untyped_storage()
+            offset = arg.storage_offset() - begin // arg.element_size()
+            return arg.new_empty(0, device="cpu").set_(storages[key], offset, arg.size(), arg.stride())
+
+        args_hst = [to_host(arg) for arg in args_dev]
         # Process keyword arguments
-        kwargs_hst = {}
-        for key, value in kwargs.items():
-            if hasattr(value, "data_ptr"):
-                kwargs_hst[key] = value.cpu()
-            else:
-                kwargs_hst[key] = value
+        kwargs_hst = {key: to_host(value) for key, value in kwargs.items()}
         return args_hst, kwargs_hst
 
-    def _restore_args_dev(self, args_dev, args_hst, kwargs, kwargs_hst):
+    def _restore_args_dev(self, args_dev, args_hst, kwargs, kwargs_hst, written):
+        # Only host copies the kernel stored to (or ran atomics on) are copied back
         for arg_dev, arg_hst in zip(args_dev, args_hst):
-            if hasattr(arg_dev, "data_ptr"):
+            if arg_hst is not arg_dev and written.get(id(arg_hst), False):
                 arg_dev.data.copy_(arg_hst.to(arg_dev.device).data)
 
         # Restore keyword arguments
         for key, kwarg_dev in kwargs.items():
             kwarg_hst = kwargs_hst[key]
-            if hasattr(kwarg_dev, "data_ptr"):
+            if kwarg_hst is not kwarg_dev and written.get(id(kwarg_hst), False):
                 kwarg_dev.data.copy_(kwarg_hst.to(kwarg_dev.device).data)
 
+    def _specialization_key(self, args):
+        # Whether the programs diverge depends on the constexpr values, so each specialization is tracked apart
+        def hashable(value):
+            try:
+                hash(value)
+                return value
+            except TypeError:
+                return repr(value)
+
+        return (self.fn, tuple(hashable(args[name]) for name in self.constexprs))
+
+    def _run_vectorized(self, args, tensors, key):
+        # Runs the kernel body once with every value carrying a leading grid axis. If the programs diverge (or
+        # the kernel uses something without a vectorized implementation), memory written so far is restored
+        # and False is returned so the caller can fall back to running one program at a time. Any other error
+        # is a genuine failure of the kernel and propagates.
+        snapshot = []
+        # Device prints are held back until the programs are known not to be run again
+        printed = []
+
+        def take_snapshot():
+            for tensor in tensors:
+                tensor = getattr(tensor, "base", tensor)
+                snapshot.append((tensor, tensor.clone()))
+
+        trace = interpreter_builder.access_trace
+        trace_checkpoint = trace.checkpoint() if trace is not None else None
+        interpreter_builder.set_grid_vectorized(True, side_effect_hook=take_snapshot, print_buffer=printed)
+        try:
+            self.fn(**args)
+            return True
+        except GridDivergenceError:
+            printed.clear()
+            for tensor, saved in snapshot:
+                tensor.copy_(saved)
+            if trace is not None:
+                trace.rollback(trace_checkpoint)
+            self.unvectorizable_specializations.add(key)
+            return False
+        finally:
+            interpreter_builder.set_grid_vectorized(False)
+            for line in printed:
+                print(line)
+
+    def _run_programs(self, args, grid):
+        num_threads = min(_get_num_threads(), grid[0] * grid[1] * grid[2])
+        if num_threads > 1:
+            return self._run_parallel(args, grid, num_threads)
+        for x in range(grid[0]):
+            for y in range(grid[1]):
+                for z in range(grid[2]):
+                    interpreter_builder.set_grid_idx(x, y, z)
+                    self.fn(**args)
+
+    def _run_parallel(self, args, grid, num_threads):
+        # Program instances are distributed round-robin over a thread pool. numpy and the
+        # native load/store/atomic routines release the GIL, and atomics are real host atomics,
+        # so programs synchronize with each other the same way they do on the GPU.
+        program_ids = list(itertools.product(range(grid[0]), range(grid[1]), range(grid[2])))
+        failed = threading.Event()
+
+        def run_programs(worker_program_ids):
+            for x, y, z in worker_program_ids:
+                if failed.is_set():
+                    return
+                interpreter_builder.set_grid_idx(x, y, z)
+                try:
+                    self.fn(**args)
+                except Exception:
+                    failed.set()
+                    raise
+
+        # Programs still running stop at their next branch on a tensor once `failed` is set
+        interpreter_builder.launch_failed = failed
+        try:
+            with ThreadPoolExecutor(max_workers=num_threads) as executor:
+                futures = [executor.submit(run_programs, program_ids[i::num_threads]) for i in range(num_threads)]
+                errors = [future.exception() for future in futures]
+        finally:
+            interpreter_builder.launch_failed = None
+        # Report the program that failed rather than the ones it aborted
+        for error in errors:
+            if error is not None and not isinstance(error, LaunchAbortedError):
+                raise error
+
     def __call__(self, *args_dev, **kwargs):
         # removes reserved keywords from kwargs
         kwargs = {k: v for k, v in kwargs.items() if k not in RESERVED_KWS}
@@ -1093,16 +1570,27 @@ class GridExecutor:
         assert len(grid) <= 3, "grid must have at most 3 dimensions"
         grid = grid + (1, ) * (3 - len(grid))
         interpreter_builder.set_grid_dim(*grid)
+        tensors = [arg for arg in itertools.chain(args_hst, kwargs_hst.values()) if hasattr(arg, "data_ptr")]
+        key = self._specialization_key(args)
+        vectorize = _vectorize_grid() and key not in self.unvectorizable_specializations
+        write_tracker = WriteTracker(tensors)
+        interpreter_builder.write_tracker = write_tracker
+        trace_path = _get_trace_path()
+        if trace_path:
+            interpreter_builder.access_trace = mem_trace.TraceWriter(trace_path, self.fn.__name__, grid)
         try:
-            for x in range(grid[0]):
-                for y in range(grid[1]):
-                    for z in range(grid[2]):
-                        interpreter_builder.set_grid_idx(x, y, z)
-                        self.fn(**args)
+            if not (vectorize and self._run_vectorized(args, tensors, key)):
+                self._run_programs(args, grid)
         except Exception as e:
             raise InterpreterError(repr(e)) from e
-        # copy arguments back to propagate side-effects
-        self._restore_args_dev(args_dev, args_hst, kwargs, kwargs_hst)
+        finally:
+            interpreter_builder.write_tracker = None
+            if interpreter_builder.access_trace is not None:
+                interpreter_builder.access_trace.close()
+                interpreter_builder.access_trace = None
+        # copy written arguments back to propagate side-effects
+        written = {id(tensor): is_written for tensor, is_written in zip(tensors, write_tracker.written)}
+        self._restore_args_dev(args_dev, args_hst, kwargs, kwargs_hst, written)
 
 
 class ASTTransformer(ast.NodeTransformer):
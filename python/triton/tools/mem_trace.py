@@ -0,0 +1,287 @@
+import struct
+import threading
+from dataclasses import dataclass, field
+from typing import Dict, List
+
+import numpy as np
+
+# A memory trace is a little-endian binary file written by the interpreter when TRITON_INTERPRET_TRACE is set.
+# It starts with MAGIC and VERSION (u32), followed by records that each start with a one byte record type:
+#   LAUNCH:   name length (u32), kernel name (utf-8), grid x, y, z (3 x u32)
+#   LOCATION: location id (u32), length (u32), source location "file:line" (utf-8)
+#   ACCESS:   kind (u8), element size (u8), location id (u32), program id x, y, z (3 x u32), count (u32),
+#             followed by `count` addresses (u64) in program order; masked-off elements are not recorded
+# Location ids are scoped to the launch that defines them.
+MAGIC = b"TTMT"
+VERSION = 1
+
+RECORD_LAUNCH = 0
+RECORD_LOCATION = 1
+RECORD_ACCESS = 2
+
+ACCESS_LOAD = 0
+ACCESS_STORE = 1
+ACCESS_ATOMIC = 2
+ACCESS_KINDS = {ACCESS_LOAD: "load", ACCESS_STORE: "store", ACCESS_ATOMIC: "atomic"}
+
+_LAUNCH = struct.Struct("<BI")
+_GRID = struct.Struct("<III")
+_LOCATION = struct.Struct("<BII")
+_ACCESS = struct.Struct("<BBBIIIII")
+
+SECTOR_BYTES = 32
+LINE_BYTES = 128
+
+
+class TraceWriter:
+    '''
+        Appends the accesses of one kernel launch to a memory trace file. Safe to use from multiple threads.
+    '''
+
+    def __init__(self, path, name, grid):
+        self.lock = threading.Lock()
+        self.file = open(path, "ab")
+        if self.file.tell() == 0:
+            self.file.write(MAGIC + struct.pack("<I", VERSION))
+        encoded = name.encode()
+        self.file.write(_LAUNCH.pack(RECORD_LAUNCH, len(encoded)) + encoded + _GRID.pack(*grid))
+        self.locations = {}
+
+    def _location_id(self, location):
+        location_id = self.locations.get(location)
+        if location_id is None:
+            location_id = len(self.locations)
+            self.locations[location] = location_id
+            encoded = location.encode()
+            self.file.write(_LOCATION.pack(RECORD_LOCATION, location_id, len(encoded)) + encoded)
+        return location_id
+
+    def write(self, kind, itemsize, location, program_id, addresses):
+        addresses = np.ascontiguousarray(addresses, dtype="<u8")
+        with self.lock:
+            header = _ACCESS.pack(RECORD_ACCESS, kind, itemsize, self._location_id(location), *program_id,
+                                  addresses.size)
+            self.file.write(header)
+            self.file.write(addresses.tobytes())
+
+    def checkpoint(self):
+        with self.lock:
+            return self.file.tell(), dict(self.locations)
+
+    def rollback(self, checkpoint):
+        # Drops everything written since `checkpoint`
+        with self.lock:
+            position, self.locations = checkpoint
+            self.file.seek(position)
+            self.file.truncate()
+
+    def close(self):
+        self.file.close()
+
+
+@dataclass
+class Access:
+    kind: int
+    itemsize: int
+    location: str
+    program_id: tuple
+    addresses: np.ndarray
+
+
+@dataclass
+class Launch:
+    name: str
+    grid: tuple
+    accesses: List[Access] = field(default_factory=list)
+
+
+def read_trace(path) -> List[Launch]:
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:len(MAGIC)] != MAGIC:
+        raise ValueError(f"{path} is not a memory trace")
+    version, = struct.unpack_from("<I", data, len(MAGIC))
+    if version != VERSION:
+        raise ValueError(f"unsupported memory trace version {version}")
+    offset = len(MAGIC) + 4
+    launches = []
+    locations = {}
+    while offset < len(data):
+        record = data[offset]
+        if record == RECORD_LAUNCH:
+            _, length = _LAUNCH.unpack_from(data, offset)
+            offset += _LAUNCH.size
+            name = data[offset:offset + length].decode()
+            offset += length
+            grid = _GRID.unpack_from(data, offset)
+            offset += _GRID.size
+            launches.append(Launch(name, grid))
+            locations = {}
+        elif record == RECORD_LOCATION:
+            _, location_id, length = _LOCATION.unpack_from(data, offset)
+            offset += _LOCATION.size
+            locations[location_id] = data[offset:offset + length].decode()
+            offset += length
+        elif record == RECORD_ACCESS:
+            _, kind, itemsize, location_id, x, y, z, count = _ACCESS.unpack_from(data, offset)
+            offset += _ACCESS.size
+            addresses = np.frombuffer(data, dtype="<u8", count=count, offset=offset)
+            offset += 8 * count
+            launches[-1].accesses.append(Access(kind, itemsize, locations[location_id], (x, y, z), addresses))
+        else:
+            raise ValueError(f"corrupted memory trace: unknown record type {record} at offset {offset}")
+    return launches
+
+
+class _FenwickTree:
+
+    def __init__(self, size):
+        self.tree = [0] * (size + 1)
+
+    def add(self, i, delta):
+        i += 1
+        while i < len(self.tree):
+            self.tree[i] += delta
+            i += i & -i
+
+    def prefix_sum(self, i):
+        # Sum of entries [0, i)
+        total = 0
+        while i > 0:
+            total += self.tree[i]
+            i -= i & -i
+        return total
+
+
+def reuse_distances(lines):
+    '''
+        For every access of the `lines` stream, the number of distinct lines accessed since the previous access to
+        the same line, or -1 for first accesses
+    '''
+    tree = _FenwickTree(len(lines))
+    last_access = {}
+    distances = np.full(len(lines), -1, dtype=np.int64)
+    for t, line in enumerate(lines.tolist()):
+        previous = last_access.get(line)
+        if previous is not None:
+            # Lines whose latest access lies strictly between the two accesses
+            distances[t] = tree.prefix_sum(t) - tree.prefix_sum(previous + 1)
+            tree.add(previous, -1)
+        tree.add(t, 1)
+        last_access[line] = t
+    return distances
+
+
+@dataclass
+class LocationStats:
+    location: str
+    kinds: set = field(default_factory=set)
+    instructions: int = 0
+    requested_bytes: int = 0
+    sectors: int = 0
+    lines: int = 0
+    unique_lines: set = field(default_factory=set)
+    reuses: int = 0
+    l2_hits: int = 0
+    line_accesses: int = 0
+    reuse_distance_sum: int = 0
+
+    @property
+    def sector_utilization(self):
+        return self.requested_bytes / (self.sectors * SECTOR_BYTES) if self.sectors else 0.0
+
+    @property
+    def line_utilization(self):
+        return self.requested_bytes / (self.lines * LINE_BYTES) if self.lines else 0.0
+
+    @property
+    def mean_reuse_distance(self):
+        return self.reuse_distance_sum / self.reuses if self.reuses else float("nan")
+
+    @property
+    def l2_footprint(self):
+        return len(self.unique_lines) * LINE_BYTES
+
+    @property
+    def l2_hit_rate(self):
+        return self.l2_hits / self.line_accesses if self.line_accesses else 0.0
+
+
+def analyze(launch: Launch, l2_bytes=40 * 2**20) -> Dict[str, LocationStats]:
+    '''
+        Per source location statistics of a launch. Each recorded instruction of each program is treated as one
+        memory transaction: sector/line utilization is the fraction of the fetched 32B sectors/128B lines that was
+        requested. Reuse distances are measured over the 128B lines of the whole launch in program order, and an
+        access counts as an L2 hit when fewer than `l2_bytes` worth of other lines were touched since the line was
+        last used (an LRU cache model).
+    '''
+    stats = {}
+    streams = []
+    for access in launch.accesses:
+        s = stats.get(access.location)
+        if s is None:
+            s = stats[access.location] = LocationStats(access.location)
+        s.kinds.add(ACCESS_KINDS[access.kind])
+        s.instructions += 1
+        s.requested_bytes += access.addresses.size * access.itemsize
+        # An element may straddle a sector or line boundary when it is not naturally aligned
+        first, last = access.addresses, access.addresses + np.uint64(access.itemsize - 1)
+        sectors = np.unique(np.concatenate((first // np.uint64(SECTOR_BYTES), last // np.uint64(SECTOR_BYTES))))
+        lines = np.unique(np.concatenate((first // np.uint64(LINE_BYTES), last // np.uint64(LINE_BYTES))))
+        s.sectors += sectors.size
+        s.lines += lines.size
+        s.unique_lines.update(lines.tolist())
+        streams.append((s, lines))
+    if not streams:
+        return stats
+    all_lines = np.concatenate([lines for _, lines in streams])
+    distances = reuse_distances(all_lines)
+    l2_lines = l2_bytes // LINE_BYTES
+    begin = 0
+    for s, lines in streams:
+        d = distances[begin:begin + lines.size]
+        begin += lines.size
+        reused = d >= 0
+        s.line_accesses += lines.size
+        s.reuses += int(np.count_nonzero(reused))
+        s.reuse_distance_sum += int(d[reused].sum())
+        s.l2_hits += int(np.count_nonzero(reused & (d < l2_lines)))
+    return stats
+
+
+def format_report(launches: List[Launch], l2_bytes=40 * 2**20) -> str:
+    header = f"{'location':<40} {'kind':<12} {'instrs':>8} {'bytes':>12} {'sector%':>8} {'line%':>8} " \
+             f"{'reuse dist':>10} {'L2 hit%':>8} {'L2 footprint':>12}"
+    out = []
+    for launch in launches:
+        out.append(f"{launch.name} grid={launch.grid}")
+        out.append(header)
+        stats = sorted(analyze(launch, l2_bytes).values(), key=lambda s: s.requested_bytes, reverse=True)
+        for s in stats:
+            out.append(f"{s.location[-40:]:<40} {','.join(sorted(s.kinds)):<12} {s.instructions:>8} "
+                       f"{s.requested_bytes:>12} {100 * s.sector_utilization:>7.1f}% "
+                       f"{100 * s.line_utilization:>7.1f}% {s.mean_reuse_distance:>10.1f} "
+                       f"{100 * s.l2_hit_rate:>7.1f}% {s.l2_footprint:>12}")
+        out.append("")
+    return "\n".join(out)
+
+
+desc = """
+Reports memory coalescing and reuse statistics of a memory trace recorded by the interpreter:
+
+TRITON_INTERPRET=1 TRITON_INTERPRET_TRACE=trace.bin python my_kernel.py
+python mem_trace.py trace.bin
+
+For every tt.load/tt.store/atomic source location the report lists how much of the fetched 32B sectors and 128B
+lines were actually requested, the mean reuse distance (in distinct 128B lines) and the hit rate of an LRU L2
+model, and the number of distinct bytes the location pulls into L2.
+"""
+
+if __name__ == "__main__":
+    from argparse import ArgumentParser
+
+    parser = ArgumentParser(description=desc)
+    parser.add_argument("trace", help="Path to a trace written with TRITON_INTERPRET_TRACE")
+    parser.add_argument("--l2-size", type=int, default=40 * 2**20, help="L2 capacity in bytes for the hit rate model")
+    args = parser.parse_args()
+    print(format_report(read_trace(args.trace), args.l2_size))
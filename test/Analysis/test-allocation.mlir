@@ -1,4 +1,5 @@
 // RUN: triton-opt %s -split-input-file --mlir-disable-threading -test-print-allocation 2>&1 | FileCheck %s
+// RUN: triton-opt %s -split-input-file --mlir-disable-threading -test-print-allocation-peak 2>&1 | FileCheck %s --check-prefix=PEAK
 
 #AL = #triton_gpu.blocked<{sizePerThread = [1, 4], threadsPerWarp = [4, 8], warpsPerCTA = [4, 1], order = [1, 0]}>
 #sliceAd0 = #triton_gpu.slice<{dim = 0, parent = #AL}>
@@ -131,6 +132,7 @@ tt.func @preallocate(%A : !tt.ptr<f16>) {
   triton_gpu.local_dealloc %cst5 : !tt.memdesc<64x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   tt.return
   // CHECK-NEXT: size = 12288
+  // PEAK: preallocate: first-fit = 12288, packed = 12288
 }
 
 // Unused tensors are immediately released
@@ -150,49 +152,50 @@ tt.func @unused(%A : !tt.ptr<f16>) {
 // cst0 is alive through the entire function, it cannot be released before the end of the function
 // CHECK-LABEL: longlive
 tt.func @longlive(%A : !tt.ptr<f16>) {
-  // CHECK: offset = 0, size = 512
+  // CHECK: offset = 1024, size = 512
   %cst0 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 1024, size = 512
-  %cst1 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   // CHECK-NEXT: offset = 2048, size = 512
+  %cst1 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+  // CHECK-NEXT: offset = 3072, size = 512
   %cst2 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 3072, size = 1024
+  // CHECK-NEXT: offset = 0, size = 1024
   %a = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   triton_gpu.local_dealloc %cst1 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   triton_gpu.local_dealloc %cst2 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
 
-  // CHECK-NEXT: offset = 1024, size = 512
-  %cst3 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   // CHECK-NEXT: offset = 2048, size = 512
+  %cst3 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+  // CHECK-NEXT: offset = 3072, size = 512
   %cst4 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 3072, size = 1024
+  // CHECK-NEXT: offset = 0, size = 1024
   %b = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 3072, size = 512
+  // CHECK-NEXT: offset = 0, size = 512
   %cst5 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 3072, size = 512
+  // CHECK-NEXT: offset = 0, size = 512
   %cst6 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 3072, size = 1024
+  // CHECK-NEXT: offset = 0, size = 1024
   %c = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   triton_gpu.local_dealloc %cst3 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   triton_gpu.local_dealloc %cst4 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 1024, size = 1024
+  // CHECK-NEXT: offset = 0, size = 1024
   %d = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   triton_gpu.local_dealloc %cst0 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   tt.return
-  // CHECK-NEXT: size = 4096
+  // CHECK-NEXT: size = 3584
+  // PEAK: longlive: first-fit = 4096, packed = 3584
 }
 
 // This example triggers graph coloring with > 1 colors.
 // CHECK-LABEL: multi_color
 tt.func @multi_color(%A : !tt.ptr<f16>) {
-  // CHECK: offset = 0, size = 64
+  // CHECK: offset = 1280, size = 64
   %cst = triton_gpu.local_alloc : () -> !tt.memdesc<4x8xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 1536, size = 32
+  // CHECK-NEXT: offset = 1408, size = 32
   %cst_0 = triton_gpu.local_alloc : () -> !tt.memdesc<4x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 1664, size = 128
+  // CHECK-NEXT: offset = 1152, size = 128
   %cst_1 = triton_gpu.local_alloc : () -> !tt.memdesc<16x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   %cst_2 = arith.constant dense<0.000000e+00> : tensor<16x32xf16, #AL>
-  // CHECK-NEXT: scratch offset = 128, size = 1152
+  // CHECK-NEXT: scratch offset = 0, size = 1152
   %0 = triton_gpu.convert_layout %cst_2 : tensor<16x32xf16, #AL> -> tensor<16x32xf16, #BL>
   %1 = triton_gpu.local_load %cst : !tt.memdesc<4x8xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<4x8xf16, #AL>
   // CHECK-NEXT: offset = 0, size = 128
@@ -200,22 +203,22 @@ tt.func @multi_color(%A : !tt.ptr<f16>) {
   %2 = triton_gpu.local_load %cst_0 : !tt.memdesc<4x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<4x4xf16, #AL>
   // CHECK-NEXT: scratch offset = 0, size = 1152
   %3 = triton_gpu.convert_layout %cst_2 : tensor<16x32xf16, #AL> -> tensor<16x32xf16, #BL>
-  // CHECK-NEXT: offset = 0, size = 256
+  // CHECK-NEXT: offset = 512, size = 256
   %cst_4 = triton_gpu.local_alloc : () -> !tt.memdesc<4x32xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 256, size = 64
+  // CHECK-NEXT: offset = 768, size = 64
   %cst_5 = triton_gpu.local_alloc : () -> !tt.memdesc<4x8xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   %4 = triton_gpu.local_load %cst_5 : !tt.memdesc<4x8xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<4x8xf16, #AL>
   %5 = triton_gpu.local_load %cst_5 : !tt.memdesc<4x8xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<4x8xf16, #AL>
-  // CHECK-NEXT: offset = 1024, size = 512
+  // CHECK-NEXT: offset = 0, size = 512
   %cst_6 = triton_gpu.local_alloc : () -> !tt.memdesc<8x32xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 1792, size = 128
+  // CHECK-NEXT: offset = 1280, size = 128
   %cst_7 = triton_gpu.local_alloc : () -> !tt.memdesc<2x32xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   %6 = triton_gpu.local_load %cst_0 : !tt.memdesc<4x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<4x4xf16, #AL>
-  // CHECK-NEXT: offset = 1024, size = 512
+  // CHECK-NEXT: offset = 0, size = 512
   %cst_8 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 256, size = 32
+  // CHECK-NEXT: offset = 768, size = 32
   %cst_9 = triton_gpu.local_alloc : () -> !tt.memdesc<4x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 1024, size = 512
+  // CHECK-NEXT: offset = 0, size = 512
   %cst_10 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   %7 = triton_gpu.local_load %cst_1 : !tt.memdesc<16x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<16x4xf16, #AL>
   %8 = triton_gpu.local_load %cst_4 : !tt.memdesc<4x32xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<4x32xf16, #AL>
@@ -225,34 +228,36 @@ tt.func @multi_color(%A : !tt.ptr<f16>) {
   %10 = triton_gpu.local_load %cst_7 : !tt.memdesc<2x32xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<2x32xf16, #AL>
   %cst_12 = arith.constant dense<0.000000e+00> : tensor<4x16xf16, #AL>
   %cst_13 = arith.constant dense<0.000000e+00> : tensor<8x32xf16, #AL>
-  // CHECK-NEXT: size = 1920
+  // CHECK-NEXT: size = 1440
+  // PEAK: multi_color: first-fit = 1920, packed = 1440
   tt.return
 }
 
 // This example triggers graph coloring with multiple rounds
 // CHECK-LABEL: multi_color_multi_rounds
 tt.func @multi_color_multi_rounds(%arg0: !tt.ptr<f16>) {
-  // CHECK: offset = 0, size = 32
+  // CHECK: offset = 9472, size = 32
   %cst = triton_gpu.local_alloc : () -> !tt.memdesc<4x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 1280, size = 128
+  // CHECK-NEXT: offset = 9344, size = 128
   %cst_0 = triton_gpu.local_alloc : () -> !tt.memdesc<16x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 2048, size = 8192
+  // CHECK-NEXT: offset = 0, size = 8192
   %cst_1 = triton_gpu.local_alloc : () -> !tt.memdesc<1024x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   %cst_2 = arith.constant dense<0.000000e+00> : tensor<16x32xf16, #AL>
-  // CHECK-NEXT: scratch offset = 128, size = 1152
+  // CHECK-NEXT: scratch offset = 8192, size = 1152
   %0 = triton_gpu.convert_layout %cst_2 : tensor<16x32xf16, #AL> -> tensor<16x32xf16, #BL>
   %1 = triton_gpu.local_load %cst : !tt.memdesc<4x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<4x4xf16, #AL>
-  // CHECK-NEXT: offset = 1152, size = 128
+  // CHECK-NEXT: offset = 8704, size = 128
   %cst_3 = triton_gpu.local_alloc : () -> !tt.memdesc<2x32xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   %2 = triton_gpu.local_load %cst : !tt.memdesc<4x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<4x4xf16, #AL>
-  // CHECK-NEXT: offset = 0, size = 512
+  // CHECK-NEXT: offset = 8192, size = 512
   %cst_4 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   %3 = triton_gpu.local_load %cst_0 : !tt.memdesc<16x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<16x4xf16, #AL>
   %4 = triton_gpu.local_load %cst_1 : !tt.memdesc<1024x4xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<1024x4xf16, #AL>
   // CHECK-NEXT: scratch offset = 0, size = 1152
   %5 = triton_gpu.convert_layout %cst_2 : tensor<16x32xf16, #AL> -> tensor<16x32xf16, #BL>
   %6 = triton_gpu.local_load %cst_3 : !tt.memdesc<2x32xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<2x32xf16, #AL>
-  // CHECK-NEXT: size = 10240
+  // CHECK-NEXT: size = 9504
+  // PEAK: multi_color_multi_rounds: first-fit = 10240, packed = 9504
   tt.return
 }
 
@@ -341,59 +346,61 @@ tt.func @atomic_scalar_no_use(%arg3: !tt.ptr<i32>) {
 // Memory used by B1 can be reused by B0.
 // CHECK-LABEL: if
 tt.func @if(%i1 : i1) {
-  // CHECK: offset = 0, size = 512
+  // CHECK: offset = 1024, size = 512
   %cst0 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 1024, size = 512
+  // CHECK-NEXT: offset = 2048, size = 512
   %cst1 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   scf.if %i1 {
-    // CHECK-NEXT: offset = 2048, size = 1024
+    // CHECK-NEXT: offset = 0, size = 1024
     %a = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-    // CHECK-NEXT: offset = 2048, size = 1024
+    // CHECK-NEXT: offset = 0, size = 1024
     %b = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
     triton_gpu.local_dealloc %cst0 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
     triton_gpu.local_dealloc %cst1 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   }
-  // CHECK-NEXT: offset = 0, size = 512
-  %cst2 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   // CHECK-NEXT: offset = 1024, size = 512
+  %cst2 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+  // CHECK-NEXT: offset = 2048, size = 512
   %cst3 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 2048, size = 1024
+  // CHECK-NEXT: offset = 0, size = 1024
   %a = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   triton_gpu.local_dealloc %cst2 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   triton_gpu.local_dealloc %cst3 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   tt.return
-  // CHECK-NEXT: size = 3072
+  // CHECK-NEXT: size = 2560
+  // PEAK: if: first-fit = 3072, packed = 2560
 }
 
 // B0 -> (B1) -> (B2) -> B0
 // Memory used by B0 cannot be reused by B1 or B2.
 // CHECK-LABEL: if_else
 tt.func @if_else(%i1 : i1) {
-  // CHECK: offset = 0, size = 512
+  // CHECK: offset = 1024, size = 512
   %cst0 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-  // CHECK-NEXT: offset = 1024, size = 512
+  // CHECK-NEXT: offset = 2048, size = 512
   %cst1 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   scf.if %i1 {
-    // CHECK-NEXT: offset = 2048, size = 1024
+    // CHECK-NEXT: offset = 0, size = 1024
     %a = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-    // CHECK-NEXT: offset = 2048, size = 1024
+    // CHECK-NEXT: offset = 0, size = 1024
     %b = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   } else {
-    // CHECK-NEXT: offset = 2048, size = 512
-    %cst2 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
     // CHECK-NEXT: offset = 3072, size = 512
+    %cst2 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+    // CHECK-NEXT: offset = 4096, size = 512
     %cst3 = triton_gpu.local_alloc : () -> !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
-    // CHECK-NEXT: offset = 4096, size = 1024
+    // CHECK-NEXT: offset = 0, size = 1024
     %a = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
     triton_gpu.local_dealloc %cst2 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
     triton_gpu.local_dealloc %cst3 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   }
-  // CHECK-NEXT: offset = 2048, size = 1024
+  // CHECK-NEXT: offset = 0, size = 1024
   %a = triton_gpu.local_alloc : () -> !tt.memdesc<32x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   triton_gpu.local_dealloc %cst0 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   triton_gpu.local_dealloc %cst1 : !tt.memdesc<1x16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
   tt.return
-  // CHECK-NEXT: size = 5120
+  // CHECK-NEXT: size = 4608
+  // PEAK: if_else: first-fit = 5120, packed = 4608
 }
 
 // Block arguments and yields are memory aliases that do not trigger a new
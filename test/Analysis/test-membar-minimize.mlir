@@ -0,0 +1,127 @@
+// RUN: triton-opt %s -split-input-file --mlir-disable-threading --convert-scf-to-cf --allocate-shared-memory -test-print-membar="minimize-barriers=true" 2>&1 | FileCheck %s
+// RUN: triton-opt %s -split-input-file --mlir-disable-threading --convert-scf-to-cf --allocate-shared-memory -test-print-membar 2>&1 | FileCheck %s --check-prefix=DEFAULT
+
+#AL = #triton_gpu.blocked<{sizePerThread = [1, 4], threadsPerWarp = [4, 8], warpsPerCTA = [4, 1], order = [1, 0]}>
+// Assigns the rows to the same warps as #AL, but not to the same threads
+#AL2 = #triton_gpu.blocked<{sizePerThread = [1, 2], threadsPerWarp = [4, 8], warpsPerCTA = [4, 1], order = [1, 0]}>
+#BL = #triton_gpu.blocked<{sizePerThread = [1, 4], threadsPerWarp = [1, 32], warpsPerCTA = [4, 1], order = [1, 0]}>
+#A_SHARED = #triton_gpu.shared<{vec = 2, perPhase = 2, maxPhase = 4, order = [1, 0]}>
+
+module attributes {"triton_gpu.num-warps" = 4 : i32, "triton_gpu.num-ctas" = 1 : i32} {
+
+// The write before the loop is synced once, before entering the loop, instead
+// of in every iteration
+// CHECK-LABEL: hoist_out_of_loop
+// CHECK: triton_gpu.local_alloc
+// CHECK-NEXT: gpu.barrier
+// CHECK-NEXT: cf.br
+// CHECK-NOT: gpu.barrier
+// CHECK: tt.return
+// DEFAULT-LABEL: hoist_out_of_loop
+// DEFAULT: cf.br
+// DEFAULT: gpu.barrier
+// DEFAULT-NEXT: triton_gpu.local_load
+tt.func @hoist_out_of_loop(%lb : index, %ub : index, %step : index) {
+  %cst = arith.constant dense<0.000000e+00> : tensor<16x16xf16, #AL>
+  %a = triton_gpu.local_alloc %cst : (tensor<16x16xf16, #AL>) -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory>
+  scf.for %iv = %lb to %ub step %step {
+    %0 = triton_gpu.local_load %a : !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory> -> tensor<16x16xf16, #BL>
+  }
+  tt.return
+}
+
+// The hazards carried by the loop cannot be hoisted out of it
+// CHECK-LABEL: loop_carried
+// CHECK: gpu.barrier
+// CHECK-NEXT: triton_gpu.local_load
+// CHECK-NEXT: gpu.barrier
+// CHECK-NEXT: triton_gpu.local_store
+// CHECK-NOT: gpu.barrier
+// CHECK: tt.return
+tt.func @loop_carried(%lb : index, %ub : index, %step : index) {
+  %cst = arith.constant dense<0.000000e+00> : tensor<16x16xf16, #BL>
+  %a = triton_gpu.local_alloc : () -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+  scf.for %iv = %lb to %ub step %step {
+    %0 = triton_gpu.local_load %a : !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<16x16xf16, #AL>
+    triton_gpu.local_store %cst, %a : tensor<16x16xf16, #BL> -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+  }
+  tt.return
+}
+
+// The same hazards only need warp barriers when every element is accessed by
+// the same warp
+// CHECK-LABEL: loop_carried_warp_local
+// CHECK: gpu.barrier {warp_sync}
+// CHECK-NEXT: triton_gpu.local_load
+// CHECK-NEXT: gpu.barrier {warp_sync}
+// CHECK-NEXT: triton_gpu.local_store
+// CHECK-NOT: gpu.barrier
+// CHECK: tt.return
+tt.func @loop_carried_warp_local(%lb : index, %ub : index, %step : index) {
+  %cst = arith.constant dense<0.000000e+00> : tensor<16x16xf16, #AL2>
+  %a = triton_gpu.local_alloc : () -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+  scf.for %iv = %lb to %ub step %step {
+    %0 = triton_gpu.local_load %a : !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<16x16xf16, #AL>
+    triton_gpu.local_store %cst, %a : tensor<16x16xf16, #AL2> -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+  }
+  tt.return
+}
+
+// CHECK-LABEL: warp_local
+// CHECK: triton_gpu.local_alloc
+// CHECK-NEXT: gpu.barrier {warp_sync}
+// CHECK-NEXT: triton_gpu.local_load
+// DEFAULT-LABEL: warp_local
+// DEFAULT: triton_gpu.local_alloc
+// DEFAULT-NEXT: gpu.barrier{{$}}
+// DEFAULT-NEXT: triton_gpu.local_load
+tt.func @warp_local() {
+  %cst = arith.constant dense<0.000000e+00> : tensor<16x16xf16, #AL>
+  %a = triton_gpu.local_alloc %cst : (tensor<16x16xf16, #AL>) -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory>
+  %0 = triton_gpu.local_load %a : !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory> -> tensor<16x16xf16, #AL2>
+  tt.return
+}
+
+// CHECK-LABEL: not_warp_local
+// CHECK: triton_gpu.local_alloc
+// CHECK-NEXT: gpu.barrier{{$}}
+// CHECK-NEXT: triton_gpu.local_load
+tt.func @not_warp_local() {
+  %cst = arith.constant dense<0.000000e+00> : tensor<16x16xf16, #AL>
+  %a = triton_gpu.local_alloc %cst : (tensor<16x16xf16, #AL>) -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory>
+  %0 = triton_gpu.local_load %a : !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory> -> tensor<16x16xf16, #BL>
+  tt.return
+}
+
+// CHECK-LABEL: async_wait_no_access
+// CHECK-NOT: gpu.barrier
+// CHECK: tt.return
+// DEFAULT-LABEL: async_wait_no_access
+// DEFAULT: triton_gpu.async_wait
+// DEFAULT-NEXT: gpu.barrier
+tt.func @async_wait_no_access() {
+  triton_gpu.async_wait {num = 0 : i32}
+  tt.return
+}
+
+// A barrier before the wait does not make the writes of the copy visible
+// CHECK-LABEL: async_copy_barrier_before_wait
+// CHECK: triton_gpu.async_copy_global_to_local
+// CHECK-NEXT: gpu.barrier
+// CHECK-NEXT: triton_gpu.local_load
+// CHECK: triton_gpu.async_wait
+// CHECK-NEXT: gpu.barrier
+// CHECK-NEXT: triton_gpu.local_load
+tt.func @async_copy_barrier_before_wait(%ptr : tensor<16x16x!tt.ptr<f16>, #AL>) {
+  %cst = arith.constant dense<0.000000e+00> : tensor<16x16xf16, #AL>
+  %a = triton_gpu.local_alloc : () -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+  %b = triton_gpu.local_alloc %cst : (tensor<16x16xf16, #AL>) -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory>
+  %token = triton_gpu.async_copy_global_to_local %ptr, %a : tensor<16x16x!tt.ptr<f16>, #AL> -> !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable>
+  %0 = triton_gpu.local_load %b : !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory> -> tensor<16x16xf16, #BL>
+  %group = triton_gpu.async_commit_group %token
+  %1 = triton_gpu.async_wait %group {num = 0 : i32}
+  %2 = triton_gpu.local_load %a : !tt.memdesc<16x16xf16, #A_SHARED, #triton_gpu.shared_memory, mutable> -> tensor<16x16xf16, #AL>
+  tt.return
+}
+
+}
@@ -0,0 +1,104 @@
+// RUN: triton-opt %s -test-print-range -split-input-file -o %t 2>&1 | FileCheck %s
+
+// CHECK-LABEL: @make_range
+tt.func @make_range() {
+  // CHECK: tt.make_range {{.*}} => range = [0, 127]
+  %0 = tt.make_range {end = 128 : i32, start = 0 : i32} : tensor<128xi32>
+  // CHECK-NEXT: tt.expand_dims {{.*}} => range = [0, 127]
+  %1 = tt.expand_dims %0 {axis = 1 : i32} : tensor<128xi32> -> tensor<128x1xi32>
+  // CHECK-NEXT: tt.broadcast {{.*}} => range = [0, 127]
+  %2 = tt.broadcast %1 : tensor<128x1xi32> -> tensor<128x64xi32>
+  // CHECK-NEXT: tt.make_range {{.*}} => range = [64, 191]
+  %3 = tt.make_range {end = 192 : i32, start = 64 : i32} : tensor<128xi32>
+  // CHECK-NEXT: tt.cat {{.*}} => range = [0, 191]
+  %4 = tt.cat %0, %3 : tensor<128xi32> -> tensor<256xi32>
+  tt.return
+}
+
+// -----
+
+// CHECK-LABEL: @program_id
+tt.func @program_id() {
+  // CHECK: tt.get_program_id {{.*}} => range = [0, 2147483647]
+  %0 = tt.get_program_id x : i32
+  // CHECK-NEXT: tt.get_num_programs {{.*}} => range = [1, 2147483647]
+  %1 = tt.get_num_programs y : i32
+  // CHECK-NEXT: arith.extsi {{.*}} => range = [0, 2147483647]
+  %2 = arith.extsi %0 : i32 to i64
+  // CHECK-NEXT: arith.constant {{.*}} => range = [128, 128]
+  %c128 = arith.constant 128 : i64
+  // CHECK-NEXT: arith.muli {{.*}} => range = [0, 274877906816]
+  %3 = arith.muli %2, %c128 : i64
+  // CHECK-NEXT: tt.make_range {{.*}} => range = [0, 127]
+  %4 = tt.make_range {end = 128 : i32, start = 0 : i32} : tensor<128xi32>
+  // CHECK-NEXT: arith.extsi {{.*}} => range = [0, 127]
+  %5 = arith.extsi %4 : tensor<128xi32> to tensor<128xi64>
+  // CHECK-NEXT: tt.splat {{.*}} => range = [0, 274877906816]
+  %6 = tt.splat %3 : i64 -> tensor<128xi64>
+  // CHECK-NEXT: arith.addi {{.*}} => range = [0, 274877906943]
+  %7 = arith.addi %6, %5 : tensor<128xi64>
+  tt.return
+}
+
+// -----
+
+// CHECK-LABEL: @assume
+tt.func @assume(%arg0: i64, %arg1: i64) {
+  %c0 = arith.constant 0 : i64
+  %c64 = arith.constant 64 : i64
+  %c4096 = arith.constant 4096 : i64
+  %0 = arith.cmpi sge, %arg0, %c0 : i64
+  llvm.intr.assume %0 : i1
+  %1 = arith.cmpi sgt, %c4096, %arg0 : i64
+  llvm.intr.assume %1 : i1
+  // CHECK: arith.muli %arg0, {{.*}} => range = [0, 262080]
+  %2 = arith.muli %arg0, %c64 : i64
+  // CHECK: arith.muli %arg1, {{.*}} => range = [-9223372036854775808, 9223372036854775807]
+  %3 = arith.muli %arg1, %c64 : i64
+  tt.return
+}
+
+// -----
+
+// CHECK-LABEL: @assume_result
+tt.func @assume_result(%arg0: i64) {
+  %c4096 = arith.constant 4096 : i64
+  // CHECK: arith.remsi {{.*}} => range = [0, 4095]
+  %0 = arith.remsi %arg0, %c4096 : i64
+  %c0 = arith.constant 0 : i64
+  %1 = arith.cmpi sge, %0, %c0 : i64
+  llvm.intr.assume %1 : i1
+  // CHECK: arith.addi {{.*}} => range = [0, 8190]
+  %2 = arith.addi %0, %0 : i64
+  tt.return
+}
+
+// -----
+
+// The assume does not bound the value outside of the branch
+// CHECK-LABEL: @assume_in_branch
+tt.func @assume_in_branch(%arg0: i64, %cond: i1) {
+  %c0 = arith.constant 0 : i64
+  %c64 = arith.constant 64 : i64
+  scf.if %cond {
+    %0 = arith.cmpi sge, %arg0, %c0 : i64
+    llvm.intr.assume %0 : i1
+  }
+  // CHECK: arith.muli {{.*}} => range = [-9223372036854775808, 9223372036854775807]
+  %1 = arith.muli %arg0, %c64 : i64
+  tt.return
+}
+
+// -----
+
+// CHECK-LABEL: @loop_bounds
+tt.func @loop_bounds() {
+  %c0 = arith.constant 0 : i32
+  %c16 = arith.constant 16 : i32
+  %c128 = arith.constant 128 : i32
+  scf.for %iv = %c0 to %c128 step %c16 : i32 {
+    // CHECK: arith.extsi {{.*}} => range = [0, 127]
+    %0 = arith.extsi %iv : i32 to i64
+  }
+  tt.return
+}
@@ -0,0 +1,111 @@
+// RUN: triton-opt %s -split-input-file -tritongpu-narrow-int-arithmetic | FileCheck %s
+
+#blocked = #triton_gpu.blocked<{sizePerThread = [1], threadsPerWarp = [32], warpsPerCTA = [4], order = [0]}>
+module attributes {"triton_gpu.num-ctas" = 1 : i32, "triton_gpu.num-warps" = 4 : i32, "triton_gpu.threads-per-warp" = 32 : i32} {
+// CHECK-LABEL: @narrow_offsets
+// CHECK: %[[PID:.*]] = tt.get_program_id x : i32
+// CHECK: %[[MUL:.*]] = arith.muli %[[PID]], %{{.*}} : i32
+// CHECK: %[[SPLAT:.*]] = tt.splat %[[MUL]] : i32 -> tensor<128xi32, #blocked>
+// CHECK: %[[RANGE:.*]] = tt.make_range
+// CHECK: %[[ADD:.*]] = arith.addi %[[SPLAT]], %[[RANGE]] : tensor<128xi32, #blocked>
+// CHECK: tt.addptr %{{.*}}, %[[ADD]] : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi32, #blocked>
+// CHECK-NOT: i64
+// CHECK: tt.return
+tt.func @narrow_offsets(%arg0: !tt.ptr<f32>) {
+  %c1024_i32 = arith.constant 1024 : i32
+  %c128_i64 = arith.constant 128 : i64
+  %pid = tt.get_program_id x : i32
+  %cmp = arith.cmpi slt, %pid, %c1024_i32 : i32
+  llvm.intr.assume %cmp : i1
+  %0 = arith.extsi %pid : i32 to i64
+  %1 = arith.muli %0, %c128_i64 : i64
+  %2 = tt.splat %1 : i64 -> tensor<128xi64, #blocked>
+  %3 = tt.make_range {end = 128 : i32, start = 0 : i32} : tensor<128xi32, #blocked>
+  %4 = arith.extsi %3 : tensor<128xi32, #blocked> to tensor<128xi64, #blocked>
+  %5 = arith.addi %2, %4 : tensor<128xi64, #blocked>
+  %6 = tt.splat %arg0 : !tt.ptr<f32> -> tensor<128x!tt.ptr<f32>, #blocked>
+  %7 = tt.addptr %6, %5 : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi64, #blocked>
+  %8 = tt.load %7 : tensor<128x!tt.ptr<f32>, #blocked>
+  tt.store %7, %8 : tensor<128x!tt.ptr<f32>, #blocked>
+  tt.return
+}
+}
+
+// -----
+
+#blocked = #triton_gpu.blocked<{sizePerThread = [1], threadsPerWarp = [32], warpsPerCTA = [4], order = [0]}>
+module attributes {"triton_gpu.num-ctas" = 1 : i32, "triton_gpu.num-warps" = 4 : i32, "triton_gpu.threads-per-warp" = 32 : i32} {
+// The offsets of large programs may not fit in 32 bits
+// CHECK-LABEL: @keep_unbounded
+// CHECK: arith.muli %{{.*}}, %{{.*}} : i64
+// CHECK: arith.addi %{{.*}}, %{{.*}} : tensor<128xi64, #blocked>
+// CHECK: tt.addptr %{{.*}}, %{{.*}} : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi64, #blocked>
+tt.func @keep_unbounded(%arg0: !tt.ptr<f32>) {
+  %c128_i64 = arith.constant 128 : i64
+  %pid = tt.get_program_id x : i32
+  %0 = arith.extsi %pid : i32 to i64
+  %1 = arith.muli %0, %c128_i64 : i64
+  %2 = tt.splat %1 : i64 -> tensor<128xi64, #blocked>
+  %3 = tt.make_range {end = 128 : i32, start = 0 : i32} : tensor<128xi32, #blocked>
+  %4 = arith.extsi %3 : tensor<128xi32, #blocked> to tensor<128xi64, #blocked>
+  %5 = arith.addi %2, %4 : tensor<128xi64, #blocked>
+  %6 = tt.splat %arg0 : !tt.ptr<f32> -> tensor<128x!tt.ptr<f32>, #blocked>
+  %7 = tt.addptr %6, %5 : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi64, #blocked>
+  %8 = tt.load %7 : tensor<128x!tt.ptr<f32>, #blocked>
+  tt.store %7, %8 : tensor<128x!tt.ptr<f32>, #blocked>
+  tt.return
+}
+}
+
+// -----
+
+#blocked = #triton_gpu.blocked<{sizePerThread = [1], threadsPerWarp = [32], warpsPerCTA = [4], order = [0]}>
+module attributes {"triton_gpu.num-ctas" = 1 : i32, "triton_gpu.num-warps" = 4 : i32, "triton_gpu.threads-per-warp" = 32 : i32} {
+// CHECK-LABEL: @narrow_mask
+// CHECK: %[[RANGE:.*]] = tt.make_range
+// CHECK: %[[N:.*]] = tt.splat %{{.*}} : i32 -> tensor<128xi32, #blocked>
+// CHECK: %[[MASK:.*]] = arith.cmpi slt, %[[RANGE]], %[[N]] : tensor<128xi32, #blocked>
+// CHECK: %[[PTR:.*]] = tt.addptr %{{.*}}, %[[RANGE]] : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi32, #blocked>
+// CHECK: tt.load %[[PTR]], %[[MASK]]
+tt.func @narrow_mask(%arg0: !tt.ptr<f32>, %n: i64) {
+  %c0_i64 = arith.constant 0 : i64
+  %c1048576_i64 = arith.constant 1048576 : i64
+  %cmp0 = arith.cmpi sge, %n, %c0_i64 : i64
+  llvm.intr.assume %cmp0 : i1
+  %cmp1 = arith.cmpi sle, %n, %c1048576_i64 : i64
+  llvm.intr.assume %cmp1 : i1
+  %0 = tt.make_range {end = 128 : i32, start = 0 : i32} : tensor<128xi32, #blocked>
+  %1 = arith.extsi %0 : tensor<128xi32, #blocked> to tensor<128xi64, #blocked>
+  %2 = tt.splat %n : i64 -> tensor<128xi64, #blocked>
+  %3 = arith.cmpi slt, %1, %2 : tensor<128xi64, #blocked>
+  %4 = tt.splat %arg0 : !tt.ptr<f32> -> tensor<128x!tt.ptr<f32>, #blocked>
+  %5 = tt.addptr %4, %1 : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi64, #blocked>
+  %6 = tt.load %5, %3 : tensor<128x!tt.ptr<f32>, #blocked>
+  tt.store %5, %6 : tensor<128x!tt.ptr<f32>, #blocked>
+  tt.return
+}
+}
+
+// -----
+
+#blocked = #triton_gpu.blocked<{sizePerThread = [1], threadsPerWarp = [32], warpsPerCTA = [4], order = [0]}>
+module attributes {"triton_gpu.num-ctas" = 1 : i32, "triton_gpu.num-warps" = 4 : i32, "triton_gpu.threads-per-warp" = 32 : i32} {
+// Extensions of i32 offsets already in the input are dropped as well, but not
+// those of narrower types
+// CHECK-LABEL: @addptr_of_extsi
+// CHECK-SAME: %[[OFFS32:[^:]*]]: tensor<128xi32, #blocked>, %[[OFFS16:[^:]*]]: tensor<128xi16, #blocked>
+// CHECK-NOT: arith.extsi %[[OFFS32]]
+// CHECK: tt.addptr %{{.*}}, %[[OFFS32]] : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi32, #blocked>
+// CHECK: %[[EXT16:.*]] = arith.extsi %[[OFFS16]] : tensor<128xi16, #blocked> to tensor<128xi64, #blocked>
+// CHECK: tt.addptr %{{.*}}, %[[EXT16]] : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi64, #blocked>
+tt.func @addptr_of_extsi(%arg0: !tt.ptr<f32>, %offs32: tensor<128xi32, #blocked>, %offs16: tensor<128xi16, #blocked>) {
+  %0 = tt.splat %arg0 : !tt.ptr<f32> -> tensor<128x!tt.ptr<f32>, #blocked>
+  %1 = arith.extsi %offs32 : tensor<128xi32, #blocked> to tensor<128xi64, #blocked>
+  %2 = tt.addptr %0, %1 : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi64, #blocked>
+  %3 = tt.load %2 : tensor<128x!tt.ptr<f32>, #blocked>
+  %4 = arith.extsi %offs16 : tensor<128xi16, #blocked> to tensor<128xi64, #blocked>
+  %5 = tt.addptr %0, %4 : tensor<128x!tt.ptr<f32>, #blocked>, tensor<128xi64, #blocked>
+  tt.store %5, %3 : tensor<128x!tt.ptr<f32>, #blocked>
+  tt.return
+}
+}
@@ -50,10 +50,38 @@ struct TestAllocationPass
   }
 };
 
+struct TestAllocationPeakPass
+    : public PassWrapper<TestAllocationPeakPass, OperationPass<ModuleOp>> {
+
+  MLIR_DEFINE_EXPLICIT_INTERNAL_INLINE_TYPE_ID(TestAllocationPeakPass);
+
+  StringRef getArgument() const final { return "test-print-allocation-peak"; }
+  StringRef getDescription() const final {
+    return "print the shared memory size of the first-fit and the packed "
+           "allocation";
+  }
+
+  void runOnOperation() override {
+    auto &os = llvm::errs();
+    ModuleOp moduleOp = getOperation();
+    ModuleAllocation moduleAllocation(moduleOp);
+    moduleOp.walk([&](triton::FuncOp funcOp) {
+      auto opName = SymbolTable::getSymbolName(funcOp).getValue().str();
+      auto *allocation = moduleAllocation.getFuncData(funcOp);
+      os << opName
+         << ": first-fit = " << allocation->getFirstFitSharedMemorySize()
+         << ", packed = " << allocation->getSharedMemorySize() << "\n";
+    });
+  }
+};
+
 } // namespace
 
 namespace mlir {
 namespace test {
-void registerTestAllocationPass() { PassRegistration<TestAllocationPass>(); }
+void registerTestAllocationPass() {
+  PassRegistration<TestAllocationPass>();
+  PassRegistration<TestAllocationPeakPass>();
+}
 } // namespace test
 } // namespace mlir
@@ -1,10 +1,17 @@
 #include "mlir/Conversion/SCFToControlFlow/SCFToControlFlow.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/ControlFlow/IR/ControlFlowOps.h"
 #include "mlir/Dialect/GPU/IR/GPUDialect.h"
 #include "mlir/IR/Dialect.h"
+#include "mlir/Parser/Parser.h"
 #include "mlir/Pass/Pass.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "triton/Analysis/Allocation.h"
 #include "triton/Analysis/Membar.h"
+#include "triton/Dialect/Triton/IR/Dialect.h"
+#include "triton/Dialect/TritonGPU/IR/Dialect.h"
+
+#include <chrono>
 
 using namespace mlir;
 
@@ -15,6 +22,9 @@ struct TestMembarPass
 
   MLIR_DEFINE_EXPLICIT_INTERNAL_INLINE_TYPE_ID(TestMembarPass);
 
+  TestMembarPass() = default;
+  TestMembarPass(const TestMembarPass &other) : PassWrapper(other) {}
+
   StringRef getArgument() const final { return "test-print-membar"; }
   StringRef getDescription() const final {
     return "print the result of the allocation pass";
@@ -25,15 +35,95 @@ struct TestMembarPass
     ModuleOp moduleOp = cast<ModuleOp>(operation);
     // Print all ops after membar pass
     ModuleAllocation allocation(moduleOp);
-    ModuleMembarAnalysis membarPass(&allocation);
+    ModuleMembarAnalysis membarPass(&allocation, minimizeBarriers);
     membarPass.run();
   }
+
+  Option<bool> minimizeBarriers{
+      *this, "minimize-barriers",
+      llvm::cl::desc("place the barriers to run as rarely as possible"),
+      llvm::cl::init(false)};
+};
+
+// Builds a kernel whose loop body loads from `numBuffers` shared memory
+// buffers in turn for `numSteps` steps, storing to one of them every eighth
+// step, like a long unrolled or pipelined kernel.
+std::string getLargeKernel(int numSteps, int numBuffers) {
+  std::string src = R"(
+#AL = #triton_gpu.blocked<{sizePerThread = [1, 4], threadsPerWarp = [4, 8], warpsPerCTA = [4, 1], order = [1, 0]}>
+#A_SHARED = #triton_gpu.shared<{vec = 2, perPhase = 2, maxPhase = 4, order = [1, 0]}>
+module attributes {"triton_gpu.num-warps" = 4 : i32, "triton_gpu.num-ctas" = 1 : i32, "triton_gpu.threads-per-warp" = 32 : i32} {
+tt.func @large_kernel(%cond : i1) {
+  %cst = arith.constant dense<0.000000e+00> : tensor<16x16xf16, #AL>
+)";
+  const std::string tensorTy = "tensor<16x16xf16, #AL>";
+  const std::string memDescTy = "!tt.memdesc<16x16xf16, #A_SHARED, "
+                                "#triton_gpu.shared_memory, mutable>";
+  for (int i = 0; i < numBuffers; ++i)
+    src += "  %a" + std::to_string(i) +
+           " = triton_gpu.local_alloc : () -> " + memDescTy + "\n";
+  src += "  cf.br ^bb1\n^bb1:\n";
+  for (int step = 0; step < numSteps; ++step) {
+    src += "  %l" + std::to_string(step) + " = triton_gpu.local_load %a" +
+           std::to_string(step % numBuffers) + " : " + memDescTy + " -> " +
+           tensorTy + "\n";
+    if (step % 8 == 7)
+      src += "  triton_gpu.local_store %cst, %a" +
+             std::to_string(step * 7 % numBuffers) + " : " + tensorTy +
+             " -> " + memDescTy + "\n";
+  }
+  src += "  cf.cond_br %cond, ^bb1, ^bb2\n^bb2:\n  tt.return\n}\n}\n";
+  return src;
+}
+
+// Timings are machine dependent, so this pass is not part of the lit suite;
+// run it by hand with `triton-opt -test-membar-benchmark` on an empty module.
+struct TestMembarBenchmarkPass
+    : public PassWrapper<TestMembarBenchmarkPass, OperationPass<ModuleOp>> {
+
+  MLIR_DEFINE_EXPLICIT_INTERNAL_INLINE_TYPE_ID(TestMembarBenchmarkPass);
+
+  StringRef getArgument() const final { return "test-membar-benchmark"; }
+  StringRef getDescription() const final {
+    return "time the membar analysis on large generated kernels";
+  }
+
+  void getDependentDialects(DialectRegistry &registry) const override {
+    registry.insert<arith::ArithDialect, cf::ControlFlowDialect,
+                    gpu::GPUDialect, triton::TritonDialect,
+                    triton::gpu::TritonGPUDialect>();
+  }
+
+  void runOnOperation() override {
+    auto &os = llvm::errs();
+    const int numBuffers = 256;
+    for (int numSteps : {1024, 4096}) {
+      auto moduleOp = parseSourceString<ModuleOp>(
+          getLargeKernel(numSteps, numBuffers), ParserConfig(&getContext()));
+      if (!moduleOp)
+        return signalPassFailure();
+      ModuleAllocation allocation(*moduleOp);
+      ModuleMembarAnalysis membarPass(&allocation);
+      auto start = std::chrono::steady_clock::now();
+      membarPass.run();
+      auto elapsed = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+      int numBarriers = 0;
+      moduleOp->walk([&](gpu::BarrierOp) { ++numBarriers; });
+      os << "membar benchmark: " << numSteps << " steps, " << numBarriers
+         << " barriers, " << elapsed << " ms\n";
+    }
+  }
 };
 
 } // namespace
 
 namespace mlir {
 namespace test {
-void registerTestMembarPass() { PassRegistration<TestMembarPass>(); }
+void registerTestMembarPass() {
+  PassRegistration<TestMembarPass>();
+  PassRegistration<TestMembarBenchmarkPass>();
+}
 } // namespace test
 } // namespace mlir
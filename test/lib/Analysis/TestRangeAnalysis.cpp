@@ -0,0 +1,55 @@
+#include "mlir/Pass/Pass.h"
+#include "triton/Analysis/RangeAnalysis.h"
+#include "triton/Analysis/Utility.h"
+
+using namespace mlir;
+using namespace mlir::triton;
+
+namespace {
+
+struct TestRangeAnalysisPass
+    : public PassWrapper<TestRangeAnalysisPass, OperationPass<ModuleOp>> {
+
+  MLIR_DEFINE_EXPLICIT_INTERNAL_INLINE_TYPE_ID(TestRangeAnalysisPass);
+
+  StringRef getArgument() const final { return "test-print-range"; }
+  StringRef getDescription() const final {
+    return "print the result of the integer range analysis pass";
+  }
+
+  void runOnOperation() override {
+    ModuleOp moduleOp = getOperation();
+    moduleOp.walk([&](FuncOp funcOp) {
+      std::unique_ptr<DataFlowSolver> solver = createDataFlowSolver();
+      solver->load<TritonIntegerRangeAnalysis>(funcOp);
+      if (failed(solver->initializeAndRun(funcOp)))
+        return signalPassFailure();
+      auto &os = llvm::errs();
+      auto opName = SymbolTable::getSymbolName(funcOp).getValue().str();
+      os << "@" << opName << "\n";
+      funcOp.walk([&](Operation *op) {
+        for (Value result : op->getResults()) {
+          auto range = getIntegerRange(*solver, result);
+          if (!range)
+            continue;
+          result.print(os);
+          os << " => range = [";
+          range->smin().print(os, /*isSigned=*/true);
+          os << ", ";
+          range->smax().print(os, /*isSigned=*/true);
+          os << "]\n";
+        }
+      });
+    });
+  }
+};
+
+} // namespace
+
+namespace mlir {
+namespace test {
+void registerTestRangeAnalysisPass() {
+  PassRegistration<TestRangeAnalysisPass>();
+}
+} // namespace test
+} // namespace mlir
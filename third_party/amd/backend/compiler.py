@@ -142,6 +142,8 @@ class HIPBackend(BaseBackend):
         pm.run(mod)
         pm = ir.pass_manager(mod.context)
         pm.enable_debug()
+        if os.environ.get("TRITON_NARROW_INT_ARITHMETIC", "0") == "1":
+            passes.ttgpuir.add_narrow_int_arithmetic(pm)
         passes.ttgpuir.add_coalesce(pm)
         passes.ttgpuir.add_remove_layout_conversions(pm)
         passes.ttgpuir.add_optimize_thread_locality(pm)
@@ -190,6 +190,8 @@ class CUDABackend(BaseBackend):
         pm.enable_debug()
         passes.ttir.add_convert_to_ttgpuir(pm, f"cuda:{capability}", opt.num_warps, 32, opt.num_ctas)
         # optimize TTGIR
+        if os.environ.get("TRITON_NARROW_INT_ARITHMETIC", "0") == "1":
+            passes.ttgpuir.add_narrow_int_arithmetic(pm)
         passes.ttgpuir.add_coalesce(pm)
         if capability // 10 >= 8:
             passes.ttgpuir.add_f32_dot_tc(pm)
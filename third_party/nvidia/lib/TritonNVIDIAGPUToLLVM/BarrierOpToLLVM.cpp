@@ -25,6 +25,7 @@
 #include "TritonNVIDIAGPUToLLVM/PTXAsmFormat.h"
 #include "mlir/Conversion/LLVMCommon/Pattern.h"
 #include "mlir/Dialect/GPU/IR/GPUDialect.h"
+#include "triton/Analysis/Membar.h"
 #include "triton/Conversion/TritonGPUToLLVM/Utility.h"
 
 #include "Utility.h"
@@ -41,6 +42,15 @@ struct BarrierOpConversion
   matchAndRewrite(mlir::gpu::BarrierOp op, OpAdaptor adaptor,
                   ConversionPatternRewriter &rewriter) const override {
     Location loc = op->getLoc();
+    if (op->hasAttr(AttrWarpSyncName)) {
+      // Only the threads of each warp share data
+      PTXBuilder ptxBuilder;
+      auto &warpSyncOp = *ptxBuilder.create<>("bar.warp.sync");
+      warpSyncOp(ptxBuilder.newConstantOperand(-1));
+      ptxBuilder.launch(rewriter, loc, void_ty(op->getContext()));
+      rewriter.eraseOp(op);
+      return success();
+    }
     if (op->hasAttr("bar_id")) {
       // llvm.nvvm.barrier0 doesn't support bar_id and num_threads attributes,
       // so we have to lower it to ptx manually.
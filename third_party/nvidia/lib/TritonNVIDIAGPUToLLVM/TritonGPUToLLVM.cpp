@@ -20,6 +20,7 @@
 #include "triton/Dialect/Triton/IR/Dialect.h"
 #include "triton/Dialect/TritonGPU/IR/Dialect.h"
 #include "triton/Dialect/TritonNvidiaGPU/IR/Dialect.h"
+#include "triton/Tools/Sys/GetEnv.hpp"
 
 #include "PatternTritonGPUOpToLLVM.h"
 #include "Utility.h"
@@ -97,7 +98,8 @@ struct ConvertTritonGPUToLLVM
 
     // Allocate shared memory and set barrier
     ModuleAllocation allocation(mod);
-    ModuleMembarAnalysis membarPass(&allocation);
+    ModuleMembarAnalysis membarPass(
+        &allocation, triton::tools::getBoolEnv("TRITON_MINIMIZE_BARRIERS"));
     membarPass.run();
 
     // Lower functions
@@ -14,14 +14,19 @@ void initProton(pybind11::module &&m) {
   using ret = pybind11::return_value_policy;
   using namespace pybind11::literals;
 
-  m.def("start",
-        [](const std::string &path, const std::string &contextSourceName,
-           const std::string &dataName, const std::string &profilerName) {
-          auto sessionId = SessionManager::instance().addSession(
-              path, profilerName, contextSourceName, dataName);
-          SessionManager::instance().activateSession(sessionId);
-          return sessionId;
-        });
+  m.def(
+      "start",
+      [](const std::string &path, const std::string &contextSourceName,
+         const std::string &dataName, const std::string &profilerName,
+         double flushInterval, size_t flushSize, const std::string &sampling) {
+        auto sessionId = SessionManager::instance().addSession(
+            path, profilerName, contextSourceName, dataName, flushInterval,
+            flushSize, sampling);
+        SessionManager::instance().activateSession(sessionId);
+        return sessionId;
+      },
+      "path"_a, "context_source"_a, "data"_a, "profiler"_a,
+      "flush_interval"_a = 0.0, "flush_size"_a = 0, "sampling"_a = "");
 
   m.def("activate", [](size_t sessionId) {
     SessionManager::instance().activateSession(sessionId);
@@ -1,11 +1,14 @@
 #ifndef PROTON_CONTEXT_CONTEXT_H_
 #define PROTON_CONTEXT_CONTEXT_H_
 
+#include "Utility/Singleton.h"
 #include <atomic>
 #include <limits>
 #include <map>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace proton {
@@ -26,12 +29,43 @@ struct Context {
   bool operator>=(const Context &other) const { return !(*this < other); }
 };
 
+/// Interns context names as dense ids, so that contexts can be hashed and
+/// compared as integers. Ids are only reused after clear().
+/// [MT] Thread-safe.
+class ContextInterner : public Singleton<ContextInterner> {
+public:
+  ContextInterner() = default;
+
+  size_t intern(const std::string &name);
+
+  std::string getName(size_t id);
+
+  /// Forgets every name. Only called once no id handed out so far is held
+  /// anymore, i.e. when the last session is finalized.
+  void clear();
+
+  /// Bumped by clear(), so that caches of ids can tell they are stale.
+  size_t getGeneration() const {
+    return generation.load(std::memory_order_acquire);
+  }
+
+private:
+  std::atomic<size_t> generation{0};
+  std::shared_mutex mutex;
+  std::unordered_map<std::string, size_t> ids;
+  // id -> name, pointing into the keys of `ids`
+  std::vector<const std::string *> names;
+};
+
 /// A context source is an object that can provide a list of contexts.
 class ContextSource {
 public:
   ContextSource() = default;
   virtual ~ContextSource() = default;
   virtual std::vector<Context> getContexts() = 0;
+  /// Returns the interned ids of getContexts(). Sources that can identify
+  /// their contexts without building the names should override this.
+  virtual std::vector<size_t> getContextIds();
 };
 
 /// A scope is a context with a unique identifier.
@@ -6,9 +6,13 @@
 namespace proton {
 
 /// Unwind the Python stack and early return a list of contexts.
+/// Frames are cached by code object and instruction, so the context of a
+/// frame is only named the first time it is seen.
 class PythonContextSource : public ContextSource {
 public:
   std::vector<Context> getContexts() override;
+
+  std::vector<size_t> getContextIds() override;
 };
 
 } // namespace proton
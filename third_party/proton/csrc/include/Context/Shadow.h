@@ -14,12 +14,16 @@ public:
 
   std::vector<Context> getContexts() override { return contextStack; }
 
+  std::vector<size_t> getContextIds() override { return contextIdStack; }
+
   void enterScope(const Scope &scope) override;
 
   void exitScope(const Scope &scope) override;
 
 private:
   std::vector<Context> contextStack;
+  // Interned ids of contextStack
+  std::vector<size_t> contextIdStack;
 };
 
 } // namespace proton
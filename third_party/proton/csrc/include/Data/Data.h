@@ -6,11 +6,12 @@
 #include <map>
 #include <memory>
 #include <shared_mutex>
+#include <stdexcept>
 #include <string>
 
 namespace proton {
 
-enum class OutputFormat { Hatchet, Count };
+enum class OutputFormat { Hatchet, ChromeTrace, Binary, Count };
 
 class Data : public ThreadLocalOpInterface {
 public:
@@ -27,6 +28,13 @@ public:
   /// [MT] The implementation must be thread-safe.
   virtual void addMetric(size_t scopeId, std::shared_ptr<Metric> metric) = 0;
 
+  /// Add a single metric to the current context of the data, without keeping
+  /// a scope for it.
+  /// [MT] The implementation must be thread-safe.
+  virtual void addCurrentMetric(std::shared_ptr<Metric> metric) {
+    addMetric(addScope(Scope::getNewScopeId()), metric);
+  }
+
   /// Add multiple metrics to the data.
   /// [MT] The implementation must be thread-safe.
   virtual void addMetrics(size_t scopeId,
@@ -37,14 +45,31 @@ public:
   /// [MT] Thread-safe.
   void dump(OutputFormat outputFormat);
 
+  /// Write the data recorded since the last flush as the next part of a
+  /// streamed profile, and release the memory it no longer needs.
+  /// [MT] Thread-safe.
+  void flush(OutputFormat outputFormat);
+
+  /// An estimate of the memory held by the data in bytes.
+  /// [MT] Thread-safe.
+  virtual size_t getMemoryUsage() const { return 0; }
+
 protected:
   /// The actual implementation of the dump operation.
   /// [MT] Thread-safe.
   virtual void doDump(std::ostream &os, OutputFormat outputFormat) const = 0;
 
+  /// The actual implementation of the flush operation.
+  /// [MT] Thread-safe.
+  virtual void doFlush(std::ostream &os, OutputFormat outputFormat) {
+    throw std::logic_error("Streaming is not supported");
+  }
+
   mutable std::shared_mutex mutex;
   const std::string path{};
   ContextSource *contextSource{};
+  // Number of parts written by flush
+  size_t numParts{};
 };
 
 OutputFormat parseOutputFormat(const std::string &outputFormat);
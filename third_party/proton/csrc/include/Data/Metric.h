@@ -1,13 +1,14 @@
 #ifndef PROTON_DATA_METRIC_H_
 #define PROTON_DATA_METRIC_H_
 
+#include "Utility/Histogram.h"
 #include "Utility/Traits.h"
 #include <variant>
 #include <vector>
 
 namespace proton {
 
-enum class MetricKind { Flexible, Kernel, Count };
+enum class MetricKind { Flexible, Kernel, Host, Count };
 
 using MetricValueType = std::variant<uint64_t, int64_t, double, std::string>;
 
@@ -63,12 +64,18 @@ public:
   }
 
   /// Update all values with another metric.
-  void updateMetric(Metric &other) {
+  virtual void updateMetric(Metric &other) {
     for (int i = 0; i < values.size(); ++i) {
       updateValue(i, other.values[i]);
     }
   }
 
+  /// Returns the distribution of a value over the updates of the metric, or
+  /// nullptr if the metric only keeps the aggregate.
+  virtual const LogHistogram *getDistribution(int valueId) const {
+    return nullptr;
+  }
+
   MetricKind getKind() const { return kind; }
 
 private:
@@ -120,19 +127,34 @@ public:
 
   KernelMetric() : Metric(MetricKind::Kernel, kernelMetricKind::Count) {}
 
+  /// `weight` is the number of launches that a sampled launch stands for, by
+  /// which its aggregable values are scaled.
   KernelMetric(uint64_t startTime, uint64_t endTime, uint64_t invocations,
-               uint64_t deviceId, uint64_t deviceType)
+               uint64_t deviceId, uint64_t deviceType, uint64_t weight = 1)
       : KernelMetric() {
     this->values[StartTime] = startTime;
     this->values[EndTime] = endTime;
-    this->values[Invocations] = invocations;
-    this->values[Duration] = endTime - startTime;
+    this->values[Invocations] = invocations * weight;
+    this->values[Duration] = (endTime - startTime) * weight;
     this->values[DeviceId] = deviceId;
     this->values[DeviceType] = deviceType;
+    durations.record(endTime - startTime, weight);
   }
 
   virtual const std::string getName() const { return "KernelMetric"; }
 
+  void updateMetric(Metric &other) override {
+    Metric::updateMetric(other);
+    if (auto *otherDurations = other.getDistribution(Duration))
+      durations.merge(*otherDurations);
+  }
+
+  /// The durations of the individual launches are kept besides their total,
+  /// so that tail latencies show up.
+  const LogHistogram *getDistribution(int valueId) const override {
+    return valueId == Duration ? &durations : nullptr;
+  }
+
   virtual const std::string getValueName(int valueId) const {
     return VALUE_NAMES[valueId];
   }
@@ -146,6 +168,67 @@ private:
       "StartTime (ns)", "EndTime (ns)", "Count",
       "Time (ns)",      "DeviceId",     "DeviceType",
   };
+
+  LogHistogram durations;
+};
+
+/// A host metric measures the time that the host spends in a scope or an op,
+/// such as compiling or launching a kernel, and optionally the CPU counters of
+/// the thread over that time.
+class HostMetric : public Metric {
+public:
+  enum hostMetricKind : int {
+    Duration,
+    Invocations,
+    Cycles,
+    Instructions,
+    CacheMisses,
+    Count,
+  };
+
+  static constexpr int NumCounters = Count - Cycles;
+
+  HostMetric() : Metric(MetricKind::Host, hostMetricKind::Count) {}
+
+  /// `counters` holds the change of the CPU counters over the interval, if
+  /// they are read, in the order of the values from `Cycles` on.
+  HostMetric(uint64_t duration, const uint64_t *counters, uint64_t weight = 1)
+      : HostMetric() {
+    this->values[Duration] = duration * weight;
+    this->values[Invocations] = weight;
+    if (counters) {
+      for (int i = 0; i < NumCounters; ++i)
+        this->values[Cycles + i] = counters[i] * weight;
+      hasCounters = true;
+    }
+  }
+
+  virtual const std::string getName() const { return "HostMetric"; }
+
+  void updateMetric(Metric &other) override {
+    Metric::updateMetric(other);
+    if (auto *otherHostMetric = dynamic_cast<HostMetric *>(&other))
+      hasCounters |= otherHostMetric->hasCounters;
+  }
+
+  /// Whether the value has been measured, as the counters are not always
+  /// available.
+  bool isReported(int valueId) const {
+    return valueId < Cycles || hasCounters;
+  }
+
+  virtual const std::string getValueName(int valueId) const {
+    return VALUE_NAMES[valueId];
+  }
+
+  virtual bool isAggregable(int valueId) const { return true; }
+
+private:
+  const static inline std::string VALUE_NAMES[hostMetricKind::Count] = {
+      "Host Time (ns)", "Host Count", "Cycles", "Instructions", "Cache Misses",
+  };
+
+  bool hasCounters = false;
 };
 
 } // namespace proton
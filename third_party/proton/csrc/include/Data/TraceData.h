@@ -1,14 +1,23 @@
 #ifndef PROTON_DATA_TRACE_DATA_H_
 #define PROTON_DATA_TRACE_DATA_H_
 
+#include "Context/Context.h"
 #include "Data.h"
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace proton {
 
-class TraceData : public Data {
+/// Records a timeline of scopes, ops, kernels, and metrics instead of
+/// aggregating them. Each thread appends events to its own buffer without
+/// taking any lock, and the buffers are merged into a single trace on dump.
+class TraceData : public Data, public ScopeInterface {
 public:
-  using Data::Data;
-  virtual ~TraceData() = default;
+  TraceData(const std::string &path, ContextSource *contextSource);
+  virtual ~TraceData();
+
+  TraceData(const std::string &path) : TraceData(path, nullptr) {}
 
   size_t addScope(size_t scopeId, const std::string &name) override;
 
@@ -18,13 +27,31 @@ public:
                   const std::map<std::string, MetricValueType> &metrics,
                   bool aggregable) override;
 
+  // ScopeInterface
+  void enterScope(const Scope &scope) override;
+
+  void exitScope(const Scope &scope) override;
+
 protected:
+  // OpInterface
   void startOp(const Scope &scope) override final;
 
   void stopOp(const Scope &scope) override final;
 
 private:
+  struct Event;
+  class EventBuffer;
+
+  /// Returns the calling thread's buffer, registering it on first use.
+  EventBuffer &getThreadBuffer();
+
+  void dumpChromeTrace(std::ostream &os) const;
   void doDump(std::ostream &os, OutputFormat outputFormat) const override;
+
+  // Distinguishes this trace from earlier ones that lived at the same address
+  const size_t traceId;
+  mutable std::mutex buffersMutex;
+  std::vector<std::unique_ptr<EventBuffer>> buffers;
 };
 
 } // namespace proton
@@ -3,6 +3,9 @@
 
 #include "Context/Context.h"
 #include "Data.h"
+#include "Utility/Map.h"
+#include <chrono>
+#include <deque>
 #include <stdexcept>
 #include <unordered_map>
 
@@ -19,10 +22,14 @@ public:
 
   void addMetric(size_t scopeId, std::shared_ptr<Metric> metric) override;
 
+  void addCurrentMetric(std::shared_ptr<Metric> metric) override;
+
   void addMetrics(size_t scopeId,
                   const std::map<std::string, MetricValueType> &metrics,
                   bool aggregable) override;
 
+  size_t getMemoryUsage() const override;
+
 protected:
   // OpInterface
   void startOp(const Scope &scope) override;
@@ -31,13 +38,27 @@ protected:
 
 private:
   void init();
+  void addNodeMetric(size_t contextId, std::shared_ptr<Metric> metric);
   void dumpHatchet(std::ostream &os) const;
+  /// Writes only the subtrees with new metrics, along with the names of the
+  /// metrics that are kept, and resets the aggregable metrics in the same
+  /// walk.
+  void flushHatchet(std::ostream &os);
+  /// Writes the columnar binary format that the viewer maps into memory.
+  void dumpBinary(std::ostream &os) const;
   void doDump(std::ostream &os, OutputFormat outputFormat) const override;
+  void doFlush(std::ostream &os, OutputFormat outputFormat) override;
+  /// Forgets the scopes that are too old to receive any more metrics.
+  void releaseScopes();
 
   class Tree;
   std::unique_ptr<Tree> tree;
   // ScopeId -> ContextId
-  std::unordered_map<size_t, size_t> scopeIdToContextId;
+  ThreadSafeMap<size_t, size_t, std::unordered_map<size_t, size_t>>
+      scopeIdToContextId;
+  // <time, next scope id> of each flush, oldest first
+  std::deque<std::pair<std::chrono::steady_clock::time_point, size_t>>
+      flushedScopeIds;
 };
 
 } // namespace proton
@@ -3,6 +3,7 @@
 
 #include "Context/Context.h"
 #include "Profiler.h"
+#include "Sampler.h"
 #include "Utility/Atomic.h"
 #include "Utility/Map.h"
 #include "Utility/Set.h"
@@ -31,6 +32,33 @@ public:
                     std::unordered_map<uint64_t, std::pair<size_t, size_t>>>;
   using ApiExternIdSet = ThreadSafeSet<size_t, std::unordered_set<size_t>>;
 
+  /// The weights of sampled launches that stand for more than one launch.
+  /// Other launches weigh one, so the map is only looked up once sampling has
+  /// used it.
+  class ExternIdToWeightMap {
+  public:
+    void insert(size_t externId, uint64_t weight) {
+      weights.insert(externId, weight);
+      used.store(true, std::memory_order_relaxed);
+    }
+
+    uint64_t at(size_t externId) {
+      if (!used.load(std::memory_order_relaxed) || !weights.contain(externId))
+        return 1;
+      return weights.at(externId);
+    }
+
+    void erase(size_t externId) {
+      if (used.load(std::memory_order_relaxed))
+        weights.erase(externId);
+    }
+
+  private:
+    ThreadSafeMap<size_t, uint64_t, std::unordered_map<size_t, uint64_t>>
+        weights;
+    std::atomic<bool> used{false};
+  };
+
 protected:
   // OpInterface
   void startOp(const Scope &scope) override {
@@ -81,6 +109,7 @@ protected:
     // kernels) other than Triton.
     // It stores a subset of external ids in corrIdToExternId.
     ApiExternIdSet apiExternIds;
+    ExternIdToWeightMap externIdToWeight;
     static thread_local std::deque<size_t> externIdQueue;
 
     Correlation() = default;
@@ -98,10 +127,13 @@ protected:
     void popExternId() { externIdQueue.pop_front(); }
 
     // Correlate the correlationId with the last externId
-    void correlate(uint64_t correlationId, size_t numInstances = 1) {
+    void correlate(uint64_t correlationId, size_t numInstances = 1,
+                   uint64_t weight = 1) {
       if (externIdQueue.empty())
         return;
       corrIdToExternId[correlationId] = {externIdQueue.back(), numInstances};
+      if (weight > 1)
+        externIdToWeight.insert(externIdQueue.back(), weight);
     }
 
     template <typename FlushFnT>
@@ -0,0 +1,61 @@
+#ifndef PROTON_PROFILER_HOST_PROFILER_H_
+#define PROTON_PROFILER_HOST_PROFILER_H_
+
+#include "Context/Context.h"
+#include "Profiler.h"
+
+#include <atomic>
+
+namespace proton {
+
+/// Measures the time that the host spends in scopes and ops with a monotonic
+/// clock, so that host costs such as compiling kernels and launching them can
+/// be profiled without a GPU. With counters enabled, the cycles, instructions,
+/// and cache misses of the thread are read from Linux perf_event as well.
+///
+/// The time and counters of an interval exclude those of the intervals nested
+/// in it. Scopes are attributed to the current contexts when they exit, and
+/// ops to the contexts that the data has recorded for them.
+class HostProfiler : public Profiler,
+                     public ScopeInterface,
+                     public ThreadLocalOpInterface,
+                     public Singleton<HostProfiler> {
+public:
+  HostProfiler() = default;
+  virtual ~HostProfiler() = default;
+
+  /// Enables reading the CPU counters. Threads on which the counters cannot
+  /// be opened, for example because perf_event is restricted, fall back to
+  /// timing only.
+  HostProfiler *setCounters(bool enabled);
+
+  // ScopeInterface
+  void enterScope(const Scope &scope) override;
+  void exitScope(const Scope &scope) override;
+
+protected:
+  // OpInterface
+  void startOp(const Scope &scope) override;
+  void stopOp(const Scope &scope) override;
+
+  // Profiler
+  void doStart() override {}
+  void doFlush() override {}
+  void doStop() override {}
+
+private:
+  struct ThreadState;
+
+  static ThreadState &getThreadState();
+
+  void start(size_t scopeId, uint64_t weight);
+
+  /// Ends the interval of the scope and adds its metric to the data.
+  void stop(size_t scopeId, bool isOp);
+
+  std::atomic<bool> counters{false};
+};
+
+} // namespace proton
+
+#endif // PROTON_PROFILER_HOST_PROFILER_H_
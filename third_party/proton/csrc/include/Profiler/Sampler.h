@@ -0,0 +1,108 @@
+#ifndef PROTON_PROFILER_SAMPLER_H_
+#define PROTON_PROFILER_SAMPLER_H_
+
+#include "Utility/Singleton.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace proton {
+
+/// Decides which kernel launches are profiled, so that the overhead of
+/// profiling stays bounded. A skipped launch is neither attributed to a
+/// context nor correlated with its kernels. A sampled launch has a weight, the
+/// number of launches it stands for, by which its metrics are scaled.
+///
+/// Policies:
+///   "rate:<n>": one launch in n. The gaps between samples are drawn from a
+///   geometric distribution, so that every launch is sampled with probability
+///   1/n regardless of the pattern of launches, and weighting by n is unbiased.
+///
+///   "interval:<seconds>": the first launch of each thread in every interval,
+///   weighted by the launches of the thread since its previous sample.
+///
+///   "overhead:<percent>": like "rate", with n adjusted over time so that the
+///   host time spent on profiling launches stays around the given percentage
+///   of the wall time.
+///
+/// An empty policy samples every launch.
+class Sampler : public Singleton<Sampler> {
+public:
+  Sampler() = default;
+
+  void setPolicy(const std::string &policy);
+
+  const std::string &getPolicy() const { return policy; }
+
+  /// Starts a launch on this thread and returns its weight, which is zero if
+  /// the launch is skipped. Nested launches, such as a runtime API calling a
+  /// driver API, share the decision of the outermost one.
+  uint64_t enterLaunch();
+
+  void exitLaunch();
+
+  /// Returns the weight of the launch in progress on this thread, or one if
+  /// there is none.
+  uint64_t getLaunchWeight() const;
+
+  /// Accounts the host time spent on profiling a sampled launch while it is in
+  /// scope, which the overhead policy keeps in check.
+  class Cost {
+  public:
+    Cost() : timed(Sampler::instance().isAdaptive()) {
+      if (timed)
+        start = std::chrono::steady_clock::now();
+    }
+
+    ~Cost() {
+      if (timed)
+        Sampler::instance().addCost(std::chrono::steady_clock::now() - start);
+    }
+
+  private:
+    bool timed;
+    std::chrono::steady_clock::time_point start;
+  };
+
+private:
+  enum class Kind { All, Rate, Interval, Overhead };
+
+  struct ThreadState;
+
+  static ThreadState &getThreadState();
+
+  bool isAdaptive() const {
+    return kind.load(std::memory_order_relaxed) == Kind::Overhead;
+  }
+
+  uint64_t sample(ThreadState &state);
+
+  void drawGap(ThreadState &state, double mean);
+
+  void addCost(std::chrono::steady_clock::duration cost);
+
+  /// Recomputes the mean gap of the overhead policy once per period.
+  void adapt();
+
+  std::string policy;
+  std::atomic<Kind> kind{Kind::All};
+  // Bumped by every policy change so that threads reset their state
+  std::atomic<uint64_t> generation{0};
+  std::atomic<double> meanGap{1};
+  std::atomic<double> interval{0};
+  std::atomic<double> targetOverhead{0};
+
+  // Overhead accounting of the current period
+  std::atomic<int64_t> periodStart{0};
+  std::atomic<uint64_t> periodCost{0};
+  std::atomic<uint64_t> periodLaunches{0};
+  std::atomic<uint64_t> periodSamples{0};
+  std::mutex mutex;
+};
+
+} // namespace proton
+
+#endif // PROTON_PROFILER_SAMPLER_H_
@@ -4,11 +4,14 @@
 #include "Context/Context.h"
 #include "Data/Metric.h"
 #include "Utility/Singleton.h"
+#include <condition_variable>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <shared_mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace proton {
@@ -20,9 +23,12 @@ enum class OutputFormat;
 /// A session is a collection of profiler, context source, and data objects.
 /// There could be multiple sessions in the system, each can correspond to a
 /// different duration, or the same duration but with different configurations.
+/// A streaming session writes its data out in parts while it runs instead of
+/// holding all of it until finalize. A sampling session profiles only some of
+/// the kernel launches, and all live sessions share the same sampling policy.
 class Session {
 public:
-  ~Session() = default;
+  ~Session() { stopFlusher(); }
 
   void activate();
 
@@ -33,9 +39,22 @@ public:
 private:
   Session(size_t id, const std::string &path, Profiler *profiler,
           std::unique_ptr<ContextSource> contextSource,
-          std::unique_ptr<Data> data)
+          std::unique_ptr<Data> data, double flushInterval, size_t flushSize,
+          const std::string &sampling)
       : id(id), path(path), profiler(profiler),
-        contextSource(std::move(contextSource)), data(std::move(data)) {}
+        contextSource(std::move(contextSource)), data(std::move(data)),
+        flushInterval(flushInterval), flushSize(flushSize),
+        sampling(sampling) {
+    if (isStreaming())
+      flusher = std::thread([this]() { runFlusher(); });
+  }
+
+  bool isStreaming() const { return flushInterval > 0 || flushSize > 0; }
+
+  /// Flushes the data whenever a part is due until stopFlusher is called.
+  void runFlusher();
+
+  void stopFlusher();
 
   template <typename T> std::vector<T *> getInterfaces() {
     std::vector<T *> interfaces;
@@ -57,6 +76,17 @@ private:
   std::unique_ptr<ContextSource> contextSource{};
   std::unique_ptr<Data> data{};
 
+  // A part is due every flushInterval seconds, or when the data has grown by
+  // flushSize bytes since the last one. Zero disables either trigger.
+  const double flushInterval{};
+  const size_t flushSize{};
+  // See Sampler for the policies
+  const std::string sampling{};
+  std::thread flusher;
+  std::mutex flusherMutex;
+  std::condition_variable flusherCondition;
+  bool flusherStopped{};
+
   friend class SessionManager;
 };
 
@@ -69,7 +99,8 @@ public:
 
   size_t addSession(const std::string &path, const std::string &profilerName,
                     const std::string &contextSourceName,
-                    const std::string &dataName);
+                    const std::string &dataName, double flushInterval = 0,
+                    size_t flushSize = 0, const std::string &sampling = "");
 
   void finalizeSession(size_t sessionId, OutputFormat outputFormat);
 
@@ -95,10 +126,16 @@ private:
   std::unique_ptr<Session> makeSession(size_t id, const std::string &path,
                                        const std::string &profilerName,
                                        const std::string &contextSourceName,
-                                       const std::string &dataName);
+                                       const std::string &dataName,
+                                       double flushInterval, size_t flushSize,
+                                       const std::string &sampling);
 
   void activateSessionImpl(size_t sesssionId);
 
+  void addMetricsImpl(size_t scopeId,
+                      const std::map<std::string, MetricValueType> &metrics,
+                      bool aggregable);
+
   void deActivateSessionImpl(size_t sessionId);
 
   size_t getSessionId(const std::string &path) { return sessionPaths[path]; }
@@ -113,6 +150,27 @@ private:
 
   void removeSession(size_t sessionId);
 
+  /// Calls `fn` on the active scope interfaces. Context sources enter a scope
+  /// before the other interfaces and exit it after them, so that the others
+  /// find the scope among the current contexts.
+  template <typename FnT>
+  void visitScopeInterfaces(bool contextSourcesFirst, FnT &&fn) {
+    for (auto contextSources : {contextSourcesFirst, !contextSourcesFirst}) {
+      for (auto [scopeInterface, count] : scopeInterfaceCounts) {
+        if (count == 0)
+          continue;
+        auto isContextSource =
+            dynamic_cast<ContextSource *>(scopeInterface) != nullptr;
+        if (isContextSource == contextSources)
+          fn(scopeInterface);
+      }
+    }
+  }
+
+  /// Applies the sampling policy of a new session, which has to match the
+  /// policy of the live ones.
+  void setSamplingPolicy(const std::string &sampling);
+
   template <typename Interface, typename Counter>
   void registerInterface(size_t sessionId, Counter &interfaceCounts) {
     auto interfaces = sessions[sessionId]->getInterfaces<Interface>();
@@ -125,7 +183,11 @@ private:
   void unregisterInterface(size_t sessionId, Counter &interfaceCounts) {
     auto interfaces = sessions[sessionId]->getInterfaces<Interface>();
     for (auto *interface : interfaces) {
-      interfaceCounts[interface] -= 1;
+      // Drop the interfaces of inactive sessions, which removeSession may
+      // destroy right after
+      auto it = interfaceCounts.find(interface);
+      if (it != interfaceCounts.end() && --it->second == 0)
+        interfaceCounts.erase(it);
     }
   }
 
@@ -0,0 +1,99 @@
+#ifndef PROTON_UTILITY_HISTOGRAM_H_
+#define PROTON_UTILITY_HISTOGRAM_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace proton {
+
+/// Counts non-negative integers in log-scaled buckets, in the manner of HDR
+/// histograms. Values below 2^SubBucketBits have a bucket each, and every
+/// larger power of two is split into 2^SubBucketBits buckets, so that a bucket
+/// is never wider than 1/2^SubBucketBits of the values it holds.
+///
+/// Only the range of buckets between the smallest and the largest value is
+/// stored, which stays small for values of the same magnitude such as the
+/// durations of a kernel. Histograms are merged by adding up their buckets.
+class LogHistogram {
+public:
+  static constexpr int SubBucketBits = 5;
+  static constexpr uint64_t SubBucketCount = uint64_t(1) << SubBucketBits;
+
+  LogHistogram() = default;
+
+  explicit LogHistogram(uint64_t value) { record(value); }
+
+  static size_t getBucket(uint64_t value) {
+    if (value < SubBucketCount)
+      return value;
+    // The position of the most significant bit decides the power of two, and
+    // the bits below it the bucket within that power
+    int shift = 63 - __builtin_clzll(value) - SubBucketBits;
+    return (shift + 1) * SubBucketCount + (value >> shift) - SubBucketCount;
+  }
+
+  void record(uint64_t value, uint64_t count = 1) {
+    addToBucket(getBucket(value), count);
+    minValue = std::min(minValue, value);
+    maxValue = std::max(maxValue, value);
+  }
+
+  void merge(const LogHistogram &other) {
+    if (other.empty())
+      return;
+    reserve(other.firstBucket, other.firstBucket + other.counts.size());
+    for (size_t i = 0; i < other.counts.size(); ++i)
+      counts[other.firstBucket + i - firstBucket] += other.counts[i];
+    totalCount += other.totalCount;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+  }
+
+  bool empty() const { return totalCount == 0; }
+
+  uint64_t getCount() const { return totalCount; }
+
+  uint64_t getMin() const { return minValue; }
+
+  uint64_t getMax() const { return maxValue; }
+
+  /// The counts of the buckets from `getFirstBucket()` on.
+  const std::vector<uint64_t> &getCounts() const { return counts; }
+
+  size_t getFirstBucket() const { return firstBucket; }
+
+private:
+  void addToBucket(size_t bucket, uint64_t count) {
+    reserve(bucket, bucket + 1);
+    counts[bucket - firstBucket] += count;
+    totalCount += count;
+  }
+
+  // Grows the stored buckets to cover [begin, end)
+  void reserve(size_t begin, size_t end) {
+    if (counts.empty()) {
+      firstBucket = begin;
+      counts.resize(end - begin);
+      return;
+    }
+    if (begin < firstBucket) {
+      counts.insert(counts.begin(), firstBucket - begin, 0);
+      firstBucket = begin;
+    }
+    if (end > firstBucket + counts.size())
+      counts.resize(end - firstBucket);
+  }
+
+  size_t firstBucket = 0;
+  std::vector<uint64_t> counts;
+  uint64_t totalCount = 0;
+  uint64_t minValue = std::numeric_limits<uint64_t>::max();
+  uint64_t maxValue = 0;
+};
+
+} // namespace proton
+
+#endif // PROTON_UTILITY_HISTOGRAM_H_
@@ -1,59 +1,98 @@
 #ifndef PROTON_UTILITY_MAP_H_
 #define PROTON_UTILITY_MAP_H_
 
+#include "Utility/Striped.h"
+
 #include <map>
+#include <mutex>
 #include <shared_mutex>
 
 namespace proton {
 
-/// A simple thread safe map with read/write lock.
+/// A thread safe map behind a read/write lock. With `NumStripes` > 1, the keys
+/// are spread over stripes with their own locks instead; that only pays off
+/// when many threads access the map at once, so it is off by default.
 template <typename Key, typename Value,
-          typename Container = std::map<Key, Value>>
+          typename Container = std::map<Key, Value>, size_t NumStripes = 1>
 class ThreadSafeMap {
 public:
   ThreadSafeMap() = default;
 
   Value &operator[](const Key &key) {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    return map[key];
+    auto &stripe = stripes.getStripe(key);
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    return stripe.container[key];
   }
 
   Value &operator[](Key &&key) {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    return map[std::move(key)];
+    auto &stripe = stripes.getStripe(key);
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    return stripe.container[std::move(key)];
   }
 
   Value &at(const Key &key) {
-    std::shared_lock<std::shared_mutex> lock(mutex);
-    return map.at(key);
+    auto &stripe = stripes.getStripe(key);
+    std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+    return stripe.container.at(key);
   }
 
   void insert(const Key &key, const Value &value) {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    map[key] = value;
+    auto &stripe = stripes.getStripe(key);
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    stripe.container[key] = value;
   }
 
   bool contain(const Key &key) {
-    std::shared_lock<std::shared_mutex> lock(mutex);
-    auto it = map.find(key);
-    if (it == map.end())
+    auto &stripe = stripes.getStripe(key);
+    std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+    auto it = stripe.container.find(key);
+    if (it == stripe.container.end())
       return false;
     return true;
   }
 
   bool erase(const Key &key) {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    return map.erase(key) > 0;
+    auto &stripe = stripes.getStripe(key);
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    return stripe.container.erase(key) > 0;
+  }
+
+  /// Erases the entries for which `fn(key, value)` returns true.
+  template <typename FnT> size_t eraseIf(FnT &&fn) {
+    size_t numErased = 0;
+    for (auto &stripe : stripes) {
+      std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+      for (auto it = stripe.container.begin();
+           it != stripe.container.end();) {
+        if (fn(it->first, it->second)) {
+          it = stripe.container.erase(it);
+          numErased++;
+        } else {
+          ++it;
+        }
+      }
+    }
+    return numErased;
+  }
+
+  size_t size() const {
+    size_t size = 0;
+    for (auto &stripe : stripes) {
+      std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+      size += stripe.container.size();
+    }
+    return size;
   }
 
   void clear() {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    map.clear();
+    for (auto &stripe : stripes) {
+      std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+      stripe.container.clear();
+    }
   }
 
 private:
-  Container map;
-  std::shared_mutex mutex;
+  Striped<Container, NumStripes> stripes;
 };
 
 } // namespace proton
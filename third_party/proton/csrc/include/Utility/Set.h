@@ -1,45 +1,54 @@
 #ifndef PROTON_UTILITY_SET_H_
 #define PROTON_UTILITY_SET_H_
 
+#include "Utility/Striped.h"
+
+#include <mutex>
 #include <set>
 #include <shared_mutex>
 
 namespace proton {
 
-/// A simple thread safe set with read/write lock.
-template <typename Key, typename Container = std::set<Key>>
+/// A thread safe set behind a read/write lock. With `NumStripes` > 1, the keys
+/// are spread over stripes with their own locks instead, as in ThreadSafeMap.
+template <typename Key, typename Container = std::set<Key>,
+          size_t NumStripes = 1>
 class ThreadSafeSet {
 public:
   ThreadSafeSet() = default;
 
   void insert(const Key &key) {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    set.insert(key);
+    auto &stripe = stripes.getStripe(key);
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    stripe.container.insert(key);
   }
 
   bool contain(const Key &key) {
-    std::shared_lock<std::shared_mutex> lock(mutex);
-    auto it = set.find(key);
-    if (it == set.end())
+    auto &stripe = stripes.getStripe(key);
+    std::shared_lock<std::shared_mutex> lock(stripe.mutex);
+    auto it = stripe.container.find(key);
+    if (it == stripe.container.end())
       return false;
     return true;
   }
 
   bool erase(const Key &key) {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    return set.erase(key) > 0;
+    auto &stripe = stripes.getStripe(key);
+    std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+    return stripe.container.erase(key) > 0;
   }
 
   void clear() {
-    std::unique_lock<std::shared_mutex> lock(mutex);
-    set.clear();
+    for (auto &stripe : stripes) {
+      std::unique_lock<std::shared_mutex> lock(stripe.mutex);
+      stripe.container.clear();
+    }
   }
 
 private:
-  Container set;
-  std::shared_mutex mutex;
+  Striped<Container, NumStripes> stripes;
 };
 
 } // namespace proton
 
-#endif // PROTON_UTILITY_MAP_H_
+#endif // PROTON_UTILITY_SET_H_
@@ -0,0 +1,43 @@
+#ifndef PROTON_UTILITY_STRIPED_H_
+#define PROTON_UTILITY_STRIPED_H_
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <shared_mutex>
+
+namespace proton {
+
+/// Splits a container into independently locked stripes and assigns every key
+/// to one of them, so that threads working on different keys rarely contend.
+template <typename Container, size_t NumStripes> class Striped {
+  static_assert(NumStripes > 0 && (NumStripes & (NumStripes - 1)) == 0,
+                "NumStripes must be a power of two");
+
+public:
+  // Stripes sit on their own cache lines so that locking one does not evict
+  // its neighbors
+  struct alignas(64) Stripe {
+    Container container;
+    mutable std::shared_mutex mutex;
+  };
+
+  template <typename Key> Stripe &getStripe(const Key &key) {
+    // std::hash is the identity for integers, so consecutive ids, such as
+    // correlation ids issued by concurrent launches, land on different
+    // stripes while each stripe still sees its ids in order
+    return stripes[std::hash<Key>()(key) & (NumStripes - 1)];
+  }
+
+  Stripe *begin() { return stripes.data(); }
+  Stripe *end() { return stripes.data() + NumStripes; }
+  const Stripe *begin() const { return stripes.data(); }
+  const Stripe *end() const { return stripes.data() + NumStripes; }
+
+private:
+  std::array<Stripe, NumStripes> stripes;
+};
+
+} // namespace proton
+
+#endif // PROTON_UTILITY_STRIPED_H_
@@ -7,4 +7,38 @@ std::atomic<size_t> Scope::scopeIdCounter{1};
 /*static*/ thread_local std::map<ThreadLocalOpInterface *, bool>
     ThreadLocalOpInterface::opInProgress;
 
+size_t ContextInterner::intern(const std::string &name) {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = ids.find(name);
+    if (it != ids.end())
+      return it->second;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto [it, inserted] = ids.try_emplace(name, names.size());
+  if (inserted)
+    names.push_back(&it->first);
+  return it->second;
+}
+
+std::string ContextInterner::getName(size_t id) {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return *names.at(id);
+}
+
+void ContextInterner::clear() {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  names.clear();
+  ids.clear();
+  generation.fetch_add(1, std::memory_order_release);
+}
+
+std::vector<size_t> ContextSource::getContextIds() {
+  auto &interner = ContextInterner::instance();
+  std::vector<size_t> contextIds;
+  for (auto &context : getContexts())
+    contextIds.push_back(interner.intern(context.name));
+  return contextIds;
+}
+
 } // namespace proton
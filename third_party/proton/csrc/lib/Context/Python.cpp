@@ -1,7 +1,9 @@
 #include "Context/Python.h"
 #include "pybind11/pybind11.h"
 #include <algorithm>
+#include <optional>
 #include <string>
+#include <unordered_map>
 
 namespace proton {
 
@@ -52,6 +54,19 @@ PyFrameObject *getFrameBack(PyFrameObject *frame) {
 }
 #endif
 
+// PyFrame_GetLasti() was added to Python 3.11
+#if PY_VERSION_HEX < 0x030B0000
+int getFrameLasti(PyFrameObject *frame) {
+  assert(frame != nullptr);
+  return frame->f_lasti;
+}
+#else
+int getFrameLasti(PyFrameObject *frame) {
+  assert(frame != nullptr);
+  return PyFrame_GetLasti(frame);
+}
+#endif
+
 std::string unpackPyobject(PyObject *pyObject) {
   if (PyBytes_Check(pyObject)) {
     size_t size = PyBytes_GET_SIZE(pyObject);
@@ -69,29 +84,139 @@ std::string unpackPyobject(PyObject *pyObject) {
   return "";
 }
 
+/// A frame is identified by its code object and the instruction it is at.
+struct FrameKey {
+  PyCodeObject *code;
+  int lasti;
+
+  bool operator==(const FrameKey &other) const {
+    return code == other.code && lasti == other.lasti;
+  }
+};
+
+struct FrameKeyHash {
+  size_t operator()(const FrameKey &key) const {
+    return std::hash<const void *>()(key.code) ^
+           (static_cast<size_t>(key.lasti) * 0x9E3779B97F4A7C15ull);
+  }
+};
+
+/// Maps frames to the interned ids of their contexts, so that the name of a
+/// frame is only built the first time it is seen. The cache holds a reference
+/// to every code object in it, which keeps their addresses from being reused.
+/// Only accessed with the GIL held.
+class FrameCache {
+public:
+  /// Bumped whenever cached frames are dropped.
+  size_t generation = 0;
+
+  /// Drops the cached frames if the interner forgot their ids.
+  void sync() {
+    auto internerGeneration = ContextInterner::instance().getGeneration();
+    if (internerGeneration != this->internerGeneration) {
+      clear();
+      this->internerGeneration = internerGeneration;
+    }
+  }
+
+  size_t getContextId(PyFrameObject *frame, const FrameKey &key) {
+    auto it = contextIds.find(key);
+    if (it != contextIds.end())
+      return it->second;
+    if (contextIds.size() >= MaxFrames)
+      clear();
+    auto file = unpackPyobject(key.code->co_filename);
+    auto function = unpackPyobject(key.code->co_name);
+    auto lineno = PyFrame_GetLineNumber(frame);
+    auto contextId = ContextInterner::instance().intern(
+        file + ":" + function + "@" + std::to_string(lineno));
+    Py_INCREF(key.code);
+    contextIds.emplace(key, contextId);
+    return contextId;
+  }
+
+private:
+  // Bounds the references held on code objects that are generated at runtime
+  inline static const size_t MaxFrames = 1 << 16;
+
+  void clear() {
+    for (auto &[key, contextId] : contextIds)
+      Py_DECREF(key.code);
+    contextIds.clear();
+    ++generation;
+  }
+
+  std::unordered_map<FrameKey, size_t, FrameKeyHash> contextIds;
+  size_t internerGeneration = 0;
+};
+
+FrameCache &getFrameCache() {
+  // Never destroyed, as the cached references cannot be released after the
+  // interpreter is finalized
+  static auto *frameCache = new FrameCache();
+  return *frameCache;
+}
+
+/// The stack captured by the last call on a thread, outermost frame first.
+struct CapturedStack {
+  std::vector<FrameKey> frames;
+  std::vector<size_t> contextIds;
+  size_t generation = 0;
+};
+
 } // namespace
 
 std::vector<Context> PythonContextSource::getContexts() {
-  pybind11::gil_scoped_acquire gil;
+  auto &interner = ContextInterner::instance();
+  std::vector<Context> contexts;
+  for (auto contextId : getContextIds())
+    contexts.push_back(Context(interner.getName(contextId)));
+  return contexts;
+}
+
+std::vector<size_t> PythonContextSource::getContextIds() {
+  // Launches from Python already hold the GIL
+  std::optional<pybind11::gil_scoped_acquire> gil;
+  if (!PyGILState_Check())
+    gil.emplace();
+
+  // Frames are kept alive until their contexts are resolved
+  thread_local std::vector<std::pair<PyFrameObject *, FrameKey>> frames;
+  thread_local CapturedStack previous;
 
   PyFrameObject *frame = PyEval_GetFrame();
   Py_XINCREF(frame);
-
-  std::vector<Context> contexts;
   while (frame != nullptr) {
-    PyCodeObject *f_code = getFrameCodeObject(frame);
-    size_t lineno = PyFrame_GetLineNumber(frame);
-    size_t firstLineNo = f_code->co_firstlineno;
-    std::string file = unpackPyobject(f_code->co_filename);
-    std::string function = unpackPyobject(f_code->co_name);
-    auto pythonFrame = file + ":" + function + "@" + std::to_string(lineno);
-    contexts.push_back(Context(pythonFrame));
-    auto newFrame = getFrameBack(frame);
-    Py_DECREF(frame);
-    frame = newFrame;
+    PyCodeObject *code = getFrameCodeObject(frame);
+    frames.push_back({frame, FrameKey{code, getFrameLasti(frame)}});
+    // The frame holds a reference to its code
+    Py_DECREF(code);
+    frame = getFrameBack(frame);
   }
-  std::reverse(contexts.begin(), contexts.end());
-  return contexts;
+  std::reverse(frames.begin(), frames.end());
+
+  // The outer frames are usually the same as in the previous launch, and so
+  // are their contexts unless the cache dropped them since
+  auto &frameCache = getFrameCache();
+  frameCache.sync();
+  size_t depth = 0;
+  if (previous.generation == frameCache.generation) {
+    auto maxDepth = std::min(frames.size(), previous.frames.size());
+    while (depth < maxDepth && frames[depth].second == previous.frames[depth])
+      ++depth;
+  }
+  previous.frames.resize(depth);
+  previous.contextIds.resize(depth);
+  previous.generation = frameCache.generation;
+  for (; depth < frames.size(); ++depth) {
+    auto [frameObject, key] = frames[depth];
+    previous.frames.push_back(key);
+    previous.contextIds.push_back(frameCache.getContextId(frameObject, key));
+  }
+  for (auto [frameObject, key] : frames)
+    Py_DECREF(frameObject);
+  frames.clear();
+  return previous.contextIds;
 }
 
 } // namespace proton
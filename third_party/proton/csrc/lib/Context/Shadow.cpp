@@ -6,6 +6,7 @@ namespace proton {
 
 void ShadowContextSource::enterScope(const Scope &scope) {
   contextStack.push_back(scope);
+  contextIdStack.push_back(ContextInterner::instance().intern(scope.name));
 }
 
 void ShadowContextSource::exitScope(const Scope &scope) {
@@ -16,6 +17,7 @@ void ShadowContextSource::exitScope(const Scope &scope) {
     throw std::runtime_error("Context stack is not balanced");
   }
   contextStack.pop_back();
+  contextIdStack.pop_back();
 }
 
 } // namespace proton
@@ -17,15 +17,35 @@ void Data::dump(OutputFormat outputFormat) {
     out.reset(new std::ostream(std::cout.rdbuf())); // Redirecting to cout
   } else {
     out.reset(new std::ofstream(
-        path + "." +
-        outputFormatToString(outputFormat))); // Opening a file for output
+        path + "." + outputFormatToString(outputFormat),
+        std::ios::binary)); // Opening a file for output
   }
   doDump(*out, outputFormat);
 }
 
+void Data::flush(OutputFormat outputFormat) {
+  // Parts are numbered in the order they are written
+  std::unique_lock<std::shared_mutex> lock(mutex);
+
+  std::unique_ptr<std::ostream> out;
+  if (path.empty() || path == "-") {
+    out.reset(new std::ostream(std::cout.rdbuf())); // Redirecting to cout
+  } else {
+    out.reset(new std::ofstream(path + ".part" + std::to_string(numParts) +
+                                    "." + outputFormatToString(outputFormat),
+                                std::ios::binary));
+  }
+  doFlush(*out, outputFormat);
+  numParts++;
+}
+
 OutputFormat parseOutputFormat(const std::string &outputFormat) {
   if (toLower(outputFormat) == "hatchet") {
     return OutputFormat::Hatchet;
+  } else if (toLower(outputFormat) == "chrome_trace") {
+    return OutputFormat::ChromeTrace;
+  } else if (toLower(outputFormat) == "binary") {
+    return OutputFormat::Binary;
   }
   throw std::runtime_error("Unknown output format: " + outputFormat);
 }
@@ -33,6 +53,10 @@ OutputFormat parseOutputFormat(const std::string &outputFormat) {
 const std::string outputFormatToString(OutputFormat outputFormat) {
   if (outputFormat == OutputFormat::Hatchet) {
     return "hatchet";
+  } else if (outputFormat == OutputFormat::ChromeTrace) {
+    return "chrome_trace";
+  } else if (outputFormat == OutputFormat::Binary) {
+    return "binary";
   }
   throw std::runtime_error("Unknown output format: " +
                            std::to_string(static_cast<int>(outputFormat)));
@@ -1,30 +1,429 @@
 #include "Data/TraceData.h"
-#include "Utility/Errors.h"
+#include "Data/Metric.h"
+#include "Driver/Device.h"
+#include "nlohmann/json.hpp"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+using json = nlohmann::json;
 
 namespace proton {
 
-void TraceData::startOp(const Scope &scope) { throw NotImplemented(); }
+namespace {
+
+std::atomic<size_t> traceIdCounter{0};
+
+// The ids of the traces that have not been destroyed yet. Never freed, since
+// traces may be destroyed during static destruction.
+struct LiveTraceIds {
+  std::mutex mutex;
+  std::unordered_set<size_t> ids;
+};
+
+LiveTraceIds &getLiveTraceIds() {
+  static auto *liveTraceIds = new LiveTraceIds();
+  return *liveTraceIds;
+}
+
+// Host events are stamped with the steady clock, while kernels carry the
+// device timestamps reported by the profiler backend.
+uint64_t getHostTime() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// Chrome trace timestamps are in microseconds
+double toMicroseconds(uint64_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+} // namespace
+
+struct TraceData::Event {
+  enum class Kind : uint8_t {
+    ScopeEnter,
+    ScopeExit,
+    OpEnter,
+    OpExit,
+    // A kernel launch outside of any op; `name` is the calling context
+    Launch,
+    // A scope created under `parentId`; `name` is the kernel name
+    Child,
+    Kernel,
+    Metrics,
+  };
+
+  Kind kind{};
+  size_t scopeId{Scope::DummyScopeId};
+  size_t parentId{Scope::DummyScopeId};
+  // The host time of the event, or the device start/end time of a kernel
+  uint64_t startTime{};
+  uint64_t endTime{};
+  uint64_t deviceId{};
+  uint64_t deviceType{};
+  std::string name{};
+  std::map<std::string, MetricValueType> metrics{};
+  bool aggregable{};
+};
+
+/// An append-only list of fixed size chunks with a single writer, the owning
+/// thread. Published events are never moved, so the events appended so far can
+/// be read from any thread without blocking the writer.
+class TraceData::EventBuffer {
+public:
+  explicit EventBuffer(size_t threadIndex)
+      : threadIndex(threadIndex), head(std::make_unique<Chunk>()),
+        tail(head.get()) {}
+
+  ~EventBuffer() {
+    auto *chunk = head->next.load(std::memory_order_acquire);
+    while (chunk != nullptr) {
+      auto *next = chunk->next.load(std::memory_order_acquire);
+      delete chunk;
+      chunk = next;
+    }
+  }
+
+  void append(Event &&event) {
+    auto size = tail->size.load(std::memory_order_relaxed);
+    if (size == Chunk::Capacity) {
+      auto *chunk = new Chunk();
+      tail->next.store(chunk, std::memory_order_release);
+      tail = chunk;
+      size = 0;
+    }
+    tail->events[size] = std::move(event);
+    tail->size.store(size + 1, std::memory_order_release);
+  }
+
+  template <typename FnT> void forEach(FnT &&fn) const {
+    const Chunk *chunk = head.get();
+    while (chunk != nullptr) {
+      auto size = chunk->size.load(std::memory_order_acquire);
+      for (size_t i = 0; i < size; ++i)
+        fn(chunk->events[i]);
+      // Only move on from full chunks so that no event is skipped
+      chunk = size == Chunk::Capacity
+                  ? chunk->next.load(std::memory_order_acquire)
+                  : nullptr;
+    }
+  }
+
+  const size_t threadIndex;
+
+private:
+  struct Chunk {
+    inline static const size_t Capacity = 256;
+    std::array<Event, Capacity> events;
+    std::atomic<size_t> size{0};
+    std::atomic<Chunk *> next{nullptr};
+  };
+
+  std::unique_ptr<Chunk> head;
+  Chunk *tail;
+};
+
+TraceData::EventBuffer &TraceData::getThreadBuffer() {
+  // Keyed by trace id rather than address, since a later trace may be
+  // allocated where a finished one used to be
+  static thread_local std::unordered_map<size_t, EventBuffer *> threadBuffers;
+  auto it = threadBuffers.find(traceId);
+  if (it != threadBuffers.end())
+    return *it->second;
+  {
+    // Forget the buffers of the traces destroyed since, which are gone
+    auto &liveTraceIds = getLiveTraceIds();
+    std::lock_guard<std::mutex> lock(liveTraceIds.mutex);
+    for (auto it = threadBuffers.begin(); it != threadBuffers.end();) {
+      if (liveTraceIds.ids.count(it->first) == 0)
+        it = threadBuffers.erase(it);
+      else
+        ++it;
+    }
+  }
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  buffers.push_back(std::make_unique<EventBuffer>(buffers.size()));
+  threadBuffers[traceId] = buffers.back().get();
+  return *buffers.back();
+}
+
+void TraceData::enterScope(const Scope &scope) {
+  Event event{Event::Kind::ScopeEnter, scope.scopeId};
+  event.startTime = getHostTime();
+  event.name = scope.name;
+  getThreadBuffer().append(std::move(event));
+}
+
+void TraceData::exitScope(const Scope &scope) {
+  Event event{Event::Kind::ScopeExit, scope.scopeId};
+  event.startTime = getHostTime();
+  event.name = scope.name;
+  getThreadBuffer().append(std::move(event));
+}
 
-void TraceData::stopOp(const Scope &scope) { throw NotImplemented(); }
+void TraceData::startOp(const Scope &scope) {
+  Event event{Event::Kind::OpEnter, scope.scopeId};
+  event.startTime = getHostTime();
+  event.name = scope.name;
+  getThreadBuffer().append(std::move(event));
+}
+
+void TraceData::stopOp(const Scope &scope) {
+  Event event{Event::Kind::OpExit, scope.scopeId};
+  event.startTime = getHostTime();
+  event.name = scope.name;
+  getThreadBuffer().append(std::move(event));
+}
 
-size_t TraceData::addScope(size_t scopeId, const std::string &name) {
-  throw NotImplemented();
+size_t TraceData::addScope(size_t parentScopeId, const std::string &name) {
+  Event event;
+  event.startTime = getHostTime();
+  if (name.empty()) {
+    // Record where the launch came from
+    event.kind = Event::Kind::Launch;
+    event.scopeId = parentScopeId;
+    if (contextSource != nullptr) {
+      for (auto &context : contextSource->getContexts())
+        event.name += (event.name.empty() ? "" : "/") + context.name;
+    }
+  } else {
+    event.kind = Event::Kind::Child;
+    event.scopeId = Scope::getNewScopeId();
+    event.parentId = parentScopeId;
+    event.name = name;
+  }
+  auto scopeId = event.scopeId;
+  getThreadBuffer().append(std::move(event));
+  return scopeId;
 }
 
 void TraceData::addMetric(size_t scopeId, std::shared_ptr<Metric> metric) {
-  throw NotImplemented();
+  // Not a valid kernel activity
+  if (!metric)
+    return;
+  if (metric->getKind() != MetricKind::Kernel)
+    throw std::runtime_error("MetricKind not supported");
+  Event event{Event::Kind::Kernel, scopeId};
+  event.startTime =
+      std::get<uint64_t>(metric->getValue(KernelMetric::StartTime));
+  event.endTime = std::get<uint64_t>(metric->getValue(KernelMetric::EndTime));
+  event.deviceId = std::get<uint64_t>(metric->getValue(KernelMetric::DeviceId));
+  event.deviceType =
+      std::get<uint64_t>(metric->getValue(KernelMetric::DeviceType));
+  getThreadBuffer().append(std::move(event));
 }
 
 void TraceData::addMetrics(
     size_t scopeId, const std::map<std::string, MetricValueType> &metrics,
     bool aggregable) {
-  throw NotImplemented();
+  Event event{Event::Kind::Metrics, scopeId};
+  event.startTime = getHostTime();
+  event.metrics = metrics;
+  event.aggregable = aggregable;
+  getThreadBuffer().append(std::move(event));
+}
+
+void TraceData::dumpChromeTrace(std::ostream &os) const {
+  std::lock_guard<std::mutex> lock(buffersMutex);
+  // Events may refer to scopes recorded by other threads, so resolve names,
+  // launch contexts, and metrics of all scopes first
+  std::unordered_map<size_t, std::string> scopeNames;
+  std::unordered_map<size_t, std::string> launchContexts;
+  std::unordered_map<size_t, size_t> parentIds;
+  std::unordered_map<size_t, std::map<std::string, FlexibleMetric>>
+      scopeMetrics;
+  std::unordered_set<size_t> scopesWithEvents;
+  std::vector<const Event *> kernels;
+  for (auto &buffer : buffers) {
+    buffer->forEach([&](const Event &event) {
+      switch (event.kind) {
+      case Event::Kind::ScopeEnter:
+      case Event::Kind::OpEnter:
+        scopeNames[event.scopeId] = event.name;
+        scopesWithEvents.insert(event.scopeId);
+        break;
+      case Event::Kind::Launch:
+        launchContexts[event.scopeId] = event.name;
+        break;
+      case Event::Kind::Child:
+        scopeNames[event.scopeId] = event.name;
+        parentIds[event.scopeId] = event.parentId;
+        break;
+      case Event::Kind::Kernel:
+        scopesWithEvents.insert(event.scopeId);
+        kernels.push_back(&event);
+        break;
+      case Event::Kind::Metrics: {
+        auto &metrics = scopeMetrics[event.scopeId];
+        for (auto &[metricName, metricValue] : event.metrics) {
+          auto it = metrics.find(metricName);
+          if (it == metrics.end())
+            metrics.emplace(metricName, FlexibleMetric(metricName, metricValue,
+                                                       event.aggregable));
+          else
+            it->second.updateValue(metricValue);
+        }
+        break;
+      }
+      default:
+        break;
+      }
+    });
+  }
+
+  auto getScopeArgs = [&](size_t scopeId) {
+    json args = {{"scope_id", scopeId}};
+    auto metricsIt = scopeMetrics.find(scopeId);
+    if (metricsIt != scopeMetrics.end()) {
+      for (auto &[metricName, metric] : metricsIt->second)
+        std::visit([&](auto &&value) { args[metricName] = value; },
+                   metric.getValues()[0]);
+    }
+    return args;
+  };
+
+  json traceEvents = json::array();
+  const int hostPid = 0;
+  traceEvents.push_back({{"name", "process_name"},
+                         {"ph", "M"},
+                         {"pid", hostPid},
+                         {"args", {{"name", "Host"}}}});
+  for (auto &buffer : buffers) {
+    auto tid = buffer->threadIndex;
+    traceEvents.push_back(
+        {{"name", "thread_name"},
+         {"ph", "M"},
+         {"pid", hostPid},
+         {"tid", tid},
+         {"args", {{"name", "Thread " + std::to_string(tid)}}}});
+    buffer->forEach([&](const Event &event) {
+      json traceEvent = {{"name", event.name},
+                         {"ts", toMicroseconds(event.startTime)},
+                         {"pid", hostPid},
+                         {"tid", tid}};
+      switch (event.kind) {
+      case Event::Kind::ScopeEnter:
+      case Event::Kind::OpEnter:
+        traceEvent["ph"] = "B";
+        traceEvent["cat"] =
+            event.kind == Event::Kind::ScopeEnter ? "scope" : "op";
+        traceEvent["args"] = getScopeArgs(event.scopeId);
+        break;
+      case Event::Kind::ScopeExit:
+      case Event::Kind::OpExit:
+        traceEvent["ph"] = "E";
+        traceEvent["cat"] =
+            event.kind == Event::Kind::ScopeExit ? "scope" : "op";
+        break;
+      case Event::Kind::Metrics:
+        // Metrics of scopes without any event of their own
+        if (scopesWithEvents.count(event.scopeId))
+          return;
+        traceEvent["name"] = "metrics";
+        traceEvent["ph"] = "i";
+        traceEvent["s"] = "t";
+        traceEvent["args"] = {{"scope_id", event.scopeId}};
+        for (auto &[metricName, metricValue] : event.metrics)
+          std::visit(
+              [&](auto &&value) { traceEvent["args"][metricName] = value; },
+              metricValue);
+        break;
+      default:
+        return;
+      }
+      traceEvents.push_back(std::move(traceEvent));
+    });
+  }
+
+  // Kernels get one process per device. Concurrent kernels are spread over
+  // as many rows as needed so that their overlap stays visible.
+  std::stable_sort(kernels.begin(), kernels.end(),
+                   [](const Event *lhs, const Event *rhs) {
+                     return lhs->startTime < rhs->startTime;
+                   });
+  std::map<std::pair<uint64_t, uint64_t>, int> devicePids;
+  std::map<int, std::vector<uint64_t>> deviceRowEnds;
+  for (auto *kernel : kernels) {
+    auto device = std::make_pair(kernel->deviceType, kernel->deviceId);
+    auto pidIt = devicePids.find(device);
+    if (pidIt == devicePids.end()) {
+      auto pid = static_cast<int>(devicePids.size()) + 1;
+      pidIt = devicePids.emplace(device, pid).first;
+      auto deviceName =
+          getDeviceTypeString(static_cast<DeviceType>(kernel->deviceType)) +
+          " " + std::to_string(kernel->deviceId);
+      traceEvents.push_back({{"name", "process_name"},
+                             {"ph", "M"},
+                             {"pid", pid},
+                             {"args", {{"name", deviceName}}}});
+    }
+    auto pid = pidIt->second;
+    auto &rowEnds = deviceRowEnds[pid];
+    size_t row = std::find_if(rowEnds.begin(), rowEnds.end(),
+                              [&](uint64_t end) {
+                                return end <= kernel->startTime;
+                              }) -
+                 rowEnds.begin();
+    if (row == rowEnds.size())
+      rowEnds.push_back(kernel->endTime);
+    else
+      rowEnds[row] = kernel->endTime;
+
+    auto args = getScopeArgs(kernel->scopeId);
+    auto launchId = kernel->scopeId;
+    auto parentIt = parentIds.find(kernel->scopeId);
+    if (parentIt != parentIds.end()) {
+      launchId = parentIt->second;
+      auto parentNameIt = scopeNames.find(launchId);
+      if (parentNameIt != scopeNames.end())
+        args["parent"] = parentNameIt->second;
+    }
+    auto contextIt = launchContexts.find(launchId);
+    if (contextIt != launchContexts.end() && !contextIt->second.empty())
+      args["context"] = contextIt->second;
+    auto nameIt = scopeNames.find(kernel->scopeId);
+    traceEvents.push_back(
+        {{"name", nameIt != scopeNames.end() ? nameIt->second : "kernel"},
+         {"cat", "kernel"},
+         {"ph", "X"},
+         {"ts", toMicroseconds(kernel->startTime)},
+         {"dur", toMicroseconds(kernel->endTime - kernel->startTime)},
+         {"pid", pid},
+         {"tid", row},
+         {"args", std::move(args)}});
+  }
+
+  json output = {{"traceEvents", std::move(traceEvents)},
+                 {"displayTimeUnit", "ns"}};
+  os << output.dump() << std::endl;
 }
 
 void TraceData::doDump(std::ostream &os, OutputFormat outputFormat) const {
-  throw NotImplemented();
+  if (outputFormat == OutputFormat::ChromeTrace) {
+    dumpChromeTrace(os);
+  } else {
+    throw std::logic_error("OutputFormat not supported");
+  }
+}
+
+TraceData::TraceData(const std::string &path, ContextSource *contextSource)
+    : Data(path, contextSource), traceId(traceIdCounter++) {
+  auto &liveTraceIds = getLiveTraceIds();
+  std::lock_guard<std::mutex> lock(liveTraceIds.mutex);
+  liveTraceIds.ids.insert(traceId);
+}
+
+TraceData::~TraceData() {
+  auto &liveTraceIds = getLiveTraceIds();
+  std::lock_guard<std::mutex> lock(liveTraceIds.mutex);
+  liveTraceIds.ids.erase(traceId);
 }
 
 } // namespace proton
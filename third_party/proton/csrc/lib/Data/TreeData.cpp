@@ -4,11 +4,19 @@
 #include "Driver/Device.h"
 #include "nlohmann/json.hpp"
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iterator>
 #include <limits>
 #include <map>
 #include <mutex>
 #include <set>
+#include <shared_mutex>
 #include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
 
 using json = nlohmann::json;
 
@@ -21,57 +29,100 @@ public:
     inline static const size_t DummyId = std::numeric_limits<size_t>::max();
 
     TreeNode() = default;
-    explicit TreeNode(size_t id, const std::string &name)
-        : id(id), Context(name) {}
-    TreeNode(size_t id, size_t parentId, const std::string &name)
-        : id(id), parentId(parentId), Context(name) {}
     virtual ~TreeNode() = default;
 
-    void addChild(const Context &context, size_t id) { children[context] = id; }
-
-    bool hasChild(const Context &context) const {
-      return children.find(context) != children.end();
+    /// Returns the child with the given interned context id, or DummyId.
+    size_t getChild(size_t contextId) const {
+      if (childSlots.empty())
+        return DummyId;
+      auto mask = childSlots.size() - 1;
+      for (auto slot = hashContextId(contextId) & mask;;
+           slot = (slot + 1) & mask) {
+        auto [slotContextId, childId] = childSlots[slot];
+        if (slotContextId == contextId)
+          return childId;
+        if (slotContextId == DummyId)
+          return DummyId;
+      }
     }
 
-    size_t getChild(const Context &context) const {
-      return children.at(context);
+    void addChild(size_t contextId, size_t childId) {
+      children.emplace_back(contextId, childId);
+      // Keep the load factor at or below 1/2 so that probes stay short
+      if (2 * children.size() > childSlots.size()) {
+        childSlots.assign(std::max<size_t>(8, 2 * childSlots.size()),
+                          {DummyId, DummyId});
+        for (auto [childContextId, id] : children)
+          insertChildSlot(childContextId, id);
+      } else {
+        insertChildSlot(contextId, childId);
+      }
     }
 
     size_t parentId = DummyId;
     size_t id = DummyId;
-    std::map<Context, size_t> children = {};
-    std::map<MetricKind, std::shared_ptr<Metric>> metrics = {};
+    // <context id, child id> in insertion order
+    std::vector<std::pair<size_t, size_t>> children = {};
+    std::array<std::shared_ptr<Metric>, static_cast<size_t>(MetricKind::Count)>
+        metrics = {};
     std::map<std::string, FlexibleMetric> flexibleMetrics = {};
+    // Guards metrics and flexibleMetrics
+    std::mutex metricMutex;
     friend class Tree;
+
+  private:
+    static size_t hashContextId(size_t contextId) {
+      // Context ids are dense, so spread them over the table
+      return (contextId * 0x9E3779B97F4A7C15ull) >> 32;
+    }
+
+    void insertChildSlot(size_t contextId, size_t childId) {
+      auto mask = childSlots.size() - 1;
+      auto slot = hashContextId(contextId) & mask;
+      while (childSlots[slot].first != DummyId)
+        slot = (slot + 1) & mask;
+      childSlots[slot] = {contextId, childId};
+    }
+
+    // Open addressing table of <context id, child id>
+    std::vector<std::pair<size_t, size_t>> childSlots = {};
   };
 
-  Tree() {
-    treeNodeMap.try_emplace(TreeNode::RootId, TreeNode::RootId, "ROOT");
+  Tree() { newNode(TreeNode::DummyId, "ROOT"); }
+
+  /// Returns the node at the end of the interned `contextIds` under
+  /// `parentId`, adding the missing nodes along the way.
+  /// [MT] Lookups of existing nodes proceed in parallel; only insertions are
+  /// exclusive.
+  size_t addNode(const std::vector<size_t> &contextIds,
+                 size_t parentId = TreeNode::RootId) {
+    return addNode(contextIds.data(), contextIds.size(), parentId);
   }
 
-  size_t addNode(const Context &context, size_t parentId) {
-    if (treeNodeMap[parentId].hasChild(context)) {
-      return treeNodeMap[parentId].getChild(context);
-    }
-    auto id = nextContextId++;
-    treeNodeMap.try_emplace(id, id, parentId, context.name);
-    treeNodeMap[parentId].addChild(context, id);
-    return id;
+  size_t addNode(size_t contextId, size_t parentId) {
+    return addNode(&contextId, 1, parentId);
   }
 
-  size_t addNode(const std::vector<Context> &indices) {
-    auto parentId = TreeNode::RootId;
-    for (auto index : indices) {
-      parentId = addNode(index, parentId);
-    }
-    return parentId;
+  /// Calls `fn` on the node with exclusive access to its metrics.
+  template <typename FnT> void updateNode(size_t id, FnT &&fn) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto &node = getNode(id);
+    std::lock_guard<std::mutex> nodeLock(node.metricMutex);
+    fn(node);
   }
 
-  TreeNode &getNode(size_t id) { return treeNodeMap.at(id); }
+  size_t size() {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return numNodes;
+  }
 
   enum class WalkPolicy { PreOrder, PostOrder };
 
+  /// Calls `fn(node, children)` on every node, where `children` are the ids
+  /// of the node's children sorted by name. Insertions are blocked during the
+  /// walk.
   template <WalkPolicy walkPolicy, typename FnT> void walk(FnT &&fn) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
     if constexpr (walkPolicy == WalkPolicy::PreOrder) {
       walkPreOrder(TreeNode::RootId, fn);
     } else if constexpr (walkPolicy == WalkPolicy::PostOrder) {
@@ -79,204 +130,717 @@ public:
     }
   }
 
+private:
+  inline static const size_t NodesPerChunk = 256;
+
+  TreeNode &getNode(size_t id) {
+    return chunks[id / NodesPerChunk][id % NodesPerChunk];
+  }
+
+  size_t newNode(size_t parentId, const std::string &name) {
+    auto id = numNodes++;
+    if (id % NodesPerChunk == 0)
+      chunks.push_back(std::make_unique<TreeNode[]>(NodesPerChunk));
+    auto &node = getNode(id);
+    node.id = id;
+    node.parentId = parentId;
+    node.name = name;
+    return id;
+  }
+
+  // Follows `contextIds` from `nodeId` as far as the nodes exist. Returns the
+  // last node found and the number of contexts matched.
+  std::pair<size_t, size_t> findNode(const size_t *contextIds,
+                                     size_t numContexts, size_t nodeId) {
+    size_t depth = 0;
+    for (; depth < numContexts; ++depth) {
+      auto childId = getNode(nodeId).getChild(contextIds[depth]);
+      if (childId == TreeNode::DummyId)
+        break;
+      nodeId = childId;
+    }
+    return {nodeId, depth};
+  }
+
+  size_t addNode(const size_t *contextIds, size_t numContexts,
+                 size_t parentId) {
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex);
+      auto [nodeId, depth] = findNode(contextIds, numContexts, parentId);
+      if (depth == numContexts)
+        return nodeId;
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    // Other threads may have added some of the nodes in the meantime
+    auto [nodeId, depth] = findNode(contextIds, numContexts, parentId);
+    auto &interner = ContextInterner::instance();
+    for (; depth < numContexts; ++depth) {
+      auto contextId = contextIds[depth];
+      auto childId = newNode(nodeId, interner.getName(contextId));
+      getNode(nodeId).addChild(contextId, childId);
+      nodeId = childId;
+    }
+    return nodeId;
+  }
+
+  std::vector<size_t> getSortedChildren(size_t id) {
+    std::vector<size_t> children;
+    for (auto [contextId, childId] : getNode(id).children)
+      children.push_back(childId);
+    std::sort(children.begin(), children.end(), [&](size_t lhs, size_t rhs) {
+      return getNode(lhs).name < getNode(rhs).name;
+    });
+    return children;
+  }
+
   template <typename FnT> void walkPreOrder(size_t contextId, FnT &&fn) {
-    fn(getNode(contextId));
-    for (auto &child : getNode(contextId).children) {
-      walkPreOrder(child.second, fn);
+    auto children = getSortedChildren(contextId);
+    fn(getNode(contextId), children);
+    for (auto childId : children) {
+      walkPreOrder(childId, fn);
     }
   }
 
   template <typename FnT> void walkPostOrder(size_t contextId, FnT &&fn) {
-    for (auto &child : getNode(contextId).children) {
-      walkPostOrder(child.second, fn);
+    auto children = getSortedChildren(contextId);
+    for (auto childId : children) {
+      walkPostOrder(childId, fn);
     }
-    fn(getNode(contextId));
+    fn(getNode(contextId), children);
   }
 
-private:
-  size_t nextContextId = TreeNode::RootId + 1;
-  // tree node id->tree node
-  std::map<size_t, TreeNode> treeNodeMap;
+  // Guards the structure of the tree: the node arena and the children of each
+  // node
+  std::shared_mutex mutex;
+  // Nodes are allocated in fixed size chunks, so they never move
+  std::vector<std::unique_ptr<TreeNode[]>> chunks;
+  size_t numNodes = 0;
 };
 
 void TreeData::init() { tree = std::make_unique<Tree>(); }
 
 void TreeData::startOp(const Scope &scope) {
   // enterOp and addMetric maybe called from different threads
-  std::unique_lock<std::shared_mutex> lock(mutex);
-  std::vector<Context> contexts;
+  std::vector<size_t> contextIds;
   if (contextSource != nullptr)
-    contexts = contextSource->getContexts();
-  contexts.push_back(Context(scope.name));
-  auto contextId = tree->addNode(contexts);
-  scopeIdToContextId[scope.scopeId] = contextId;
+    contextIds = contextSource->getContextIds();
+  contextIds.push_back(ContextInterner::instance().intern(scope.name));
+  auto contextId = tree->addNode(contextIds);
+  scopeIdToContextId.insert(scope.scopeId, contextId);
 }
 
 void TreeData::stopOp(const Scope &scope) {}
 
 size_t TreeData::addScope(size_t parentScopeId, const std::string &name) {
-  std::unique_lock<std::shared_mutex> lock(mutex);
-  auto scopeIdIt = scopeIdToContextId.find(parentScopeId);
   auto scopeId = parentScopeId;
-  if (scopeIdIt == scopeIdToContextId.end()) {
-    std::vector<Context> contexts;
+  if (!scopeIdToContextId.contain(parentScopeId)) {
+    std::vector<size_t> contextIds;
     if (contextSource != nullptr)
-      contexts = contextSource->getContexts();
+      contextIds = contextSource->getContextIds();
     // Record the parent context
-    scopeIdToContextId[parentScopeId] = tree->addNode(contexts);
+    scopeIdToContextId.insert(parentScopeId, tree->addNode(contextIds));
   } else {
     // Add a new context under it and update the context
+    auto parentContextId = scopeIdToContextId.at(parentScopeId);
     scopeId = Scope::getNewScopeId();
-    scopeIdToContextId[scopeId] =
-        tree->addNode(Context(name), scopeIdIt->second);
+    scopeIdToContextId.insert(
+        scopeId, tree->addNode(ContextInterner::instance().intern(name),
+                               parentContextId));
   }
   return scopeId;
 }
 
 void TreeData::addMetric(size_t scopeId, std::shared_ptr<Metric> metric) {
-  std::unique_lock<std::shared_mutex> lock(mutex);
-  auto scopeIdIt = scopeIdToContextId.find(scopeId);
   // The profile data is deactived, ignore the metric
-  if (scopeIdIt == scopeIdToContextId.end())
+  if (!scopeIdToContextId.contain(scopeId))
     return;
-  auto contextId = scopeIdIt->second;
-  auto &node = tree->getNode(contextId);
-  if (node.metrics.find(metric->getKind()) == node.metrics.end())
-    node.metrics.emplace(metric->getKind(), metric);
-  else
-    node.metrics[metric->getKind()]->updateMetric(*metric);
+  addNodeMetric(scopeIdToContextId.at(scopeId), metric);
+}
+
+void TreeData::addCurrentMetric(std::shared_ptr<Metric> metric) {
+  std::vector<size_t> contextIds;
+  if (contextSource != nullptr)
+    contextIds = contextSource->getContextIds();
+  addNodeMetric(tree->addNode(contextIds), metric);
+}
+
+void TreeData::addNodeMetric(size_t contextId,
+                             std::shared_ptr<Metric> metric) {
+  tree->updateNode(contextId, [&](Tree::TreeNode &node) {
+    auto &slot = node.metrics[static_cast<size_t>(metric->getKind())];
+    if (!slot)
+      slot = metric;
+    else
+      slot->updateMetric(*metric);
+  });
 }
 
 void TreeData::addMetrics(size_t scopeId,
                           const std::map<std::string, MetricValueType> &metrics,
                           bool aggregable) {
-  std::unique_lock<std::shared_mutex> lock(mutex);
-  auto scopeIdIt = scopeIdToContextId.find(scopeId);
   auto contextId = Tree::TreeNode::DummyId;
-  if (scopeIdIt == scopeIdToContextId.end()) {
+  if (!scopeIdToContextId.contain(scopeId)) {
     if (contextSource == nullptr)
       throw std::runtime_error("ContextSource is not set");
     // Attribute the metric to the last context
-    std::vector<Context> contexts = contextSource->getContexts();
-    contextId = tree->addNode(contexts);
+    contextId = tree->addNode(contextSource->getContextIds());
   } else {
-    contextId = scopeIdIt->second;
-  }
-  auto &node = tree->getNode(contextId);
-  for (auto [metricName, metricValue] : metrics) {
-    if (node.flexibleMetrics.find(metricName) == node.flexibleMetrics.end())
-      node.flexibleMetrics.emplace(
-          metricName, FlexibleMetric(metricName, metricValue, aggregable));
-    else {
-      node.flexibleMetrics.at(metricName).updateValue(metricValue);
+    contextId = scopeIdToContextId.at(scopeId);
+  }
+  tree->updateNode(contextId, [&](Tree::TreeNode &node) {
+    for (auto [metricName, metricValue] : metrics) {
+      if (node.flexibleMetrics.find(metricName) == node.flexibleMetrics.end())
+        node.flexibleMetrics.emplace(
+            metricName, FlexibleMetric(metricName, metricValue, aggregable));
+      else {
+        node.flexibleMetrics.at(metricName).updateValue(metricValue);
+      }
+    }
+  });
+}
+
+namespace {
+
+// A streamed scope may still receive metrics from kernels that complete after
+// the flush that follows its launch, so it is kept for a while longer
+const auto ScopeRetention = std::chrono::seconds(10);
+
+// Approximate size of a scope id -> context id entry, including its hash node
+const size_t ScopeEntryBytes = 64;
+
+// device type -> device ids
+using DeviceIds = std::map<uint64_t, std::set<uint64_t>>;
+
+// Calls `fn(valueName, value, aggregable)` on every value reported for the
+// node, and records the devices that its kernels ran on
+template <typename TreeNodeT, typename FnT>
+void visitNodeMetrics(TreeNodeT &node, DeviceIds &deviceIds, FnT &&fn) {
+  for (auto &metric : node.metrics) {
+    if (!metric)
+      continue;
+    if (metric->getKind() == MetricKind::Host) {
+      auto hostMetric = std::dynamic_pointer_cast<HostMetric>(metric);
+      for (int valueId = 0; valueId < HostMetric::Count; ++valueId) {
+        if (hostMetric->isReported(valueId))
+          fn(hostMetric->getValueName(valueId), hostMetric->getValue(valueId),
+             /*aggregable=*/true);
+      }
+      continue;
     }
+    if (metric->getKind() != MetricKind::Kernel)
+      throw std::runtime_error("MetricKind not supported");
+    auto kernelMetric = std::dynamic_pointer_cast<KernelMetric>(metric);
+    auto deviceId =
+        std::get<uint64_t>(kernelMetric->getValue(KernelMetric::DeviceId));
+    auto deviceType =
+        std::get<uint64_t>(kernelMetric->getValue(KernelMetric::DeviceType));
+    for (auto valueId : {KernelMetric::Duration, KernelMetric::Invocations})
+      fn(kernelMetric->getValueName(valueId), kernelMetric->getValue(valueId),
+         /*aggregable=*/true);
+    fn(kernelMetric->getValueName(KernelMetric::DeviceId),
+       std::to_string(deviceId), /*aggregable=*/false);
+    fn(kernelMetric->getValueName(KernelMetric::DeviceType),
+       getDeviceTypeString(static_cast<DeviceType>(deviceType)),
+       /*aggregable=*/false);
+    deviceIds[deviceType].insert(deviceId);
   }
+  for (auto &[_, flexibleMetric] : node.flexibleMetrics)
+    fn(flexibleMetric.getValueName(0), flexibleMetric.getValues()[0],
+       flexibleMetric.isAggregable(0));
 }
 
-void TreeData::dumpHatchet(std::ostream &os) const {
+// Calls `fn(valueName, distribution)` on every value of the node whose
+// distribution is kept
+template <typename TreeNodeT, typename FnT>
+void visitNodeDistributions(TreeNodeT &node, FnT &&fn) {
+  for (auto &metric : node.metrics) {
+    if (!metric)
+      continue;
+    for (size_t valueId = 0; valueId < metric->getValues().size(); ++valueId) {
+      auto *distribution = metric->getDistribution(valueId);
+      if (distribution && !distribution->empty())
+        fn(metric->getValueName(valueId), *distribution);
+    }
+  }
+}
+
+json getDistributionJson(const LogHistogram &distribution) {
+  return {{"bucket_bits", LogHistogram::SubBucketBits},
+          {"first_bucket", distribution.getFirstBucket()},
+          {"counts", distribution.getCounts()},
+          {"min", distribution.getMin()},
+          {"max", distribution.getMax()}};
+}
+
+// Clears the metrics that a streamed part has reported for the node, except
+// for its properties which do not change over time
+template <typename TreeNodeT>
+void resetNodeMetrics(TreeNodeT &node) {
+  for (auto &metric : node.metrics)
+    metric.reset();
+  for (auto it = node.flexibleMetrics.begin();
+       it != node.flexibleMetrics.end();) {
+    if (it->second.isAggregable(0))
+      it = node.flexibleMetrics.erase(it);
+    else
+      ++it;
+  }
+}
+
+// Removes the subtrees without any metrics and returns whether `jsonNode` is
+// left with anything to report
+bool pruneHatchet(json &jsonNode) {
+  auto &children = jsonNode["children"];
+  for (auto it = children.begin(); it != children.end();) {
+    if (pruneHatchet(*it))
+      ++it;
+    else
+      it = children.erase(it);
+  }
+  return !children.empty() || !jsonNode["metrics"].empty();
+}
+
+json getDeviceInfo(const DeviceIds &deviceIds) {
+  // Note that this is done from the application thread,
+  // query device information from the tool thread (e.g., CUPTI) will have
+  // problems
+  json deviceJson = json::object();
+  for (auto &[deviceType, ids] : deviceIds) {
+    auto deviceTypeName =
+        getDeviceTypeString(static_cast<DeviceType>(deviceType));
+    if (!deviceJson.contains(deviceTypeName))
+      deviceJson[deviceTypeName] = json::object();
+    for (auto deviceId : ids) {
+      Device device = getDevice(static_cast<DeviceType>(deviceType), deviceId);
+      deviceJson[deviceTypeName][std::to_string(deviceId)] = {
+          {"clock_rate", device.clockRate},
+          {"memory_clock_rate", device.memoryClockRate},
+          {"bus_width", device.busWidth},
+          {"arch", device.arch},
+          {"num_sms", device.numSms}};
+    }
+  }
+  return deviceJson;
+}
+
+// The binary format is a columnar layout meant to be mapped into memory:
+//
+//   BinaryHeader
+//   Strings: uint64_t offsets[numStrings + 1] into the UTF-8 bytes that
+//            follow them
+//   Nodes:   uint64_t parents[numNodes], then uint64_t names[numNodes]
+//   Columns: BinaryColumn[numColumns], then for each column a presence bitmap
+//            of (numNodes + 63) / 64 uint64_t words followed by numNodes
+//            values of 8 bytes
+//
+// The values of distribution columns are strings holding the histogram in
+// JSON, as it is written in hatchet profiles. Nodes are numbered in pre-order,
+// so the root is node 0 and parents come before their children. Strings are
+// referred to by their index, every section is 8-byte aligned, and integers
+// are stored in the native byte order.
+// proton/viewer.py reads the same layout.
+const char BinaryMagic[8] = {'P', 'R', 'O', 'T', 'O', 'N', 'B', 'F'};
+const uint32_t BinaryVersion = 2;
+const uint64_t BinaryNoParent = std::numeric_limits<uint64_t>::max();
+
+struct BinaryHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t numColumns;
+  uint64_t numNodes;
+  uint64_t numStrings;
+  uint64_t stringsOffset;
+  uint64_t nodesOffset;
+  uint64_t columnsOffset;
+  // The device information in JSON
+  uint64_t deviceInfo;
+};
+
+enum class BinaryColumnType : uint32_t {
+  UInt64,
+  Int64,
+  Double,
+  String,
+  Distribution
+};
+
+enum BinaryColumnFlags : uint32_t { BinaryPropertyColumn = 1 };
+
+struct BinaryColumn {
+  uint64_t name;
+  BinaryColumnType type;
+  uint32_t flags;
+  uint64_t offset;
+};
+
+static_assert(sizeof(BinaryHeader) == 64 && sizeof(BinaryColumn) == 24,
+              "The binary layout must not have padding");
+
+/// Collects the tables of a binary profile and writes them out.
+class BinaryProfileWriter {
+public:
+  size_t addNode(uint64_t parent, const std::string &name) {
+    parents.push_back(parent);
+    names.push_back(getString(name));
+    return parents.size() - 1;
+  }
+
+  void setValue(size_t node, const std::string &valueName,
+                const MetricValueType &value, bool aggregable) {
+    auto type = getType(value);
+    auto &column = columns[valueName];
+    if (column.values.empty()) {
+      column.type = type;
+    } else if (column.type != type) {
+      // Numbers of different types are stored as doubles, and anything mixed
+      // with strings as strings
+      auto promotedType = column.type == BinaryColumnType::String ||
+                                  type == BinaryColumnType::String
+                              ? BinaryColumnType::String
+                              : BinaryColumnType::Double;
+      convertColumn(column, promotedType);
+      type = promotedType;
+    }
+    column.property |= !aggregable;
+    setBits(column, node, encode(type, convert(value, type)));
+  }
+
+  void setDistribution(size_t node, const std::string &valueName,
+                       const LogHistogram &distribution) {
+    // Distributions are named after their value, so they are kept apart
+    auto &column = distributionColumns[valueName];
+    column.type = BinaryColumnType::Distribution;
+    setBits(column, node, getString(getDistributionJson(distribution).dump()));
+  }
+
+  void write(std::ostream &os, const std::string &deviceInfo) {
+    auto numNodes = parents.size();
+    auto numWords = (numNodes + 63) / 64;
+    // Numeric columns are listed on the root, as hatchet profiles do. Zero is
+    // all bits cleared for each numeric type.
+    for (auto &[_, column] : columns) {
+      if (column.type != BinaryColumnType::String && numNodes > 0 &&
+          !(column.present[0] & 1)) {
+        column.values[0] = 0;
+        column.present[0] |= 1;
+      }
+    }
+
+    // All strings are interned before the string table is laid out
+    std::vector<BinaryColumn> columnHeaders;
+    std::vector<Column *> allColumns;
+    for (auto *columnMap : {&columns, &distributionColumns}) {
+      for (auto &[valueName, column] : *columnMap) {
+        columnHeaders.push_back({getString(valueName), column.type,
+                                 column.property ? BinaryPropertyColumn : 0u,
+                                 /*offset=*/0});
+        allColumns.push_back(&column);
+      }
+    }
+
+    BinaryHeader header{};
+    std::copy(std::begin(BinaryMagic), std::end(BinaryMagic), header.magic);
+    header.version = BinaryVersion;
+    header.deviceInfo = getString(deviceInfo);
+    header.numColumns = columnHeaders.size();
+    header.numNodes = numNodes;
+    header.numStrings = strings.size();
+    std::vector<uint64_t> stringOffsets = {0};
+    for (auto &string : strings)
+      stringOffsets.push_back(stringOffsets.back() + string.size());
+    auto stringBytes = alignTo8(stringOffsets.back());
+    header.stringsOffset = sizeof(BinaryHeader);
+    header.nodesOffset =
+        header.stringsOffset + stringOffsets.size() * 8 + stringBytes;
+    header.columnsOffset = header.nodesOffset + 2 * numNodes * 8;
+
+    auto offset =
+        header.columnsOffset + columnHeaders.size() * sizeof(BinaryColumn);
+    for (auto &columnHeader : columnHeaders) {
+      columnHeader.offset = offset;
+      offset += (numWords + numNodes) * 8;
+    }
+
+    writeBytes(os, &header, sizeof(header));
+    writeVector(os, stringOffsets);
+    for (auto &string : strings)
+      writeBytes(os, string.data(), string.size());
+    writeBytes(os, Padding, stringBytes - stringOffsets.back());
+    writeVector(os, parents);
+    writeVector(os, names);
+    writeVector(os, columnHeaders);
+    for (auto *column : allColumns) {
+      column->present.resize(numWords);
+      column->values.resize(numNodes);
+      writeVector(os, column->present);
+      writeVector(os, column->values);
+    }
+  }
+
+private:
+  struct Column {
+    BinaryColumnType type{};
+    bool property{};
+    std::vector<uint64_t> present;
+    std::vector<uint64_t> values;
+  };
+
+  inline static const char Padding[8] = {};
+
+  static uint64_t alignTo8(uint64_t size) { return (size + 7) & ~uint64_t(7); }
+
+  static void setBits(Column &column, size_t node, uint64_t bits) {
+    if (column.values.size() <= node) {
+      column.values.resize(node + 1);
+      column.present.resize(node / 64 + 1);
+    }
+    column.values[node] = bits;
+    column.present[node / 64] |= uint64_t(1) << (node % 64);
+  }
+
+  static void writeBytes(std::ostream &os, const void *data, size_t size) {
+    os.write(static_cast<const char *>(data), size);
+  }
+
+  template <typename T>
+  static void writeVector(std::ostream &os, const std::vector<T> &vector) {
+    writeBytes(os, vector.data(), vector.size() * sizeof(T));
+  }
+
+  static BinaryColumnType getType(const MetricValueType &value) {
+    return std::visit(
+        [](auto &&v) {
+          using T = std::decay_t<decltype(v)>;
+          if constexpr (std::is_same_v<T, uint64_t>)
+            return BinaryColumnType::UInt64;
+          else if constexpr (std::is_same_v<T, int64_t>)
+            return BinaryColumnType::Int64;
+          else if constexpr (std::is_same_v<T, double>)
+            return BinaryColumnType::Double;
+          else
+            return BinaryColumnType::String;
+        },
+        value);
+  }
+
+  static MetricValueType convert(const MetricValueType &value,
+                                 BinaryColumnType type) {
+    if (getType(value) == type)
+      return value;
+    return std::visit(
+        [&](auto &&v) -> MetricValueType {
+          using T = std::decay_t<decltype(v)>;
+          if constexpr (std::is_same_v<T, std::string>)
+            return v;
+          else if (type == BinaryColumnType::String)
+            return std::to_string(v);
+          else
+            return static_cast<double>(v);
+        },
+        value);
+  }
+
+  uint64_t encode(BinaryColumnType type, const MetricValueType &value) {
+    switch (type) {
+    case BinaryColumnType::UInt64:
+      return std::get<uint64_t>(value);
+    case BinaryColumnType::Int64:
+      return static_cast<uint64_t>(std::get<int64_t>(value));
+    case BinaryColumnType::Double: {
+      uint64_t bits;
+      auto number = std::get<double>(value);
+      std::memcpy(&bits, &number, sizeof(bits));
+      return bits;
+    }
+    default:
+      return getString(std::get<std::string>(value));
+    }
+  }
+
+  MetricValueType decode(BinaryColumnType type, uint64_t bits) const {
+    switch (type) {
+    case BinaryColumnType::UInt64:
+      return bits;
+    case BinaryColumnType::Int64:
+      return static_cast<int64_t>(bits);
+    case BinaryColumnType::Double: {
+      double number;
+      std::memcpy(&number, &bits, sizeof(number));
+      return number;
+    }
+    default:
+      return strings[bits];
+    }
+  }
+
+  void convertColumn(Column &column, BinaryColumnType type) {
+    for (size_t node = 0; node < column.values.size(); ++node) {
+      if (column.present[node / 64] & (uint64_t(1) << (node % 64)))
+        column.values[node] = encode(
+            type, convert(decode(column.type, column.values[node]), type));
+    }
+    column.type = type;
+  }
+
+  uint64_t getString(const std::string &string) {
+    auto [it, inserted] = stringIds.try_emplace(string, strings.size());
+    if (inserted)
+      strings.push_back(string);
+    return it->second;
+  }
+
+  std::vector<uint64_t> parents;
+  std::vector<uint64_t> names;
+  std::map<std::string, Column> columns;
+  std::map<std::string, Column> distributionColumns;
+  std::vector<std::string> strings;
+  std::unordered_map<std::string, uint64_t> stringIds;
+};
+
+// Writes the tree in the hatchet format. When `flush` is set, each node's
+// aggregable metrics are reset right after it is written. The walk blocks
+// updateNode, so no metric can land between the two.
+template <typename TreeT>
+void writeHatchet(TreeT &tree, std::ostream &os, bool flush) {
   std::map<size_t, json *> jsonNodes;
   json output = json::array();
   output.push_back(json::object());
-  jsonNodes[Tree::TreeNode::RootId] = &(output.back());
+  jsonNodes[TreeT::TreeNode::RootId] = &(output.back());
   std::set<std::string> valueNames;
-  std::map<uint64_t, std::set<uint64_t>> deviceIds;
-  this->tree->template walk<Tree::WalkPolicy::PreOrder>(
-      [&](Tree::TreeNode &treeNode) {
+  std::set<std::string> propertyNames;
+  DeviceIds deviceIds;
+  tree.template walk<TreeT::WalkPolicy::PreOrder>(
+      [&](typename TreeT::TreeNode &treeNode,
+          const std::vector<size_t> &children) {
         const auto contextName = treeNode.name;
         auto contextId = treeNode.id;
         json *jsonNode = jsonNodes[contextId];
         (*jsonNode)["frame"] = {{"name", contextName}, {"type", "function"}};
         (*jsonNode)["metrics"] = json::object();
-        for (auto [metricKind, metric] : treeNode.metrics) {
-          if (metricKind == MetricKind::Kernel) {
-            auto kernelMetric = std::dynamic_pointer_cast<KernelMetric>(metric);
-            auto duration = std::get<uint64_t>(
-                kernelMetric->getValue(KernelMetric::Duration));
-            auto invocations = std::get<uint64_t>(
-                kernelMetric->getValue(KernelMetric::Invocations));
-            auto deviceId = std::get<uint64_t>(
-                kernelMetric->getValue(KernelMetric::DeviceId));
-            auto deviceType = std::get<uint64_t>(
-                kernelMetric->getValue(KernelMetric::DeviceType));
-            auto deviceTypeName =
-                getDeviceTypeString(static_cast<DeviceType>(deviceType));
-            (*jsonNode)["metrics"]
-                       [kernelMetric->getValueName(KernelMetric::Duration)] =
-                           duration;
-            (*jsonNode)["metrics"]
-                       [kernelMetric->getValueName(KernelMetric::Invocations)] =
-                           invocations;
-            (*jsonNode)["metrics"]
-                       [kernelMetric->getValueName(KernelMetric::DeviceId)] =
-                           std::to_string(deviceId);
-            (*jsonNode)["metrics"]
-                       [kernelMetric->getValueName(KernelMetric::DeviceType)] =
-                           deviceTypeName;
-            valueNames.insert(
-                kernelMetric->getValueName(KernelMetric::Duration));
-            valueNames.insert(
-                kernelMetric->getValueName(KernelMetric::Invocations));
-            deviceIds.insert({deviceType, {deviceId}});
-          } else {
-            throw std::runtime_error("MetricKind not supported");
-          }
-        }
-        for (auto [_, flexibleMetric] : treeNode.flexibleMetrics) {
-          auto valueName = flexibleMetric.getValueName(0);
-          valueNames.insert(valueName);
-          std::visit(
-              [&](auto &&value) { (*jsonNode)["metrics"][valueName] = value; },
-              flexibleMetric.getValues()[0]);
+        visitNodeMetrics(
+            treeNode, deviceIds,
+            [&](const std::string &valueName, const MetricValueType &value,
+                bool aggregable) {
+              std::visit(
+                  [&](auto &&v) { (*jsonNode)["metrics"][valueName] = v; },
+                  value);
+              if (!std::holds_alternative<std::string>(value))
+                valueNames.insert(valueName);
+            });
+        // Hatchet ignores keys besides the frame, metrics, and children, so
+        // the distributions are kept next to the metrics
+        visitNodeDistributions(treeNode, [&](const std::string &valueName,
+                                             const LogHistogram &distribution) {
+          (*jsonNode)["histograms"][valueName] =
+              getDistributionJson(distribution);
+        });
+        if (flush) {
+          for (auto &[metricName, metric] : treeNode.flexibleMetrics)
+            if (!metric.isAggregable(0))
+              propertyNames.insert(metricName);
+          resetNodeMetrics(treeNode);
         }
         (*jsonNode)["children"] = json::array();
-        auto children = treeNode.children;
         for (auto _ : children) {
           (*jsonNode)["children"].push_back(json::object());
         }
         auto idx = 0;
-        for (auto child : children) {
-          auto [index, childId] = child;
+        for (auto childId : children) {
           jsonNodes[childId] = &(*jsonNode)["children"][idx];
           idx++;
         }
       });
+  if (flush)
+    pruneHatchet(output[TreeT::TreeNode::RootId]);
   // Hints for all available metrics
   for (auto valueName : valueNames) {
-    output[Tree::TreeNode::RootId]["metrics"][valueName] = 0;
-  }
-  // Prepare the device information
-  // Note that this is done from the application thread,
-  // query device information from the tool thread (e.g., CUPTI) will have
-  // problems
-  output.push_back(json::object());
-  auto &deviceJson = output.back();
-  for (auto [deviceType, deviceIds] : deviceIds) {
-    auto deviceTypeName =
-        getDeviceTypeString(static_cast<DeviceType>(deviceType));
-    if (!deviceJson.contains(deviceTypeName))
-      deviceJson[deviceTypeName] = json::object();
-    for (auto deviceId : deviceIds) {
-      Device device = getDevice(static_cast<DeviceType>(deviceType), deviceId);
-      deviceJson[deviceTypeName][std::to_string(deviceId)] = {
-          {"clock_rate", device.clockRate},
-          {"memory_clock_rate", device.memoryClockRate},
-          {"bus_width", device.busWidth},
-          {"arch", device.arch},
-          {"num_sms", device.numSms}};
-    }
+    output[TreeT::TreeNode::RootId]["metrics"][valueName] = 0;
   }
+  output.push_back(getDeviceInfo(deviceIds));
+  // Tells the viewer which metrics to keep rather than add up when it merges
+  // the parts of a streamed profile
+  if (flush)
+    output.push_back({{"properties", propertyNames}});
   os << std::endl << output.dump(4) << std::endl;
 }
 
+} // namespace
+
+void TreeData::dumpHatchet(std::ostream &os) const {
+  writeHatchet(*tree, os, /*flush=*/false);
+}
+
+void TreeData::flushHatchet(std::ostream &os) {
+  writeHatchet(*tree, os, /*flush=*/true);
+}
+
+void TreeData::dumpBinary(std::ostream &os) const {
+  BinaryProfileWriter writer;
+  // tree node id -> binary node id
+  std::vector<uint64_t> nodeIds;
+  DeviceIds deviceIds;
+  this->tree->template walk<Tree::WalkPolicy::PreOrder>(
+      [&](Tree::TreeNode &treeNode, const std::vector<size_t> &children) {
+        auto parent = treeNode.id == Tree::TreeNode::RootId
+                          ? BinaryNoParent
+                          : nodeIds[treeNode.parentId];
+        auto node = writer.addNode(parent, treeNode.name);
+        if (nodeIds.size() <= treeNode.id)
+          nodeIds.resize(treeNode.id + 1);
+        nodeIds[treeNode.id] = node;
+        visitNodeMetrics(
+            treeNode, deviceIds,
+            [&](const std::string &valueName, const MetricValueType &value,
+                bool aggregable) {
+              writer.setValue(node, valueName, value, aggregable);
+            });
+        visitNodeDistributions(treeNode, [&](const std::string &valueName,
+                                             const LogHistogram &distribution) {
+          writer.setDistribution(node, valueName, distribution);
+        });
+      });
+  writer.write(os, getDeviceInfo(deviceIds).dump());
+}
+
 void TreeData::doDump(std::ostream &os, OutputFormat outputFormat) const {
-  std::shared_lock<std::shared_mutex> lock(mutex);
   if (outputFormat == OutputFormat::Hatchet) {
     dumpHatchet(os);
+  } else if (outputFormat == OutputFormat::Binary) {
+    dumpBinary(os);
   } else {
-    std::logic_error("OutputFormat not supported");
+    throw std::logic_error("OutputFormat not supported");
   }
 }
 
+void TreeData::doFlush(std::ostream &os, OutputFormat outputFormat) {
+  if (outputFormat == OutputFormat::Hatchet) {
+    flushHatchet(os);
+  } else {
+    throw std::logic_error("OutputFormat not supported");
+  }
+  releaseScopes();
+}
+
+void TreeData::releaseScopes() {
+  auto now = std::chrono::steady_clock::now();
+  flushedScopeIds.emplace_back(now, Scope::scopeIdCounter.load());
+  // Find the last flush that is old enough
+  size_t minScopeId = 0;
+  while (!flushedScopeIds.empty() &&
+         now - flushedScopeIds.front().first >= ScopeRetention) {
+    minScopeId = flushedScopeIds.front().second;
+    flushedScopeIds.pop_front();
+  }
+  if (minScopeId > 0)
+    scopeIdToContextId.eraseIf(
+        [&](size_t scopeId, size_t) { return scopeId < minScopeId; });
+}
+
+size_t TreeData::getMemoryUsage() const {
+  return tree->size() * sizeof(Tree::TreeNode) +
+         scopeIdToContextId.size() * ScopeEntryBytes;
+}
+
 TreeData::TreeData(const std::string &path, ContextSource *contextSource)
     : Data(path, contextSource) {
   init();
@@ -23,7 +23,8 @@ thread_local std::deque<size_t>
 
 namespace {
 
-std::shared_ptr<Metric> convertActivityToMetric(CUpti_Activity *activity) {
+std::shared_ptr<Metric> convertActivityToMetric(CUpti_Activity *activity,
+                                                uint64_t weight) {
   std::shared_ptr<Metric> metric;
   switch (activity->kind) {
   case CUPTI_ACTIVITY_KIND_KERNEL:
@@ -34,7 +35,7 @@ std::shared_ptr<Metric> convertActivityToMetric(CUpti_Activity *activity) {
           static_cast<uint64_t>(kernel->start),
           static_cast<uint64_t>(kernel->end), 1,
           static_cast<uint64_t>(kernel->deviceId),
-          static_cast<uint64_t>(DeviceType::CUDA));
+          static_cast<uint64_t>(DeviceType::CUDA), weight);
     } // else: not a valid kernel activity
     break;
   }
@@ -47,6 +48,7 @@ std::shared_ptr<Metric> convertActivityToMetric(CUpti_Activity *activity) {
 uint32_t
 processActivityKernel(CuptiProfiler::CorrIdToExternIdMap &corrIdToExternId,
                       CuptiProfiler::ApiExternIdSet &apiExternIds,
+                      CuptiProfiler::ExternIdToWeightMap &externIdToWeight,
                       std::set<Data *> &dataSet, CUpti_Activity *activity) {
   // Support CUDA >= 11.0
   auto *kernel = reinterpret_cast<CUpti_ActivityKernel5 *>(activity);
@@ -54,6 +56,7 @@ processActivityKernel(CuptiProfiler::CorrIdToExternIdMap &corrIdToExternId,
   if (/*Not a valid context*/ !corrIdToExternId.contain(correlationId))
     return correlationId;
   auto [parentId, numInstances] = corrIdToExternId.at(correlationId);
+  auto weight = externIdToWeight.at(parentId);
   if (kernel->graphId == 0) {
     // Non-graph kernels
     for (auto *data : dataSet) {
@@ -62,7 +65,7 @@ processActivityKernel(CuptiProfiler::CorrIdToExternIdMap &corrIdToExternId,
         // It's triggered by a CUDA op but not triton op
         scopeId = data->addScope(parentId, kernel->name);
       }
-      data->addMetric(scopeId, convertActivityToMetric(activity));
+      data->addMetric(scopeId, convertActivityToMetric(activity, weight));
     }
   } else {
     // Graph kernels
@@ -75,13 +78,14 @@ processActivityKernel(CuptiProfiler::CorrIdToExternIdMap &corrIdToExternId,
     // 3. corrId -> numKernels
     for (auto *data : dataSet) {
       auto externId = data->addScope(parentId, kernel->name);
-      data->addMetric(externId, convertActivityToMetric(activity));
+      data->addMetric(externId, convertActivityToMetric(activity, weight));
     }
   }
   apiExternIds.erase(parentId);
   --numInstances;
   if (numInstances == 0) {
     corrIdToExternId.erase(correlationId);
+    externIdToWeight.erase(parentId);
   } else {
     corrIdToExternId[correlationId].second = numInstances;
   }
@@ -90,13 +94,14 @@ processActivityKernel(CuptiProfiler::CorrIdToExternIdMap &corrIdToExternId,
 
 uint32_t processActivity(CuptiProfiler::CorrIdToExternIdMap &corrIdToExternId,
                          CuptiProfiler::ApiExternIdSet &apiExternIds,
+                         CuptiProfiler::ExternIdToWeightMap &externIdToWeight,
                          std::set<Data *> &dataSet, CUpti_Activity *activity) {
   auto correlationId = 0;
   switch (activity->kind) {
   case CUPTI_ACTIVITY_KIND_KERNEL:
   case CUPTI_ACTIVITY_KIND_CONCURRENT_KERNEL: {
-    correlationId = processActivityKernel(corrIdToExternId, apiExternIds,
-                                          dataSet, activity);
+    correlationId = processActivityKernel(
+        corrIdToExternId, apiExternIds, externIdToWeight, dataSet, activity);
     break;
   }
   default:
@@ -219,7 +224,9 @@ void CuptiProfiler::CuptiProfilerPimpl::completeBuffer(CUcontext ctx,
     if (status == CUPTI_SUCCESS) {
       auto correlationId =
           processActivity(profiler.correlation.corrIdToExternId,
-                          profiler.correlation.apiExternIds, dataSet, activity);
+                          profiler.correlation.apiExternIds,
+                          profiler.correlation.externIdToWeight, dataSet,
+                          activity);
       maxCorrelationId = std::max(maxCorrelationId, correlationId);
     } else if (status == CUPTI_ERROR_MAX_LIMIT_REACHED) {
       break;
@@ -269,6 +276,12 @@ void CuptiProfiler::CuptiProfilerPimpl::callbackFn(void *userData,
     const CUpti_CallbackData *callbackData =
         static_cast<const CUpti_CallbackData *>(cbData);
     if (callbackData->callbackSite == CUPTI_API_ENTER) {
+      // Skipped launches are neither attributed nor correlated, so their
+      // kernels are dropped when their activities arrive
+      auto weight = Sampler::instance().enterLaunch();
+      if (weight == 0)
+        return;
+      Sampler::Cost cost;
       auto scopeId = Scope::getNewScopeId();
       threadState.record(scopeId);
       threadState.enterOp(scopeId);
@@ -297,8 +310,13 @@ void CuptiProfiler::CuptiProfilerPimpl::callbackFn(void *userData,
                        "please start profiling before the graph is created."
                     << std::endl;
       }
-      profiler.correlation.correlate(callbackData->correlationId, numInstances);
+      profiler.correlation.correlate(callbackData->correlationId, numInstances,
+                                     weight);
     } else if (callbackData->callbackSite == CUPTI_API_EXIT) {
+      auto weight = Sampler::instance().getLaunchWeight();
+      Sampler::instance().exitLaunch();
+      if (weight == 0)
+        return;
       threadState.exitOp();
       profiler.correlation.submit(callbackData->correlationId);
     }
@@ -0,0 +1,239 @@
+#include "Profiler/HostProfiler.h"
+#include "Data/Metric.h"
+#include "Profiler/Sampler.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace proton {
+
+namespace {
+
+uint64_t getHostTime() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+using CounterValues = std::array<uint64_t, HostMetric::NumCounters>;
+
+/// The CPU counters of the calling thread, opened as a single perf_event group
+/// so that they are read together with one system call.
+class CounterGroup {
+public:
+  CounterGroup() { fds.fill(-1); }
+
+  ~CounterGroup() { close(); }
+
+  /// Opens the counters on first use and returns whether they are available.
+  bool open() {
+    if (state == State::Closed)
+      state = doOpen() ? State::Open : State::Failed;
+    return state == State::Open;
+  }
+
+  /// Reads the running totals of the counters, scaled up for the time that
+  /// the group was not scheduled on the CPU.
+  bool read(CounterValues &values) {
+#ifdef __linux__
+    struct {
+      uint64_t nr;
+      uint64_t timeEnabled;
+      uint64_t timeRunning;
+      uint64_t values[HostMetric::NumCounters];
+    } data;
+    if (::read(fds[0], &data, sizeof(data)) != sizeof(data))
+      return false;
+    for (int i = 0; i < HostMetric::NumCounters; ++i) {
+      values[i] = data.timeRunning == 0 || data.timeRunning == data.timeEnabled
+                      ? data.values[i]
+                      : static_cast<uint64_t>(
+                            static_cast<double>(data.values[i]) *
+                            data.timeEnabled / data.timeRunning);
+    }
+    return true;
+#else
+    return false;
+#endif
+  }
+
+private:
+  enum class State { Closed, Open, Failed };
+
+  bool doOpen() {
+#ifdef __linux__
+    // In the order of the counter values of HostMetric
+    const uint64_t configs[HostMetric::NumCounters] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES};
+    for (int i = 0; i < HostMetric::NumCounters; ++i) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      // Counting user space only works under the default perf_event_paranoid
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.disabled = i == 0;
+      fds[i] = syscall(SYS_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1,
+                       /*group_fd=*/i == 0 ? -1 : fds[0], /*flags=*/0);
+      if (fds[i] < 0) {
+        warn(std::strerror(errno));
+        close();
+        return false;
+      }
+    }
+    ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    warn("perf_event is only available on Linux");
+    return false;
+#endif
+  }
+
+  void close() {
+#ifdef __linux__
+    for (auto &fd : fds) {
+      if (fd >= 0)
+        ::close(fd);
+      fd = -1;
+    }
+#endif
+  }
+
+  static void warn(const char *reason) {
+    static std::once_flag warned;
+    std::call_once(warned, [&]() {
+      std::cerr << "[PROTON] Cannot read the CPU counters: " << reason
+                << ", only the host time is measured" << std::endl;
+    });
+  }
+
+  State state{State::Closed};
+  std::array<int, HostMetric::NumCounters> fds;
+};
+
+} // namespace
+
+struct HostProfiler::ThreadState {
+  struct Interval {
+    size_t scopeId;
+    uint64_t startTime;
+    uint64_t weight;
+    bool hasCounters;
+    CounterValues counters;
+    // Spent in the nested intervals, which report it themselves
+    uint64_t childTime;
+    CounterValues childCounters;
+  };
+
+  // Scopes and the op in progress, innermost last
+  std::vector<Interval> intervals;
+  CounterGroup counterGroup;
+};
+
+HostProfiler::ThreadState &HostProfiler::getThreadState() {
+  static thread_local ThreadState state;
+  return state;
+}
+
+HostProfiler *HostProfiler::setCounters(bool enabled) {
+  counters.store(enabled, std::memory_order_relaxed);
+  return this;
+}
+
+void HostProfiler::enterScope(const Scope &scope) {
+  start(scope.scopeId, /*weight=*/1);
+}
+
+void HostProfiler::exitScope(const Scope &scope) {
+  stop(scope.scopeId, /*isOp=*/false);
+}
+
+void HostProfiler::startOp(const Scope &scope) {
+  // A sampled op stands for the skipped ones, like its kernels
+  start(scope.scopeId, Sampler::instance().getLaunchWeight());
+}
+
+void HostProfiler::stopOp(const Scope &scope) {
+  stop(scope.scopeId, /*isOp=*/true);
+}
+
+void HostProfiler::start(size_t scopeId, uint64_t weight) {
+  auto &state = getThreadState();
+  ThreadState::Interval interval{scopeId, 0, weight, false, {}, 0, {}};
+  if (counters.load(std::memory_order_relaxed) && state.counterGroup.open())
+    interval.hasCounters = state.counterGroup.read(interval.counters);
+  // Read the clock last and first in stop, so that the time excludes reading
+  // the counters
+  interval.startTime = getHostTime();
+  state.intervals.push_back(interval);
+}
+
+void HostProfiler::stop(size_t scopeId, bool isOp) {
+  auto endTime = getHostTime();
+  auto &state = getThreadState();
+  // Scopes entered before the profiler was activated have no interval
+  auto it = state.intervals.end();
+  while (it != state.intervals.begin() && (it - 1)->scopeId != scopeId)
+    --it;
+  if (it == state.intervals.begin())
+    return;
+  auto interval = *(it - 1);
+  state.intervals.erase(it - 1, state.intervals.end());
+  CounterValues counters{};
+  auto hasCounters =
+      interval.hasCounters && state.counterGroup.read(counters);
+  // Without a reading at both ends there is nothing to subtract
+  if (hasCounters) {
+    for (int i = 0; i < HostMetric::NumCounters; ++i)
+      counters[i] -= interval.counters[i];
+  }
+  auto time = endTime - interval.startTime;
+  if (!state.intervals.empty()) {
+    auto &parent = state.intervals.back();
+    parent.childTime += time;
+    if (hasCounters) {
+      for (int i = 0; i < HostMetric::NumCounters; ++i)
+        parent.childCounters[i] += counters[i];
+    }
+  }
+  // Report the exclusive values, as the inclusive ones are the sums over the
+  // subtrees
+  time -= std::min(time, interval.childTime);
+  if (hasCounters) {
+    for (int i = 0; i < HostMetric::NumCounters; ++i)
+      counters[i] -= std::min(counters[i], interval.childCounters[i]);
+  }
+  for (auto *data : getDataSet()) {
+    auto metric = std::make_shared<HostMetric>(
+        time, hasCounters ? counters.data() : nullptr, interval.weight);
+    if (isOp) {
+      // The data has recorded the contexts of the op when it started
+      data->addMetric(scopeId, metric);
+    } else {
+      // The scope is still among the current contexts of the data
+      data->addCurrentMetric(metric);
+    }
+  }
+}
+
+} // namespace proton
@@ -70,7 +70,7 @@ private:
 };
 
 std::shared_ptr<Metric>
-convertActivityToMetric(const roctracer_record_t *activity) {
+convertActivityToMetric(const roctracer_record_t *activity, uint64_t weight) {
   std::shared_ptr<Metric> metric;
   switch (activity->kind) {
   case kHipVdiCommandKernel: {
@@ -79,7 +79,7 @@ convertActivityToMetric(const roctracer_record_t *activity) {
         static_cast<uint64_t>(activity->end_ns), 1,
         static_cast<uint64_t>(
             DeviceInfo::instance().mapDeviceId(activity->device_id)),
-        static_cast<uint64_t>(DeviceType::HIP));
+        static_cast<uint64_t>(DeviceType::HIP), weight);
     break;
   }
   default:
@@ -88,7 +88,8 @@ convertActivityToMetric(const roctracer_record_t *activity) {
   return metric;
 }
 
-void processActivityKernel(size_t externId, std::set<Data *> &dataSet,
+void processActivityKernel(size_t externId, uint64_t weight,
+                           std::set<Data *> &dataSet,
                            const roctracer_record_t *activity, bool isAPI) {
   if (externId == Scope::DummyScopeId)
     return;
@@ -97,16 +98,17 @@ void processActivityKernel(size_t externId, std::set<Data *> &dataSet,
     auto scopeId = externId;
     if (isAPI)
       scopeId = data->addScope(/*parentId=*/externId, activity->kernel_name);
-    data->addMetric(scopeId, convertActivityToMetric(activity));
+    data->addMetric(scopeId, convertActivityToMetric(activity, weight));
   }
 }
 
-void processActivity(size_t externId, std::set<Data *> &dataSet,
+void processActivity(size_t externId, uint64_t weight,
+                     std::set<Data *> &dataSet,
                      const roctracer_record_t *record, bool isAPI) {
   switch (record->kind) {
   case 0x11F1: // Task - kernel enqueued by graph launch
   case kHipVdiCommandKernel: {
-    processActivityKernel(externId, dataSet, record, isAPI);
+    processActivityKernel(externId, weight, dataSet, record, isAPI);
     break;
   }
   default:
@@ -175,12 +177,22 @@ void RoctracerProfiler::RoctracerProfilerPimpl::apiCallback(
   if (domain == ACTIVITY_DOMAIN_HIP_API) {
     const hip_api_data_t *data = (const hip_api_data_t *)(callbackData);
     if (data->phase == ACTIVITY_API_PHASE_ENTER) {
+      // Skipped launches are neither attributed nor correlated
+      auto weight = Sampler::instance().enterLaunch();
+      if (weight == 0)
+        return;
+      Sampler::Cost cost;
       // Valid context and outermost level of the kernel launch
       auto scopeId = Scope::getNewScopeId();
       threadState.record(scopeId);
       threadState.enterOp(scopeId);
-      profiler.correlation.correlate(data->correlation_id);
+      profiler.correlation.correlate(data->correlation_id, /*numInstances=*/1,
+                                     weight);
     } else if (data->phase == ACTIVITY_API_PHASE_EXIT) {
+      auto weight = Sampler::instance().getLaunchWeight();
+      Sampler::instance().exitLaunch();
+      if (weight == 0)
+        return;
       threadState.exitOp();
       // Track outstanding op for flush
       profiler.correlation.submit(data->correlation_id);
@@ -212,11 +224,13 @@ void RoctracerProfiler::RoctracerProfilerPimpl::activityCallback(
             ? correlation.corrIdToExternId.at(record->correlation_id).first
             : Scope::DummyScopeId;
     auto isAPI = correlation.apiExternIds.contain(externId);
-    processActivity(externId, dataSet, record, isAPI);
+    auto weight = correlation.externIdToWeight.at(externId);
+    processActivity(externId, weight, dataSet, record, isAPI);
     // Track correlation ids from the same stream and erase those <
     // correlationId
     correlation.corrIdToExternId.erase(record->correlation_id);
     correlation.apiExternIds.erase(externId);
+    correlation.externIdToWeight.erase(externId);
     roctracer::getNextRecord<true>(record, &record);
   }
   correlation.complete(maxCorrelationId);
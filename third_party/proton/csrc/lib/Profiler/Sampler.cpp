@@ -0,0 +1,179 @@
+#include "Profiler/Sampler.h"
+#include "Utility/String.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+namespace proton {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The overhead policy adapts its rate at most this often
+const auto AdaptPeriod = std::chrono::milliseconds(100);
+
+int64_t getNanoseconds(Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+} // namespace
+
+struct Sampler::ThreadState {
+  uint64_t generation = 0;
+  // Launches left to skip before the next sample
+  uint64_t gap = 0;
+  // Weight of the next sample
+  uint64_t weight = 1;
+  Clock::time_point nextSample{};
+  // Nesting depth and weight of the launch in progress
+  size_t depth = 0;
+  uint64_t launchWeight = 1;
+  std::minstd_rand random{std::random_device()()};
+};
+
+Sampler::ThreadState &Sampler::getThreadState() {
+  static thread_local ThreadState state;
+  return state;
+}
+
+void Sampler::setPolicy(const std::string &policy) {
+  auto kind = Kind::All;
+  double value = 0;
+  if (!policy.empty()) {
+    auto separator = policy.find(':');
+    auto name = toLower(policy.substr(0, separator));
+    try {
+      value = separator == std::string::npos
+                  ? 0
+                  : std::stod(policy.substr(separator + 1));
+    } catch (const std::exception &) {
+      value = 0;
+    }
+    if (name == "rate" && value >= 1) {
+      kind = Kind::Rate;
+      meanGap.store(value);
+    } else if (name == "interval" && value > 0) {
+      kind = Kind::Interval;
+      interval.store(value);
+    } else if (name == "overhead" && value > 0 && value <= 100) {
+      kind = Kind::Overhead;
+      targetOverhead.store(value / 100);
+      // Sample everything until the cost of a launch is known
+      meanGap.store(1);
+    } else {
+      throw std::runtime_error("Unknown sampling policy: " + policy);
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  this->policy = policy;
+  periodStart.store(getNanoseconds(Clock::now()));
+  periodCost.store(0);
+  periodLaunches.store(0);
+  periodSamples.store(0);
+  this->kind.store(kind);
+  generation.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t Sampler::enterLaunch() {
+  auto &state = getThreadState();
+  if (state.depth++ == 0)
+    state.launchWeight = sample(state);
+  return state.launchWeight;
+}
+
+void Sampler::exitLaunch() {
+  auto &state = getThreadState();
+  if (state.depth > 0)
+    --state.depth;
+}
+
+uint64_t Sampler::getLaunchWeight() const {
+  auto &state = getThreadState();
+  return state.depth > 0 ? state.launchWeight : 1;
+}
+
+uint64_t Sampler::sample(ThreadState &state) {
+  auto kind = this->kind.load(std::memory_order_relaxed);
+  if (kind == Kind::All)
+    return 1;
+  auto generation = this->generation.load(std::memory_order_acquire);
+  if (state.generation != generation) {
+    state.generation = generation;
+    state.weight = 0;
+    state.nextSample = Clock::now();
+    if (kind != Kind::Interval)
+      drawGap(state, meanGap.load());
+  }
+  if (kind == Kind::Interval) {
+    // The weight counts the launches up to the sample
+    ++state.weight;
+    auto now = Clock::now();
+    if (now < state.nextSample)
+      return 0;
+    state.nextSample = now + std::chrono::duration_cast<Clock::duration>(
+                                 std::chrono::duration<double>(interval));
+    return std::exchange(state.weight, 0);
+  }
+  if (state.gap > 0) {
+    --state.gap;
+    return 0;
+  }
+  auto weight = state.weight;
+  if (kind == Kind::Overhead) {
+    periodLaunches.fetch_add(weight, std::memory_order_relaxed);
+    periodSamples.fetch_add(1, std::memory_order_relaxed);
+    adapt();
+  }
+  drawGap(state, meanGap.load(std::memory_order_relaxed));
+  return weight;
+}
+
+void Sampler::drawGap(ThreadState &state, double mean) {
+  // Sampling every launch with probability 1/n leaves gaps that follow a
+  // geometric distribution, so drawing the gaps takes one random number per
+  // sample rather than one per launch
+  auto n = std::max<uint64_t>(1, std::llround(mean));
+  state.weight = n;
+  if (n == 1) {
+    state.gap = 0;
+    return;
+  }
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  auto u = uniform(state.random);
+  state.gap = static_cast<uint64_t>(std::floor(
+      std::log1p(-u) / std::log1p(-1.0 / static_cast<double>(n))));
+}
+
+void Sampler::addCost(std::chrono::steady_clock::duration cost) {
+  periodCost.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(cost).count(),
+      std::memory_order_relaxed);
+}
+
+void Sampler::adapt() {
+  auto now = getNanoseconds(Clock::now());
+  auto start = periodStart.load(std::memory_order_relaxed);
+  if (now - start < std::chrono::nanoseconds(AdaptPeriod).count())
+    return;
+  std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+  if (!lock.owns_lock() || periodStart.load() != start)
+    return;
+  periodStart.store(now);
+  auto cost = periodCost.exchange(0);
+  auto launches = periodLaunches.exchange(0);
+  auto samples = periodSamples.exchange(0);
+  if (cost == 0 || samples == 0)
+    return;
+  // Sampling one launch in n costs launches / n * costPerSample per period
+  auto costPerSample = static_cast<double>(cost) / samples;
+  auto budget = targetOverhead.load() * (now - start);
+  meanGap.store(std::max(1.0, launches * costPerSample / budget));
+}
+
+} // namespace proton
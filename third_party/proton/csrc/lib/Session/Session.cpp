@@ -1,11 +1,18 @@
 #include "Session/Session.h"
 #include "Context/Python.h"
 #include "Context/Shadow.h"
+#include "Data/TraceData.h"
 #include "Data/TreeData.h"
 #include "Profiler/CuptiProfiler.h"
+#include "Profiler/HostProfiler.h"
 #include "Profiler/RoctracerProfiler.h"
+#include "Profiler/Sampler.h"
 #include "Utility/String.h"
 
+#include <chrono>
+#include <type_traits>
+#include <variant>
+
 namespace proton {
 
 namespace {
@@ -16,6 +23,12 @@ Profiler *getProfiler(const std::string &profilerName) {
   if (proton::toLower(profilerName) == "roctracer") {
     return &RoctracerProfiler::instance();
   }
+  if (proton::toLower(profilerName) == "host") {
+    return HostProfiler::instance().setCounters(false);
+  }
+  if (proton::toLower(profilerName) == "perf") {
+    return HostProfiler::instance().setCounters(true);
+  }
   throw std::runtime_error("Unknown profiler: " + profilerName);
 }
 
@@ -24,6 +37,8 @@ std::unique_ptr<Data> makeData(const std::string &dataName,
                                ContextSource *contextSource) {
   if (toLower(dataName) == "tree") {
     return std::make_unique<TreeData>(path, contextSource);
+  } else if (toLower(dataName) == "trace") {
+    return std::make_unique<TraceData>(path, contextSource);
   }
   throw std::runtime_error("Unknown data: " + dataName);
 }
@@ -51,18 +66,69 @@ void Session::deactivate() {
 }
 
 void Session::finalize(OutputFormat outputFormat) {
+  stopFlusher();
   profiler->stop();
-  data->dump(outputFormat);
+  if (isStreaming()) {
+    // Everything before has already been written out
+    data->flush(outputFormat);
+  } else {
+    data->dump(outputFormat);
+  }
+}
+
+void Session::runFlusher() {
+  // Checking the memory usage is cheap, so do it well within the interval
+  const auto pollPeriod = std::chrono::milliseconds(100);
+  auto lastFlushTime = std::chrono::steady_clock::now();
+  auto lastMemoryUsage = data->getMemoryUsage();
+  std::unique_lock<std::mutex> lock(flusherMutex);
+  while (!flusherCondition.wait_for(lock, pollPeriod,
+                                    [this]() { return flusherStopped; })) {
+    auto now = std::chrono::steady_clock::now();
+    auto memoryUsage = data->getMemoryUsage();
+    auto timeDue = flushInterval > 0 &&
+                   std::chrono::duration<double>(now - lastFlushTime).count() >=
+                       flushInterval;
+    auto sizeDue = flushSize > 0 && memoryUsage >= lastMemoryUsage + flushSize;
+    if (!timeDue && !sizeDue)
+      continue;
+    // Collect the kernel records buffered so far, so that their scopes are
+    // still known when they are added
+    profiler->flush();
+    data->flush(OutputFormat::Hatchet);
+    lastFlushTime = now;
+    lastMemoryUsage = data->getMemoryUsage();
+  }
+}
+
+void Session::stopFlusher() {
+  if (!flusher.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(flusherMutex);
+    flusherStopped = true;
+  }
+  flusherCondition.notify_one();
+  flusher.join();
 }
 
 std::unique_ptr<Session> SessionManager::makeSession(
     size_t id, const std::string &path, const std::string &profilerName,
-    const std::string &contextSourceName, const std::string &dataName) {
+    const std::string &contextSourceName, const std::string &dataName,
+    double flushInterval, size_t flushSize, const std::string &sampling) {
+  if ((flushInterval > 0 || flushSize > 0) && toLower(dataName) != "tree")
+    throw std::runtime_error("Streaming is not supported by data: " +
+                             dataName);
   auto profiler = getProfiler(profilerName);
+  // Traces already have the host time of every scope and op
+  if (dynamic_cast<HostProfiler *>(profiler) && toLower(dataName) != "tree")
+    throw std::runtime_error("Profiler " + profilerName +
+                             " is not supported by data: " + dataName);
   auto contextSource = makeContextSource(contextSourceName);
   auto data = makeData(dataName, path, contextSource.get());
-  auto *session = new Session(id, path, profiler, std::move(contextSource),
-                              std::move(data));
+  auto *session =
+      new Session(id, path, profiler, std::move(contextSource),
+                  std::move(data), flushInterval, flushSize, sampling);
   return std::unique_ptr<Session>(session);
 }
 
@@ -102,22 +168,43 @@ void SessionManager::removeSession(size_t sessionId) {
   auto path = sessions[sessionId]->path;
   sessionPaths.erase(path);
   sessions.erase(sessionId);
+  if (sessions.empty()) {
+    Sampler::instance().setPolicy("");
+    // No data or context source holds on to interned ids anymore
+    ContextInterner::instance().clear();
+  }
+}
+
+void SessionManager::setSamplingPolicy(const std::string &sampling) {
+  for (auto &[sessionId, session] : sessions) {
+    if (session->sampling != sampling)
+      throw std::runtime_error("Sampling policy " + sampling +
+                               " differs from the policy " +
+                               session->sampling + " of session " +
+                               std::to_string(sessionId));
+  }
+  if (Sampler::instance().getPolicy() != sampling)
+    Sampler::instance().setPolicy(sampling);
 }
 
 size_t SessionManager::addSession(const std::string &path,
                                   const std::string &profilerName,
                                   const std::string &contextSourceName,
-                                  const std::string &dataName) {
+                                  const std::string &dataName,
+                                  double flushInterval, size_t flushSize,
+                                  const std::string &sampling) {
   std::unique_lock<std::shared_mutex> lock(mutex);
   if (hasSession(path)) {
     auto sessionId = getSessionId(path);
     activateSessionImpl(sessionId);
     return sessionId;
   }
+  setSamplingPolicy(sampling);
   auto sessionId = nextSessionId++;
   sessionPaths[path] = sessionId;
-  sessions[sessionId] =
-      makeSession(sessionId, path, profilerName, contextSourceName, dataName);
+  sessions[sessionId] = makeSession(sessionId, path, profilerName,
+                                    contextSourceName, dataName, flushInterval,
+                                    flushSize, sampling);
   return sessionId;
 }
 
@@ -147,25 +234,25 @@ void SessionManager::finalizeAllSessions(OutputFormat outputFormat) {
 
 void SessionManager::enterScope(const Scope &scope) {
   std::shared_lock<std::shared_mutex> lock(mutex);
-  for (auto iter : scopeInterfaceCounts) {
-    auto [scopeInterface, count] = iter;
-    if (count > 0) {
-      scopeInterface->enterScope(scope);
-    }
-  }
+  visitScopeInterfaces(/*contextSourcesFirst=*/true,
+                       [&](ScopeInterface *scopeInterface) {
+                         scopeInterface->enterScope(scope);
+                       });
 }
 
 void SessionManager::exitScope(const Scope &scope) {
   std::shared_lock<std::shared_mutex> lock(mutex);
-  for (auto iter : scopeInterfaceCounts) {
-    auto [scopeInterface, count] = iter;
-    if (count > 0) {
-      scopeInterface->exitScope(scope);
-    }
-  }
+  visitScopeInterfaces(/*contextSourcesFirst=*/false,
+                       [&](ScopeInterface *scopeInterface) {
+                         scopeInterface->exitScope(scope);
+                       });
 }
 
 void SessionManager::enterOp(const Scope &scope) {
+  // The GPU profiler callbacks of the launch reuse the decision made here
+  if (Sampler::instance().enterLaunch() == 0)
+    return;
+  Sampler::Cost cost;
   std::shared_lock<std::shared_mutex> lock(mutex);
   for (auto iter : opInterfaceCounts) {
     auto [opInterface, count] = iter;
@@ -176,6 +263,10 @@ void SessionManager::enterOp(const Scope &scope) {
 }
 
 void SessionManager::exitOp(const Scope &scope) {
+  auto weight = Sampler::instance().getLaunchWeight();
+  Sampler::instance().exitLaunch();
+  if (weight == 0)
+    return;
   std::shared_lock<std::shared_mutex> lock(mutex);
   for (auto iter : opInterfaceCounts) {
     auto [opInterface, count] = iter;
@@ -188,6 +279,31 @@ void SessionManager::exitOp(const Scope &scope) {
 void SessionManager::addMetrics(
     size_t scopeId, const std::map<std::string, MetricValueType> &metrics,
     bool aggregable) {
+  // Metrics added during a launch, such as those of the triton hook, are
+  // scaled like the kernels of the launch
+  auto weight = Sampler::instance().getLaunchWeight();
+  if (weight == 0)
+    return;
+  if (weight == 1 || !aggregable) {
+    addMetricsImpl(scopeId, metrics, aggregable);
+    return;
+  }
+  auto scaledMetrics = metrics;
+  for (auto &[name, value] : scaledMetrics) {
+    std::visit(
+        [&](auto &&v) {
+          using T = std::decay_t<decltype(v)>;
+          if constexpr (!std::is_same_v<T, std::string>)
+            v *= static_cast<T>(weight);
+        },
+        value);
+  }
+  addMetricsImpl(scopeId, scaledMetrics, aggregable);
+}
+
+void SessionManager::addMetricsImpl(
+    size_t scopeId, const std::map<std::string, MetricValueType> &metrics,
+    bool aggregable) {
   std::shared_lock<std::shared_mutex> lock(mutex);
   for (auto [sessionId, active] : activeSessions) {
     if (active) {
@@ -26,6 +26,9 @@ def start(
     data: Optional[str] = "tree",
     backend: Optional[str] = None,
     hook: Optional[str] = None,
+    flush_interval: Optional[float] = None,
+    flush_size: Optional[int] = None,
+    sampling: Optional[str] = None,
 ):
     """
     Start profiling with the given name and backend.
@@ -42,17 +45,36 @@ def start(
         name (str, optional): The name (with path) of the profiling session.
                               If not provided, the default name is "~/proton.hatchet".
         backend (str, optional): The backend to use for profiling.
-                                 Available options are ["cupti"].
+                                 Available options are ["cupti", "roctracer", "host", "perf"].
+                                 "host" measures the host time of scopes and ops without a GPU, and "perf" reads the
+                                 cycles, instructions, and cache misses of the CPU from Linux perf_event as well.
+                                 Both only support the "tree" data.
                                  Defaults to None, which automatically selects the backend matching the current active runtime.
         context (str, optional): The context to use for profiling.
                                  Available options are ["shadow", "python"].
                                  Defaults to "shadow".
         data (str, optional): The data structure to use for profiling.
-                              Available options are ["tree"].
+                              Available options are ["tree", "trace"].
+                              "tree" aggregates metrics by calling context, while "trace" records a timeline of
+                              scopes, ops, and kernels.
                               Defaults to "tree".
         hook (str, optional): The hook to use for profiling.
                               Available options are [None, "triton"].
                               Defaults to None.
+        flush_interval (float, optional): Streams the profile: every `flush_interval` seconds, the metrics recorded
+                                          since the last part are written to "name.part<k>.hatchet" and released.
+                                          Only the "tree" data supports streaming.
+                                          Defaults to None, which keeps all metrics until finalize.
+        flush_size (int, optional): Streams the profile like `flush_interval`, but writes a part whenever the profile
+                                    data has grown by `flush_size` MB.
+                                    Defaults to None.
+        sampling (str, optional): Profiles only some of the kernel launches to bound the overhead of profiling, and
+                                  scales the metrics of the profiled ones by the number of launches they stand for.
+                                  Available options are "rate:<n>" (one launch in n, at random), "interval:<s>" (the
+                                  first launch of each thread every s seconds), and "overhead:<percent>" (adapts the
+                                  rate to keep the host overhead around the percentage).
+                                  All sessions must use the same policy.
+                                  Defaults to None, which profiles every launch.
     Returns:
         session (int): The session ID of the profiling session.
     """
@@ -69,7 +91,11 @@ def start(
     set_profiling_on()
     if hook and hook == "triton":
         register_triton_hook()
-    return libproton.start(name, context, data, backend)
+    flush_interval = flush_interval if flush_interval else 0.0
+    flush_size = flush_size * 1024 * 1024 if flush_size else 0
+    sampling = sampling if sampling else ""
+    return libproton.start(name, context, data, backend, flush_interval=flush_interval, flush_size=flush_size,
+                           sampling=sampling)
 
 
 def activate(session: Optional[int] = 0) -> None:
@@ -112,7 +138,10 @@ def finalize(session: Optional[int] = None, output_format: str = "hatchet") -> N
     Args:
         session (int, optional): The session ID to finalize. If None, all sessions are finalized. Defaults to None.
         output_format (str, optional): The output format for the profiling results.
-                                       Aavailable options are ["hatchet"].
+                                       Aavailable options are ["hatchet", "binary", "chrome_trace"].
+                                       "hatchet" and "binary" are supported by the "tree" data and "chrome_trace" by
+                                       the "trace" data. "binary" is a compact format that proton-viewer loads faster,
+                                       but streamed profiles are only written in "hatchet".
 
     Returns:
         None
@@ -13,11 +13,21 @@ def parse_arguments():
     python -m triton.profiler.proton [options] script.py [script_args] [script_options]
 """, formatter_class=argparse.RawTextHelpFormatter)
     parser.add_argument("-n", "--name", type=str, help="Name of the profiling session")
-    parser.add_argument("-b", "--backend", type=str, help="Profiling backend", default=None, choices=["cupti"])
+    parser.add_argument("-b", "--backend", type=str, help="Profiling backend", default=None,
+                        choices=["cupti", "roctracer", "host", "perf"])
     parser.add_argument("-c", "--context", type=str, help="Profiling context", default="shadow",
                         choices=["shadow", "python"])
-    parser.add_argument("-d", "--data", type=str, help="Profiling data", default="tree", choices=["tree"])
+    parser.add_argument("-d", "--data", type=str, help="Profiling data", default="tree", choices=["tree", "trace"])
     parser.add_argument("-k", "--hook", type=str, help="Profiling hook", default=None, choices=[None, "triton"])
+    parser.add_argument("-f", "--format", type=str, help="Output format, which defaults to the one of the data",
+                        default=None, choices=["hatchet", "binary", "chrome_trace"])
+    parser.add_argument("--flush-interval", type=float, help="Stream the profile in parts written every N seconds",
+                        default=None)
+    parser.add_argument("--flush-size", type=int,
+                        help="Stream the profile in parts written whenever it grows by N MB", default=None)
+    parser.add_argument("--sampling", type=str,
+                        help="Profile only some kernel launches, e.g., rate:100, interval:0.01, or overhead:5",
+                        default=None)
     args, target_args = parser.parse_known_args()
     return args, target_args
 
@@ -55,7 +65,8 @@ def execute_as_main(script, args):
 def run_profiling(args, target_args):
     backend = args.backend if args.backend else _select_backend()
 
-    start(args.name, context=args.context, data=args.data, backend=backend, hook=args.hook)
+    start(args.name, context=args.context, data=args.data, backend=backend, hook=args.hook,
+          flush_interval=args.flush_interval, flush_size=args.flush_size, sampling=args.sampling)
 
     # Set the command line mode to avoid any `start` calls in the script.
     set_command_line()
@@ -68,7 +79,8 @@ def run_profiling(args, target_args):
     else:
         execute_as_main(script, script_args)
 
-    finalize()
+    output_format = args.format if args.format else "chrome_trace" if args.data == "trace" else "hatchet"
+    finalize(output_format=output_format)
 
 
 def main():
@@ -1,8 +1,14 @@
 import argparse
 from collections import namedtuple
 import json
+import math
+import mmap
+import struct
 import pandas as pd
 import hatchet as ht
+from hatchet.frame import Frame
+from hatchet.graph import Graph
+from hatchet.node import Node
 import numpy as np
 from triton.profiler.hook import COMPUTE_METADATA_SCOPE_NAME, TritonHook
 
@@ -15,7 +21,8 @@ def match_available_metrics(metrics, raw_metrics):
             for raw_metric in raw_metrics:
                 raw_metric_no_unit = raw_metric.split("(")[0].strip().lower()
                 if metric in (raw_metric, raw_metric_no_unit):
-                    ret.append(raw_metric + " (inc)")
+                    # Statistics over ranks are already inclusive
+                    ret.append(raw_metric if raw_metric.endswith("(inc)") else raw_metric + " (inc)")
                     break
     else:
         ret = [raw_metrics[0] + " (inc)"]
@@ -25,12 +32,408 @@ def match_available_metrics(metrics, raw_metrics):
 
 
 def get_raw_metrics(file):
-    database = json.load(file)
-    device_info = database.pop(1)
-    gf = ht.GraphFrame.from_literal(database)
+    return get_raw_metrics_from_database(json.load(file))
+
+
+def get_raw_metrics_from_database(database):
+    tree, device_info = database[0], database[1]
+    add_percentile_metrics(tree)
+    gf = ht.GraphFrame.from_literal([tree])
     return gf, gf.show_metric_columns(), device_info
 
 
+PERCENTILES = [50, 90, 99]
+
+
+def _get_bucket_range(bucket, bucket_bits):
+    # See LogHistogram in csrc/include/Utility/Histogram.h
+    sub_bucket_count = 1 << bucket_bits
+    if bucket < sub_bucket_count:
+        return bucket, bucket + 1
+    shift = bucket // sub_bucket_count - 1
+    sub_bucket = bucket % sub_bucket_count + sub_bucket_count
+    return sub_bucket << shift, (sub_bucket + 1) << shift
+
+
+def get_histogram_percentile(histogram, percentile):
+    """Returns the value at the given percentile of a histogram, up to the width of the bucket that holds it."""
+    rank = max(1, math.ceil(percentile / 100 * sum(histogram["counts"])))
+    seen = 0
+    for offset, count in enumerate(histogram["counts"]):
+        seen += count
+        if seen >= rank:
+            low, high = _get_bucket_range(histogram["first_bucket"] + offset, histogram["bucket_bits"])
+            return min(max((low + high - 1) / 2, histogram["min"]), histogram["max"])
+    return float("nan")
+
+
+def merge_histograms(target, source):
+    assert target["bucket_bits"] == source["bucket_bits"], "Histograms have different buckets"
+    first_bucket = min(target["first_bucket"], source["first_bucket"])
+    end_bucket = max(histogram["first_bucket"] + len(histogram["counts"]) for histogram in (target, source))
+    counts = [0] * (end_bucket - first_bucket)
+    for histogram in (target, source):
+        for offset, count in enumerate(histogram["counts"]):
+            counts[histogram["first_bucket"] - first_bucket + offset] += count
+    return {
+        "bucket_bits": target["bucket_bits"], "first_bucket": first_bucket, "counts": counts,
+        "min": min(target["min"], source["min"]), "max": max(target["max"], source["max"])
+    }
+
+
+def get_percentile_metric_name(metric_name, percentile):
+    # Time (ns) -> Time p99 (ns)
+    name, _, unit = metric_name.partition(" (")
+    return f"{name} p{percentile} ({unit}" if unit else f"{name} p{percentile}"
+
+
+def add_percentile_metrics(node):
+    """
+    Adds the percentiles of the histograms of a node and its descendants to their metrics.
+    They are not listed on the root, so hatchet keeps them as they are instead of adding them up along the tree.
+    """
+    for metric_name, histogram in node.get("histograms", {}).items():
+        for percentile in PERCENTILES:
+            node["metrics"][get_percentile_metric_name(metric_name,
+                                                       percentile)] = get_histogram_percentile(histogram, percentile)
+    for child in node["children"]:
+        add_percentile_metrics(child)
+
+
+class BinaryProfile:
+    """
+    A profile written in the binary format, which is mapped into memory rather than parsed.
+    The layout is described in csrc/lib/Data/TreeData.cpp: nodes are stored in pre-order with the index of their parent,
+    and each metric is a column of 8-byte values with a bitmap of the nodes that have one. Histograms are kept in
+    separate distribution columns.
+    """
+    MAGIC = b"PROTONBF"
+    VERSION = 2
+    HEADER = struct.Struct("=8sIIQQQQQQ")
+    COLUMN = struct.Struct("=QIIQ")
+    NO_PARENT = 2**64 - 1
+    TYPES = ["Q", "q", "d", "Q", "Q"]
+    STRING_TYPE = 3
+    DISTRIBUTION_TYPE = 4
+    PROPERTY_FLAG = 1
+
+    def __init__(self, file_name):
+        with open(file_name, "rb") as f:
+            self._mmap = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        self._buffer = memoryview(self._mmap)
+        (magic, version, num_columns, self.num_nodes, num_strings, strings_offset, nodes_offset, columns_offset,
+         device_info) = self.HEADER.unpack_from(self._buffer)
+        if magic != self.MAGIC or version != self.VERSION:
+            self.close()
+            raise ValueError(f"{file_name} is not a binary proton profile of version {self.VERSION}")
+        self._string_offsets = self._view(strings_offset, num_strings + 1, "Q")
+        self._string_bytes = strings_offset + (num_strings + 1) * 8
+        self._strings = {}
+        self.parents = self._view(nodes_offset, self.num_nodes, "Q")
+        self._names = self._view(nodes_offset + self.num_nodes * 8, self.num_nodes, "Q")
+        self.columns = {}
+        self.distributions = {}
+        for i in range(num_columns):
+            name, type, flags, offset = self.COLUMN.unpack_from(self._buffer, columns_offset + i * self.COLUMN.size)
+            columns = self.distributions if type == self.DISTRIBUTION_TYPE else self.columns
+            columns[self.get_string(name)] = (type, flags, offset)
+        self.device_info = json.loads(self.get_string(device_info))
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        # Views into the mapping have to be released before it can be closed
+        for name in ["_string_offsets", "parents", "_names"]:
+            if hasattr(self, name):
+                getattr(self, name).release()
+        self._buffer.release()
+        self._mmap.close()
+
+    def _view(self, offset, count, format):
+        return self._buffer[offset:offset + count * 8].cast(format)
+
+    def get_string(self, index):
+        if index not in self._strings:
+            begin, end = self._string_offsets[index], self._string_offsets[index + 1]
+            self._strings[index] = str(self._buffer[self._string_bytes + begin:self._string_bytes + end], "utf-8")
+        return self._strings[index]
+
+    def get_name(self, node):
+        return self.get_string(self._names[node])
+
+    def is_property(self, column):
+        return bool(self.columns[column][1] & self.PROPERTY_FLAG)
+
+    def get_column(self, column):
+        """Returns the values of a metric for all nodes, with None for the nodes without a value."""
+        return self._read_column(*self.columns[column])
+
+    def get_distribution(self, column):
+        """Returns the histograms of a metric for all nodes, with None for the nodes without one."""
+        return self._read_column(*self.distributions[column])
+
+    def _read_column(self, type, flags, offset):
+        num_words = (self.num_nodes + 63) // 64
+        with self._view(offset, num_words, "Q") as present, self._view(offset + num_words * 8, self.num_nodes,
+                                                                        self.TYPES[type]) as values:
+            words = present.tolist()
+            ret = values.tolist()
+        for node in range(self.num_nodes):
+            if not (words[node // 64] >> (node % 64)) & 1:
+                ret[node] = None
+            elif type == self.STRING_TYPE:
+                ret[node] = self.get_string(ret[node])
+            elif type == self.DISTRIBUTION_TYPE:
+                ret[node] = json.loads(self.get_string(ret[node]))
+        return ret
+
+    def to_graphframe(self):
+        """Builds the hatchet graph frame directly, the same way hatchet reads a json profile."""
+        columns = {column: self.get_column(column) for column in self.columns}
+        for column in self.distributions:
+            histograms = self.get_distribution(column)
+            for percentile in PERCENTILES:
+                columns[get_percentile_metric_name(column, percentile)] = [
+                    None if histogram is None else get_histogram_percentile(histogram, percentile)
+                    for histogram in histograms
+                ]
+        nodes = []
+        depths = []
+        roots = []
+        for index, parent in enumerate(self.parents):
+            frame = Frame({"name": self.get_name(index), "type": "function"})
+            if parent == self.NO_PARENT:
+                node = Node(frame, None, hnid=-1, depth=0)
+                roots.append(node)
+                depths.append(0)
+            else:
+                node = Node(frame, nodes[parent], hnid=-1, depth=depths[parent] + 1)
+                nodes[parent].add_child(node)
+                depths.append(depths[parent] + 1)
+            nodes.append(node)
+        graph = Graph(roots)
+        graph.enumerate_traverse()
+        dataframe = pd.DataFrame({"node": nodes, "name": [self.get_name(index) for index in range(self.num_nodes)],
+                                  **columns})
+        dataframe.set_index(["node"], inplace=True)
+        dataframe.sort_index(inplace=True)
+        # As in json profiles, the metrics are the ones listed on the root
+        metrics = [column for column in self.columns if columns[column] and columns[column][0] is not None]
+        exc_metrics = [metric for metric in metrics if "(inc)" not in metric]
+        inc_metrics = [metric for metric in metrics if "(inc)" in metric]
+        return ht.GraphFrame(graph, dataframe, exc_metrics, inc_metrics)
+
+    def to_literal(self):
+        """Converts the profile to the json layout, listing its properties as the parts of a streamed profile do."""
+        columns = {column: self.get_column(column) for column in self.columns}
+        distributions = {column: self.get_distribution(column) for column in self.distributions}
+        literal_nodes = []
+        for index, parent in enumerate(self.parents):
+            metrics = {column: values[index] for column, values in columns.items() if values[index] is not None}
+            literal_node = {"frame": {"name": self.get_name(index), "type": "function"}, "metrics": metrics,
+                            "children": []}
+            histograms = {
+                column: values[index]
+                for column, values in distributions.items()
+                if values[index] is not None
+            }
+            if histograms:
+                literal_node["histograms"] = histograms
+            if parent != self.NO_PARENT:
+                literal_nodes[parent]["children"].append(literal_node)
+            literal_nodes.append(literal_node)
+        properties = [column for column in self.columns if self.is_property(column)]
+        return [literal_nodes[0], self.device_info, {"properties": properties}]
+
+
+def is_binary_profile(file_name):
+    with open(file_name, "rb") as f:
+        return f.read(len(BinaryProfile.MAGIC)) == BinaryProfile.MAGIC
+
+
+def get_raw_metrics_from_files(file_names, ranks=False):
+    # A single binary profile is loaded without going through the json layout
+    if len(file_names) == 1 and is_binary_profile(file_names[0]):
+        with BinaryProfile(file_names[0]) as profile:
+            gf = profile.to_graphframe()
+            return gf, gf.show_metric_columns(), profile.device_info
+    return get_raw_metrics_from_database(read_profiles(file_names, ranks))
+
+
+def _merge_node(target, source, properties):
+    for name, value in source["metrics"].items():
+        if name in target["metrics"] and name not in properties and not isinstance(value, str):
+            target["metrics"][name] += value
+        else:
+            target["metrics"][name] = value
+    for name, histogram in source.get("histograms", {}).items():
+        histograms = target.setdefault("histograms", {})
+        histograms[name] = merge_histograms(histograms[name], histogram) if name in histograms else histogram
+    children = {child["frame"]["name"]: child for child in target["children"]}
+    for source_child in source["children"]:
+        name = source_child["frame"]["name"]
+        if name not in children:
+            children[name] = {"frame": source_child["frame"], "metrics": {}, "children": []}
+            target["children"].append(children[name])
+        _merge_node(children[name], source_child, properties)
+
+
+def merge_profiles(databases):
+    """
+    Merge the parts of a streamed profile, or profiles of the same program, into a single profile.
+    Frames are matched by their path from the root. Metrics are added up, except for strings and the properties listed
+    by a part, which are taken from the last part that has them. Histograms are merged bucket by bucket.
+    """
+    tree = {"frame": {"name": "ROOT", "type": "function"}, "metrics": {}, "children": []}
+    device_info = {}
+    for database in databases:
+        # Parts of a streamed profile list their properties in a third element
+        properties = set(database[2]["properties"]) if len(database) > 2 else set()
+        _merge_node(tree, database[0], properties)
+        for device_type, devices in database[1].items():
+            device_info.setdefault(device_type, {}).update(devices)
+    return [tree, device_info]
+
+
+def iter_profiles(file_names):
+    """Loads the profiles one at a time, so that merging them holds a single profile besides the result."""
+    for file_name in file_names:
+        if is_binary_profile(file_name):
+            with BinaryProfile(file_name) as profile:
+                yield profile.to_literal()
+        else:
+            with open(file_name, "r") as f:
+                yield json.load(f)
+
+
+def read_profiles(file_names, ranks=False):
+    if ranks:
+        return merge_rank_profiles(iter_profiles(file_names))
+    if len(file_names) == 1:
+        database = next(iter_profiles(file_names))
+        if len(database) == 2:
+            return database
+    return merge_profiles(iter_profiles(file_names))
+
+
+RANK_STATISTICS = ["min", "mean", "max", "std", "imbalance"]
+
+
+def get_rank_metric_name(metric_name, statistic):
+    # Time (ns) -> Time max (ns) (inc)
+    name, _, unit = metric_name.partition(" (")
+    name = f"{name} {statistic} ({unit}" if unit and statistic != "imbalance" else f"{name} {statistic}"
+    return name + " (inc)"
+
+
+def _get_inclusive_metrics(node, path, properties, result):
+    # path -> {metric name: inclusive value} of the numeric metrics in the subtree of the node
+    metrics = {
+        name: value
+        for name, value in node["metrics"].items()
+        if name not in properties and isinstance(value, (int, float)) and "(inc)" not in name
+    }
+    for child in node["children"]:
+        child_path = path + (child["frame"]["name"], )
+        for name, value in _get_inclusive_metrics(child, child_path, properties, result).items():
+            metrics[name] = metrics.get(name, 0) + value
+    result[path] = metrics
+    return metrics
+
+
+def _add_rank_statistics(node, path, statistics):
+    for name, (count, mean, m2, minimum, maximum) in statistics.get(path, {}).items():
+        values = {"min": minimum, "mean": mean, "max": maximum, "std": math.sqrt(m2 / count)}
+        if mean > 0:
+            values["imbalance"] = maximum / mean
+        for statistic, value in values.items():
+            node["metrics"][get_rank_metric_name(name, statistic)] = value
+    for child in node["children"]:
+        _add_rank_statistics(child, path + (child["frame"]["name"], ), statistics)
+
+
+def merge_rank_profiles(databases):
+    """
+    Merge the profiles of the ranks of a distributed run, as `merge_profiles` does, and add statistics over the ranks.
+    The inclusive value of every numeric metric of a frame is summarized by its min, mean, max, and standard deviation
+    over the ranks, and by its imbalance, max / mean, where ranks without the frame count as zero. The statistics are
+    listed as inclusive metrics, such as "Time max (ns) (inc)", so that hatchet does not add them up along the tree.
+    Profiles are read one at a time and only the statistics of each frame are kept, so that hundreds of ranks can be
+    merged.
+    """
+    # path -> {metric name: (count, mean, m2, min, max)}, updated with Welford's algorithm
+    statistics = {}
+    num_ranks = 0
+
+    def add_rank(database):
+        properties = set(database[2]["properties"]) if len(database) > 2 else set()
+        rank_metrics = {}
+        _get_inclusive_metrics(database[0], (database[0]["frame"]["name"], ), properties, rank_metrics)
+        for path, metrics in rank_metrics.items():
+            path_statistics = statistics.setdefault(path, {})
+            for name, value in metrics.items():
+                count, mean, m2, minimum, maximum = path_statistics.get(name, (0, 0.0, 0.0, value, value))
+                count += 1
+                delta = value - mean
+                mean += delta / count
+                m2 += delta * (value - mean)
+                path_statistics[name] = (count, mean, m2, min(minimum, value), max(maximum, value))
+
+    def iter_ranks():
+        nonlocal num_ranks
+        for database in databases:
+            add_rank(database)
+            num_ranks += 1
+            yield database
+
+    merged = merge_profiles(iter_ranks())
+    if num_ranks == 0:
+        raise ValueError("No profiles to merge")
+    for path_statistics in statistics.values():
+        for name, (count, mean, m2, minimum, maximum) in path_statistics.items():
+            # Fold in the ranks that do not have the frame as zeros
+            missing = num_ranks - count
+            if missing > 0:
+                m2 += mean * mean * count * missing / num_ranks
+                mean = mean * count / num_ranks
+                minimum = min(minimum, 0)
+                maximum = max(maximum, 0)
+            path_statistics[name] = (num_ranks, mean, m2, minimum, maximum)
+    tree = merged[0]
+    _add_rank_statistics(tree, (tree["frame"]["name"], ), statistics)
+    return merged
+
+
+def _get_exclusive_metric(node, path, metric_name, result):
+    # path -> value of the metric on the frame itself
+    value = node["metrics"].get(metric_name, 0)
+    if isinstance(value, (int, float)):
+        result[path] = result.get(path, 0) + value
+    for child in node["children"]:
+        _get_exclusive_metric(child, path + (child["frame"]["name"], ), metric_name, result)
+    return result
+
+
+def diff_profiles(base_database, new_database, metric_name):
+    """
+    Compares the value of a metric on every frame, matched by its path from the root, between two profiles.
+    Returns (path, base value, new value) for the frames whose value changed, with the largest regressions first and
+    the largest improvements last. Values are exclusive, so that a regression shows up on the frame that causes it
+    rather than on all of its ancestors.
+    """
+    root_path = (base_database[0]["frame"]["name"], )
+    base = _get_exclusive_metric(base_database[0], root_path, metric_name, {})
+    new = _get_exclusive_metric(new_database[0], root_path, metric_name, {})
+    paths = list(base) + [path for path in new if path not in base]
+    rows = [(path, base.get(path, 0), new.get(path, 0)) for path in paths]
+    rows = [row for row in rows if row[2] != row[1]]
+    return sorted(rows, key=lambda row: row[2] - row[1], reverse=True)
+
+
 def get_min_time_flops(df, device_info):
     min_time_flops = pd.DataFrame(0.0, index=df.index, columns=["min_time"])
     for device_type in device_info:
@@ -80,6 +483,16 @@ def get_min_time_bytes(df, device_info):
 FactorDict = namedtuple("FactorDict", ["name", "factor"])
 time_factor_dict = FactorDict("time", {"time/s": 1, "time/ms": 1e-3, "time/us": 1e-6, "time/ns": 1e-9})
 avg_time_factor_dict = FactorDict("avg_time", {f"avg_{key}": value for key, value in time_factor_dict.factor.items()})
+# p99_time/us -> (99, 1e-6)
+percentile_time_dict = {
+    f"p{percentile}_{key}": (percentile, value)
+    for percentile in PERCENTILES
+    for key, value in time_factor_dict.factor.items()
+}
+# host_time/us -> Host Time (ns) of the host profiler
+host_time_factor_dict = FactorDict("host time",
+                                   {f"host_{key}": value
+                                    for key, value in time_factor_dict.factor.items()})
 bytes_factor_dict = FactorDict("bytes", {"byte/s": 1, "gbyte/s": 1e9, "tbyte/s": 1e12})
 
 derivable_metrics = {
@@ -101,7 +514,8 @@ for width in TritonHook.flops_width:
 def derive_metrics(gf, metrics, raw_metrics, device_info):
     derived_metrics = []
     original_metrics = []
-    internal_frame_indices = gf.dataframe["DeviceId"].isna()
+    # Host profiles have no kernels and thus no devices
+    internal_frame_indices = gf.dataframe["DeviceId"].isna() if "DeviceId" in gf.dataframe.columns else []
 
     def get_time_seconds(df):
         time_metric_name = match_available_metrics([time_factor_dict.name], raw_metrics)[0]
@@ -135,6 +549,23 @@ def derive_metrics(gf, metrics, raw_metrics, device_info):
                                                avg_time_factor_dict.factor[metric_time_unit])
             gf.dataframe.loc[internal_frame_indices, f"{metric} (inc)"] = np.nan
             derived_metrics.append(f"{metric} (inc)")
+        elif metric in host_time_factor_dict.factor:
+            host_time_metric_name = match_available_metrics([host_time_factor_dict.name], raw_metrics)[0]
+            host_time_unit = time_factor_dict.name + "/" + host_time_metric_name.split("(")[1].split(")")[0]
+            gf.dataframe[f"{metric} (inc)"] = (gf.dataframe[host_time_metric_name] *
+                                               time_factor_dict.factor[host_time_unit] /
+                                               host_time_factor_dict.factor[metric])
+            derived_metrics.append(f"{metric} (inc)")
+        elif metric in percentile_time_dict:
+            percentile, factor = percentile_time_dict[metric]
+            time_metric_name = match_available_metrics([time_factor_dict.name], raw_metrics)[0]
+            time_unit = time_factor_dict.name + "/" + time_metric_name.split("(")[1].split(")")[0]
+            percentile_metric_name = get_percentile_metric_name(time_metric_name[:-len(" (inc)")], percentile)
+            if percentile_metric_name not in gf.dataframe.columns:
+                raise RuntimeError(f"Metric {metric} is not found. The profile has no histograms of kernel time")
+            gf.dataframe[f"{metric} (inc)"] = (gf.dataframe[percentile_metric_name] *
+                                               time_factor_dict.factor[time_unit] / factor)
+            derived_metrics.append(f"{metric} (inc)")
         else:
             original_metrics.append(metric)
 
@@ -153,37 +584,66 @@ def format_frames(gf, format):
     return gf
 
 
-def parse(metrics, filename, include, exclude, threshold, depth, format):
-    with open(filename, "r") as f:
-        gf, raw_metrics, device_info = get_raw_metrics(f)
-        gf = format_frames(gf, format)
-        assert len(raw_metrics) > 0, "No metrics found in the input file"
-        gf.update_inclusive_columns()
-        metrics = derive_metrics(gf, metrics, raw_metrics, device_info)
-        if include or exclude:
-            # make regex do negative match
-            name_filter = f"^(?!{exclude}).*" if exclude else include
-            query = ["*", {"name": name_filter}]
-            gf = gf.filter(query, squash=True)
-        # filter out metadata computation
-        query = [{"name": f"^(?!{COMPUTE_METADATA_SCOPE_NAME}).*"}]
+def parse(metrics, file_names, include, exclude, threshold, depth, format, ranks=False):
+    gf, raw_metrics, device_info = get_raw_metrics_from_files(file_names, ranks)
+    gf = format_frames(gf, format)
+    assert len(raw_metrics) > 0, "No metrics found in the input file"
+    gf.update_inclusive_columns()
+    metrics = derive_metrics(gf, metrics, raw_metrics, device_info)
+    if include or exclude:
+        # make regex do negative match
+        name_filter = f"^(?!{exclude}).*" if exclude else include
+        query = ["*", {"name": name_filter}]
         gf = gf.filter(query, squash=True)
-        if threshold:
-            # TODO: generalize to support multiple metrics
-            query = ["*", {metrics[0]: f">= {threshold}"}]
-            gf = gf.filter(query, squash=True)
-        print(gf.tree(metric_column=metrics, expand_name=True, depth=depth, render_header=False))
-
-
-def show_metrics(file_name):
-    with open(file_name, "r") as f:
-        _, raw_metrics, _ = get_raw_metrics(f)
-        print("Available metrics:")
-        if raw_metrics:
-            for raw_metric in raw_metrics:
-                raw_metric_no_unit = raw_metric.split("(")[0].strip().lower()
-                print(f"- {raw_metric_no_unit}")
-        return
+    # filter out metadata computation
+    query = [{"name": f"^(?!{COMPUTE_METADATA_SCOPE_NAME}).*"}]
+    gf = gf.filter(query, squash=True)
+    if threshold:
+        # TODO: generalize to support multiple metrics
+        query = ["*", {metrics[0]: f">= {threshold}"}]
+        gf = gf.filter(query, squash=True)
+    print(gf.tree(metric_column=metrics, expand_name=True, depth=depth, render_header=False))
+
+
+def show_metrics(file_names, ranks=False):
+    _, raw_metrics, _ = get_raw_metrics_from_files(file_names, ranks)
+    print("Available metrics:")
+    if raw_metrics:
+        for raw_metric in raw_metrics:
+            raw_metric_no_unit = raw_metric.split("(")[0].strip().lower()
+            print(f"- {raw_metric_no_unit}")
+    return
+
+
+def write_merged_profile(file_names, output, ranks=False):
+    with open(output, "w") as f:
+        json.dump(read_profiles(file_names, ranks), f, indent=4)
+
+
+def get_diff_metric(metric, raw_metrics):
+    """Returns the raw metric to compare for a metric given on the command line, and the factor of its unit."""
+    for factor_dict in (time_factor_dict, host_time_factor_dict):
+        if metric in factor_dict.factor:
+            raw_metric = match_available_metrics([factor_dict.name], raw_metrics)[0][:-len(" (inc)")]
+            time_unit = time_factor_dict.name + "/" + raw_metric.split("(")[1].split(")")[0]
+            return raw_metric, factor_dict.factor[metric] / time_factor_dict.factor[time_unit]
+    return match_available_metrics([metric] if metric else None, raw_metrics)[0][:-len(" (inc)")], 1
+
+
+def show_diff(metrics, base_file_name, file_names, threshold):
+    base_database = read_profiles([base_file_name])
+    new_database = read_profiles(file_names)
+    # As in hatchet, the metrics are the ones listed on the root
+    raw_metrics = [name for name in base_database[0]["metrics"] if "(inc)" not in name]
+    metric, factor = get_diff_metric(metrics[0] if metrics else None, raw_metrics)
+    print(f"Changes of {metrics[0] if metrics else metric} from {base_file_name}, largest regressions first:")
+    print(f"{'base':>14} {'new':>14} {'delta':>14}  frame")
+    for path, base, new in diff_profiles(base_database, new_database, metric):
+        base, new = base / factor, new / factor
+        if threshold and abs(new - base) < threshold:
+            continue
+        frame = " > ".join(path[1:]) if len(path) > 1 else path[0]
+        print(f"{base:>14.6g} {new:>14.6g} {new - base:>+14.6g}  {frame}")
 
 
 def main():
@@ -199,6 +659,8 @@ def main():
 Derived metrics can be created when source metrics are available.
 - time/s, time/ms, time/us, time/ns: time
 - avg_time/s, avg_time/ms, avg_time/us, avg_time/ns: time / count
+- p<50/90/99>_time/s, p<50/90/99>_time/ms, p<50/90/99>_time/us, p<50/90/99>_time/ns: percentiles of the kernel time
+- host_time/s, host_time/ms, host_time/us, host_time/ns: host time of the host profiler
 - flop[<8/16/32/64>]/s, gflop[<8/16/32/64>]/s, tflop[<8/16/32/64>]/s: flops / time
 - byte/s, gbyte/s, tbyte/s: bytes / time
 - util: max(sum(flops<width>) / peak_flops<width>_time, sum(bytes) / peak_bandwidth_time)
@@ -252,11 +714,36 @@ There are two modes:
 - function_line: include the function name and line number.
 - file_function: include the file name and function name.
 """)
+    argparser.add_argument(
+        "-o",
+        "--output",
+        type=str,
+        default=None,
+        help="""Merge the given profiles, such as the parts of a streamed profile, and write the result to this file.
+Several profiles are also merged before they are displayed.
+""",
+    )
+    argparser.add_argument(
+        "-r",
+        "--ranks",
+        action="store_true",
+        help="""Treat the given profiles as the ranks of a distributed run. Besides merging them, the min, mean, max,
+std, and imbalance (max / mean) over the ranks of every metric are added, such as "time max" and "time imbalance".
+""",
+    )
+    argparser.add_argument(
+        "--diff",
+        type=str,
+        default=None,
+        help="""Compare the given profiles against this base profile and list the frames whose first metric changed,
+largest regressions first. The threshold applies to the change.
+""",
+    )
 
     args, target_args = argparser.parse_known_args()
-    assert len(target_args) == 1, "Must specify a file to read"
+    assert len(target_args) >= 1, "Must specify a file to read"
 
-    file_name = target_args[0]
+    file_names = target_args
     metrics = args.metrics.split(",") if args.metrics else None
     include = args.include
     exclude = args.exclude
@@ -265,10 +752,14 @@ There are two modes:
     format = args.format
     if include and exclude:
         raise ValueError("Cannot specify both include and exclude")
-    if args.list:
-        show_metrics(file_name)
+    if args.output:
+        write_merged_profile(file_names, args.output, args.ranks)
+    elif args.diff:
+        show_diff(metrics, args.diff, file_names, threshold)
+    elif args.list:
+        show_metrics(file_names, args.ranks)
     elif metrics:
-        parse(metrics, file_name, include, exclude, threshold, depth, format)
+        parse(metrics, file_names, include, exclude, threshold, depth, format, args.ranks)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,81 @@
+"""
+Measures the host overhead that profiling adds to each kernel launch.
+
+A launch is simulated the way the triton hook reports it: an op is entered and exited under the current calling
+context and its launch metadata is attached as metrics. No kernel is run, so the numbers only cover the work done
+by the profile data on the launching threads.
+
+    python benchmark_launch_overhead.py --context python --depth 64 --threads 4
+"""
+import argparse
+import tempfile
+import threading
+import time
+
+import triton._C.libproton.proton as libproton
+from triton.profiler.profile import _select_backend
+
+
+def launch(num_launches, names):
+    for i in range(num_launches):
+        scope_id = libproton.record_scope()
+        name = names[i % len(names)]
+        libproton.enter_op(scope_id, name)
+        libproton.add_metrics(scope_id, {"flops": 1.0})
+        libproton.exit_op(scope_id, name)
+
+
+def recurse(depth, fn, *args):
+    # Calls `fn` under `depth` additional Python frames
+    if depth == 0:
+        return fn(*args)
+    return recurse(depth - 1, fn, *args)
+
+
+def run(num_launches, depth, num_threads, names):
+    # The shadow context is shared by all threads, while each thread has its own Python stack
+    scopes = [(libproton.record_scope(), f"level{level}") for level in range(depth)]
+    for scope_id, name in scopes:
+        libproton.enter_scope(scope_id, name)
+    threads = [
+        threading.Thread(target=recurse, args=(depth, launch, num_launches, names)) for _ in range(num_threads)
+    ]
+    start = time.perf_counter()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    elapsed = time.perf_counter() - start
+    for scope_id, name in reversed(scopes):
+        libproton.exit_scope(scope_id, name)
+    return elapsed / (num_launches * num_threads)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--launches", type=int, default=100000, help="Launches per thread")
+    parser.add_argument("--depth", type=int, default=32, help="Depth of the calling context")
+    parser.add_argument("--threads", type=int, default=1, help="Number of launching threads")
+    parser.add_argument("--kernels", type=int, default=8, help="Number of distinct kernel names")
+    parser.add_argument("--context", type=str, default="shadow", choices=["shadow", "python"])
+    parser.add_argument("--data", type=str, default="tree", choices=["tree", "trace"])
+    args = parser.parse_args()
+
+    names = [f"kernel_{i}" for i in range(args.kernels)]
+    # Without an active session the calls only cross into the library
+    baseline = run(args.launches, args.depth, args.threads, names)
+    with tempfile.TemporaryDirectory() as tmpdir:
+        session = libproton.start(f"{tmpdir}/profile", args.context, args.data, _select_backend())
+        # Warm up so that the calling contexts already exist
+        run(min(args.launches, 1000), args.depth, args.threads, names)
+        profiled = run(args.launches, args.depth, args.threads, names)
+        libproton.finalize(session, "chrome_trace" if args.data == "trace" else "hatchet")
+
+    print(f"context={args.context} data={args.data} depth={args.depth} threads={args.threads}")
+    print(f"baseline: {baseline * 1e6:.2f} us/launch")
+    print(f"profiled: {profiled * 1e6:.2f} us/launch")
+    print(f"overhead: {(profiled - baseline) * 1e6:.2f} us/launch")
+
+
+if __name__ == "__main__":
+    main()
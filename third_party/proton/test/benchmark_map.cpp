@@ -0,0 +1,117 @@
+// Stress benchmark for the concurrent containers in Utility/Map.h and
+// Utility/Set.h. It replays the correlation traffic of the GPU profilers on
+// the host: launching threads map new correlation ids to external ids while a
+// completion thread looks them up and erases them, as the CUPTI and roctracer
+// buffer callbacks do. No GPU library is needed.
+//
+//   proton_map_benchmark [--threads N] [--launches N]
+
+#include "Utility/Map.h"
+#include "Utility/Set.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using namespace proton;
+
+namespace {
+
+// Every launch publishes its progress on a separate cache line
+struct alignas(64) Progress {
+  std::atomic<uint64_t> value{0};
+};
+
+template <size_t NumStripes>
+double run(size_t numThreads, uint64_t numLaunches) {
+  ThreadSafeMap<uint64_t, std::pair<size_t, size_t>,
+                std::unordered_map<uint64_t, std::pair<size_t, size_t>>,
+                NumStripes>
+      corrIdToExternId;
+  ThreadSafeSet<size_t, std::unordered_set<size_t>, NumStripes> apiExternIds;
+  std::vector<Progress> launched(numThreads);
+
+  auto getCorrelationId = [&](size_t thread, uint64_t launch) {
+    return launch * numThreads + thread + 1;
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (size_t thread = 0; thread < numThreads; ++thread) {
+    threads.emplace_back([&, thread] {
+      for (uint64_t launch = 0; launch < numLaunches; ++launch) {
+        auto correlationId = getCorrelationId(thread, launch);
+        // One in four launches comes from a framework rather than triton
+        if (launch % 4 == 0)
+          apiExternIds.insert(correlationId);
+        corrIdToExternId[correlationId] = {correlationId, 1};
+        launched[thread].value.store(launch + 1, std::memory_order_release);
+      }
+    });
+  }
+  uint64_t numCompleted = 0;
+  uint64_t numErrors = 0;
+  std::vector<uint64_t> completed(numThreads, 0);
+  while (numCompleted < numThreads * numLaunches) {
+    for (size_t thread = 0; thread < numThreads; ++thread) {
+      auto end = launched[thread].value.load(std::memory_order_acquire);
+      for (auto launch = completed[thread]; launch < end; ++launch) {
+        auto correlationId = getCorrelationId(thread, launch);
+        if (!corrIdToExternId.contain(correlationId) ||
+            corrIdToExternId.at(correlationId).first != correlationId)
+          ++numErrors;
+        if (apiExternIds.contain(correlationId) != (launch % 4 == 0))
+          ++numErrors;
+        apiExternIds.erase(correlationId);
+        corrIdToExternId.erase(correlationId);
+      }
+      numCompleted += end - completed[thread];
+      completed[thread] = end;
+    }
+  }
+  for (auto &thread : threads)
+    thread.join();
+  auto elapsed = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  if (numErrors > 0 || corrIdToExternId.contain(getCorrelationId(0, 0))) {
+    std::fprintf(stderr, "%llu inconsistent lookups\n",
+                 static_cast<unsigned long long>(numErrors));
+    std::exit(1);
+  }
+  return numThreads * numLaunches / elapsed;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  size_t numThreads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  uint64_t numLaunches = 1000000;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--threads") == 0) {
+      numThreads = std::strtoull(argv[i + 1], nullptr, 10);
+    } else if (std::strcmp(argv[i], "--launches") == 0) {
+      numLaunches = std::strtoull(argv[i + 1], nullptr, 10);
+    } else {
+      std::fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::printf("threads=%zu launches=%llu\n", numThreads,
+              static_cast<unsigned long long>(numLaunches));
+  std::printf("single lock: %.2f Mlaunches/s\n",
+              run<1>(numThreads, numLaunches) / 1e6);
+  std::printf("striped:     %.2f Mlaunches/s\n",
+              run<32>(numThreads, numLaunches) / 1e6);
+  return 0;
+}
@@ -1,6 +1,7 @@
 import triton._C.libproton.proton as libproton
 import tempfile
 import pathlib
+import json
 from triton.profiler.profile import _select_backend
 
 
@@ -44,3 +45,24 @@ def test_add_metrics():
         libproton.exit_scope(id1, "one")
         libproton.finalize_all("hatchet")
         assert pathlib.Path(f.name).exists()
+
+
+def test_trace():
+    with tempfile.NamedTemporaryFile(delete=True, suffix=".chrome_trace") as f:
+        session_id = libproton.start(f.name.split(".")[0], "shadow", "trace", _select_backend())
+        id0 = libproton.record_scope()
+        libproton.enter_scope(id0, "zero")
+        libproton.add_metrics(id0, {"a": 1.0})
+        libproton.add_metrics(id0, {"a": 2.0})
+        id1 = libproton.record_scope()
+        libproton.enter_op(id1, "one")
+        libproton.exit_op(id1, "one")
+        libproton.exit_scope(id0, "zero")
+        libproton.finalize(session_id, "chrome_trace")
+        events = json.load(f)["traceEvents"]
+        scopes = [(event["ph"], event["name"]) for event in events if event["ph"] in ("B", "E")]
+        assert scopes == [("B", "zero"), ("B", "one"), ("E", "one"), ("E", "zero")]
+        enter = next(event for event in events if event["ph"] == "B" and event["name"] == "zero")
+        assert enter["args"]["a"] == 3.0
+        exit = next(event for event in events if event["ph"] == "E" and event["name"] == "zero")
+        assert exit["ts"] >= enter["ts"]
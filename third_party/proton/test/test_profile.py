@@ -4,7 +4,10 @@ import triton.profiler as proton
 import tempfile
 import json
 import pytest
+import threading
+import time
 from typing import NamedTuple
+from triton.profiler.viewer import merge_profiles, BinaryProfile
 
 import triton.language as tl
 
@@ -213,3 +216,141 @@ def test_deactivate():
         assert "DeviceId" not in data[0]["metrics"]
         assert len(data[0]["children"]) == 1
         assert "DeviceId" in data[0]["children"][0]["metrics"]
+
+
+def test_trace():
+
+    @triton.jit
+    def foo(x, y):
+        tl.store(y, tl.load(x))
+
+    x = torch.tensor([2], device="cuda")
+    y = torch.zeros_like(x)
+    with tempfile.NamedTemporaryFile(delete=True, suffix=".chrome_trace") as f:
+        proton.start(f.name.split(".")[0], data="trace", hook="triton")
+        with proton.scope("test0"):
+            foo[(1, )](x, y)
+            torch.ones((2, 2), device="cuda")
+        proton.finalize(output_format="chrome_trace")
+        events = json.load(f)["traceEvents"]
+        scope = next(event for event in events if event["ph"] == "B" and event["name"] == "test0")
+        assert scope["cat"] == "scope"
+        kernels = [event for event in events if event["ph"] == "X"]
+        assert len(kernels) == 2
+        assert kernels[0]["name"] == "foo"
+        assert "elementwise_kernel" in kernels[1]["name"]
+        assert kernels[1]["args"]["context"] == "test0"
+        assert all(kernel["dur"] > 0 for kernel in kernels)
+
+
+def test_streaming(tmp_path):
+
+    @triton.jit
+    def foo(x, y):
+        tl.store(y, tl.load(x))
+
+    x = torch.tensor([2], device="cuda")
+    y = torch.zeros_like(x)
+    name = str(tmp_path / "stream")
+    proton.start(name, hook="triton", flush_interval=0.2)
+    for _ in range(3):
+        with proton.scope("test0"):
+            foo[(1, )](x, y)
+        torch.cuda.synchronize()
+        time.sleep(0.5)
+    proton.finalize()
+    parts = sorted(tmp_path.glob("stream.part*.hatchet"))
+    assert len(parts) >= 3
+    tree, _ = merge_profiles([json.load(open(part)) for part in parts])
+    test0 = next(child for child in tree["children"] if child["frame"]["name"] == "test0")
+    assert test0["children"][0]["frame"]["name"] == "foo"
+    assert test0["children"][0]["metrics"]["Count"] == 3
+
+
+
+def test_streaming_concurrent_metrics(tmp_path):
+    # Metrics recorded while a part is being flushed must land in that part or the next one
+    name = str(tmp_path / "stream")
+    proton.start(name, flush_interval=0.05)
+    num_threads, num_scopes = 4, 20000
+
+    def record():
+        for _ in range(num_scopes):
+            with proton.scope("test0", {"flops": 1}):
+                pass
+
+    threads = [threading.Thread(target=record) for _ in range(num_threads)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    proton.finalize()
+    parts = sorted(tmp_path.glob("stream.part*.hatchet"))
+    assert len(parts) >= 2
+    tree, _ = merge_profiles([json.load(open(part)) for part in parts])
+    test0 = next(child for child in tree["children"] if child["frame"]["name"] == "test0")
+    assert test0["metrics"]["flops"] == num_threads * num_scopes
+
+def test_binary(tmp_path):
+    name = str(tmp_path / "binary")
+    proton.start(name)
+    with proton.scope("test0", {"bytes": 10}):
+        torch.ones((2, 2), device="cuda")
+    proton.finalize(output_format="binary")
+    with BinaryProfile(name + ".binary") as profile:
+        tree, device_info, _ = profile.to_literal()
+    assert len(device_info) == 1
+    test0 = tree["children"][0]
+    assert test0["frame"]["name"] == "test0"
+    assert test0["metrics"]["bytes"] == 10
+    assert test0["children"][0]["metrics"]["Time (ns)"] > 0
+
+
+def test_sampling(tmp_path):
+
+    def metadata_fn(grid: tuple, metadata: NamedTuple, args: dict):
+        return {"name": "foo", "flops32": 1.0}
+
+    @triton.jit(launch_metadata=metadata_fn)
+    def foo(x, y):
+        tl.store(y, tl.load(x))
+
+    x = torch.tensor([2], device="cuda", dtype=torch.float32)
+    y = torch.zeros_like(x)
+    name = str(tmp_path / "sampling")
+    proton.start(name, hook="triton", sampling="rate:10")
+    with proton.scope("test0"):
+        for _ in range(1000):
+            foo[(1, )](x, y)
+    proton.finalize()
+    with open(name + ".hatchet") as f:
+        data = json.load(f)
+    foo_node = data[0]["children"][0]["children"][0]
+    assert foo_node["frame"]["name"] == "foo"
+    # Sampled launches stand for ten launches each, so the estimate has a
+    # standard deviation of about 10%
+    count = foo_node["metrics"]["Count"]
+    assert 600 <= count <= 1400 and count % 10 == 0
+    assert foo_node["metrics"]["flops32"] == count
+
+
+def test_host(tmp_path):
+    name = str(tmp_path / "host")
+    # The host profiler does not need a GPU
+    proton.start(name, backend="host")
+    with proton.scope("test0"):
+        time.sleep(0.01)
+        with proton.scope("test1"):
+            time.sleep(0.1)
+    proton.finalize()
+    with open(name + ".hatchet") as f:
+        data = json.load(f)
+    test0 = data[0]["children"][0]
+    assert test0["frame"]["name"] == "test0"
+    assert test0["metrics"]["Host Count"] == 1
+    assert test0["metrics"]["Host Time (ns)"] >= 1e7
+    test1 = test0["children"][0]
+    assert test1["frame"]["name"] == "test1"
+    assert test1["metrics"]["Host Time (ns)"] >= 1e8
+    # Nested scopes report their own time, so test0 excludes the longer sleep of test1
+    assert test0["metrics"]["Host Time (ns)"] < test1["metrics"]["Host Time (ns)"]
@@ -1,12 +1,19 @@
+import copy
+import json
 import pytest
 import subprocess
 from triton.profiler.viewer import get_min_time_flops, get_min_time_bytes, get_raw_metrics, format_frames, derive_metrics
+from triton.profiler.viewer import merge_profiles, get_raw_metrics_from_files, read_profiles
+from triton.profiler.viewer import get_histogram_percentile, merge_histograms
+from triton.profiler.viewer import merge_rank_profiles, diff_profiles, BinaryProfile
 import numpy as np
 
 file_path = __file__
 cuda_example_file = file_path.replace("test_viewer.py", "example_cuda.json")
+cuda_binary_example_file = file_path.replace("test_viewer.py", "example_cuda.binary")
 hip_example_file = file_path.replace("test_viewer.py", "example_hip.json")
 frame_example_file = file_path.replace("test_viewer.py", "example_frame.json")
+host_example_file = file_path.replace("test_viewer.py", "example_host.json")
 
 
 def test_help():
@@ -123,3 +130,131 @@ def test_flops_derivation():
         },
         sample_file=cuda_example_file,
     )
+
+
+def test_percentile_derivation():
+    derivation_metrics_test(
+        metrics=["p50_time/us", "p99_time/ns"], expected_data={
+            'p50_time/us (inc)': [np.nan, 20.48, 204.8], 'p99_time/ns (inc)': [np.nan, 20480.0, 204800.0]
+        }, sample_file=cuda_example_file)
+
+
+def test_host_time_derivation():
+    derivation_metrics_test(
+        metrics=["host_time/ms", "host_time/us"], expected_data={
+            'host_time/ms (inc)': [4.0, 4.0, 1.0], 'host_time/us (inc)': [4000.0, 4000.0, 1000.0]
+        }, sample_file=host_example_file)
+
+
+def test_histograms():
+    # Values below 32 have a bucket each
+    low = {"bucket_bits": 5, "first_bucket": 1, "counts": [1] * 20, "min": 1, "max": 20}
+    assert get_histogram_percentile(low, 50) == 10
+    assert get_histogram_percentile(low, 100) == 20
+    # Values in [1024, 1056) share a bucket, which is reported by its middle
+    high = {"bucket_bits": 5, "first_bucket": 192, "counts": [60], "min": 1024, "max": 1055}
+    assert get_histogram_percentile(high, 50) == 1039.5
+    merged = merge_histograms(low, high)
+    assert merged["first_bucket"] == 1 and len(merged["counts"]) == 192
+    assert merged["min"] == 1 and merged["max"] == 1055
+    assert get_histogram_percentile(merged, 25) == 20
+    assert get_histogram_percentile(merged, 99) == 1039.5
+
+
+def test_merge_profiles():
+
+    def node(name, metrics, children=()):
+        return {"frame": {"name": name, "type": "function"}, "metrics": metrics, "children": list(children)}
+
+    device_info = {"CUDA": {"0": {"arch": "90"}}}
+    part0 = [
+        node("ROOT", {"Time (ns)": 0}, [
+            node("test0", {"flops": 1, "tag": 7}, [node("foo", {"Time (ns)": 10, "Count": 1, "DeviceId": "0"})]),
+        ]), device_info, {"properties": ["tag"]}
+    ]
+    part1 = [
+        node("ROOT", {"Time (ns)": 0}, [
+            node("test0", {"flops": 2, "tag": 7}, [node("foo", {"Time (ns)": 30, "Count": 2, "DeviceId": "0"})]),
+            node("test1", {"flops": 4}),
+        ]), {"CUDA": {"1": {"arch": "90"}}}, {"properties": ["tag"]}
+    ]
+    part0[0]["children"][0]["children"][0]["histograms"] = {
+        "Time (ns)": {"bucket_bits": 5, "first_bucket": 10, "counts": [1], "min": 10, "max": 10}
+    }
+    part1[0]["children"][0]["children"][0]["histograms"] = {
+        "Time (ns)": {"bucket_bits": 5, "first_bucket": 15, "counts": [2], "min": 15, "max": 15}
+    }
+    tree, devices = merge_profiles([part0, part1])
+    test0, test1 = tree["children"]
+    assert test0["metrics"] == {"flops": 3, "tag": 7}
+    assert test0["children"][0]["metrics"] == {"Time (ns)": 40, "Count": 3, "DeviceId": "0"}
+    assert test0["children"][0]["histograms"]["Time (ns)"]["counts"] == [1, 0, 0, 0, 0, 2]
+    assert test1["frame"]["name"] == "test1" and test1["metrics"] == {"flops": 4}
+    assert set(devices["CUDA"].keys()) == {"0", "1"}
+
+
+def test_merge_rank_profiles():
+
+    def node(name, metrics, children=()):
+        return {"frame": {"name": name, "type": "function"}, "metrics": metrics, "children": list(children)}
+
+    ranks = [[node("ROOT", {"Time (ns)": 0}, [node("foo", {"Time (ns)": time, "DeviceId": "0"})] +
+                   ([node("bar", {"Time (ns)": 4})] if with_bar else [])), {}]
+             for time, with_bar in [(10, True), (30, False), (20, True)]]
+    tree, _ = merge_rank_profiles(iter(ranks))
+    foo, bar = tree["children"]
+    assert foo["metrics"]["Time (ns)"] == 60
+    assert foo["metrics"]["Time min (ns) (inc)"] == 10
+    assert foo["metrics"]["Time mean (ns) (inc)"] == 20
+    assert foo["metrics"]["Time max (ns) (inc)"] == 30
+    np.testing.assert_allclose(foo["metrics"]["Time std (ns) (inc)"], np.std([10, 30, 20]))
+    assert foo["metrics"]["Time imbalance (inc)"] == 1.5
+    assert "DeviceId min (inc)" not in foo["metrics"]
+    # A rank without the frame counts as zero
+    assert bar["metrics"]["Time min (ns) (inc)"] == 0
+    np.testing.assert_allclose(bar["metrics"]["Time std (ns) (inc)"], np.std([4, 0, 4]))
+    assert tree["metrics"]["Time max (ns) (inc)"] == 30
+
+
+def test_diff_profiles():
+    with open(cuda_example_file, "r") as f:
+        base = json.load(f)
+    new = copy.deepcopy(base)
+    new[0]["children"][0]["metrics"]["Time (ns)"] *= 2
+    new[0]["children"][1]["metrics"]["Time (ns)"] //= 2
+    rows = diff_profiles(base, new, "Time (ns)")
+    assert [row[0] for row in rows] == [("ROOT", "foo0"), ("ROOT", "foo1")]
+    assert rows[0][2] - rows[0][1] == 204800 and rows[1][2] - rows[1][1] == -102400
+
+
+def test_binary_profile():
+    # example_cuda.binary holds the same profile as example_cuda.json
+    with open(cuda_example_file, "r") as f:
+        json_gf, json_raw_metrics, json_device_info = get_raw_metrics(f)
+    gf, raw_metrics, device_info = get_raw_metrics_from_files([cuda_binary_example_file])
+    assert raw_metrics == json_raw_metrics
+    assert device_info == json_device_info
+    assert gf.dataframe["name"].tolist() == json_gf.dataframe["name"].tolist()
+    assert gf.dataframe["DeviceId"].isna().tolist() == json_gf.dataframe["DeviceId"].isna().tolist()
+    gf.update_inclusive_columns()
+    json_gf.update_inclusive_columns()
+    metrics = ["util", "time/ns", "avg_time/ns", "gbyte/s", "tflop8/s"]
+    derived_metrics = derive_metrics(gf, metrics, raw_metrics, device_info)
+    derive_metrics(json_gf, metrics, json_raw_metrics, json_device_info)
+    for derived_metric in derived_metrics:
+        np.testing.assert_allclose(gf.dataframe[derived_metric].to_numpy(),
+                                   json_gf.dataframe[derived_metric].to_numpy())
+    # Binary and json profiles can be merged
+    tree, _ = read_profiles([cuda_binary_example_file, cuda_example_file])
+    assert [child["metrics"]["Count"] for child in tree["children"]] == [20, 2]
+
+
+def test_binary_profile_version(tmp_path):
+    # Files of another version are rejected up front rather than misread
+    with open(cuda_binary_example_file, "rb") as f:
+        data = bytearray(f.read())
+    data[8:12] = (BinaryProfile.VERSION - 1).to_bytes(4, "little")
+    old_file = tmp_path / "old.binary"
+    old_file.write_bytes(data)
+    with pytest.raises(ValueError, match="not a binary proton profile"):
+        BinaryProfile(str(old_file))
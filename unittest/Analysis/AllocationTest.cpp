@@ -0,0 +1,105 @@
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/Parser/Parser.h"
+#include "triton/Analysis/Allocation.h"
+#include "triton/Dialect/Triton/IR/Dialect.h"
+#include "triton/Dialect/TritonGPU/IR/Dialect.h"
+
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace mlir {
+namespace {
+
+// Builds a function with `numSteps` steps, each of which allocates a buffer
+// that is freed `window` steps later and converts a layout through a scratch
+// buffer, like the unrolled loops of large fused kernels.
+std::string getManyBuffersModule(int numSteps, int window) {
+  std::string src = R"(
+#AL = #triton_gpu.blocked<{sizePerThread = [1, 4], threadsPerWarp = [4, 8], warpsPerCTA = [4, 1], order = [1, 0]}>
+#BL = #triton_gpu.blocked<{sizePerThread = [1, 4], threadsPerWarp = [1, 32], warpsPerCTA = [4, 1], order = [1, 0]}>
+#A_SHARED = #triton_gpu.shared<{vec = 2, perPhase = 2, maxPhase = 4, order = [1, 0]}>
+module attributes {"triton_gpu.num-warps" = 4 : i32, "triton_gpu.num-ctas" = 1 : i32, "triton_gpu.threads-per-warp" = 32 : i32} {
+tt.func @many_buffers() {
+  %cst = arith.constant dense<0.000000e+00> : tensor<16x32xf16, #AL>
+)";
+  const std::string memDesc = "!tt.memdesc<32x16xf16, #A_SHARED, "
+                              "#triton_gpu.shared_memory, mutable>";
+  auto dealloc = [&](int step) {
+    src += "  triton_gpu.local_dealloc %a" + std::to_string(step) + " : " +
+           memDesc + "\n";
+  };
+  for (int step = 0; step < numSteps; ++step) {
+    auto id = std::to_string(step);
+    src += "  %a" + id + " = triton_gpu.local_alloc : () -> " + memDesc + "\n";
+    src += "  %c" + id +
+           " = triton_gpu.convert_layout %cst : tensor<16x32xf16, #AL> -> "
+           "tensor<16x32xf16, #BL>\n";
+    if (step >= window)
+      dealloc(step - window);
+  }
+  for (int step = std::max(0, numSteps - window); step < numSteps; ++step)
+    dealloc(step);
+  src += "  tt.return\n}\n}\n";
+  return src;
+}
+
+class AllocationTest : public ::testing::TestWithParam<int> {
+protected:
+  AllocationTest() {
+    ctx.loadDialect<triton::TritonDialect, triton::gpu::TritonGPUDialect,
+                    arith::ArithDialect>();
+  }
+
+  MLIRContext ctx;
+};
+
+// Also serves as a compile-time benchmark of the allocation analysis, whose
+// time is printed for each number of steps.
+TEST_P(AllocationTest, ManyBuffers) {
+  const int numSteps = GetParam();
+  const int window = 16;
+  auto module = parseSourceString<ModuleOp>(
+      getManyBuffersModule(numSteps, window), ParserConfig(&ctx));
+  ASSERT_TRUE(module);
+
+  auto start = std::chrono::steady_clock::now();
+  ModuleAllocation moduleAllocation(*module);
+  auto elapsed = std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  llvm::outs() << "Allocated " << 2 * numSteps << " buffers in " << elapsed
+               << " ms\n";
+
+  triton::FuncOp funcOp = *module->getOps<triton::FuncOp>().begin();
+  auto *allocation = moduleAllocation.getFuncData(funcOp);
+  EXPECT_LE(allocation->getSharedMemorySize(),
+            allocation->getFirstFitSharedMemorySize());
+  // The buffers that are live at the same time must not overlap
+  for (auto &[op, bufferIds] : allocation->getLiveBuffers()) {
+    for (auto x : bufferIds) {
+      for (auto y : bufferIds) {
+        if (x == y)
+          continue;
+        EXPECT_FALSE(allocation->getAllocatedInterval(x).intersects(
+            allocation->getAllocatedInterval(y)));
+      }
+    }
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Allocation, AllocationTest,
+                         ::testing::Values(64, 256, 1024));
+
+} // namespace
+} // namespace mlir
+
+int main(int argc, char *argv[]) {
+  llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}